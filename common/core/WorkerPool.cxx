@@ -0,0 +1,135 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <algorithm>
+
+#include <core/WorkerPool.h>
+
+using namespace core;
+
+WorkerPool::WorkerPool(size_t concurrency)
+    : job(nullptr), jobCount(0), nextTask(0), activeTasks(0), stopRequested(false) {
+  while (concurrency-- > 1)
+    threads.push_back(new std::thread(&WorkerPool::worker, this));
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    stopRequested = true;
+  }
+  workCond.notify_all();
+
+  while (!threads.empty()) {
+    threads.back()->join();
+    delete threads.back();
+    threads.pop_back();
+  }
+}
+
+void WorkerPool::run(size_t count, const std::function<void(size_t)>& task) {
+  if (count == 0)
+    return;
+
+  // Nothing to gain from waking anyone for a single task
+  if (count == 1 || threads.empty()) {
+    for (size_t i = 0; i < count; i++)
+      task(i);
+    return;
+  }
+
+  std::lock_guard<std::mutex> runLock(runMutex);
+  std::unique_lock<std::mutex> lock(queueMutex);
+
+  job = &task;
+  jobCount = count;
+  nextTask = 0;
+  activeTasks = 0;
+  jobException = nullptr;
+
+  workCond.notify_all();
+
+  // The calling thread helps out rather than just sleeping
+  while (runOne(lock))
+    ;
+
+  doneCond.wait(lock, [this] { return (nextTask >= jobCount) && (activeTasks == 0); });
+
+  job = nullptr;
+
+  if (jobException) {
+    std::exception_ptr e;
+    e = jobException;
+    jobException = nullptr;
+    std::rethrow_exception(e);
+  }
+}
+
+size_t WorkerPool::defaultConcurrency(size_t max) {
+  size_t cpuCount;
+
+  cpuCount = std::thread::hardware_concurrency();
+  if (cpuCount == 0)
+    cpuCount = 1;
+
+  return std::min(cpuCount, max);
+}
+
+void WorkerPool::worker() {
+  std::unique_lock<std::mutex> lock(queueMutex);
+
+  while (!stopRequested) {
+    if (!runOne(lock))
+      workCond.wait(lock);
+  }
+}
+
+bool WorkerPool::runOne(std::unique_lock<std::mutex>& lock) {
+  size_t index;
+  const std::function<void(size_t)>* task;
+
+  if ((job == nullptr) || (nextTask >= jobCount))
+    return false;
+
+  index = nextTask++;
+  task = job;
+  activeTasks++;
+
+  lock.unlock();
+  try {
+    (*task)(index);
+  } catch (...) {
+    lock.lock();
+    if (!jobException)
+      jobException = std::current_exception();
+    // Skip whatever has not been started yet
+    nextTask = jobCount;
+    lock.unlock();
+  }
+  lock.lock();
+
+  activeTasks--;
+  if ((nextTask >= jobCount) && (activeTasks == 0))
+    doneCond.notify_all();
+
+  return true;
+}
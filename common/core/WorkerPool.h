@@ -0,0 +1,85 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef COMMON_CORE_WORKERPOOL_H_
+#define COMMON_CORE_WORKERPOOL_H_
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace core {
+
+/* WorkerPool
+
+   A small fork/join pool for splitting CPU bound work (framebuffer
+   comparison, encoding, compression) across cores. run() hands out
+   task indices 0..count-1 to the worker threads and to the calling
+   thread, and returns once every task has finished. An exception
+   thrown by any task is rethrown from run().
+
+   run() may be called from several threads, but calls are serialised.
+*/
+
+class WorkerPool {
+public:
+  // Creates a pool able to run up to "concurrency" tasks at once. The
+  // calling thread counts towards this, so concurrency - 1 threads are
+  // started.
+  explicit WorkerPool(size_t concurrency);
+  ~WorkerPool();
+
+  size_t concurrency() const {
+    return threads.size() + 1;
+  }
+
+  void run(size_t count, const std::function<void(size_t)>& task);
+
+  // Suggested concurrency when the user has not configured one: the
+  // number of cores, capped at max.
+  static size_t defaultConcurrency(size_t max);
+
+private:
+  void worker();
+  bool runOne(std::unique_lock<std::mutex>& lock);
+
+  std::vector<std::thread*> threads;
+
+  std::mutex runMutex;
+
+  std::mutex queueMutex;
+  std::condition_variable workCond;
+  std::condition_variable doneCond;
+
+  const std::function<void(size_t)>* job;
+  size_t jobCount;
+  size_t nextTask;
+  size_t activeTasks;
+  bool stopRequested;
+
+  std::exception_ptr jobException;
+};
+
+} // namespace core
+
+#endif // COMMON_CORE_WORKERPOOL_H_
@@ -0,0 +1,110 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+
+#include <core/WorkerThread.h>
+
+using namespace core;
+
+WorkerThread::WorkerThread() : thread(nullptr), started(false), done(false), stopRequested(false) {
+  thread = new std::thread(&WorkerThread::worker, this);
+}
+
+WorkerThread::~WorkerThread() {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    // Never pull the rug out from under a running job
+    doneCond.wait(lock, [this] { return !started || done; });
+    stopRequested = true;
+  }
+  workCond.notify_all();
+
+  thread->join();
+  delete thread;
+}
+
+void WorkerThread::start(const std::function<void()>& job_) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  assert(!started);
+
+  job = job_;
+  started = true;
+  done = false;
+  jobException = nullptr;
+
+  workCond.notify_all();
+}
+
+bool WorkerThread::busy() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return started;
+}
+
+bool WorkerThread::finished() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return started && done;
+}
+
+void WorkerThread::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  if (!started)
+    return;
+
+  doneCond.wait(lock, [this] { return done; });
+
+  started = false;
+  job = nullptr;
+
+  if (jobException) {
+    std::exception_ptr e;
+    e = jobException;
+    jobException = nullptr;
+    std::rethrow_exception(e);
+  }
+}
+
+void WorkerThread::worker() {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (!stopRequested) {
+    if (!started || done) {
+      workCond.wait(lock);
+      continue;
+    }
+
+    lock.unlock();
+    try {
+      job();
+    } catch (...) {
+      lock.lock();
+      jobException = std::current_exception();
+      lock.unlock();
+    }
+    lock.lock();
+
+    done = true;
+    doneCond.notify_all();
+  }
+}
@@ -0,0 +1,71 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef COMMON_CORE_WORKERTHREAD_H_
+#define COMMON_CORE_WORKERTHREAD_H_
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace core {
+
+/* WorkerThread
+
+   A single background thread that runs one job at a time on behalf of
+   an owner that has other things to do meanwhile. start() hands over
+   a job, finished() polls for it and wait() blocks until it is done,
+   rethrowing any exception the job threw. A new job can be started
+   once wait() has returned.
+*/
+
+class WorkerThread {
+public:
+  WorkerThread();
+  ~WorkerThread();
+
+  void start(const std::function<void()>& job);
+
+  // A job has been started and not yet waited for
+  bool busy();
+  bool finished();
+
+  void wait();
+
+private:
+  void worker();
+
+  std::thread* thread;
+
+  std::mutex mutex;
+  std::condition_variable workCond;
+  std::condition_variable doneCond;
+
+  std::function<void()> job;
+  bool started;
+  bool done;
+  bool stopRequested;
+
+  std::exception_ptr jobException;
+};
+
+} // namespace core
+
+#endif // COMMON_CORE_WORKERTHREAD_H_
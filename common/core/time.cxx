@@ -47,6 +47,21 @@ unsigned msSince(const struct timeval* then) {
   return msBetween(then, &now);
 }
 
+uint64_t usBetween(const struct timeval* first, const struct timeval* second) {
+  if (isBefore(second, first))
+    return 0;
+
+  return (second->tv_sec - first->tv_sec) * 1000000ULL + (second->tv_usec - first->tv_usec);
+}
+
+uint64_t usSince(const struct timeval* then) {
+  struct timeval now;
+
+  gettimeofday(&now, nullptr);
+
+  return usBetween(then, &now);
+}
+
 unsigned msUntil(const struct timeval* then) {
   struct timeval now;
 
@@ -25,6 +25,7 @@
 #define __CORE_TIME_H__
 
 #include <limits.h>
+#include <stdint.h>
 
 struct timeval;
 
@@ -42,6 +43,10 @@ unsigned msBetween(const struct timeval* first, const struct timeval* second);
 // Returns time elapsed since given moment in milliseconds.
 unsigned msSince(const struct timeval* then);
 
+// Same as msBetween() and msSince(), but in microseconds
+uint64_t usBetween(const struct timeval* first, const struct timeval* second);
+uint64_t usSince(const struct timeval* then);
+
 // Returns time until the given moment in milliseconds.
 unsigned msUntil(const struct timeval* then);
 
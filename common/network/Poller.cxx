@@ -0,0 +1,278 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
+
+#include <core/Exception.h>
+
+#include <network/Poller.h>
+
+using namespace network;
+
+const int Poller::Read;
+const int Poller::Write;
+const int Poller::EdgeTriggered;
+
+#ifdef __linux__
+static uint32_t toEpoll(int events) {
+  uint32_t ev;
+
+  ev = 0;
+  if (events & Poller::Read)
+    ev |= EPOLLIN | EPOLLRDHUP;
+  if (events & Poller::Write)
+    ev |= EPOLLOUT;
+  if (events & Poller::EdgeTriggered)
+    ev |= EPOLLET;
+
+  return ev;
+}
+
+static int fromEpoll(uint32_t ev) {
+  int events;
+
+  // Errors and hangups are reported as readable so that the caller
+  // gets to see them when it tries to read
+  events = 0;
+  if (ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+    events |= Poller::Read;
+  if (ev & EPOLLOUT)
+    events |= Poller::Write;
+
+  return events;
+}
+#endif
+
+Poller::Poller() {
+#ifdef __linux__
+  struct epoll_event ev;
+
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (epollFd < 0)
+    throw core::socket_error("epoll_create1", errno);
+
+  timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timerFd < 0) {
+    int err = errno;
+    ::close(epollFd);
+    throw core::socket_error("timerfd_create", err);
+  }
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = timerFd;
+  if (epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &ev) < 0) {
+    int err = errno;
+    ::close(timerFd);
+    ::close(epollFd);
+    throw core::socket_error("epoll_ctl", err);
+  }
+
+  timerArmed = false;
+#endif
+}
+
+Poller::~Poller() {
+#ifdef __linux__
+  ::close(timerFd);
+  ::close(epollFd);
+#endif
+}
+
+bool Poller::edgeTriggered() {
+#ifdef __linux__
+  return true;
+#else
+  return false;
+#endif
+}
+
+void Poller::add(int fd, int events) {
+#ifdef __linux__
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = toEpoll(events);
+  ev.data.fd = fd;
+  if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+    throw core::socket_error("epoll_ctl", errno);
+#else
+  if (fd >= FD_SETSIZE)
+    throw core::socket_error("select", EMFILE);
+#endif
+
+  fds[fd] = events;
+}
+
+void Poller::modify(int fd, int events) {
+  std::unordered_map<int, int>::iterator iter;
+
+  iter = fds.find(fd);
+  if (iter == fds.end()) {
+    add(fd, events);
+    return;
+  }
+
+  if (iter->second == events)
+    return;
+
+#ifdef __linux__
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = toEpoll(events);
+  ev.data.fd = fd;
+  if (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) < 0)
+    throw core::socket_error("epoll_ctl", errno);
+#endif
+
+  iter->second = events;
+}
+
+void Poller::remove(int fd) {
+  if (fds.erase(fd) == 0)
+    return;
+
+#ifdef __linux__
+  // Might already be closed, which removes it anyway
+  epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+
+  readyEvents.erase(fd);
+}
+
+int Poller::wait(int timeoutMs) {
+  ready.clear();
+  readyEvents.clear();
+
+#ifdef __linux__
+  struct epoll_event events[64];
+  int n;
+
+  // The timeout goes via the timerfd so that it has better than
+  // millisecond precision and is not cut short by unrelated wakeups
+  if (timeoutMs > 0) {
+    struct itimerspec its;
+
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = timeoutMs / 1000;
+    its.it_value.tv_nsec = (timeoutMs % 1000) * 1000000;
+    if (timerfd_settime(timerFd, 0, &its, nullptr) < 0)
+      throw core::socket_error("timerfd_settime", errno);
+    timerArmed = true;
+  } else if (timerArmed) {
+    struct itimerspec its;
+
+    memset(&its, 0, sizeof(its));
+    timerfd_settime(timerFd, 0, &its, nullptr);
+    timerArmed = false;
+  }
+
+  n = epoll_wait(epollFd, events, sizeof(events) / sizeof(events[0]), timeoutMs == 0 ? 0 : -1);
+  if (n < 0) {
+    if (errno == EINTR)
+      return 0;
+    throw core::socket_error("epoll_wait", errno);
+  }
+
+  for (int i = 0; i < n; i++) {
+    Event event;
+
+    if (events[i].data.fd == timerFd) {
+      uint64_t expirations;
+      (void)!read(timerFd, &expirations, sizeof(expirations));
+      timerArmed = false;
+      continue;
+    }
+
+    event.fd = events[i].data.fd;
+    event.events = fromEpoll(events[i].events);
+    ready.push_back(event);
+    readyEvents[event.fd] = event.events;
+  }
+#else
+  fd_set rfds, wfds;
+  struct timeval tv;
+  int maxFd, n;
+
+  FD_ZERO(&rfds);
+  FD_ZERO(&wfds);
+  maxFd = -1;
+
+  for (const std::pair<const int, int>& fd : fds) {
+    if (fd.second & Read)
+      FD_SET(fd.first, &rfds);
+    if (fd.second & Write)
+      FD_SET(fd.first, &wfds);
+    if (fd.first > maxFd)
+      maxFd = fd.first;
+  }
+
+  tv.tv_sec = timeoutMs / 1000;
+  tv.tv_usec = (timeoutMs % 1000) * 1000;
+
+  n = select(maxFd + 1, &rfds, &wfds, nullptr, timeoutMs >= 0 ? &tv : nullptr);
+  if (n < 0) {
+    if (errno == EINTR)
+      return 0;
+    throw core::socket_error("select", errno);
+  }
+
+  for (const std::pair<const int, int>& fd : fds) {
+    Event event;
+
+    event.fd = fd.first;
+    event.events = 0;
+    if (FD_ISSET(fd.first, &rfds))
+      event.events |= Read;
+    if (FD_ISSET(fd.first, &wfds))
+      event.events |= Write;
+
+    if (event.events == 0)
+      continue;
+
+    ready.push_back(event);
+    readyEvents[event.fd] = event.events;
+  }
+#endif
+
+  return ready.size();
+}
+
+int Poller::getEvents(int fd) const {
+  std::unordered_map<int, int>::const_iterator iter;
+
+  iter = readyEvents.find(fd);
+  if (iter == readyEvents.end())
+    return 0;
+
+  return iter->second;
+}
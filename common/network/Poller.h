@@ -0,0 +1,88 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef __NETWORK_POLLER_H__
+#define __NETWORK_POLLER_H__
+
+#include <unordered_map>
+#include <vector>
+
+namespace network {
+
+// Waits for activity on a set of file descriptors, and for timeouts
+// from core::Timer.
+//
+// On Linux this uses epoll, which has no limit on descriptor numbers
+// and only has to look at the descriptors that are actually ready on
+// each wakeup, with the timeout kept in a timerfd. Elsewhere it falls
+// back to select().
+
+class Poller {
+public:
+  Poller();
+  ~Poller();
+
+  static const int Read = 1 << 0;
+  static const int Write = 1 << 1;
+  // Only report when the descriptor becomes ready, rather than for as
+  // long as it is. The caller must then read or write until it would
+  // block. Ignored if edgeTriggered() is false.
+  static const int EdgeTriggered = 1 << 2;
+
+  // edgeTriggered() returns true if the EdgeTriggered flag is honoured.
+  // If not, Write should only be asked for when there is something to
+  // write.
+  static bool edgeTriggered();
+
+  void add(int fd, int events);
+  void modify(int fd, int events);
+  void remove(int fd);
+
+  // wait() blocks until at least one descriptor is ready, timeoutMs
+  // milliseconds have passed, or a signal arrives. A negative timeout
+  // waits forever. Returns the number of ready descriptors.
+  int wait(int timeoutMs);
+
+  // getEvents() returns what the last wait() reported for fd
+  int getEvents(int fd) const;
+
+  struct Event {
+    int fd;
+    int events;
+  };
+
+  // getReady() returns everything the last wait() reported
+  const std::vector<Event>& getReady() const {
+    return ready;
+  }
+
+private:
+  std::unordered_map<int, int> fds;
+  std::vector<Event> ready;
+  std::unordered_map<int, int> readyEvents;
+
+#ifdef __linux__
+  int epollFd;
+  int timerFd;
+  bool timerArmed;
+#endif
+};
+
+} // namespace network
+
+#endif
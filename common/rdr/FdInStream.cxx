@@ -32,6 +32,7 @@
 #else
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #define errorNumber errno
 #endif
@@ -47,13 +48,28 @@
 
 using namespace rdr;
 
-FdInStream::FdInStream(int fd_, bool closeWhenDone_) : fd(fd_), closeWhenDone(closeWhenDone_) {}
+FdInStream::FdInStream(int fd_, bool closeWhenDone_) : fd(fd_), closeWhenDone(closeWhenDone_), acceptFds_(false) {}
 
 FdInStream::~FdInStream() {
+  while (!receivedFds.empty())
+    close(takeFd());
+
   if (closeWhenDone)
     close(fd);
 }
 
+int FdInStream::takeFd() {
+  int passedFd;
+
+  if (receivedFds.empty())
+    return -1;
+
+  passedFd = receivedFds.front();
+  receivedFds.pop_front();
+
+  return passedFd;
+}
+
 bool FdInStream::fillBuffer() {
   size_t n = readFd((uint8_t*)end, availSpace());
   if (n == 0)
@@ -93,7 +109,10 @@ size_t FdInStream::readFd(uint8_t* buf, size_t len) {
     return 0;
 
   do {
-    n = ::recv(fd, (char*)buf, len, 0);
+    if (acceptFds_)
+      n = recvWithFds(buf, len);
+    else
+      n = ::recv(fd, (char*)buf, len, 0);
   } while (n < 0 && errorNumber == EINTR);
 
   if (n < 0)
@@ -103,3 +122,62 @@ size_t FdInStream::readFd(uint8_t* buf, size_t len) {
 
   return n;
 }
+
+//
+// recvWithFds() is recv() that also collects any file descriptors
+// that come with the data.
+//
+
+int FdInStream::recvWithFds(uint8_t* buf, size_t len) {
+#ifdef _WIN32
+  return ::recv(fd, (char*)buf, len, 0);
+#else
+  // More than we ever expect in a single message
+  const int maxPassedFds = 4;
+
+  struct msghdr msg;
+  struct iovec iov;
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int) * maxPassedFds)];
+  } control;
+  struct cmsghdr* cmsg;
+  int n;
+
+  memset(&msg, 0, sizeof(msg));
+
+  iov.iov_base = buf;
+  iov.iov_len = len;
+
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+#ifdef MSG_CMSG_CLOEXEC
+  n = ::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+#else
+  n = ::recvmsg(fd, &msg, 0);
+#endif
+  if (n < 0)
+    return n;
+
+  // If there were more than we have room for, then the system has
+  // closed the rest and whoever expects them will notice
+  for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    size_t count;
+
+    if ((cmsg->cmsg_level != SOL_SOCKET) || (cmsg->cmsg_type != SCM_RIGHTS))
+      continue;
+
+    count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    for (size_t i = 0; i < count; i++) {
+      int passedFd;
+      memcpy(&passedFd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+      receivedFds.push_back(passedFd);
+    }
+  }
+
+  return n;
+#endif
+}
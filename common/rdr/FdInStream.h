@@ -23,6 +23,8 @@
 #ifndef __RDR_FDINSTREAM_H__
 #define __RDR_FDINSTREAM_H__
 
+#include <list>
+
 #include <rdr/BufferedInStream.h>
 
 namespace rdr {
@@ -37,13 +39,26 @@ public:
     return fd;
   }
 
+  // File descriptors passed along with the data (see
+  // FdOutStream::passFd()) are only kept if enabled, and otherwise
+  // closed by the system. Only Unix domain sockets can pass them.
+  void acceptFds(bool enable) {
+    acceptFds_ = enable;
+  }
+  // takeFd() returns the oldest file descriptor received, or -1 if
+  // there is none. The caller becomes responsible for closing it.
+  int takeFd();
+
 private:
   bool fillBuffer() override;
 
   size_t readFd(uint8_t* buf, size_t len);
+  int recvWithFds(uint8_t* buf, size_t len);
 
   int fd;
   bool closeWhenDone;
+  bool acceptFds_;
+  std::list<int> receivedFds;
 };
 
 } // end of namespace rdr
@@ -35,6 +35,7 @@
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #define errorNumber errno
 #endif
@@ -44,6 +45,8 @@
 #include <sys/select.h>
 #endif
 
+#include <stdexcept>
+
 #include <core/Exception.h>
 #include <core/time.h>
 
@@ -61,7 +64,12 @@ FdOutStream::FdOutStream(int fd_)
   gettimeofday(&lastWrite, nullptr);
 }
 
-FdOutStream::~FdOutStream() {}
+FdOutStream::~FdOutStream() {
+#ifndef _WIN32
+  for (int pendingFd : pendingFds)
+    close(pendingFd);
+#endif
+}
 
 unsigned FdOutStream::getIdleTime() {
   return core::msSince(&lastWrite);
@@ -76,6 +84,15 @@ void FdOutStream::cork(bool enable) {
 #endif
 }
 
+void FdOutStream::passFd(int fd_) {
+#ifdef _WIN32
+  (void)fd_;
+  throw std::logic_error("File descriptor passing is not supported");
+#else
+  pendingFds.push_back(fd_);
+#endif
+}
+
 bool FdOutStream::flushBuffer() {
   size_t n = writeFd(sentUpTo, ptr - sentUpTo);
   if (n == 0)
@@ -120,9 +137,9 @@ size_t FdOutStream::writeFd(const uint8_t* data, size_t length) {
     // blocking, which is normally 1. Use MSG_DONTWAIT to avoid
     // blocking, when possible.
 #ifndef MSG_DONTWAIT
-    n = ::send(fd, (const char*)data, length, 0);
+    n = sendWithFds(data, length, 0);
 #else
-    n = ::send(fd, (const char*)data, length, MSG_DONTWAIT);
+    n = sendWithFds(data, length, MSG_DONTWAIT);
 #endif
   } while (n < 0 && (errorNumber == EINTR));
 
@@ -136,3 +153,52 @@ size_t FdOutStream::writeFd(const uint8_t* data, size_t length) {
 
   return n;
 }
+
+//
+// sendWithFds() is send() that also passes any file descriptors
+// waiting to go out.
+//
+
+int FdOutStream::sendWithFds(const uint8_t* data, size_t length, int flags) {
+#ifdef _WIN32
+  return ::send(fd, (const char*)data, length, flags);
+#else
+  struct msghdr msg;
+  struct iovec iov;
+  std::vector<uint8_t> control;
+  struct cmsghdr* cmsg;
+  int n;
+
+  if (pendingFds.empty())
+    return ::send(fd, (const char*)data, length, flags);
+
+  memset(&msg, 0, sizeof(msg));
+
+  iov.iov_base = (void*)data;
+  iov.iov_len = length;
+
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  control.resize(CMSG_SPACE(sizeof(int) * pendingFds.size()));
+  msg.msg_control = control.data();
+  msg.msg_controllen = control.size();
+
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * pendingFds.size());
+  memcpy(CMSG_DATA(cmsg), pendingFds.data(), sizeof(int) * pendingFds.size());
+
+  n = ::sendmsg(fd, &msg, flags);
+  if (n < 0)
+    return n;
+
+  // Our copies are no longer needed once the peer has theirs
+  for (int pendingFd : pendingFds)
+    close(pendingFd);
+  pendingFds.clear();
+
+  return n;
+#endif
+}
@@ -27,6 +27,8 @@
 #include <stdint.h>
 #include <sys/time.h>
 
+#include <vector>
+
 #include <rdr/BufferedOutStream.h>
 
 namespace rdr {
@@ -45,6 +47,13 @@ public:
 
   void cork(bool enable) override;
 
+  // passFd() sends a file descriptor to the peer together with the
+  // next data that goes out, so it arrives no later than anything
+  // written after this call. Only Unix domain sockets can do this.
+  // The stream takes over the file descriptor and closes it once
+  // sent.
+  void passFd(int fd);
+
   // Total number of bytes successfully written on this stream since
   // construction. This is used for coarse-grained per-connection
   // bandwidth statistics in the viewer and server.
@@ -55,7 +64,9 @@ public:
 private:
   bool flushBuffer() override;
   size_t writeFd(const uint8_t* data, size_t length);
+  int sendWithFds(const uint8_t* data, size_t length, int flags);
   int fd;
+  std::vector<int> pendingFds;
   struct timeval lastWrite;
   uint64_t bytesWritten_;
 };
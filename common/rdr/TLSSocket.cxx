@@ -26,12 +26,27 @@
 #include <core/Exception.h>
 #include <core/LogWriter.h>
 
+#include <rdr/FdInStream.h>
+#include <rdr/FdOutStream.h>
 #include <rdr/InStream.h>
 #include <rdr/OutStream.h>
 #include <rdr/TLSException.h>
 #include <rdr/TLSSocket.h>
 
 #include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <linux/tls.h>
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#endif
 
 #ifdef HAVE_GNUTLS
 
@@ -40,7 +55,8 @@ using namespace rdr;
 static core::LogWriter vlog("TLSSocket");
 
 TLSSocket::TLSSocket(InStream* in_, OutStream* out_, gnutls_session_t session_)
-    : session(session_), in(in_), out(out_), tlsin(this), tlsout(this) {
+    : session(session_), in(in_), out(out_), tlsin(this), tlsout(this), kernelFd(-1), kernelTx(false),
+      kernelRx(false) {
   gnutls_transport_set_pull_function(session, [](gnutls_transport_ptr_t sock, void* data, size_t size) {
     return ((TLSSocket*)sock)->pull(data, size);
   });
@@ -103,6 +119,12 @@ void TLSSocket::shutdown() {
     vlog.error("Failed to flush remaining socket data on close: %s", e.what());
   }
 
+  // GnuTLS no longer knows the state of the sending side
+  if (kernelTx) {
+    sendKernelCloseNotify();
+    return;
+  }
+
   // FIXME: We can't currently wait for the response, so we only send
   //        our close and hope for the best
   ret = gnutls_bye(session, GNUTLS_SHUT_WR);
@@ -110,9 +132,270 @@ void TLSSocket::shutdown() {
     vlog.error("TLS shutdown failed: %s", gnutls_strerror(ret));
 }
 
+bool TLSSocket::enableKernelTLS() {
+#if defined(__linux__) && defined(TLS_TX)
+  FdInStream* fdin;
+  FdOutStream* fdout;
+  gnutls_protocol_t version;
+
+  fdin = dynamic_cast<FdInStream*>(in);
+  fdout = dynamic_cast<FdOutStream*>(out);
+  if ((fdin == nullptr) || (fdout == nullptr) || (fdin->getFd() != fdout->getFd()))
+    return false;
+
+  version = gnutls_protocol_get_version(session);
+  if ((version != GNUTLS_TLS1_2) && (version != GNUTLS_TLS1_3)) {
+    vlog.debug("Kernel TLS not supported for %s", gnutls_protocol_get_name(version));
+    return false;
+  }
+
+  switch (gnutls_cipher_get(session)) {
+  case GNUTLS_CIPHER_AES_128_GCM:
+  case GNUTLS_CIPHER_AES_256_GCM:
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+  case GNUTLS_CIPHER_CHACHA20_POLY1305:
+#endif
+    break;
+  default:
+    vlog.debug("Kernel TLS not supported for %s", gnutls_cipher_get_name(gnutls_cipher_get(session)));
+    return false;
+  }
+
+  // Everything GnuTLS has encrypted must be on the wire before the
+  // kernel starts adding records of its own
+  fdout->flush();
+  if (fdout->hasBufferedData() || tlsout.hasBufferedData()) {
+    vlog.debug("Kernel TLS not possible with data still to be sent");
+    return false;
+  }
+
+  if (setsockopt(fdout->getFd(), SOL_TCP, TCP_ULP, "tls", sizeof("tls")) < 0) {
+    vlog.info("Kernel TLS not available: %s", strerror(errno));
+    return false;
+  }
+
+  // Without keys the socket just passes data through, so failing
+  // here leaves the session working as before
+  if (!setKernelKeys(fdout->getFd(), false))
+    return false;
+
+  kernelFd = fdout->getFd();
+  kernelTx = true;
+
+  // TLS 1.3 has handshake messages after the handshake, which only
+  // GnuTLS knows what to do with. Records that have already been
+  // read must also still go through GnuTLS.
+  if ((version == GNUTLS_TLS1_2) && (fdin->avail() == 0) && (gnutls_record_check_pending(session) == 0))
+    kernelRx = setKernelKeys(kernelFd, true);
+
+  vlog.info("Using kernel TLS for %s", kernelRx ? "sending and receiving" : "sending");
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+#if defined(__linux__) && defined(TLS_TX)
+template <class T>
+static bool fillCryptoInfo(T* info, unsigned version, uint16_t cipherType, const gnutls_datum_t& iv,
+                           const gnutls_datum_t& key, const unsigned char* seq) {
+  if (key.size != sizeof(info->key))
+    return false;
+
+  info->info.version = version;
+  info->info.cipher_type = cipherType;
+  memcpy(info->key, key.data, sizeof(info->key));
+  memcpy(info->rec_seq, seq, sizeof(info->rec_seq));
+
+  // TLS 1.2 AES-GCM has an implicit salt and sends the rest of the
+  // nonce, which GnuTLS sets to the sequence number. Otherwise the
+  // whole nonce comes from the key exchange.
+  if ((version == TLS_1_2_VERSION) && (sizeof(info->salt) != 0)) {
+    if (iv.size != sizeof(info->salt))
+      return false;
+    memcpy(info->salt, iv.data, sizeof(info->salt));
+    memcpy(info->iv, seq, sizeof(info->iv));
+  } else {
+    if (iv.size != sizeof(info->salt) + sizeof(info->iv))
+      return false;
+    memcpy(info->salt, iv.data, sizeof(info->salt));
+    memcpy(info->iv, iv.data + sizeof(info->salt), sizeof(info->iv));
+  }
+
+  return true;
+}
+#endif
+
+bool TLSSocket::setKernelKeys(int fd, bool read) {
+#if defined(__linux__) && defined(TLS_TX)
+  union {
+    struct tls12_crypto_info_aes_gcm_128 aes128;
+    struct tls12_crypto_info_aes_gcm_256 aes256;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    struct tls12_crypto_info_chacha20_poly1305 chacha20;
+#endif
+  } info;
+  size_t infoSize;
+
+  gnutls_datum_t iv, key;
+  unsigned char seq[8];
+  unsigned version;
+  bool ok;
+  int ret;
+
+  ret = gnutls_record_get_state(session, read, nullptr, &iv, &key, seq);
+  if (ret != GNUTLS_E_SUCCESS) {
+    vlog.error("Failed to get TLS session keys: %s", gnutls_strerror(ret));
+    return false;
+  }
+
+  version = gnutls_protocol_get_version(session) == GNUTLS_TLS1_3 ? TLS_1_3_VERSION : TLS_1_2_VERSION;
+
+  memset(&info, 0, sizeof(info));
+
+  switch (gnutls_cipher_get(session)) {
+  case GNUTLS_CIPHER_AES_128_GCM:
+    ok = fillCryptoInfo(&info.aes128, version, TLS_CIPHER_AES_GCM_128, iv, key, seq);
+    infoSize = sizeof(info.aes128);
+    break;
+  case GNUTLS_CIPHER_AES_256_GCM:
+    ok = fillCryptoInfo(&info.aes256, version, TLS_CIPHER_AES_GCM_256, iv, key, seq);
+    infoSize = sizeof(info.aes256);
+    break;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+  case GNUTLS_CIPHER_CHACHA20_POLY1305:
+    ok = fillCryptoInfo(&info.chacha20, version, TLS_CIPHER_CHACHA20_POLY1305, iv, key, seq);
+    infoSize = sizeof(info.chacha20);
+    break;
+#endif
+  default:
+    ok = false;
+    infoSize = 0;
+  }
+
+  if (!ok) {
+    vlog.error("Unexpected TLS session key layout");
+    return false;
+  }
+
+  if (setsockopt(fd, SOL_TLS, read ? TLS_RX : TLS_TX, &info, infoSize) < 0) {
+    vlog.info("Kernel TLS not available for %s: %s", read ? "receiving" : "sending", strerror(errno));
+    return false;
+  }
+
+  return true;
+#else
+  (void)fd;
+  (void)read;
+  return false;
+#endif
+}
+
+void TLSSocket::sendKernelCloseNotify() {
+#if defined(__linux__) && defined(TLS_TX)
+  unsigned char alert[2] = {GNUTLS_AL_WARNING, GNUTLS_A_CLOSE_NOTIFY};
+  char control[CMSG_SPACE(sizeof(unsigned char))];
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr* cmsg;
+
+  memset(&msg, 0, sizeof(msg));
+  memset(control, 0, sizeof(control));
+
+  iov.iov_base = alert;
+  iov.iov_len = sizeof(alert);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  // Anything other than application data has to be marked as such
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_TLS;
+  cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+  *CMSG_DATA(cmsg) = 21; // Alert
+
+  if (sendmsg(kernelFd, &msg, MSG_NOSIGNAL) < 0)
+    vlog.error("TLS shutdown failed: %s", strerror(errno));
+#endif
+}
+
+void TLSSocket::readKernelControlRecord() {
+#if defined(__linux__) && defined(TLS_TX)
+  unsigned char record[256];
+  char control[CMSG_SPACE(sizeof(unsigned char))];
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr* cmsg;
+  unsigned char type;
+  ssize_t n;
+
+  memset(&msg, 0, sizeof(msg));
+  memset(control, 0, sizeof(control));
+
+  iov.iov_base = record;
+  iov.iov_len = sizeof(record);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  n = recvmsg(kernelFd, &msg, 0);
+  if (n < 0)
+    throw core::socket_error("read", errno);
+  if (n == 0)
+    throw end_of_stream();
+
+  cmsg = CMSG_FIRSTHDR(&msg);
+  if ((cmsg == nullptr) || (cmsg->cmsg_level != SOL_TLS) || (cmsg->cmsg_type != TLS_GET_RECORD_TYPE))
+    throw tls_error("readTLS", GNUTLS_E_UNEXPECTED_PACKET);
+
+  type = *CMSG_DATA(cmsg);
+
+  // The peer closing the session is the same as a clean EOF
+  if ((type == 21) && (n == 2) && (record[1] == GNUTLS_A_CLOSE_NOTIFY))
+    throw end_of_stream();
+
+  if ((type == 21) && (n == 2)) {
+    if (record[0] == GNUTLS_AL_FATAL)
+      throw tls_error("readTLS", GNUTLS_E_FATAL_ALERT_RECEIVED, record[1]);
+    throw tls_error("readTLS", GNUTLS_E_WARNING_ALERT_RECEIVED, record[1]);
+  }
+
+  // Anything else needs GnuTLS, which no longer has the keys
+  vlog.error("Unexpected TLS record type %d with kernel TLS", type);
+  throw tls_error("readTLS", GNUTLS_E_UNEXPECTED_PACKET);
+#else
+  throw end_of_stream();
+#endif
+}
+
 size_t TLSSocket::readTLS(uint8_t* buf, size_t len) {
   int n;
 
+  // The kernel has already decrypted the data
+  if (kernelRx) {
+    size_t count;
+
+    try {
+      if (!in->hasData(1))
+        return 0;
+    } catch (core::socket_error& e) {
+      // Records other than application data can only be fetched with
+      // recvmsg(), so plain reads fail with EIO when one arrives
+      if (e.err != EIO)
+        throw;
+      readKernelControlRecord();
+    }
+
+    count = std::min(len, in->avail());
+    in->readBytes(buf, count);
+
+    return count;
+  }
+
   while (true) {
     streamEmpty = false;
     n = gnutls_record_recv(session, (void*)buf, len);
@@ -145,6 +428,12 @@ size_t TLSSocket::readTLS(uint8_t* buf, size_t len) {
 size_t TLSSocket::writeTLS(const uint8_t* data, size_t length) {
   int n;
 
+  // The kernel will encrypt the data
+  if (kernelTx) {
+    out->writeBytes(data, length);
+    return length;
+  }
+
   n = gnutls_record_send(session, data, length);
   if (n == GNUTLS_E_INTERRUPTED || n == GNUTLS_E_AGAIN)
     return 0;
@@ -195,6 +484,15 @@ ssize_t TLSSocket::pull(void* data, size_t size) {
 ssize_t TLSSocket::push(const void* data, size_t size) {
   saved_exception = nullptr;
 
+  // GnuTLS might want to answer a key update, but its keys are no
+  // longer the ones in use
+  if (kernelTx) {
+    vlog.error("Cannot send TLS control messages with kernel TLS");
+    gnutls_transport_set_errno(session, EIO);
+    saved_exception = std::make_exception_ptr(tls_error("push", GNUTLS_E_PUSH_ERROR));
+    return -1;
+  }
+
   try {
     out->writeBytes((const uint8_t*)data, size);
     out->flush();
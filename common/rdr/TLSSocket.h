@@ -53,6 +53,14 @@ public:
   bool handshake();
   void shutdown();
 
+  // enableKernelTLS() hands the session keys to the kernel after the
+  // handshake, so that data is encrypted, and if possible decrypted,
+  // there rather than by GnuTLS. The underlying streams must be
+  // FdInStream and FdOutStream for a TCP socket. Returns false and
+  // leaves the session as it was if the kernel, the cipher or the
+  // state of the streams doesn't allow it.
+  bool enableKernelTLS();
+
 protected:
   /* Used by the stream classes */
   size_t readTLS(uint8_t* buf, size_t len);
@@ -65,6 +73,12 @@ private:
   ssize_t pull(void* data, size_t size);
   ssize_t push(const void* data, size_t size);
 
+  bool setKernelKeys(int fd, bool read);
+  void sendKernelCloseNotify();
+  // Reads a non-application data record from a kernel TLS socket,
+  // and throws the appropriate exception for it
+  void readKernelControlRecord();
+
   gnutls_session_t session;
 
   InStream* in;
@@ -75,6 +89,10 @@ private:
 
   bool streamEmpty;
 
+  int kernelFd;
+  bool kernelTx;
+  bool kernelRx;
+
   std::exception_ptr saved_exception;
 };
 
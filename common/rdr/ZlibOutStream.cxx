@@ -21,9 +21,13 @@
 #include <config.h>
 #endif
 
+#include <assert.h>
 #include <stdio.h>
 
+#include <algorithm>
+
 #include <core/LogWriter.h>
+#include <core/WorkerPool.h>
 
 #include <rdr/ZlibOutStream.h>
 
@@ -35,18 +39,85 @@ static core::LogWriter vlog("ZlibOutStream");
 
 using namespace rdr;
 
-ZlibOutStream::ZlibOutStream(OutStream* os, int compressLevel)
-    : underlying(os), compressionLevel(compressLevel), newLevel(compressLevel) {
+// The streams are raw deflate streams with the zlib header written by
+// us, as zlib only allows replacing the dictionary of a raw stream
+// once it has produced output
+static const int WindowBits = 15;
+static const size_t WindowSize = 1 << WindowBits;
+
+// Every chunk must be larger than the window, as the window of the
+// next chunk is taken from its end
+static const size_t ParallelChunkMinSize = 64 * 1024;
+
+// Input is held back while corked in parallel mode, up to this much
+static const size_t ParallelMaxPending = 4 * 1024 * 1024;
+
+static core::WorkerPool* deflatePool() {
+  static core::WorkerPool pool(core::WorkerPool::defaultConcurrency(16));
+  return &pool;
+}
+
+static z_stream* createStream(int level) {
+  z_stream* zs;
+
   zs = new z_stream;
   zs->zalloc = nullptr;
   zs->zfree = nullptr;
   zs->opaque = nullptr;
   zs->next_in = nullptr;
   zs->avail_in = 0;
-  if (deflateInit(zs, compressLevel) != Z_OK) {
+  if (deflateInit2(zs, level, Z_DEFLATED, -WindowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
     delete zs;
     throw std::runtime_error("ZlibOutStream: deflateInit failed");
   }
+
+  return zs;
+}
+
+static void destroyStream(z_stream* zs) {
+  deflateEnd(zs);
+  delete zs;
+}
+
+// Compresses one chunk of a parallel flush on its own, ending on a
+// byte boundary so that it can simply be appended to the previous one
+static void deflateChunk(z_stream* zs, const uint8_t* data, size_t length, std::vector<uint8_t>* out) {
+  size_t used;
+
+  if (deflateReset(zs) != Z_OK)
+    throw std::runtime_error("ZlibOutStream: deflateReset failed");
+  if (deflateSetDictionary(zs, data - WindowSize, WindowSize) != Z_OK)
+    throw std::runtime_error("ZlibOutStream: deflateSetDictionary failed");
+
+  out->resize(deflateBound(zs, length) + 16);
+
+  zs->next_in = (uint8_t*)data;
+  zs->avail_in = length;
+
+  used = 0;
+  while (true) {
+    int rc;
+
+    zs->next_out = out->data() + used;
+    zs->avail_out = out->size() - used;
+
+    rc = ::deflate(zs, Z_SYNC_FLUSH);
+    if ((rc < 0) && (rc != Z_BUF_ERROR))
+      throw std::runtime_error("ZlibOutStream: deflate failed");
+
+    used = out->size() - zs->avail_out;
+    if (zs->avail_out != 0)
+      break;
+
+    out->resize(out->size() * 2);
+  }
+
+  out->resize(used);
+}
+
+ZlibOutStream::ZlibOutStream(OutStream* os, int compressLevel)
+    : underlying(os), compressionLevel(compressLevel), newLevel(compressLevel), headerPending(true), threads(1) {
+  zs = createStream(compressLevel);
 }
 
 ZlibOutStream::~ZlibOutStream() {
@@ -54,8 +125,9 @@ ZlibOutStream::~ZlibOutStream() {
     flush();
   } catch (std::exception&) {
   }
-  deflateEnd(zs);
-  delete zs;
+  destroyStream(zs);
+  for (z_stream* cs : chunkStreams)
+    destroyStream(cs);
 }
 
 void ZlibOutStream::setUnderlying(OutStream* os) {
@@ -71,6 +143,30 @@ void ZlibOutStream::setCompressionLevel(int level) {
   newLevel = level;
 }
 
+void ZlibOutStream::reset() {
+  if (underlying != nullptr)
+    flush();
+
+  if (deflateReset(zs) != Z_OK)
+    throw std::runtime_error("ZlibOutStream: deflateReset failed");
+  headerPending = true;
+
+  // Nothing is buffered after a reset, so the level can be changed
+  // without the extra flush checkCompressionLevel() has to do
+  if (newLevel != compressionLevel) {
+    if (deflateParams(zs, newLevel, Z_DEFAULT_STRATEGY) != Z_OK)
+      throw std::runtime_error("ZlibOutStream: deflateParams failed");
+    compressionLevel = newLevel;
+  }
+}
+
+void ZlibOutStream::setThreads(int threads_) {
+  if (threads_ <= 0)
+    threads_ = deflatePool()->concurrency();
+
+  threads = threads_;
+}
+
 void ZlibOutStream::flush() {
   BufferedOutStream::flush();
   if (underlying != nullptr)
@@ -84,6 +180,22 @@ void ZlibOutStream::cork(bool enable) {
 }
 
 bool ZlibOutStream::flushBuffer() {
+  if (threads > 1) {
+    size_t pending;
+
+    pending = ptr - sentUpTo;
+
+    // Collect as much as possible before splitting it up
+    if (corked && (pending < ParallelMaxPending))
+      return false;
+
+    if (pending >= ParallelChunkMinSize * 2) {
+      checkCompressionLevel();
+      deflateParallel();
+      return true;
+    }
+  }
+
   checkCompressionLevel();
 
   zs->next_in = sentUpTo;
@@ -110,6 +222,31 @@ void ZlibOutStream::deflate(int flush) {
   if ((flush == Z_NO_FLUSH) && (zs->avail_in == 0))
     return;
 
+  if (headerPending) {
+    unsigned header, levelFlags;
+
+    // Same header as deflate() would have written
+    if (compressionLevel == -1)
+      levelFlags = 2;
+    else if (compressionLevel < 2)
+      levelFlags = 0;
+    else if (compressionLevel < 6)
+      levelFlags = 1;
+    else if (compressionLevel == 6)
+      levelFlags = 2;
+    else
+      levelFlags = 3;
+
+    header = (Z_DEFLATED + ((WindowBits - 8) << 4)) << 8;
+    header |= levelFlags << 6;
+    header += 31 - (header % 31);
+
+    underlying->writeU8(header >> 8);
+    underlying->writeU8(header & 0xff);
+
+    headerPending = false;
+  }
+
   do {
     size_t chunk;
     zs->next_out = underlying->getptr(1);
@@ -136,6 +273,67 @@ void ZlibOutStream::deflate(int flush) {
   } while (zs->avail_out == 0);
 }
 
+void ZlibOutStream::deflateParallel() {
+  const uint8_t* data;
+  size_t length, count, chunkSize;
+
+  data = sentUpTo;
+  length = ptr - sentUpTo;
+
+  count = std::min((size_t)threads, length / ParallelChunkMinSize);
+  assert(count >= 2);
+  chunkSize = length / count;
+
+  // The first chunk continues the main stream, so only the others need
+  // streams of their own
+  while (chunkStreams.size() < count - 1) {
+    chunkStreams.push_back(createStream(compressionLevel));
+    chunkLevels.push_back(compressionLevel);
+  }
+  for (size_t i = 0; i < count - 1; i++) {
+    if (chunkLevels[i] == compressionLevel)
+      continue;
+    destroyStream(chunkStreams[i]);
+    chunkStreams[i] = nullptr;
+    chunkStreams[i] = createStream(compressionLevel);
+    chunkLevels[i] = compressionLevel;
+  }
+  chunkOutput.resize(count - 1);
+
+#ifdef ZLIBOUT_DEBUG
+  vlog.debug("Parallel flush: %d bytes in %d chunks", (int)length, (int)count);
+#endif
+
+  deflatePool()->run(count, [&](size_t i) {
+    const uint8_t* chunk;
+    size_t chunkLength;
+
+    chunk = data + i * chunkSize;
+    if (i == count - 1)
+      chunkLength = length - i * chunkSize;
+    else
+      chunkLength = chunkSize;
+
+    if (i == 0) {
+      zs->next_in = (uint8_t*)chunk;
+      zs->avail_in = chunkLength;
+      deflate(Z_SYNC_FLUSH);
+      return;
+    }
+
+    deflateChunk(chunkStreams[i - 1], chunk, chunkLength, &chunkOutput[i - 1]);
+  });
+
+  for (size_t i = 0; i < count - 1; i++)
+    underlying->writeBytes(chunkOutput[i].data(), chunkOutput[i].size());
+
+  // The main stream has to carry on from the end of the last chunk
+  if (deflateSetDictionary(zs, ptr - WindowSize, WindowSize) != Z_OK)
+    throw std::runtime_error("ZlibOutStream: deflateSetDictionary failed");
+
+  sentUpTo = ptr;
+}
+
 void ZlibOutStream::checkCompressionLevel() {
   int rc;
 
@@ -25,6 +25,8 @@
 #ifndef __RDR_ZLIBOUTSTREAM_H__
 #define __RDR_ZLIBOUTSTREAM_H__
 
+#include <vector>
+
 #include <rdr/BufferedOutStream.h>
 
 struct z_stream_s;
@@ -39,18 +41,33 @@ public:
 
   void setUnderlying(OutStream* os);
   void setCompressionLevel(int level = -1);
+  // Starts over with an empty dictionary, as if newly created. Any
+  // buffered data is flushed first.
+  void reset();
+  // Lets large flushes be split up in chunks that are compressed
+  // concurrently, each primed with the end of the previous chunk. The
+  // output is still a single stream. 0 means one per core, and 1
+  // (the default) turns this off.
+  void setThreads(int threads);
   void flush() override;
   void cork(bool enable) override;
 
 private:
   bool flushBuffer() override;
   void deflate(int flush);
+  void deflateParallel();
   void checkCompressionLevel();
 
   OutStream* underlying;
   int compressionLevel;
   int newLevel;
   z_stream_s* zs;
+  bool headerPending;
+
+  int threads;
+  std::vector<z_stream_s*> chunkStreams;
+  std::vector<int> chunkLevels;
+  std::vector<std::vector<uint8_t>> chunkOutput;
 };
 
 } // end of namespace rdr
@@ -0,0 +1,209 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <limits.h>
+#include <string.h>
+
+#include <core/time.h>
+
+#include <rfb/BandwidthModel.h>
+
+using namespace rfb;
+
+// How many round trips a bandwidth sample is remembered for
+static const unsigned BandwidthWindow = 10;
+
+// How many seconds a latency sample is remembered for
+static const unsigned RTTWindow = 10;
+
+// The bandwidth has stopped growing once it has grown by less than a
+// quarter for this many round trips
+static const unsigned FullBandwidthRounds = 3;
+
+// Pacing gains in percent. Startup doubles the rate every round trip,
+// then each round trip of the cycle probes for more bandwidth, drains
+// the queue that probing created, and cruises.
+static const unsigned StartupGain = 289;
+static const unsigned CycleGains[] = {125, 75, 100, 100, 100, 100, 100, 100};
+static const unsigned CycleLength = sizeof(CycleGains) / sizeof(CycleGains[0]);
+
+// Compare position even when wrapped around
+static inline bool isAfter(unsigned a, unsigned b) {
+  return a != b && a - b <= UINT_MAX / 2;
+}
+
+BandwidthModel::BandwidthModel()
+    : haveDelivered(false), delivered(0), round(0), roundEnd(0), roundEndValid(false), roundAppLimited(true),
+      startup(true), fullBandwidth(0), fullBandwidthRounds(0), cycleIndex(0) {
+  memset(&deliveredTime, 0, sizeof(deliveredTime));
+  memset(&firstSent, 0, sizeof(firstSent));
+  memset(&cycleStart, 0, sizeof(cycleStart));
+}
+
+void BandwidthModel::sentMarker(const struct timeval* now, unsigned pos, bool appLimited) {
+  Marker marker;
+
+  // Nothing in flight, so the time spent idle must not count against
+  // the next sample
+  if (markers.empty() && haveDelivered) {
+    deliveredTime = *now;
+    firstSent = *now;
+  }
+
+  marker.sent = *now;
+  marker.pos = pos;
+  marker.appLimited = appLimited;
+
+  marker.haveDelivered = haveDelivered;
+  marker.delivered = delivered;
+  marker.deliveredTime = deliveredTime;
+  marker.firstSent = firstSent;
+
+  markers.push_back(marker);
+}
+
+void BandwidthModel::ackedMarker(const struct timeval* now) {
+  Marker marker;
+  unsigned rtt;
+
+  if (markers.empty())
+    return;
+
+  marker = markers.front();
+  markers.pop_front();
+
+  rtt = core::usBetween(&marker.sent, now);
+  if (rtt < 1)
+    rtt = 1;
+  addRTTSample(now, rtt);
+
+  haveDelivered = true;
+  delivered = marker.pos;
+  deliveredTime = *now;
+  firstSent = marker.sent;
+
+  if (marker.haveDelivered) {
+    unsigned bytes;
+    uint64_t sendElapsed, ackElapsed, interval;
+
+    bytes = marker.pos - marker.delivered;
+
+    // Data can be acknowledged in bursts, and the rate it was sent at
+    // is then the better guess
+    sendElapsed = core::usBetween(&marker.firstSent, &marker.sent);
+    ackElapsed = core::usBetween(&marker.deliveredTime, now);
+    interval = sendElapsed > ackElapsed ? sendElapsed : ackElapsed;
+
+    // An interval below the wire latency is not a real measurement
+    if ((bytes > 0) && (interval >= getMinRTT()) && (interval > 0))
+      addBandwidthSample((uint64_t)bytes * 1000000 / interval, marker.appLimited);
+
+    // A round trip ends once everything that had been acknowledged
+    // when it started has been
+    if (!roundEndValid || !isAfter(roundEnd, marker.delivered)) {
+      roundEnd = delivered;
+      roundEndValid = true;
+      roundAppLimited = marker.appLimited;
+      startRound();
+    }
+  }
+
+  if (!startup) {
+    if (core::usBetween(&cycleStart, now) > getMinRTT()) {
+      cycleIndex = (cycleIndex + 1) % CycleLength;
+      cycleStart = *now;
+    }
+  }
+}
+
+size_t BandwidthModel::getBandwidth() const {
+  if (bandwidthSamples.empty())
+    return 0;
+
+  return bandwidthSamples.front().bandwidth;
+}
+
+unsigned BandwidthModel::getMinRTT() const {
+  if (rttSamples.empty())
+    return 0;
+
+  return rttSamples.front().rtt;
+}
+
+size_t BandwidthModel::getPacingRate() const {
+  unsigned gain;
+
+  if (startup)
+    gain = StartupGain;
+  else
+    gain = CycleGains[cycleIndex];
+
+  return (uint64_t)getBandwidth() * gain / 100;
+}
+
+void BandwidthModel::addBandwidthSample(size_t bandwidth, bool appLimited) {
+  if (appLimited && (bandwidth <= getBandwidth()))
+    return;
+
+  while (!bandwidthSamples.empty() && (bandwidthSamples.back().bandwidth <= bandwidth))
+    bandwidthSamples.pop_back();
+
+  bandwidthSamples.push_back({round, bandwidth});
+}
+
+void BandwidthModel::addRTTSample(const struct timeval* now, unsigned rtt) {
+  while (!rttSamples.empty() && (core::usBetween(&rttSamples.front().time, now) > RTTWindow * 1000000ULL))
+    rttSamples.pop_front();
+
+  while (!rttSamples.empty() && (rttSamples.back().rtt >= rtt))
+    rttSamples.pop_back();
+
+  rttSamples.push_back({*now, rtt});
+}
+
+void BandwidthModel::startRound() {
+  size_t bandwidth;
+
+  round++;
+
+  // Keep the newest sample even if it is too old, as it is still the
+  // best guess we have
+  while ((bandwidthSamples.size() > 1) && (round - bandwidthSamples.front().round >= BandwidthWindow))
+    bandwidthSamples.pop_front();
+
+  if (!startup || roundAppLimited)
+    return;
+
+  bandwidth = getBandwidth();
+  if (bandwidth >= fullBandwidth + fullBandwidth / 4) {
+    fullBandwidth = bandwidth;
+    fullBandwidthRounds = 0;
+    return;
+  }
+
+  fullBandwidthRounds++;
+  if (fullBandwidthRounds >= FullBandwidthRounds) {
+    startup = false;
+    cycleIndex = 0;
+    cycleStart = deliveredTime;
+  }
+}
@@ -0,0 +1,127 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef __RFB_BANDWIDTHMODEL_H__
+#define __RFB_BANDWIDTHMODEL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include <deque>
+
+namespace rfb {
+
+// Estimates the bottleneck bandwidth and the wire latency of a
+// connection in the way of BBR, from when markers placed on the
+// outgoing stream are acknowledged.
+//
+// Every acknowledgement gives a delivery rate sample, i.e. how many
+// bytes made it through since the previous acknowledgement and over
+// what time. The bandwidth estimate is the highest sample over the
+// last few round trips, and the latency the lowest round trip time
+// seen over the last ten seconds. Samples taken while the sender had
+// nothing more to send are only used if they raise the estimate, as
+// they cannot tell how much more the link could have carried.
+
+class BandwidthModel {
+public:
+  BandwidthModel();
+
+  // sentMarker() must be called when a marker is placed at the given
+  // stream position, and ackedMarker() when the oldest marker not yet
+  // acknowledged is. If the sender was not using all of the
+  // connection at the time, appLimited should be set.
+  void sentMarker(const struct timeval* now, unsigned pos, bool appLimited);
+  void ackedMarker(const struct timeval* now);
+
+  // getBandwidth() returns the bottleneck bandwidth in bytes per
+  // second, or 0 if there is no estimate yet.
+  size_t getBandwidth() const;
+
+  // getMinRTT() returns the wire latency in microseconds, or 0 if
+  // there is no estimate yet.
+  unsigned getMinRTT() const;
+
+  // getPacingRate() returns the rate at which data should be sent
+  // right now in bytes per second, or 0 if unknown. It goes above the
+  // bandwidth estimate while probing for more.
+  size_t getPacingRate() const;
+
+  // inStartup() is true until the bandwidth estimate has stopped
+  // growing, i.e. the link has been filled.
+  bool inStartup() const {
+    return startup;
+  }
+
+private:
+  void addBandwidthSample(size_t bandwidth, bool appLimited);
+  void addRTTSample(const struct timeval* now, unsigned rtt);
+  void startRound();
+
+  struct Marker {
+    struct timeval sent;
+    unsigned pos;
+    bool appLimited;
+
+    // What had been acknowledged when the marker was sent
+    unsigned delivered;
+    struct timeval deliveredTime;
+    struct timeval firstSent;
+    bool haveDelivered;
+  };
+
+  std::deque<Marker> markers;
+
+  // Position and time of the most recent acknowledgement, and when
+  // that marker was sent
+  bool haveDelivered;
+  unsigned delivered;
+  struct timeval deliveredTime;
+  struct timeval firstSent;
+
+  // A round trip ends when a marker sent after it started is acked
+  unsigned round;
+  unsigned roundEnd;
+  bool roundEndValid;
+  bool roundAppLimited;
+
+  // Windowed maximum and minimum, kept as monotonic queues
+  struct BandwidthSample {
+    unsigned round;
+    size_t bandwidth;
+  };
+  struct RTTSample {
+    struct timeval time;
+    unsigned rtt;
+  };
+
+  std::deque<BandwidthSample> bandwidthSamples;
+  std::deque<RTTSample> rttSamples;
+
+  bool startup;
+  size_t fullBandwidth;
+  unsigned fullBandwidthRounds;
+
+  unsigned cycleIndex;
+  struct timeval cycleStart;
+};
+
+} // namespace rfb
+
+#endif
@@ -42,6 +42,7 @@
 #include <rfb/PixelBuffer.h>
 #include <rfb/Security.h>
 #include <rfb/SecurityClient.h>
+#include <rfb/SharedPixelBuffer.h>
 #include <rfb/clipboardTypes.h>
 #include <rfb/fenceTypes.h>
 #include <rfb/screenTypes.h>
@@ -72,11 +73,12 @@ static bool isFBHashDebugEnabled() {
 CConnection::CConnection()
     : csecurity(nullptr), supportsLocalCursor(false), supportsCursorPosition(false), supportsDesktopResize(false),
       supportsLEDState(false), supportsContentCache(true), supportsPersistentCache(true),
-      supportsNativeFormatCache_(true), is(nullptr), os(nullptr), reader_(nullptr), writer_(nullptr), shared(false),
-      state_(RFBSTATE_UNINITIALISED), pendingPFChange(false), preferredEncoding(encodingTight), compressLevel(2),
-      qualityLevel(-1), formatChange(false), encodingChange(false), firstUpdate(true), pendingUpdate(false),
-      continuousUpdates(false), forceNonincremental(true), framebuffer(nullptr), decoder(this),
-      hasRemoteClipboard(false), hasLocalClipboard(false) {}
+      supportsNativeFormatCache_(true), supportsLossyRefinement(true), supportsSharedMemory(false), is(nullptr),
+      os(nullptr), reader_(nullptr), writer_(nullptr), shared(false), state_(RFBSTATE_UNINITIALISED),
+      pendingPFChange(false), preferredEncoding(encodingTight), compressLevel(2), qualityLevel(-1),
+      formatChange(false), encodingChange(false), firstUpdate(true), pendingUpdate(false), continuousUpdates(false),
+      forceNonincremental(true), framebuffer(nullptr), decoder(this), sharedFramebuffer(nullptr),
+      sharedGeneration(0), hasRemoteClipboard(false), hasLocalClipboard(false) {}
 
 CConnection::~CConnection() {
   close();
@@ -405,11 +407,6 @@ void CConnection::securityCompleted() {
   writer_ = new CMsgWriter(&server, os);
   vlog.debug("Authentication success!");
   writer_->writeClientInit(shared);
-
-  // After authentication is complete and the CMsgWriter exists, advertise any
-  // hashes loaded from the client-side PersistentCache so the server can
-  // immediately exploit a warm cache.
-  decoder.advertisePersistentCacheHashes();
 }
 
 void CConnection::close() {
@@ -426,6 +423,8 @@ void CConnection::close() {
   }
 
   setFramebuffer(nullptr);
+  delete sharedFramebuffer;
+  sharedFramebuffer = nullptr;
   delete csecurity;
   csecurity = nullptr;
   delete reader_;
@@ -1049,6 +1048,9 @@ void CConnection::updateEncodings() {
     // a guaranteed miss (server didn't know we had the hash).
     decoder.triggerPersistentCacheLoad();
     encodings.push_back(pseudoEncodingPersistentCache);
+    encodings.push_back(pseudoEncodingPersistentCacheEpoch);
+    encodings.push_back(encodingPersistentCachedRectDelta);
+    encodings.push_back(encodingGlyphRect);
     if (supportsNativeFormatCache_) {
       encodings.push_back(pseudoEncodingNativeFormatCache);
       vlog.info("Cache protocol: advertising NativeFormatCache (-327)");
@@ -1056,6 +1058,14 @@ void CConnection::updateEncodings() {
     vlog.info("Cache protocol: advertising PersistentCache (-321)");
   }
 
+  if (supportsLossyRefinement)
+    encodings.push_back(encodingLossyRefinement);
+
+  if (supportsSharedMemory) {
+    encodings.push_back(pseudoEncodingSharedMemory);
+    encodings.push_back(encodingSharedMemory);
+  }
+
   if (Decoder::supported(preferredEncoding)) {
     encodings.push_back(preferredEncoding);
   }
@@ -1073,6 +1083,13 @@ void CConnection::updateEncodings() {
     encodings.push_back(pseudoEncodingQualityLevel0 + qualityLevel);
 
   writer()->writeSetEncodings(encodings);
+
+  // Advertise the hashes loaded from the client-side PersistentCache so
+  // the server can immediately exploit a warm cache. This has to follow
+  // SetEncodings, as the server only answers with an epoch to clients
+  // it knows support them.
+  if (supportsPersistentCache)
+    decoder.advertisePersistentCacheHashes();
 }
 
 void CConnection::handleCachedRect(const core::Rect& r, const CacheKey& key) {
@@ -1147,6 +1164,78 @@ void CConnection::storePersistentCachedRect(const core::Rect& r, const CacheKey&
   decoder.storePersistentCachedRect(r, key, encoding, framebuffer);
 }
 
+void CConnection::handlePersistentCachedRectDelta(const core::Rect& r, const CacheKey& baseKey, const CacheKey& newKey,
+                                                  const uint8_t* data, size_t length) {
+  // A delta is only ever sent against content the server has seen us
+  // receive, so the protocol has already been negotiated by now
+  decoder.handlePersistentCachedRectDelta(r, baseKey, newKey, data, length, framebuffer);
+}
+
+void CConnection::handleGlyphRect(const core::Rect& r, uint8_t flags, uint8_t cellW, uint8_t cellH, uint8_t ox,
+                                  uint8_t oy, const uint8_t* data, size_t length) {
+  decoder.handleGlyphRect(r, flags, cellW, cellH, ox, oy, data, length, framebuffer);
+}
+
+void CConnection::handleLossyRefinement(const core::Rect& r, uint64_t baseHash, const uint8_t* data, size_t length) {
+  if (decoder.handleLossyRefinement(r, baseHash, data, length, framebuffer))
+    return;
+
+  // Our pixels aren't what the server thinks they are, most likely
+  // because our JPEG decoder rounds differently. Get the real pixels
+  // the normal way, and don't let this happen again.
+  vlog.info("Lossy refinement: unexpected pixels at %dx%d+%d+%d, disabling", r.width(), r.height(), r.tl.x,
+            r.tl.y);
+  writer()->writeFramebufferUpdateRequest(r, false);
+
+  supportsLossyRefinement = false;
+  encodingChange = true;
+}
+
+void CConnection::setSharedFramebuffer(uint32_t generation, int width, int height, int stride,
+                                       const PixelFormat& pf) {
+  int fd;
+
+  decoder.flush();
+
+  delete sharedFramebuffer;
+  sharedFramebuffer = nullptr;
+
+  fd = takePassedFd();
+
+  try {
+    if (fd < 0)
+      throw std::runtime_error("No file descriptor received");
+
+    sharedFramebuffer = new SharedPixelBuffer(fd, pf, width, height, stride);
+    sharedGeneration = generation;
+
+    vlog.info("SharedMemory: using a %dx%d shared framebuffer (generation %u)", width, height, generation);
+  } catch (std::exception& e) {
+    // Anything sent via the buffer we don't have needs to be sent
+    // again, the normal way
+    vlog.error("SharedMemory: %s, disabling", e.what());
+
+    supportsSharedMemory = false;
+    encodingChange = true;
+    refreshFramebuffer();
+  }
+}
+
+void CConnection::handleSharedMemoryRect(const core::Rect& r, uint32_t generation) {
+  // Already disabled, and a full refresh is on the way
+  if (sharedFramebuffer == nullptr)
+    return;
+
+  if (generation != sharedGeneration)
+    throw protocol_error(core::format("SharedMemory: unknown generation %u", generation));
+
+  decoder.handleSharedMemoryRect(r, sharedFramebuffer, framebuffer);
+}
+
+int CConnection::takePassedFd() {
+  return -1;
+}
+
 void CConnection::seedCachedRect(const core::Rect& r, const CacheKey& key) {
   // Server tells us to take existing framebuffer pixels at rect R and
   // associate them with cache ID. This is used for whole-rectangle caching
@@ -1159,3 +1248,7 @@ void CConnection::seedCachedRect(const core::Rect& r, const CacheKey& key) {
   // Use encodingRaw as the "encoding" since we're reading raw pixels from framebuffer.
   decoder.seedCachedRect(r, key, framebuffer);
 }
+
+void CConnection::setPersistentCacheEpoch(uint64_t token) {
+  decoder.setPersistentCacheEpoch(token);
+}
@@ -42,6 +42,7 @@ namespace rfb {
 class CMsgReader;
 class CMsgWriter;
 class CSecurity;
+class SharedPixelBuffer;
 
 enum MsgBoxFlags {
   M_OK = 0,
@@ -266,10 +267,18 @@ protected:
   void handlePersistentCachedRectWithOffset(const core::Rect& r, const CacheKey& key, uint16_t ox, uint16_t oy,
                                             uint16_t cachedW, uint16_t cachedH) override;
   void storePersistentCachedRect(const core::Rect& r, const CacheKey& key, int encoding) override;
+  void handlePersistentCachedRectDelta(const core::Rect& r, const CacheKey& baseKey, const CacheKey& newKey,
+                                       const uint8_t* data, size_t length) override;
+  void handleGlyphRect(const core::Rect& r, uint8_t flags, uint8_t cellW, uint8_t cellH, uint8_t ox, uint8_t oy,
+                       const uint8_t* data, size_t length) override;
+  void handleLossyRefinement(const core::Rect& r, uint64_t baseHash, const uint8_t* data, size_t length) override;
+  void setSharedFramebuffer(uint32_t generation, int width, int height, int stride, const PixelFormat& pf) override;
+  void handleSharedMemoryRect(const core::Rect& r, uint32_t generation) override;
 
   // Cache seed: server tells client to associate existing framebuffer pixels
   // at rect R with cache ID. Used for whole-rectangle caching.
   void seedCachedRect(const core::Rect& r, const CacheKey& key) override;
+  void setPersistentCacheEpoch(uint64_t token) override;
 
   // Methods to be overridden in a derived class
 
@@ -304,6 +313,11 @@ protected:
   // server received the request.
   virtual void handleClipboardData(const char* data);
 
+  // takePassedFd() returns a file descriptor that the server passed
+  // along with its messages, or -1 if there is none. A subclass that
+  // sets supportsSharedMemory must provide this.
+  virtual int takePassedFd();
+
 protected:
   CSecurity* csecurity;
   SecurityClient security;
@@ -343,6 +357,12 @@ protected:
   bool supportsPersistentCache;
   bool supportsNativeFormatCache_;
 
+  // Dropped if our JPEG decoder turns out not to agree with the server's
+  bool supportsLossyRefinement;
+
+  // Only for Unix sockets, as the server passes a file descriptor
+  bool supportsSharedMemory;
+
   // Negotiated cache protocol (first one actually used by server)
   enum CacheProtocolNegotiated { CacheProtocolNone = 0, CacheProtocolContent, CacheProtocolPersistent };
   CacheProtocolNegotiated negotiatedCacheProtocol = CacheProtocolNone;
@@ -391,6 +411,9 @@ private:
   ModifiablePixelBuffer* framebuffer;
   DecodeManager decoder;
 
+  SharedPixelBuffer* sharedFramebuffer;
+  uint32_t sharedGeneration;
+
   std::string serverClipboard;
   bool hasRemoteClipboard;
   bool hasLocalClipboard;
@@ -90,11 +90,30 @@ public:
   // encodingRaw, encodingZRLE, encodingTight). This allows the client
   // implementation to treat lossy payloads differently for persistence.
   virtual void storePersistentCachedRect(const core::Rect& r, const CacheKey& key, int encoding) = 0;
+  // New content given as a compressed residual against the lossless
+  // entry for baseKey, to be stored as newKey once reconstructed
+  virtual void handlePersistentCachedRectDelta(const core::Rect& r, const CacheKey& baseKey, const CacheKey& newKey,
+                                               const uint8_t* data, size_t length) = 0;
+  // Text-like content as indices into the glyph dictionary
+  virtual void handleGlyphRect(const core::Rect& r, uint8_t flags, uint8_t cellW, uint8_t cellH, uint8_t ox,
+                               uint8_t oy, const uint8_t* data, size_t length) = 0;
+  // The difference between a rect we decoded from a JPEG and the real
+  // pixels, valid if our pixels hash to baseHash
+  virtual void handleLossyRefinement(const core::Rect& r, uint64_t baseHash, const uint8_t* data,
+                                     size_t length) = 0;
+  // The server has passed us a shared memory copy of its framebuffer,
+  // or a part of the one we have has changed
+  virtual void setSharedFramebuffer(uint32_t generation, int width, int height, int stride,
+                                    const PixelFormat& pf) = 0;
+  virtual void handleSharedMemoryRect(const core::Rect& r, uint32_t generation) = 0;
 
   // Cache seed: server tells client to take existing framebuffer pixels
   // at rect R and associate them with cache key. Used for whole-rectangle
   // caching where subrect data was already sent via normal encoding.
   virtual void seedCachedRect(const core::Rect& r, const CacheKey& key) = 0;
+  // Server has recorded the IDs we advertised under this token, or
+  // wants the full list if it is 0
+  virtual void setPersistentCacheEpoch(uint64_t token) = 0;
   // Whether this connection advertised the native-format cache extension
   // (PersistentCachedRectInit v2). Default false; override in clients that
   // send pseudoEncodingNativeFormatCache in SetEncodings.
@@ -241,6 +241,24 @@ bool CMsgReader::readMsg() {
     case encodingCachedRectSeed:
       ret = readCachedRectSeed(dataRect);
       break;
+    case encodingPersistentCachedRectDelta:
+      ret = readPersistentCachedRectDelta(dataRect);
+      break;
+    case encodingGlyphRect:
+      ret = readGlyphRect(dataRect);
+      break;
+    case encodingLossyRefinement:
+      ret = readLossyRefinement(dataRect);
+      break;
+    case pseudoEncodingSharedMemory:
+      ret = readSharedMemorySetup(dataRect);
+      break;
+    case encodingSharedMemory:
+      ret = readSharedMemoryRect(dataRect);
+      break;
+    case pseudoEncodingPersistentCacheEpoch:
+      ret = readPersistentCacheEpoch();
+      break;
     default:
       ret = readRect(dataRect, rectEncoding);
       break;
@@ -859,6 +877,20 @@ bool CMsgReader::readLEDState() {
   return true;
 }
 
+bool CMsgReader::readPersistentCacheEpoch() {
+  uint64_t token;
+
+  if (!is->hasData(8))
+    return false;
+
+  token = (uint64_t)is->readU32() << 32;
+  token |= is->readU32();
+
+  handler->setPersistentCacheEpoch(token);
+
+  return true;
+}
+
 bool CMsgReader::readVMwareLEDState() {
   uint32_t ledState;
 
@@ -1001,3 +1033,130 @@ bool CMsgReader::readCachedRectSeed(const core::Rect& r) {
   handler->seedCachedRect(r, key);
   return true;
 }
+
+bool CMsgReader::readPersistentCachedRectDelta(const core::Rect& r) {
+  uint8_t keyBuf[16];
+  CacheKey baseKey, newKey;
+  uint32_t len;
+  size_t maxLen;
+
+  if (!is->hasData(16 + 16 + 4))
+    return false;
+
+  is->setRestorePoint();
+
+  is->readBytes(keyBuf, 16);
+  baseKey = CacheKey(keyBuf);
+  is->readBytes(keyBuf, 16);
+  newKey = CacheKey(keyBuf);
+  len = is->readU32();
+
+  // The server only sends a residual that is smaller than the raw
+  // pixels, so anything larger is garbage
+  maxLen = (size_t)r.area() * 4 + 1024;
+  if (len > maxLen)
+    throw protocol_error(core::format("PersistentCachedRectDelta: residual too large (%u bytes)", len));
+
+  if (!is->hasDataOrRestore(len))
+    return false;
+  is->clearRestorePoint();
+
+  std::vector<uint8_t> data(len);
+  is->readBytes(data.data(), len);
+
+  handler->handlePersistentCachedRectDelta(r, baseKey, newKey, data.data(), len);
+  return true;
+}
+
+bool CMsgReader::readGlyphRect(const core::Rect& r) {
+  uint8_t flags, cellW, cellH, ox, oy;
+  uint32_t len;
+  size_t maxLen;
+
+  if (!is->hasData(5 + 4))
+    return false;
+
+  is->setRestorePoint();
+
+  flags = is->readU8();
+  cellW = is->readU8();
+  cellH = is->readU8();
+  ox = is->readU8();
+  oy = is->readU8();
+  len = is->readU32();
+
+  // Glyph definitions, indices and literals can at worst add up to a
+  // bit over twice the raw pixels
+  maxLen = (size_t)r.area() * 4 * 2 + 1024;
+  if (len > maxLen)
+    throw protocol_error(core::format("GlyphRect: payload too large (%u bytes)", len));
+
+  if (!is->hasDataOrRestore(len))
+    return false;
+  is->clearRestorePoint();
+
+  std::vector<uint8_t> data(len);
+  is->readBytes(data.data(), len);
+
+  handler->handleGlyphRect(r, flags, cellW, cellH, ox, oy, data.data(), len);
+  return true;
+}
+
+bool CMsgReader::readLossyRefinement(const core::Rect& r) {
+  uint64_t baseHash;
+  uint32_t len;
+  size_t maxLen;
+
+  if (!is->hasData(8 + 4))
+    return false;
+
+  is->setRestorePoint();
+
+  baseHash = (uint64_t)is->readU32() << 32;
+  baseHash |= is->readU32();
+  len = is->readU32();
+
+  // Three bytes per pixel, plus whatever zlib adds to incompressible
+  // data
+  maxLen = (size_t)r.area() * 3 * 2 + 1024;
+  if (len > maxLen)
+    throw protocol_error(core::format("LossyRefinement: payload too large (%u bytes)", len));
+
+  if (!is->hasDataOrRestore(len))
+    return false;
+  is->clearRestorePoint();
+
+  std::vector<uint8_t> data(len);
+  is->readBytes(data.data(), len);
+
+  handler->handleLossyRefinement(r, baseHash, data.data(), len);
+  return true;
+}
+
+bool CMsgReader::readSharedMemorySetup(const core::Rect& r) {
+  uint32_t generation, stride;
+  PixelFormat pf;
+
+  if (!is->hasData(4 + 4 + 16))
+    return false;
+
+  generation = is->readU32();
+  stride = is->readU32();
+  pf.read(is);
+
+  if ((r.tl.x != 0) || (r.tl.y != 0) || r.is_empty())
+    throw protocol_error("SharedMemory: invalid buffer size");
+  if ((stride < (uint32_t)r.width()) || (stride > 0xffff))
+    throw protocol_error(core::format("SharedMemory: invalid stride (%u pixels)", stride));
+
+  handler->setSharedFramebuffer(generation, r.width(), r.height(), stride, pf);
+  return true;
+}
+
+bool CMsgReader::readSharedMemoryRect(const core::Rect& r) {
+  if (!is->hasData(4))
+    return false;
+
+  handler->handleSharedMemoryRect(r, is->readU32());
+  return true;
+}
@@ -88,6 +88,13 @@ protected:
 
   // Cache seed: associate existing framebuffer pixels with cache ID
   bool readCachedRectSeed(const core::Rect& r);
+  bool readPersistentCachedRectDelta(const core::Rect& r);
+  bool readGlyphRect(const core::Rect& r);
+  bool readLossyRefinement(const core::Rect& r);
+  bool readSharedMemorySetup(const core::Rect& r);
+  bool readSharedMemoryRect(const core::Rect& r);
+
+  bool readPersistentCacheEpoch();
 
 private:
   CMsgHandler* handler;
@@ -42,6 +42,7 @@
 #include <rfb/fenceTypes.h>
 #include <rfb/msgTypes.h>
 #include <rfb/qemuTypes.h>
+#include <rfb/cache/IdListCodec.h>
 
 using namespace rfb;
 
@@ -253,6 +254,30 @@ void CMsgWriter::writePersistentHashList(uint32_t sequenceId, uint16_t totalChun
   endMsg();
 }
 
+void CMsgWriter::writePersistentIdList(uint8_t flags, uint64_t baseToken, uint16_t totalChunks, uint16_t chunkIndex,
+                                       const std::vector<uint64_t>& ids) {
+  std::vector<uint8_t> data;
+  uint8_t riceBits;
+
+  if (ids.size() > 65536)
+    throw std::out_of_range("Too many IDs in one PersistentCache ID list");
+
+  riceBits = cache::chooseRiceBits(ids.data(), ids.size());
+  cache::encodeIdList(ids.data(), ids.size(), riceBits, &data);
+
+  startMsg(msgTypePersistentCacheIdList);
+  os->writeU8(flags);
+  os->writeU8(riceBits);
+  os->writeU16(totalChunks);
+  os->writeU16(chunkIndex);
+  os->writeU32(baseToken >> 32);
+  os->writeU32(baseToken);
+  os->writeU32(ids.size());
+  os->writeU32(data.size());
+  os->writeBytes(data.data(), data.size());
+  endMsg();
+}
+
 void CMsgWriter::writePersistentCacheEviction(const std::vector<CacheKey>& keys) {
   // Always emit a well-formed message, even for an empty list.
   size_t count = keys.size();
@@ -70,6 +70,10 @@ public:
   void writePersistentCacheQuery(const std::vector<CacheKey>& keys);
   void writePersistentHashList(uint32_t sequenceId, uint16_t totalChunks, uint16_t chunkIndex,
                                const std::vector<CacheKey>& keys);
+  // Compressed alternative to the HashList. The IDs must be sorted and
+  // free of duplicates.
+  void writePersistentIdList(uint8_t flags, uint64_t baseToken, uint16_t totalChunks, uint16_t chunkIndex,
+                             const std::vector<uint64_t>& ids);
   void writePersistentCacheEviction(const std::vector<CacheKey>& keys);
   void writePersistentCacheEvictionBatched(const std::vector<CacheKey>& keys);
   void writePersistentCacheHashReport(const CacheKey& canonicalKey, const CacheKey& actualKey);
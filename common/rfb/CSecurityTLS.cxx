@@ -155,6 +155,9 @@ bool CSecurityTLS::processMsg() {
 
   checkSession();
 
+  if (Security::KernelTLS)
+    tlssock->enableKernelTLS();
+
   cc->setStreams(&tlssock->inStream(), &tlssock->outStream());
 
   return true;
@@ -22,25 +22,108 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <sys/time.h>
 
 #include <algorithm>
 #include <vector>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include <core/LogWriter.h>
+#include <core/WorkerPool.h>
 #include <core/string.h>
+#include <core/time.h>
 
 #include <rfb/ComparingUpdateTracker.h>
+#include <rfb/ServerCore.h>
 
 using namespace rfb;
 
 static core::LogWriter vlog("ComparingUpdateTracker");
 
+// Below this many bytes it is cheaper to compare on the calling thread
+// than to wake the workers
+static const size_t minParallelBytes = 1024 * 1024;
+
+// Compares one row of a block and brings the old copy up to date in
+// the same pass. Returns false if the row is unchanged, otherwise the
+// offsets of the first and last differing bytes are stored in first
+// and last.
+static inline bool compareAndCopyRow(uint8_t* oldRow, const uint8_t* newRow, int len, int* first, int* last) {
+  int i, lo, hi;
+
+  i = 0;
+  lo = hi = -1;
+
+#if defined(__SSE2__)
+  for (; i + 16 <= len; i += 16) {
+    __m128i o, n;
+    unsigned mask;
+
+    o = _mm_loadu_si128((const __m128i*)(oldRow + i));
+    n = _mm_loadu_si128((const __m128i*)(newRow + i));
+    mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(o, n)) ^ 0xffff;
+    if (mask == 0)
+      continue;
+
+    if (lo < 0)
+      lo = i + __builtin_ctz(mask);
+    hi = i + 31 - __builtin_clz(mask);
+
+    _mm_storeu_si128((__m128i*)(oldRow + i), n);
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  for (; i + 16 <= len; i += 16) {
+    uint8x16_t o, n;
+
+    o = vld1q_u8(oldRow + i);
+    n = vld1q_u8(newRow + i);
+    if (vmaxvq_u8(veorq_u8(o, n)) == 0)
+      continue;
+
+    for (int j = 0; j < 16; j++) {
+      if (oldRow[i + j] != newRow[i + j]) {
+        if (lo < 0)
+          lo = i + j;
+        hi = i + j;
+      }
+    }
+
+    vst1q_u8(oldRow + i, n);
+  }
+#endif
+
+  for (; i < len; i++) {
+    if (oldRow[i] == newRow[i])
+      continue;
+    if (lo < 0)
+      lo = i;
+    hi = i;
+    oldRow[i] = newRow[i];
+  }
+
+  if (lo < 0)
+    return false;
+
+  *first = lo;
+  *last = hi;
+
+  return true;
+}
+
 ComparingUpdateTracker::ComparingUpdateTracker(PixelBuffer* buffer)
-    : fb(buffer), oldFb(fb->getPF(), 0, 0), firstCompare(true), enabled(true), totalPixels(0), missedPixels(0) {
+    : fb(buffer), oldFb(fb->getPF(), 0, 0), firstCompare(true), enabled(true), workers(nullptr), totalPixels(0),
+      missedPixels(0), comparedBytes(0), compareTimeUs(0) {
   changed.assign_union(fb->getRect());
 }
 
-ComparingUpdateTracker::~ComparingUpdateTracker() {}
+ComparingUpdateTracker::~ComparingUpdateTracker() {
+  delete workers;
+}
 
 #define BLOCK_SIZE 64
 
@@ -74,11 +157,46 @@ bool ComparingUpdateTracker::compare() {
 
   changed.get_rects(&rects);
 
-  core::Region newChanged;
+  struct timeval start;
+  size_t bytes = 0;
+
+  gettimeofday(&start, nullptr);
+
+  std::vector<Band> bands;
   for (i = rects.begin(); i != rects.end(); i++)
-    compareRect(*i, &newChanged);
+    compareRect(*i, &bands);
+
+  for (const Band& band : bands)
+    bytes += (size_t)band.rect.area() * (fb->getPF().bpp / 8);
+
+  if ((bands.size() > 1) && (bytes >= minParallelBytes)) {
+    if (workers == nullptr) {
+      size_t concurrency;
+
+      concurrency = rfb::Server::compareFBThreads;
+      if (concurrency == 0)
+        concurrency = core::WorkerPool::defaultConcurrency(8);
+
+      vlog.debug("Using %d thread(s) for framebuffer comparison", (int)concurrency);
+      workers = new core::WorkerPool(concurrency);
+    }
+
+    workers->run(bands.size(), [&bands, this](size_t n) { compareBand(&bands[n]); });
+  } else {
+    for (Band& band : bands)
+      compareBand(&band);
+  }
+
+  core::Region newChanged;
+  for (const Band& band : bands) {
+    for (const core::Rect& r : band.changed)
+      newChanged.assign_union(r);
+    oldFb.commitBufferRW(band.rect);
+  }
+
+  comparedBytes += bytes;
+  compareTimeUs += core::usSince(&start);
 
-  changed.get_rects(&rects);
   for (i = rects.begin(); i != rects.end(); i++)
     totalPixels += i->area();
   newChanged.get_rects(&rects);
@@ -104,135 +222,102 @@ void ComparingUpdateTracker::disable() {
   firstCompare = true;
 }
 
-void ComparingUpdateTracker::compareRect(const core::Rect& r, core::Region* newChanged) {
+void ComparingUpdateTracker::compareRect(const core::Rect& r, std::vector<Band>* bands) {
   if (!r.enclosed_by(fb->getRect())) {
     core::Rect safe;
     // Crop the rect and try again
     safe = r.intersect(fb->getRect());
     if (!safe.is_empty())
-      compareRect(safe, newChanged);
+      compareRect(safe, bands);
     return;
   }
 
   int bytesPerPixel = fb->getPF().bpp / 8;
-  int oldStride;
+  int oldStride, newStride;
   uint8_t* oldData = oldFb.getBufferRW(r, &oldStride);
-  int oldStrideBytes = oldStride * bytesPerPixel;
+  const uint8_t* newData = fb->getBuffer(r, &newStride);
+
+  // Split the rect in to bands that can be compared independently
+  for (int blockTop = r.tl.y; blockTop < r.br.y; blockTop += BLOCK_SIZE) {
+    Band band;
+
+    band.rect = core::Rect(r.tl.x, blockTop, r.br.x, std::min(r.br.y, blockTop + BLOCK_SIZE));
+    band.newData = newData + (size_t)(blockTop - r.tl.y) * newStride * bytesPerPixel;
+    band.newStride = newStride;
+    band.oldData = oldData + (size_t)(blockTop - r.tl.y) * oldStride * bytesPerPixel;
+    band.oldStride = oldStride;
+
+    bands->push_back(band);
+  }
+}
+
+void ComparingUpdateTracker::compareBand(Band* band) {
+  const core::Rect& r = band->rect;
+
+  int bytesPerPixel = fb->getPF().bpp / 8;
+  int oldStrideBytes = band->oldStride * bytesPerPixel;
+  int newStrideBytes = band->newStride * bytesPerPixel;
 
   // Used to efficiently crop the left and right of the change rectangle
   int minCompareWidthInPixels = BLOCK_SIZE / 8;
-  int minCompareWidthInBytes = minCompareWidthInPixels * bytesPerPixel;
 
-  for (int blockTop = r.tl.y; blockTop < r.br.y; blockTop += BLOCK_SIZE) {
-    // Get a strip of the source buffer
-    core::Rect pos(r.tl.x, blockTop, r.br.x, std::min(r.br.y, blockTop + BLOCK_SIZE));
-    int fbStride;
-    const uint8_t* newBlockPtr = fb->getBuffer(pos, &fbStride);
-    int newStrideBytes = fbStride * bytesPerPixel;
-
-    uint8_t* oldBlockPtr = oldData;
-    int blockBottom = std::min(blockTop + BLOCK_SIZE, r.br.y);
-
-    for (int blockLeft = r.tl.x; blockLeft < r.br.x; blockLeft += BLOCK_SIZE) {
-      const uint8_t* newPtr = newBlockPtr;
-      uint8_t* oldPtr = oldBlockPtr;
-
-      int blockRight = std::min(blockLeft + BLOCK_SIZE, r.br.x);
-      int blockWidthInBytes = (blockRight - blockLeft) * bytesPerPixel;
-
-      // Scan the block top to bottom, to identify the first row of change
-      for (int y = blockTop; y < blockBottom; y++) {
-        if (memcmp(oldPtr, newPtr, blockWidthInBytes) != 0) {
-          // Define the change rectangle using pessimistic values to start
-          int changeHeight = blockBottom - y;
-          int changeLeft = blockLeft;
-          int changeRight = blockRight;
-
-          // For every unchanged row at the bottom of the block, decrement change height
-          {
-            const uint8_t* newRowPtr = newPtr + ((changeHeight - 1) * newStrideBytes);
-            const uint8_t* oldRowPtr = oldPtr + ((changeHeight - 1) * oldStrideBytes);
-            while (changeHeight > 1 && memcmp(oldRowPtr, newRowPtr, blockWidthInBytes) == 0) {
-              newRowPtr -= newStrideBytes;
-              oldRowPtr -= oldStrideBytes;
-
-              changeHeight--;
-            }
-          }
-
-          // For every unchanged column at the left of the block, increment change left
-          {
-            const uint8_t* newColumnPtr = newPtr;
-            const uint8_t* oldColumnPtr = oldPtr;
-            while (changeLeft + minCompareWidthInPixels < changeRight) {
-              const uint8_t* newRowPtr = newColumnPtr;
-              const uint8_t* oldRowPtr = oldColumnPtr;
-              for (int row = 0; row < changeHeight; row++) {
-                if (memcmp(oldRowPtr, newRowPtr, minCompareWidthInBytes) != 0)
-                  goto endOfChangeLeft;
-
-                newRowPtr += newStrideBytes;
-                oldRowPtr += oldStrideBytes;
-              }
-
-              newColumnPtr += minCompareWidthInBytes;
-              oldColumnPtr += minCompareWidthInBytes;
-
-              changeLeft += minCompareWidthInPixels;
-            }
-          }
-        endOfChangeLeft:
-
-          // For every unchanged column at the right of the block, decrement change right
-          {
-            const uint8_t* newColumnPtr = newPtr + blockWidthInBytes;
-            const uint8_t* oldColumnPtr = oldPtr + blockWidthInBytes;
-            while (changeLeft + minCompareWidthInPixels < changeRight) {
-              newColumnPtr -= minCompareWidthInBytes;
-              oldColumnPtr -= minCompareWidthInBytes;
-
-              const uint8_t* newRowPtr = newColumnPtr;
-              const uint8_t* oldRowPtr = oldColumnPtr;
-              for (int row = 0; row < changeHeight; row++) {
-                if (memcmp(oldRowPtr, newRowPtr, minCompareWidthInBytes) != 0)
-                  goto endOfChangeRight;
-
-                newRowPtr += newStrideBytes;
-                oldRowPtr += oldStrideBytes;
-              }
-
-              changeRight -= minCompareWidthInPixels;
-            }
-          }
-        endOfChangeRight:
-
-          // Block change extends from (changeLeft, y) to (changeRight,
-          // y + changeHeight)
-          newChanged->assign_union({{changeLeft, y, changeRight, y + changeHeight}});
-
-          // Copy the change from fb to oldFb to allow future changes to be identified
-          for (int row = 0; row < changeHeight; row++) {
-            memcpy(oldPtr, newPtr, blockWidthInBytes);
-            newPtr += newStrideBytes;
-            oldPtr += oldStrideBytes;
-          }
-
-          // No further processing is required for this block
-          break;
-        }
-
-        newPtr += newStrideBytes;
-        oldPtr += oldStrideBytes;
+  const uint8_t* newBlockPtr = band->newData;
+  uint8_t* oldBlockPtr = band->oldData;
+
+  for (int blockLeft = r.tl.x; blockLeft < r.br.x; blockLeft += BLOCK_SIZE) {
+    const uint8_t* newPtr = newBlockPtr;
+    uint8_t* oldPtr = oldBlockPtr;
+
+    int blockRight = std::min(blockLeft + BLOCK_SIZE, r.br.x);
+    int blockWidthInBytes = (blockRight - blockLeft) * bytesPerPixel;
+
+    // Compare and copy the block in a single pass, recording which
+    // rows and bytes differ
+    int firstRow = -1, lastRow = -1;
+    int firstByte = blockWidthInBytes, lastByte = -1;
+
+    for (int y = r.tl.y; y < r.br.y; y++) {
+      int first, last;
+
+      if (compareAndCopyRow(oldPtr, newPtr, blockWidthInBytes, &first, &last)) {
+        if (firstRow < 0)
+          firstRow = y;
+        lastRow = y;
+
+        firstByte = std::min(firstByte, first);
+        lastByte = std::max(lastByte, last);
       }
 
-      oldBlockPtr += blockWidthInBytes;
-      newBlockPtr += blockWidthInBytes;
+      newPtr += newStrideBytes;
+      oldPtr += oldStrideBytes;
     }
 
-    oldData += oldStrideBytes * BLOCK_SIZE;
-  }
+    oldBlockPtr += blockWidthInBytes;
+    newBlockPtr += blockWidthInBytes;
+
+    if (firstRow < 0)
+      continue;
+
+    // Crop the left and right in steps of minCompareWidthInPixels,
+    // stepping from each edge of the block
+    int firstPixel = blockLeft + firstByte / bytesPerPixel;
+    int lastPixel = blockLeft + lastByte / bytesPerPixel;
 
-  oldFb.commitBufferRW(r);
+    int changeLeft = blockLeft;
+    int changeRight = blockRight;
+
+    while ((changeLeft + minCompareWidthInPixels < changeRight) &&
+           (changeLeft + minCompareWidthInPixels <= firstPixel))
+      changeLeft += minCompareWidthInPixels;
+
+    while ((changeLeft + minCompareWidthInPixels < changeRight) &&
+           (changeRight - minCompareWidthInPixels > lastPixel))
+      changeRight -= minCompareWidthInPixels;
+
+    // Block change extends from (changeLeft, firstRow) to
+    // (changeRight, lastRow + 1)
+    band->changed.push_back({changeLeft, firstRow, changeRight, lastRow + 1});
+  }
 }
 
 void ComparingUpdateTracker::logStats() {
@@ -246,5 +331,15 @@ void ComparingUpdateTracker::logStats() {
              core::siPrefix(missedPixels, "pixels").c_str());
   vlog.debug("(1:%g ratio)", ratio);
 
+  if (compareTimeUs > 0) {
+    double throughput;
+
+    throughput = (double)comparedBytes / compareTimeUs / 1000.0;
+
+    vlog.debug("%s compared in %g ms (%g GB/s)", core::iecPrefix(comparedBytes, "B").c_str(),
+               compareTimeUs / 1000.0, throughput);
+  }
+
   totalPixels = missedPixels = 0;
+  comparedBytes = compareTimeUs = 0;
 }
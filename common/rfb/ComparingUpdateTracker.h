@@ -19,9 +19,15 @@
 #ifndef __RFB_COMPARINGUPDATETRACKER_H__
 #define __RFB_COMPARINGUPDATETRACKER_H__
 
+#include <vector>
+
 #include <rfb/PixelBuffer.h>
 #include <rfb/UpdateTracker.h>
 
+namespace core {
+class WorkerPool;
+}
+
 namespace rfb {
 
 class ComparingUpdateTracker : public SimpleUpdateTracker {
@@ -45,13 +51,28 @@ public:
   void logStats();
 
 private:
-  void compareRect(const core::Rect& r, core::Region* newchanged);
+  // A horizontal band of at most BLOCK_SIZE rows of one changed rect.
+  // Bands never overlap, so they can be compared concurrently.
+  struct Band {
+    core::Rect rect;
+    const uint8_t* newData;
+    int newStride;
+    uint8_t* oldData;
+    int oldStride;
+    std::vector<core::Rect> changed;
+  };
+
+  void compareRect(const core::Rect& r, std::vector<Band>* bands);
+  void compareBand(Band* band);
   PixelBuffer* fb;
   ManagedPixelBuffer oldFb;
   bool firstCompare;
   bool enabled;
 
+  core::WorkerPool* workers;
+
   unsigned long long totalPixels, missedPixels;
+  unsigned long long comparedBytes, compareTimeUs;
 };
 
 } // namespace rfb
@@ -151,6 +151,8 @@ void Congestion::sentPing() {
   rttInfo.congested = isCongested();
 
   pings.push_back(rttInfo);
+
+  model.sentMarker(&rttInfo.tv, rttInfo.pos, !rttInfo.congested);
 }
 
 void Congestion::gotPong() {
@@ -169,6 +171,8 @@ void Congestion::gotPong() {
   lastPong = rttInfo;
   lastPongArrival = now;
 
+  model.ackedMarker(&now);
+
   rtt = core::msBetween(&rttInfo.tv, &now);
   if (rtt < 1)
     rtt = 1;
@@ -290,6 +294,12 @@ int Congestion::getUncongestedETA() {
 size_t Congestion::getBandwidth() {
   size_t bandwidth;
 
+  // Measured delivery rate is much better than what we can infer from
+  // the window, once we have it
+  bandwidth = model.getBandwidth();
+  if (bandwidth != 0)
+    return bandwidth;
+
   // No measurements yet? Guess RTT of 60 ms
   if (safeBaseRTT == (unsigned)-1)
     bandwidth = congWindow * 1000 / 60;
@@ -304,6 +314,20 @@ size_t Congestion::getBandwidth() {
   return bandwidth;
 }
 
+unsigned Congestion::getMinRTT() {
+  return model.getMinRTT();
+}
+
+size_t Congestion::getPacingRate() {
+  size_t rate;
+
+  rate = model.getPacingRate();
+  if (rate != 0)
+    return rate;
+
+  return getBandwidth();
+}
+
 void Congestion::debugTrace(const char* filename, int fd) {
   (void)filename;
   (void)fd;
@@ -473,6 +497,9 @@ void Congestion::updateCongestion() {
 #ifdef CONGESTION_DEBUG
   vlog.debug("RTT: %d/%d ms (%d ms), Window: %d KiB, Bandwidth: %g Mbps%s", minRTT, minCongestedRTT, baseRTT,
              congWindow / 1024, congWindow * 8.0 / baseRTT / 1000.0, inSlowStart ? " (slow start)" : "");
+  vlog.debug("Model: RTT %g ms, Bandwidth: %g Mbps, Pacing: %g Mbps%s", model.getMinRTT() / 1000.0,
+             model.getBandwidth() * 8.0 / 1000000.0, model.getPacingRate() * 8.0 / 1000000.0,
+             model.inStartup() ? " (startup)" : "");
 #endif
 
   measurements = 0;
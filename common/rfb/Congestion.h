@@ -21,6 +21,8 @@
 
 #include <list>
 
+#include <rfb/BandwidthModel.h>
+
 namespace rfb {
 class Congestion {
 public:
@@ -51,6 +53,15 @@ public:
   // per second.
   size_t getBandwidth();
 
+  // getMinRTT() returns the wire latency in microseconds, or 0 if it
+  // is not yet known.
+  unsigned getMinRTT();
+
+  // getPacingRate() returns the rate in bytes per second that data
+  // should currently be produced at. It is above the bandwidth
+  // estimate while probing for more.
+  size_t getPacingRate();
+
   // debugTrace() writes the current congestion window, as well as the
   // congestion window of the underlying TCP layer, to the specified
   // file
@@ -89,6 +100,8 @@ private:
   int measurements;
   struct timeval lastAdjustment;
   unsigned minRTT, minCongestedRTT;
+
+  BandwidthModel model;
 };
 } // namespace rfb
 
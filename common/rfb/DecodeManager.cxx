@@ -35,6 +35,7 @@
 #include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <iterator>
 #include <limits>
 #include <string>
 #include <vector>
@@ -50,8 +51,12 @@
 #include <rfb/ContentHash.h>
 #include <rfb/Decoder.h>
 #include <rfb/Exception.h>
+#include <rfb/LossyRefinement.h>
 #include <rfb/PixelBuffer.h>
 #include <rfb/encodings.h>
+#include <rfb/msgTypes.h>
+#include <rfb/cache/CacheDelta.h>
+#include <rfb/cache/IdListCodec.h>
 
 namespace rfb {
 
@@ -63,6 +68,10 @@ static inline CacheKey makeCacheKeyFromU64(uint64_t id) {
   return k;
 }
 
+// IDs per PersistentCache ID list message, well below what the server
+// accepts
+static const size_t idListBatchSize = 16384;
+
 static inline uint64_t cacheKeyFirstU64(const CacheKey &key) {
   uint64_t v = 0;
   memcpy(&v, key.bytes.data(), sizeof(v));
@@ -216,6 +225,7 @@ static void logFBHashDebug(const char *tag, const core::Rect &r,
 DecodeManager::DecodeManager(CConnection *conn_)
     : conn(conn_), threadException(nullptr), persistentCache(nullptr),
       persistentCacheEnabled_(true), persistentHashListSent(false),
+      serverSupportsIdList_(false), advertisedDelta_(false),
       persistentCacheLoadTriggered(false), arcEvictionLogInitialized_(false),
       lastArcEvictions_(0) {
   size_t cpuCount;
@@ -569,14 +579,10 @@ void DecodeManager::triggerPersistentCacheLoad() {
                  indexPath.c_str());
     }
   }
-
-  // After loading index, advertise our hashes to the server
-  // (includes both hydrated and index-only entries)
-  advertisePersistentCacheHashes();
 }
 
 void DecodeManager::advertisePersistentCacheHashes() {
-  // Only send the HashList once per connection, and only when we have a
+  // Only advertise once per connection, and only when we have a
   // fully-initialised CConnection with a valid writer.
   if (persistentHashListSent)
     return;
@@ -584,11 +590,86 @@ void DecodeManager::advertisePersistentCacheHashes() {
     return;
 
   std::vector<CacheKey> keys = persistentCache->getAllKeys();
-  if (keys.empty()) {
-    vlog.debug("PersistentCache: no keys available for HashList advertisement");
-    return;
+  std::vector<uint64_t> ids;
+  std::vector<uint64_t> base;
+  uint64_t token;
+
+  ids.reserve(keys.size());
+  for (const CacheKey &key : keys)
+    ids.push_back(cacheKeyFirstU64(key));
+  cache::sortIds(&ids);
+
+  // If the server gave us an epoch for what we sent last time then we
+  // only need to tell it what has changed since. Servers that have never
+  // sent us an epoch might not know the ID list message and would drop
+  // the connection, so they get the older HashList.
+  if (persistentCacheDiskEnabled_ &&
+      persistentCache->loadEpoch(conn->getServerName(), &token, &base)) {
+    std::vector<uint64_t> added, removed;
+
+    std::set_difference(ids.begin(), ids.end(), base.begin(), base.end(),
+                        std::back_inserter(added));
+    std::set_difference(base.begin(), base.end(), ids.begin(), ids.end(),
+                        std::back_inserter(removed));
+
+    // The token can only be used once
+    persistentCache->clearEpoch(conn->getServerName());
+
+    vlog.info("PersistentCache: advertising %zu added and %zu removed IDs "
+              "since last epoch",
+              added.size(), removed.size());
+
+    // Added and removed IDs go in separate messages, so the chunk
+    // numbering has to span both
+    size_t addChunks, removeChunks;
+
+    addChunks = (added.size() + idListBatchSize - 1) / idListBatchSize;
+    removeChunks = (removed.size() + idListBatchSize - 1) / idListBatchSize;
+    if (addChunks + removeChunks == 0)
+      addChunks = 1;
+
+    for (size_t i = 0; i < addChunks; i++) {
+      size_t start = std::min(i * idListBatchSize, added.size());
+      size_t end = std::min(start + idListBatchSize, added.size());
+      std::vector<uint64_t> chunk(added.begin() + start, added.begin() + end);
+      conn->writer()->writePersistentIdList(idListFlagDelta, token,
+                                            addChunks + removeChunks, i,
+                                            chunk);
+    }
+    for (size_t i = 0; i < removeChunks; i++) {
+      size_t start = i * idListBatchSize;
+      size_t end = std::min(start + idListBatchSize, removed.size());
+      std::vector<uint64_t> chunk(removed.begin() + start,
+                                  removed.begin() + end);
+      conn->writer()->writePersistentIdList(
+          idListFlagDelta | idListFlagRemoved, token,
+          addChunks + removeChunks, addChunks + i, chunk);
+    }
+
+    advertisedDelta_ = true;
+  } else if (serverSupportsIdList_) {
+    vlog.info("PersistentCache: advertising %zu IDs to server", ids.size());
+
+    writePersistentIdList(0, 0, ids);
+
+    advertisedDelta_ = false;
+  } else {
+    if (keys.empty()) {
+      vlog.debug("PersistentCache: no keys available for HashList advertisement");
+      return;
+    }
+
+    writePersistentHashList(keys);
+
+    advertisedDelta_ = false;
   }
 
+  // Kept in case the server gives us an epoch for them
+  advertisedIds_.swap(ids);
+  persistentHashListSent = true;
+}
+
+void DecodeManager::writePersistentHashList(const std::vector<CacheKey> &keys) {
   const size_t batchSize = 1000; // conservative chunking
   uint32_t sequenceId = 1;       // per-connection sequence
   uint16_t totalChunks = (keys.size() + batchSize - 1) / batchSize;
@@ -608,8 +689,52 @@ void DecodeManager::advertisePersistentCacheHashes() {
     offset = end;
     chunkIndex++;
   }
+}
 
-  persistentHashListSent = true;
+void DecodeManager::writePersistentIdList(uint8_t flags, uint64_t baseToken,
+                                          const std::vector<uint64_t> &ids) {
+  size_t totalChunks;
+
+  // Always send at least one (possibly empty) chunk so the server
+  // replies with an epoch
+  totalChunks = (ids.size() + idListBatchSize - 1) / idListBatchSize;
+  if (totalChunks == 0)
+    totalChunks = 1;
+
+  for (size_t i = 0; i < totalChunks; i++) {
+    size_t start = i * idListBatchSize;
+    size_t end = std::min(start + idListBatchSize, ids.size());
+    std::vector<uint64_t> chunk(ids.begin() + start, ids.begin() + end);
+    conn->writer()->writePersistentIdList(flags, baseToken, totalChunks, i,
+                                          chunk);
+  }
+}
+
+void DecodeManager::setPersistentCacheEpoch(uint64_t token) {
+  if (!persistentCache || !conn)
+    return;
+
+  serverSupportsIdList_ = true;
+
+  if (token == 0) {
+    // The server has forgotten our epoch, so start over with everything
+    if (advertisedDelta_) {
+      vlog.info("PersistentCache: server rejected ID list delta, sending "
+                "full list");
+      advertisedDelta_ = false;
+      writePersistentIdList(0, 0, advertisedIds_);
+      return;
+    }
+
+    advertisedIds_.clear();
+    return;
+  }
+
+  if (persistentCacheDiskEnabled_)
+    persistentCache->saveEpoch(conn->getServerName(), token, advertisedIds_);
+
+  advertisedIds_.clear();
+  advertisedIds_.shrink_to_fit();
 }
 
 void DecodeManager::logStats() {
@@ -691,6 +816,10 @@ void DecodeManager::logStats() {
     vlog.info("    Misses: %u, Queries sent: %u",
               persistentCacheStats.cache_misses,
               persistentCacheStats.queries_sent);
+    if (persistentCacheStats.deltas != 0)
+      vlog.info("    Deltas applied: %u", persistentCacheStats.deltas);
+    if (glyphTable.size() != 0)
+      vlog.info("    Glyphs held: %zu", glyphTable.size());
     vlog.info("  ARC cache performance:");
     vlog.info("    Total entries: %zu, Total bytes: %s", pcStats.totalEntries,
               core::iecPrefix(pcStats.totalBytes, "B").c_str());
@@ -1311,6 +1440,170 @@ void DecodeManager::seedCachedRect(const core::Rect &r, const CacheKey &key,
   }
 }
 
+void DecodeManager::handlePersistentCachedRectDelta(
+    const core::Rect &r, const CacheKey &baseKey, const CacheKey &newKey,
+    const uint8_t *data, size_t length, ModifiablePixelBuffer *pb) {
+  const PixelFormat &pf = conn->server.pf();
+  uint64_t baseId, newId;
+  size_t bufferLength;
+
+  flush();
+
+  if (pb == nullptr) {
+    vlog.error("handlePersistentCachedRectDelta called with null framebuffer");
+    return;
+  }
+  if (persistentCache == nullptr)
+    return;
+
+  baseId = cacheKeyFirstU64(baseKey);
+  newId = cacheKeyFirstU64(newKey);
+
+  CacheStatsView pcStats{
+      &persistentCacheStats.cache_hits, &persistentCacheStats.cache_lookups,
+      &persistentCacheStats.cache_misses, &persistentCacheStats.stores};
+
+  // The residual was computed against the exact pixels of the base, so
+  // only a lossless copy of it will do
+  const GlobalClientPersistentCache::CachedPixels *cached =
+      persistentCache->getByCanonicalHash(baseId, r.width(), r.height(),
+                                          pb->getPF().bpp);
+  if ((cached == nullptr) || !cached->isLossless()) {
+    recordCacheMiss(pcStats);
+    vlog.debug("Delta base %" PRIx64 " unavailable for rect [%d,%d-%d,%d], "
+               "requesting %" PRIx64,
+               baseId, r.tl.x, r.tl.y, r.br.x, r.br.y, newId);
+    pendingQueries.push_back(newId);
+    if (pendingQueries.size() >= 10)
+      flushPendingQueries();
+    return;
+  }
+
+  recordCacheHit(pcStats);
+
+  bufferLength = (size_t)r.area() * (pf.bpp / 8);
+  deltaBuffer.resize(bufferLength);
+  pf.bufferFromBuffer(deltaBuffer.data(), cached->format,
+                      cached->pixels.data(), r.width(), r.height(),
+                      r.width(), cached->stridePixels);
+
+  if (!rfb::cache::applyResidual(data, length, deltaBuffer.data(),
+                                 bufferLength))
+    throw protocol_error("PersistentCachedRectDelta: invalid residual");
+
+  pb->imageRect(pf, r, deltaBuffer.data());
+
+  persistentCacheStats.deltas++;
+
+  // Store the result like any other new content
+  seedCachedRect(r, newKey, pb);
+}
+
+void DecodeManager::handleGlyphRect(const core::Rect &r, uint8_t flags,
+                                    uint8_t cellW, uint8_t cellH, uint8_t ox,
+                                    uint8_t oy, const uint8_t *data,
+                                    size_t length, ModifiablePixelBuffer *pb) {
+  const PixelFormat &pf = conn->server.pf();
+  rfb::cache::GlyphLayout layout;
+
+  flush();
+
+  if (pb == nullptr) {
+    vlog.error("handleGlyphRect called with null framebuffer");
+    return;
+  }
+
+  if ((cellW == 0) || (cellH == 0) || (ox >= cellW) || (oy >= cellH))
+    throw protocol_error(core::format("GlyphRect: invalid %dx%d cell grid",
+                                      cellW, cellH));
+
+  // Sent when the server's dictionary starts over, e.g. because the
+  // pixel format or the cell size changed
+  if (flags & glyphRectFlagReset)
+    glyphTable.clear();
+
+  layout.width = r.width();
+  layout.height = r.height();
+  layout.cellW = cellW;
+  layout.cellH = cellH;
+  layout.ox = ox;
+  layout.oy = oy;
+  layout.bytesPerPixel = pf.bpp / 8;
+
+  glyphBuffer.resize((size_t)r.area() * layout.bytesPerPixel);
+
+  if (!rfb::cache::decodeGlyphRect(layout, data, length, &glyphTable,
+                                   glyphBuffer.data()))
+    throw protocol_error("GlyphRect: invalid payload");
+
+  pb->imageRect(pf, r, glyphBuffer.data());
+
+  stats[encodingGlyphRect].rects++;
+  stats[encodingGlyphRect].bytes += 12 + 9 + length;
+  stats[encodingGlyphRect].pixels += r.area();
+  stats[encodingGlyphRect].equivalent += 12 + glyphBuffer.size();
+}
+
+bool DecodeManager::handleLossyRefinement(const core::Rect &r,
+                                          uint64_t baseHash,
+                                          const uint8_t *data, size_t length,
+                                          ModifiablePixelBuffer *pb) {
+  flush();
+
+  if (pb == nullptr) {
+    vlog.error("handleLossyRefinement called with null framebuffer");
+    return false;
+  }
+
+  if (!r.enclosed_by(pb->getRect()))
+    throw protocol_error("LossyRefinement: rect outside framebuffer");
+
+  refinementBuffer.resize((size_t)r.area() * 4);
+  pb->getImage(lossyRefinementPF, refinementBuffer.data(), r);
+
+  if (hashRefinementBase(refinementBuffer.data(), r.area()) != baseHash)
+    return false;
+
+  if (!applyRefinement(data, length, refinementBuffer.data(), r.area()))
+    throw protocol_error("LossyRefinement: invalid payload");
+
+  pb->imageRect(lossyRefinementPF, r, refinementBuffer.data());
+
+  stats[encodingLossyRefinement].rects++;
+  stats[encodingLossyRefinement].bytes += 12 + 12 + length;
+  stats[encodingLossyRefinement].pixels += r.area();
+  stats[encodingLossyRefinement].equivalent +=
+      12 + (size_t)r.area() * (conn->server.pf().bpp / 8);
+
+  return true;
+}
+
+void DecodeManager::handleSharedMemoryRect(const core::Rect &r,
+                                           const PixelBuffer *shared,
+                                           ModifiablePixelBuffer *pb) {
+  const uint8_t *data;
+  int stride;
+
+  flush();
+
+  if (pb == nullptr) {
+    vlog.error("handleSharedMemoryRect called with null framebuffer");
+    return;
+  }
+
+  if (!r.enclosed_by(shared->getRect()) || !r.enclosed_by(pb->getRect()))
+    throw protocol_error("SharedMemory: rect outside framebuffer");
+
+  data = shared->getBuffer(r, &stride);
+  pb->imageRect(shared->getPF(), r, data, stride);
+
+  stats[encodingSharedMemory].rects++;
+  stats[encodingSharedMemory].bytes += 12 + 4;
+  stats[encodingSharedMemory].pixels += r.area();
+  stats[encodingSharedMemory].equivalent +=
+      12 + (size_t)r.area() * (shared->getPF().bpp / 8);
+}
+
 void DecodeManager::flushPendingQueries() {
   if (pendingQueries.empty())
     return; // Send batched query to server
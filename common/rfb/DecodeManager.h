@@ -39,6 +39,7 @@
 #include <rfb/GlobalClientPersistentCache.h>
 #include <rfb/ServerParams.h>
 #include <rfb/cache/BandwidthStats.h>
+#include <rfb/cache/GlyphDictionary.h>
 #include <rfb/encodings.h>
 
 namespace core {
@@ -53,6 +54,7 @@ namespace rfb {
 class CConnection;
 class Decoder;
 class ModifiablePixelBuffer;
+class PixelBuffer;
 class ServerParams;
 
 class DecodeManager {
@@ -91,13 +93,37 @@ public:
   // them in cache with the given ID. Used for whole-rectangle caching.
   void seedCachedRect(const core::Rect& r, const CacheKey& key, ModifiablePixelBuffer* pb);
 
+  // Cache delta: reconstruct new content from the lossless entry for
+  // baseKey plus a residual, then store it under newKey
+  void handlePersistentCachedRectDelta(const core::Rect& r, const CacheKey& baseKey, const CacheKey& newKey,
+                                       const uint8_t* data, size_t length, ModifiablePixelBuffer* pb);
+
+  // Glyph rect: compose text-like content from the glyph dictionary,
+  // which also learns the glyphs the rect defines
+  void handleGlyphRect(const core::Rect& r, uint8_t flags, uint8_t cellW, uint8_t cellH, uint8_t ox, uint8_t oy,
+                       const uint8_t* data, size_t length, ModifiablePixelBuffer* pb);
+
+  // Lossy refinement: add the difference to what we decoded from a
+  // JPEG. Returns false, without touching anything, if our pixels
+  // aren't the ones the server expects.
+  bool handleLossyRefinement(const core::Rect& r, uint64_t baseHash, const uint8_t* data, size_t length,
+                             ModifiablePixelBuffer* pb);
+
+  // Shared memory: copy a changed rect from the server's buffer
+  void handleSharedMemoryRect(const core::Rect& r, const PixelBuffer* shared, ModifiablePixelBuffer* pb);
+
   // Log end-of-session decode and cache statistics (client-side)
   void logStats();
 
   // Advertise any hashes loaded into the client-side PersistentCache to the
-  // server via the HashList protocol once the CMsgWriter is available.
+  // server once the CMsgWriter is available. Uses the compact ID list if
+  // the server is known to support it, and the HashList otherwise.
   void advertisePersistentCacheHashes();
 
+  // The server has recorded the IDs we advertised under this epoch
+  // token, or could not apply our delta if the token is zero.
+  void setPersistentCacheEpoch(uint64_t token);
+
   // Trigger lazy loading of PersistentCache from disk. Called by CConnection
   // when PersistentCache protocol is first negotiated (on first use).
   // This defers disk I/O until we know the server actually supports
@@ -184,6 +210,7 @@ private:
     unsigned cache_misses;
     unsigned stores;
     unsigned queries_sent;
+    unsigned deltas;
   };
   PersistentCacheStats persistentCacheStats;
 
@@ -194,6 +221,16 @@ private:
   std::vector<uint64_t> pendingQueries;
   void flushPendingQueries();
 
+  // Scratch space for reconstructing cache deltas
+  std::vector<uint8_t> deltaBuffer;
+
+  // Glyphs defined by the server for GlyphRects
+  rfb::cache::GlyphTable glyphTable;
+  std::vector<uint8_t> glyphBuffer;
+
+  // Scratch space for lossy refinements
+  std::vector<uint8_t> refinementBuffer;
+
   // Forward pending cache evictions to the server.
   void flushPendingEvictions();
 
@@ -203,6 +240,19 @@ private:
   // One-shot guard to avoid sending the PersistentCache HashList more than once per connection.
   bool persistentHashListSent;
 
+  // Sends the IDs in chunks of a size the server will accept
+  void writePersistentIdList(uint8_t flags, uint64_t baseToken, const std::vector<uint64_t>& ids);
+  void writePersistentHashList(const std::vector<CacheKey>& keys);
+
+  // The server has sent us an epoch during this connection, so it
+  // understands ID lists
+  bool serverSupportsIdList_;
+
+  // IDs in the last ID list, kept until the server gives us an epoch
+  // for them, and whether that list was a delta
+  std::vector<uint64_t> advertisedIds_;
+  bool advertisedDelta_;
+
   // Guard to ensure we only trigger PersistentCache disk load once per connection.
   bool persistentCacheLoadTriggered;
 
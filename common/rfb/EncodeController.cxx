@@ -0,0 +1,207 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <algorithm>
+
+#include <core/LogWriter.h>
+
+#include <rfb/ClientParams.h>
+#include <rfb/EncodeController.h>
+
+using namespace rfb;
+
+static core::LogWriter vlog("EncodeController");
+
+// How far the settings may stray from the client's
+static const int MaxCompressChange = 3;
+static const int MaxQualityReduction = 3;
+
+// Updates to wait after a change before judging its effect
+static const unsigned AdjustInterval = 4;
+
+// What TightEncoder uses when the client has no preference
+static const int DefaultCompressLevel = 2;
+
+// Bounds on the wait before lossless is tried again
+static const unsigned MinLosslessHoldoff = 16;
+static const unsigned MaxLosslessHoldoff = 1024;
+
+EncodeController::EncodeController()
+    : clientCompressLevel(-1), clientQualityLevel(-1), clientFineQualityLevel(-1),
+      clientSubsampling(subsampleUndefined) {
+  reset();
+}
+
+void EncodeController::reset() {
+  compressChange = 0;
+  qualityChange = 0;
+  lossless = false;
+  losslessHoldoff = 0;
+  updatesSinceLossless = 0;
+
+  encodeUs = 0;
+  sendUs = 0;
+  updates = 0;
+  updatesSinceChange = 0;
+}
+
+void EncodeController::setClientSettings(int compressLevel_, int qualityLevel_, int fineQualityLevel_,
+                                         int subsampling_) {
+  clientCompressLevel = compressLevel_;
+  clientQualityLevel = qualityLevel_;
+  clientFineQualityLevel = fineQualityLevel_;
+  clientSubsampling = subsampling_;
+}
+
+void EncodeController::noteUpdate(uint64_t encodeUs_, size_t bytes, size_t bandwidth, unsigned targetMs) {
+  uint64_t sendUs_;
+
+  if (targetMs == 0)
+    return;
+
+  sendUs_ = 0;
+  if (bandwidth != 0)
+    sendUs_ = (uint64_t)bytes * 1000000 / bandwidth;
+
+  if (updates == 0) {
+    encodeUs = encodeUs_;
+    sendUs = sendUs_;
+  } else {
+    encodeUs = (encodeUs * 3 + encodeUs_) / 4;
+    sendUs = (sendUs * 3 + sendUs_) / 4;
+  }
+
+  updates++;
+  updatesSinceChange++;
+  updatesSinceLossless++;
+
+  if (updatesSinceChange < AdjustInterval)
+    return;
+
+  adjust(targetMs * 1000);
+}
+
+int EncodeController::compressLevel() const {
+  int level;
+
+  if (compressChange == 0)
+    return clientCompressLevel;
+
+  level = clientCompressLevel;
+  if (level < 0)
+    level = DefaultCompressLevel;
+
+  return std::min(std::max(level + compressChange, 0), 9);
+}
+
+int EncodeController::qualityLevel() const {
+  if (clientQualityLevel == -1)
+    return -1;
+
+  return std::max(clientQualityLevel + qualityChange, 0);
+}
+
+int EncodeController::fineQualityLevel() const {
+  if (clientFineQualityLevel == -1)
+    return -1;
+
+  return std::max(clientFineQualityLevel + qualityChange * 10, 1);
+}
+
+int EncodeController::subsampling() const {
+  // Grayscale, or already heavy, subsampling is left alone
+  if ((clientSubsampling != subsampleNone) && (clientSubsampling != subsample2X))
+    return clientSubsampling;
+
+  if (qualityChange <= -3)
+    return subsample4X;
+  if (qualityChange <= -2)
+    return subsample2X;
+
+  return clientSubsampling;
+}
+
+void EncodeController::adjust(unsigned targetUs) {
+  int oldCompress, oldQuality, oldFineQuality;
+  bool oldLossless;
+  const char* reason;
+
+  oldCompress = compressLevel();
+  oldQuality = qualityLevel();
+  oldFineQuality = fineQualityLevel();
+  oldLossless = lossless;
+
+  if ((encodeUs > targetUs) && (encodeUs >= sendUs)) {
+    reason = "encoding";
+
+    if (lossless)
+      dropLossless();
+    else if ((compressChange > -MaxCompressChange) && (compressLevel() > 0))
+      compressChange--;
+    else if (jpegAllowed() && (qualityChange > -MaxQualityReduction))
+      qualityChange--;
+  } else if (sendUs > targetUs) {
+    reason = "sending";
+
+    if (lossless)
+      dropLossless();
+    else if (jpegAllowed() && (qualityChange > -MaxQualityReduction))
+      qualityChange--;
+    else if ((compressChange < MaxCompressChange) && (compressLevel() < 9) && (encodeUs * 2 < targetUs))
+      compressChange++;
+  } else if ((encodeUs * 4 < targetUs) && (sendUs * 4 < targetUs)) {
+    reason = "headroom";
+
+    if (qualityChange < 0)
+      qualityChange++;
+    else if (compressChange < 0)
+      compressChange++;
+    else if (compressChange > 0)
+      compressChange--;
+    else if (jpegAllowed() && (updatesSinceLossless >= losslessHoldoff))
+      lossless = true;
+  } else {
+    return;
+  }
+
+  if ((compressLevel() == oldCompress) && (qualityLevel() == oldQuality) && (fineQualityLevel() == oldFineQuality) &&
+      (lossless == oldLossless))
+    return;
+
+  vlog.info("Limited by %s (%.1f ms encoding, %.1f ms sending, target %.1f ms): compression level %d -> %d, "
+            "quality %d -> %d, fine quality %d -> %d, %s",
+            reason, encodeUs / 1000.0, sendUs / 1000.0, targetUs / 1000.0, oldCompress, compressLevel(), oldQuality,
+            qualityLevel(), oldFineQuality, fineQualityLevel(), lossless ? "lossless" : "lossy");
+
+  updatesSinceChange = 0;
+}
+
+void EncodeController::dropLossless() {
+  lossless = false;
+
+  losslessHoldoff = std::min(std::max(losslessHoldoff * 2, MinLosslessHoldoff), MaxLosslessHoldoff);
+  updatesSinceLossless = 0;
+}
+
+bool EncodeController::jpegAllowed() const {
+  return (clientQualityLevel != -1) || (clientFineQualityLevel != -1) || (clientSubsampling != subsampleUndefined);
+}
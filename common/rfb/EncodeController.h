@@ -0,0 +1,92 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef __RFB_ENCODECONTROLLER_H__
+#define __RFB_ENCODECONTROLLER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace rfb {
+
+// Adapts the encoding settings of a connection to how long its updates
+// take to encode and to send, aiming to fit both within a frame time.
+//
+// When encoding is the bottleneck the compression level is lowered
+// first, and then the JPEG quality. When the link is, the JPEG quality
+// is lowered first, and then the compression level is raised if there
+// is CPU to spare. With plenty of headroom on both, the settings go
+// back to what the client asked for, and finally full colour rects are
+// sent losslessly instead of as JPEG.
+//
+// The JPEG quality never goes above what the client asked for, or
+// more than a few steps below it. The compression level stays within
+// a few steps of the client's.
+
+class EncodeController {
+public:
+  EncodeController();
+
+  // Forgets all adjustments
+  void reset();
+
+  void setClientSettings(int compressLevel, int qualityLevel, int fineQualityLevel, int subsampling);
+
+  // Reports an update that took encodeUs to encode into bytes of
+  // output. The bandwidth estimate is in bytes per second, or 0 if
+  // unknown.
+  void noteUpdate(uint64_t encodeUs, size_t bytes, size_t bandwidth, unsigned targetMs);
+
+  // Settings to use instead of the client's
+  int compressLevel() const;
+  int qualityLevel() const;
+  int fineQualityLevel() const;
+  int subsampling() const;
+  bool preferLossless() const {
+    return lossless;
+  }
+
+private:
+  void adjust(unsigned targetUs);
+  void dropLossless();
+  bool jpegAllowed() const;
+
+  int clientCompressLevel;
+  int clientQualityLevel;
+  int clientFineQualityLevel;
+  int clientSubsampling;
+
+  int compressChange;
+  int qualityChange;
+  bool lossless;
+
+  // Lossless output can be many times larger than JPEG, so each
+  // failed attempt doubles the wait before the next
+  unsigned losslessHoldoff;
+  unsigned updatesSinceLossless;
+
+  // Smoothed time per update
+  uint64_t encodeUs;
+  uint64_t sendUs;
+  unsigned updates;
+  unsigned updatesSinceChange;
+};
+
+} // namespace rfb
+
+#endif
@@ -23,14 +23,27 @@
 #include <config.h>
 #endif
 
+#include <algorithm>
+#include <atomic>
 #include <assert.h>
 #include <ctime>
 #include <stdlib.h>
 #include <string>
 #include <sys/time.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define SOLID_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include <core/LogWriter.h>
+#include <core/WorkerPool.h>
 #include <core/string.h>
+#include <core/time.h>
 
 #include <rfb/CacheKey.h>
 #include <rfb/ContentHash.h>
@@ -39,21 +52,33 @@
 #include <rfb/Encoder.h>
 #include <rfb/Palette.h>
 #include <rfb/PixelBuffer.h>
+#include <rfb/PixelFormatSIMD.h>
 #include <rfb/SConnection.h>
 #include <rfb/SMsgWriter.h>
 #include <rfb/ServerCore.h>
+#include <rfb/SharedEncodeCache.h>
 #include <rfb/UpdateTracker.h>
 #include <rfb/encodings.h>
 
+#include <rfb/cache/BorderedRegionTracker.h>
+#include <rfb/cache/CacheDelta.h>
+#include <rfb/cache/EncodedPayloadCache.h>
+#include <rfb/cache/GlyphDictionary.h>
+#include <rfb/cache/ScanTelemetry.h>
 #include <rfb/cache/ShiftTolerantScan.h>
 #include <rfb/cache/TilingIntegration.h>
+#include <rfb/cache/VolatilityMap.h>
 
 #include <rfb/HextileEncoder.h>
 #include <rfb/RREEncoder.h>
 #include <rfb/RawEncoder.h>
 #include <rfb/TightEncoder.h>
+#include <rfb/TightGradient.h>
 #include <rfb/TightJPEGEncoder.h>
 #include <rfb/ZRLEEncoder.h>
+#ifdef HAVE_H264
+#include <rfb/H264Encoder.h>
+#endif
 
 // For lossy hash computation
 #include <rdr/MemInStream.h>
@@ -70,6 +95,24 @@ static core::LogWriter vlog("EncodeManager");
 static const int SubRectMaxArea = 65536;
 static const int SubRectMaxWidth = 2048;
 
+// Height of the bands a split rectangle is cut into is kept a multiple
+// of this, so that every band but the last one ends on a JPEG MCU
+// boundary and no band pays for a partially padded row of blocks.
+static const int SubRectHeightAlign = 16;
+
+// Smallest update worth handing to the encoding threads
+static const size_t ParallelEncodeMinArea = 2 * SubRectMaxArea;
+
+static int subRectHeight(int sw) {
+  int sh;
+
+  sh = SubRectMaxArea / sw;
+  if (sh > SubRectHeightAlign)
+    sh -= sh % SubRectHeightAlign;
+
+  return sh;
+}
+
 // ContentCache debug logging helpers (anonymous namespace)
 namespace {
 // Format a rectangle as "x,y wxh"
@@ -222,9 +265,31 @@ static const int SolidSearchBlock = 16;
 // Don't bother with blocks smaller than this
 static const int SolidBlockMinArea = 2048;
 
+// Fewest full cells that make a GlyphRect worthwhile
+static const int GlyphMinCells = 4;
+// Widest GlyphRect, in cells
+static const int GlyphMaxColumns = 256;
+// Taller areas are left to the PersistentCache, which can send all of
+// it as one reference if the client has seen it before
+static const int GlyphMaxCacheableRows = 4;
+// Updates to wait before looking for the cell grid again
+static const unsigned GlyphPhaseRetryUpdates = 32;
+
 // How long we consider a region recently changed (in ms)
 static const int RecentChangeTimeout = 50;
 
+// Lowest quality level volatile areas are reduced to (unless the
+// client asked for even less)
+static const int VolatileMinQuality = 2;
+static const int VolatileMinFineQuality = 30;
+
+// Number of updates a volatile area must keep its geometry before it
+// is sent as an H.264 stream
+static const unsigned H264StableUpdates = 5;
+// Bitrate limits for H.264 streams, in bits per second
+static const size_t H264MinBitrate = 500000;
+static const size_t H264MaxBitrate = 20000000;
+
 namespace rfb {
 
 static const char* encoderClassName(EncoderClass klass) {
@@ -241,6 +306,8 @@ static const char* encoderClassName(EncoderClass klass) {
     return "Tight (JPEG)";
   case encoderZRLE:
     return "ZRLE";
+  case encoderH264:
+    return "H.264";
   case encoderClassMax:
     break;
   }
@@ -285,8 +352,14 @@ static bool isCCTilingDebugEnabled() {
 }
 
 EncodeManager::EncodeManager(SConnection* conn_)
-    : conn(conn_), lastSentBpp(0), recentChangeTimer(this), cacheStatsTimer(this), usePersistentCache(false),
-      nativeFormatCacheSupported(false) {
+    : conn(conn_), lastSentBpp(0), recentChangeTimer(this), cacheStatsTimer(this), threadedUpdate(false),
+      recentChangeStarted(false), volatilityMap(nullptr),
+      borderedTracker(nullptr), encodingVolatile(false), videoRectUpdates(0), encodeWorkers(nullptr),
+      nextEncodeJob(0), activeJob(nullptr), parallelEncoding(false), sharedEncodes(nullptr), sharingEncodes(false),
+      usePersistentCache(false), nativeFormatCacheSupported(false),
+      deltaRefs((size_t)Server::persistentCacheDeltaSize * 1024 * 1024), glyphs(Server::glyphCacheSize),
+      glyphCellW(0), glyphCellH(0), glyphReset(true), glyphPhaseStale(true), glyphPhaseSearchAt(0),
+      glyphUpdateCells(0), glyphUpdateKnown(0) {
   StatsVector::iterator iter;
 
   if (isCCDebugEnabled()) {
@@ -302,10 +375,21 @@ EncodeManager::EncodeManager(SConnection* conn_)
   encoders[encoderTight] = new TightEncoder(conn);
   encoders[encoderTightJPEG] = new TightJPEGEncoder(conn);
   encoders[encoderZRLE] = new ZRLEEncoder(conn);
+#ifdef HAVE_H264
+  encoders[encoderH264] = new H264Encoder(conn);
+#endif
 
   updates = 0;
   memset(&copyStats, 0, sizeof(copyStats));
   memset(&persistentCacheStats, 0, sizeof(persistentCacheStats));
+  memset(&volatileStats, 0, sizeof(volatileStats));
+  memset(&payloadCacheStats, 0, sizeof(payloadCacheStats));
+  memset(&sharedStats, 0, sizeof(sharedStats));
+  memset(&deltaStats, 0, sizeof(deltaStats));
+  memset(&glyphStats, 0, sizeof(glyphStats));
+  memset(&refinementStats, 0, sizeof(refinementStats));
+
+  gettimeofday(&volatilityEpoch, nullptr);
   stats.resize(encoderClassMax);
   for (iter = stats.begin(); iter != stats.end(); ++iter) {
     StatsVector::value_type::iterator iter2;
@@ -323,8 +407,21 @@ EncodeManager::EncodeManager(SConnection* conn_)
 EncodeManager::~EncodeManager() {
   logStats();
 
+  if ((sharedEncodes != nullptr) && !sharedFingerprint.empty())
+    sharedEncodes->leave(sharedFingerprint);
+
   for (Encoder* encoder : encoders)
     delete encoder;
+
+  delete volatilityMap;
+  delete borderedTracker;
+
+  delete encodeWorkers;
+  for (EncodeSlot* slot : encodeSlots) {
+    for (Encoder* encoder : slot->encoders)
+      delete encoder;
+    delete slot;
+  }
 }
 
 bool EncodeManager::isLossyEncoding(int encoding) const {
@@ -351,6 +448,17 @@ bool EncodeManager::isLossyEncoding(int encoding) const {
   return false;
 }
 
+int EncodeManager::zlibLevel() const {
+  int level;
+
+  // Same default as the zlib based encoders
+  level = controller.compressLevel();
+  if (level < 0)
+    level = 2;
+
+  return level;
+}
+
 void EncodeManager::logStats() {
   size_t i, j;
 
@@ -358,6 +466,7 @@ void EncodeManager::logStats() {
   unsigned long long pixels, bytes, equivalent;
 
   double ratio;
+  double hitPct;
 
   rects = 0;
   pixels = bytes = equivalent = 0;
@@ -414,13 +523,69 @@ void EncodeManager::logStats() {
   vlog.info("  Total: %s, %s", core::siPrefix(rects, "rects").c_str(), core::siPrefix(pixels, "pixels").c_str());
   vlog.info("         %s (1:%g ratio)", core::iecPrefix(bytes, "B").c_str(), ratio);
 
+  if (volatileStats.updates != 0) {
+    ratio = (double)volatileStats.equivalent / volatileStats.bytes;
+    vlog.info("  Volatile areas: %s, %s", core::siPrefix(volatileStats.updates, "updates").c_str(),
+              core::siPrefix(volatileStats.pixels, "pixels").c_str());
+    vlog.info("                  %s (1:%g ratio), %g ms encoding", core::iecPrefix(volatileStats.bytes, "B").c_str(),
+              ratio, volatileStats.encodeUs / 1000.0);
+    vlog.info("                  %s not hashed for cache lookups",
+              core::siPrefix(volatileStats.hashSkipped, "pixels").c_str());
+  }
+
+  if (payloadCacheStats.lookups != 0) {
+    hitPct = 100.0 * payloadCacheStats.hits / payloadCacheStats.lookups;
+    vlog.info("  Encoded payload cache: %s, %s (%.1f%%)",
+              core::siPrefix(payloadCacheStats.lookups, "lookups").c_str(),
+              core::siPrefix(payloadCacheStats.hits, "hits").c_str(), hitPct);
+    vlog.info("                         %s reused, %g ms encoding saved",
+              core::iecPrefix(payloadCacheStats.bytes, "B").c_str(), payloadCacheStats.savedUs / 1000.0);
+  }
+
+  if (deltaStats.candidates != 0) {
+    vlog.info("  Cache deltas: %s sent of %s candidates, %s",
+              core::siPrefix(deltaStats.rects, "rects").c_str(),
+              core::siPrefix(deltaStats.candidates, "rects").c_str(),
+              core::iecPrefix(deltaStats.bytes, "B").c_str());
+    vlog.info("                %s saved, %s of reference content kept",
+              core::iecPrefix(deltaStats.bytesSaved, "B").c_str(),
+              core::iecPrefix(deltaRefs.memoryUsage(), "B").c_str());
+  }
+
+  if (glyphStats.rects != 0) {
+    ratio = (double)glyphStats.equivalent / glyphStats.bytes;
+    vlog.info("  Glyph rects: %s, %s, %s new",
+              core::siPrefix(glyphStats.rects, "rects").c_str(),
+              core::siPrefix(glyphStats.cells, "cells").c_str(),
+              core::siPrefix(glyphStats.newGlyphs, "glyphs").c_str());
+    vlog.info("               %s (1:%g ratio), %zu glyphs held, %u grid searches",
+              core::iecPrefix(glyphStats.bytes, "B").c_str(), ratio, glyphs.size(),
+              glyphStats.phaseSearches);
+  }
+
+  if (refinementStats.rects != 0) {
+    ratio = (double)refinementStats.equivalent / refinementStats.bytes;
+    vlog.info("  Lossy refinements: %s of %s candidates, %s",
+              core::siPrefix(refinementStats.rects, "rects").c_str(),
+              core::siPrefix(refinementStats.candidates, "rects").c_str(),
+              core::siPrefix(refinementStats.pixels, "pixels").c_str());
+    vlog.info("                     %s (%g:1 against sending again), %g ms",
+              core::iecPrefix(refinementStats.bytes, "B").c_str(), ratio, refinementStats.encodeUs / 1000.0);
+  }
+
+  if ((sharedStats.rects != 0) || (sharedStats.published != 0)) {
+    vlog.info("  Shared encodes: %s copied (%s), %s offered to others",
+              core::siPrefix(sharedStats.rects, "rects").c_str(), core::iecPrefix(sharedStats.bytes, "B").c_str(),
+              core::siPrefix(sharedStats.published, "rects").c_str());
+  }
+
   // Unified cache statistics (covers both ContentCache and PersistentCache
   // protocols on the wire). Preserve the original "Lookups: N, References
   // sent: M (P%)" format consumed by e2e tests such as
   // test_cachedrect_init_propagation.py.
   unsigned cacheLookups = persistentCacheStats.cacheLookups;
   unsigned cacheHits = persistentCacheStats.cacheHits;
-  double hitPct = cacheLookups ? (100.0 * (double)cacheHits / (double)cacheLookups) : 0.0;
+  hitPct = cacheLookups ? (100.0 * (double)cacheHits / (double)cacheLookups) : 0.0;
 
   vlog.info("Lookups: %u, References sent: %u (%.1f%%)", cacheLookups, cacheHits, hitPct);
 }
@@ -450,16 +615,23 @@ void EncodeManager::dumpDebugState(const char* outputDir) {
   fprintf(f, "Hits: %u\n", persistentCacheStats.cacheHits);
   fprintf(f, "Misses: %u\n", persistentCacheStats.cacheMisses);
   fprintf(f, "Bytes saved: %llu\n", (unsigned long long)persistentCacheStats.bytesSaved);
+  fprintf(f, "Delta rects: %u of %u candidates\n", deltaStats.rects, deltaStats.candidates);
+  fprintf(f, "Delta references: %zu (%zu bytes)\n", deltaRefs.size(), deltaRefs.memoryUsage());
+  fprintf(f, "Glyph rects: %u, %zu glyphs held, grid phase %d,%d\n", glyphStats.rects, glyphs.size(), glyphPhase.x,
+          glyphPhase.y);
+  fprintf(f, "Lossy refinements: %u of %u candidates, %zu rects tracked\n", refinementStats.rects,
+          refinementStats.candidates, refinements.size());
   double hitPct = persistentCacheStats.cacheLookups > 0
                       ? (100.0 * persistentCacheStats.cacheHits / persistentCacheStats.cacheLookups)
                       : 0.0;
   fprintf(f, "Hit rate: %.1f%%\n", hitPct);
 
-  fprintf(f, "\n=== Client Known IDs (ServerHashSet) ===\n");
+  fprintf(f, "\n=== Client Known IDs ===\n");
   auto hashStats = clientKnownIds_.getStats();
   fprintf(f, "Current size: %zu\n", hashStats.currentSize);
   fprintf(f, "Total added: %llu\n", (unsigned long long)hashStats.totalAdded);
   fprintf(f, "Total evicted: %llu\n", (unsigned long long)hashStats.totalEvicted);
+  fprintf(f, "Bitset memory: %zu bytes\n", clientKnownIds_.memoryUsage());
 
   fprintf(f, "\n=== Update Statistics ===\n");
   fprintf(f, "Total updates: %u\n", updates);
@@ -545,11 +717,57 @@ void EncodeManager::handlePixelFormatChange(int newBpp) {
   lastSentBpp = newBpp;
 }
 
+void EncodeManager::noteFramebufferDamage(const core::Region& damage) {
+  if (borderedTracker != nullptr)
+    borderedTracker->noteDamage(damage);
+}
+
 void EncodeManager::writeUpdate(const UpdateInfo& ui, const PixelBuffer* pb, const RenderedCursor* renderedCursor) {
+  noteVolatileDamage(ui.changed, pb);
+
+  // Normally already seen, but not everyone goes via noteFramebufferDamage()
+  noteFramebufferDamage(ui.changed);
+  noteFramebufferDamage(ui.copied);
+
+  struct timeval start;
+  size_t before;
+
+  gettimeofday(&start, nullptr);
+  before = conn->getOutStream()->length();
+
   doUpdate(true, ui.changed, ui.copied, ui.copy_delta, pb, renderedCursor);
 
+  if (rfb::Server::adaptiveEncoding && (rfb::Server::frameRate > 0))
+    controller.noteUpdate(core::usSince(&start), conn->getOutStream()->length() - before,
+                          conn->getBandwidthEstimate(), 1000 / rfb::Server::frameRate);
+
   recentlyChangedRegion.assign_union(ui.changed);
   recentlyChangedRegion.assign_union(ui.copied);
+  startRecentChangeTimer();
+}
+
+void EncodeManager::beginThreadedUpdate() {
+  recentChangeStarted = recentChangeTimer.isStarted();
+  threadedUpdate = true;
+}
+
+void EncodeManager::endThreadedUpdate() {
+  threadedUpdate = false;
+  if (recentChangeStarted && !recentChangeTimer.isStarted())
+    recentChangeTimer.start(RecentChangeTimeout);
+}
+
+bool EncodeManager::recentChangeActive() {
+  if (threadedUpdate)
+    return recentChangeStarted;
+  return recentChangeTimer.isStarted();
+}
+
+void EncodeManager::startRecentChangeTimer() {
+  if (threadedUpdate) {
+    recentChangeStarted = true;
+    return;
+  }
   if (!recentChangeTimer.isStarted())
     recentChangeTimer.start(RecentChangeTimeout);
 }
@@ -589,6 +807,7 @@ void EncodeManager::writeLosslessRefresh(const core::Region& req, const PixelBuf
         // Emit PersistentCachedRectInit with native_format flag + canonical PF
         uint8_t flags = 0x01; // native_format
         conn->writer()->writePersistentCachedRectInit(rect, cacheKey, payloadEnc->encoding, flags, &canonicalNativePF);
+        payloadEnc->setSmoothHint(info.smooth);
         payloadEnc->writeRect(ppb, info.palette);
         conn->writer()->endRect();
 
@@ -600,6 +819,7 @@ void EncodeManager::writeLosslessRefresh(const core::Region& req, const PixelBuf
 
         // Remove from reduced-depth tracking once upgraded
         reducedDepthRegion.assign_subtract(rect);
+        refinements.discard(rect);
         pendingRefreshRegion.assign_subtract(rect);
       }
 
@@ -615,10 +835,27 @@ void EncodeManager::writeLosslessRefresh(const core::Region& req, const PixelBuf
 }
 
 void EncodeManager::handleTimeout(core::Timer* t) {
+  // An update is being encoded elsewhere, so try again in a while
+  if (threadedUpdate) {
+    t->repeat();
+    return;
+  }
+
   if (t == &recentChangeTimer) {
     // Any lossy region that wasn't recently updated can
     // now be scheduled for a refresh
-    pendingRefreshRegion.assign_union(lossyRegion.subtract(recentlyChangedRegion));
+    core::Region settled;
+
+    settled = lossyRegion.subtract(recentlyChangedRegion);
+
+    // Volatile areas would just get damaged again, so wait until they
+    // settle before spending bandwidth on them
+    if ((volatilityMap != nullptr) && rfb::Server::enableVolatilityMap) {
+      volatilityMap->advance(core::usSince(&volatilityEpoch) / 1000);
+      settled.assign_subtract(volatilityMap->volatileRegion());
+    }
+
+    pendingRefreshRegion.assign_union(settled);
     recentlyChangedRegion.clear();
 
     // Will there be more to do? (i.e. do we need another round)
@@ -655,10 +892,20 @@ void EncodeManager::doUpdate(bool allowLossy, const core::Region& changed_, cons
                   fbRect.tl.y, fbRect.br.x, fbRect.br.y);
       }
       lastFramebufferRect = fbRect;
+
+      refinements.clear();
+
+#ifdef HAVE_H264
+      // All streams have the wrong geometry now
+      ((H264Encoder*)encoders[encoderH264])->resetContexts();
+      videoRect = core::Rect();
+      videoRectUpdates = 0;
+#endif
     }
   }
 
   prepareEncoders(allowLossy);
+  updateSharing();
 
   // Track if this update will use lossy encoding (for seeding decisions)
   // If allowLossy is true and client supports Tight, assume lossy until proven
@@ -666,6 +913,10 @@ void EncodeManager::doUpdate(bool allowLossy, const core::Region& changed_, cons
   currentEncodingIsLossy = allowLossy && conn->client.supportsEncoding(encodingTight);
   currentEncoding = conn->getPreferredEncoding();
 
+  volatileRegion.clear();
+  if (allowLossy && (volatilityMap != nullptr) && rfb::Server::enableVolatilityMap)
+    volatileRegion = volatilityMap->volatileRegion();
+
   changed = changed_;
 
   // Optional experimental tiling analysis (log-only). This does not
@@ -720,6 +971,15 @@ void EncodeManager::doUpdate(bool allowLossy, const core::Region& changed_, cons
   if (conn->client.supportsEncoding(encodingCopyRect) && !disableCopyRect)
     writeCopyRects(copied, copyDelta);
 
+  // What went out as JPEG can often be made exact with much less than
+  // the pixels. This also changes the number of rects.
+  if (!allowLossy && conn->client.supportsEncoding(pseudoEncodingLastRect) && pb != nullptr)
+    writeRefinementRects(&changed, pb);
+
+  // Everything else sent now replaces what the client decoded
+  refinements.discard(changed_);
+  refinements.discard(copied);
+
   // Shift-tolerant cache scan (emit tiles). Enabled via
   // Server::enableShiftTolerantCacheScan. Requires pseudoEncodingLastRect so
   // the update rect count is not fixed.
@@ -736,8 +996,26 @@ void EncodeManager::doUpdate(bool allowLossy, const core::Region& changed_, cons
   if (conn->client.supportsEncoding(pseudoEncodingLastRect))
     writeSolidRects(&changed, pb);
 
+  // Text is cut into cells regardless of the solid areas found above,
+  // and this also changes the number of rects
+  if (conn->client.supportsEncoding(pseudoEncodingLastRect) && pb != nullptr)
+    writeGlyphRects(&changed, pb, renderedCursor ? renderedCursor->getEffectiveRect() : core::Rect());
+
+  // Splitting the region changes the number of rects, so this also
+  // depends on LastRect
+  if (!volatileRegion.is_empty() && conn->client.supportsEncoding(pseudoEncodingLastRect) && pb != nullptr) {
+    core::Region volatileChanged;
+
+    volatileChanged = changed.intersect(volatileRegion);
+    changed.assign_subtract(volatileChanged);
+
+    writeVolatileRects(volatileChanged, pb);
+  }
+
   writeRects(changed, pb);
   writeRects(cursorRegion, renderedCursor);
+  // Made from the cursor's pixels rather than the framebuffer's
+  refinements.discard(cursorRegion);
   vlog.info("PCOFF SUMMARY: hits=%llu lookups=%llu bytes=%llu changed=%s", (unsigned long long)pcoffCounters.hits,
             (unsigned long long)pcoffCounters.lookups, (unsigned long long)pcoffCounters.bytes,
             strRegionSummary(changed_));
@@ -790,7 +1068,8 @@ void EncodeManager::runShiftTolerantCacheScan(core::Region* changed, const Pixel
     return conn->knowsPersistentId(id) && !conn->clientRequestedPersistent(id);
   };
 
-  std::vector<rfb::cache::KeyedRect> hits = scanner.scanAndPack(*changed, pb, nullptr, clientKnowsKey, &scanStats);
+  std::vector<rfb::cache::KeyedRect> hits = scanner.scanAndPack(*changed, pb, volatileRegion.is_empty() ? nullptr : volatilityMap,
+                                                                   clientKnowsKey, &scanStats);
 
   // Account scan hash computations as cache lookups.
   persistentCacheStats.cacheLookups += (unsigned)scanStats.blocksHashed;
@@ -816,15 +1095,8 @@ void EncodeManager::runShiftTolerantCacheScan(core::Region* changed, const Pixel
     pendingRefreshRegion.assign_subtract(kr.rect);
   }
 
-  if (cfg.logStats) {
-    vlog.info("CACHESCAN pack: blocksHashed=%llu rectsHashed=%llu "
-              "blocksHit=%llu packed=%llu verified=%llu "
-              "emitted=%llu timeUs=%llu",
-              (unsigned long long)scanStats.blocksHashed, (unsigned long long)scanStats.rectsHashed,
-              (unsigned long long)scanStats.blocksHit, (unsigned long long)scanStats.packedRects,
-              (unsigned long long)scanStats.rectHitsVerified, (unsigned long long)scanStats.rectHitsEmitted,
-              (unsigned long long)scanStats.timeUs);
-  }
+  if (cfg.logStats)
+    cache::ScanTelemetry::logIfEnabled("pack", scanStats);
 }
 
 void EncodeManager::runOffsetTilePrepass(core::Region* changed, const PixelBuffer* pb) {
@@ -953,6 +1225,11 @@ void EncodeManager::prepareEncoders(bool allowLossy) {
   solid = bitmap = bitmapRLE = encoderRaw;
   indexed = indexedRLE = fullColour = encoderRaw;
 
+  if (!rfb::Server::adaptiveEncoding)
+    controller.reset();
+  controller.setClientSettings(conn->client.compressLevel, conn->client.qualityLevel, conn->client.fineQualityLevel,
+                               conn->client.subsampling);
+
   // Strict lossless path: used for idle "lossless refresh" updates when
   // allowLossy == false. In this mode we never use JPEG at all and prefer
   // ZRLE for all rectangle types when the client supports it. This ensures
@@ -1027,6 +1304,10 @@ void EncodeManager::prepareEncoders(bool allowLossy) {
     if (bitmapRLE == encoderRaw)
       bitmapRLE = bitmap;
 
+    // There is enough time and bandwidth to do better than JPEG
+    if ((fullColour == encoderTightJPEG) && controller.preferLossless())
+      fullColour = encoderTight;
+
     if (solid == encoderRaw) {
       if (encoders[encoderTight]->isSupported())
         solid = encoderTight;
@@ -1057,11 +1338,11 @@ void EncodeManager::prepareEncoders(bool allowLossy) {
 
     encoder = encoders[*iter];
 
-    encoder->setCompressLevel(conn->client.compressLevel);
+    encoder->setCompressLevel(controller.compressLevel());
 
     if (allowLossy) {
-      encoder->setQualityLevel(conn->client.qualityLevel);
-      encoder->setFineQualityLevel(conn->client.fineQualityLevel, conn->client.subsampling);
+      encoder->setQualityLevel(controller.qualityLevel());
+      encoder->setFineQualityLevel(controller.fineQualityLevel(), controller.subsampling());
     } else {
       // Lossless refresh path: ensure any encoder that supports a
       // "losslessQuality" level uses it, and disable fine-quality
@@ -1150,7 +1431,7 @@ int EncodeManager::computeNumRects(const core::Region& changed) {
     else
       sw = SubRectMaxWidth;
 
-    sh = SubRectMaxArea / sw;
+    sh = subRectHeight(sw);
 
     // ceil(w/sw) * ceil(h/sh)
     numRects += (((w - 1) / sw) + 1) * (((h - 1) / sh) + 1);
@@ -1197,6 +1478,19 @@ Encoder* EncodeManager::startRect(const core::Rect& rect, int type) {
   else
     lossyRegion.assign_subtract(rect);
 
+  // Remember how a JPEG was made so that it can be refined later
+  if (encoderIsLossy && (klass == encoderTightJPEG) && Server::lossyRefinement &&
+      conn->client.supportsEncoding(encodingLossyRefinement) && conn->client.pf().is888()) {
+    int quality, subsampling;
+
+    ((TightJPEGEncoder*)encoder)->getJpegSettings(&quality, &subsampling);
+    refinements.add(rect, quality, subsampling);
+  } else {
+    // Encoders may rewrite more than what changed (e.g. a whole H.264
+    // stream area), so whatever JPEG was here is gone now
+    refinements.remove(rect);
+  }
+
   // This was either a rect getting refreshed, or a rect that just got
   // new content. Either way we should not try to refresh it anymore.
   pendingRefreshRegion.assign_subtract(rect);
@@ -1348,11 +1642,441 @@ void EncodeManager::findSolidRect(const core::Rect& rect, core::Region* changed,
   }
 }
 
+static int floorMod(int a, int b) {
+  return ((a % b) + b) % b;
+}
+
+// Cuts [start, end) at grid lines into pieces of at most maxCells cells
+static void splitOnGrid(int start, int end, int phase, int cell, int maxCells, std::vector<std::pair<int, int>>* out) {
+  out->clear();
+  while (start < end) {
+    int next;
+
+    next = start - floorMod(start - phase, cell) + cell * maxCells;
+    next = std::min(next, end);
+    out->push_back(std::make_pair(start, next));
+    start = next;
+  }
+}
+
+static bool sameCell(const uint8_t* a, const uint8_t* b, size_t rowBytes, size_t stride, int height) {
+  for (int y = 0; y < height; y++) {
+    if (memcmp(a + y * stride, b + y * stride, rowBytes) != 0)
+      return false;
+  }
+  return true;
+}
+
+// The number of distinct full cells in rect, per thousand cells
+static int distinctCellsPermille(const PixelBuffer* pb, const core::Rect& rect, const core::Point& phase, int cellW,
+                                 int cellH) {
+  std::unordered_set<uint64_t> distinct;
+  const uint8_t* data;
+  int stride, bpp, total;
+  int x0, y0;
+
+  data = pb->getBuffer(rect, &stride);
+  bpp = pb->getPF().bpp / 8;
+
+  x0 = floorMod(phase.x - rect.tl.x, cellW);
+  y0 = floorMod(phase.y - rect.tl.y, cellH);
+
+  total = 0;
+  for (int y = y0; y + cellH <= rect.height(); y += cellH) {
+    for (int x = x0; x + cellW <= rect.width(); x += cellW) {
+      distinct.insert(cache::GlyphDictionary::hashCell(data + (y * stride + x) * bpp, cellW * bpp, stride * bpp,
+                                                       cellH));
+      total++;
+    }
+  }
+
+  if (total == 0)
+    return 1000;
+
+  return distinct.size() * 1000 / total;
+}
+
+void EncodeManager::writeGlyphRects(core::Region* changed, const PixelBuffer* pb, const core::Rect& avoid) {
+  const PixelFormat& clientPF = conn->client.pf();
+  std::vector<core::Rect> rects;
+  std::vector<std::pair<int, int>> columns, rows;
+  core::Region candidates, area, sent;
+  core::Rect largest;
+  int cellW, cellH, maxCells;
+
+  if (!conn->client.supportsEncoding(encodingGlyphRect))
+    return;
+  if (Server::glyphCacheSize == 0)
+    return;
+  if (changed->is_empty())
+    return;
+
+  cellW = Server::glyphCellWidth;
+  cellH = Server::glyphCellHeight;
+
+  // Glyphs are kept as the client sees them, so anything that changes
+  // that makes the whole dictionary useless
+  if (((size_t)Server::glyphCacheSize != glyphs.maxGlyphs()) || !(clientPF == glyphPF) || (cellW != glyphCellW) ||
+      (cellH != glyphCellH)) {
+    glyphs.setMaxGlyphs(Server::glyphCacheSize);
+    glyphPF = clientPF;
+    glyphCellW = cellW;
+    glyphCellH = cellH;
+    glyphReset = true;
+    glyphPhaseStale = true;
+    glyphPhaseSearchAt = 0;
+  }
+
+  candidates = changed->subtract(volatileRegion);
+  candidates.get_rects(&rects);
+
+  // Large areas are better off in the PersistentCache, unless it is
+  // just a few lines of text
+  if (usePersistentCache && conn->client.supportsEncoding(pseudoEncodingPersistentCache)) {
+    rects.erase(std::remove_if(rects.begin(), rects.end(),
+                               [cellH](const core::Rect& r) {
+                                 return (r.area() >= Server::persistentCacheMinRectSize) &&
+                                        (r.height() > cellH * GlyphMaxCacheableRows);
+                               }),
+                rects.end());
+  }
+
+  if (rects.empty())
+    return;
+
+  if (glyphPhaseStale && (updates >= glyphPhaseSearchAt)) {
+    for (const core::Rect& rect : rects) {
+      if (rect.area() > largest.area())
+        largest = rect;
+    }
+    findGlyphPhase(largest, pb);
+  }
+
+  for (const core::Rect& rect : rects) {
+    core::Rect cells;
+
+    cells.tl.x = rect.tl.x - floorMod(rect.tl.x - glyphPhase.x, cellW);
+    cells.tl.y = rect.tl.y - floorMod(rect.tl.y - glyphPhase.y, cellH);
+    cells.br.x = rect.br.x + floorMod(glyphPhase.x - rect.br.x, cellW);
+    cells.br.y = rect.br.y + floorMod(glyphPhase.y - rect.br.y, cellH);
+
+    area.assign_union(cells.intersect(pb->getRect()));
+  }
+
+  // The client's cursor must not be painted over, and the volatile
+  // areas are sent separately
+  area.assign_subtract(avoid);
+  area.assign_subtract(volatileRegion);
+
+  // A rect mustn't evict its own glyphs from the dictionary
+  maxCells = std::max((int)glyphs.maxGlyphs() / 2, 1);
+
+  glyphUpdateCells = 0;
+  glyphUpdateKnown = 0;
+
+  area.get_rects(&rects);
+  for (const core::Rect& rect : rects) {
+    splitOnGrid(rect.tl.x, rect.br.x, glyphPhase.x, cellW, std::min(maxCells, GlyphMaxColumns), &columns);
+    for (const std::pair<int, int>& column : columns) {
+      int maxRows;
+
+      maxRows = std::max(maxCells / ((column.second - column.first) / cellW + 2), 1);
+      splitOnGrid(rect.tl.y, rect.br.y, glyphPhase.y, cellH, maxRows, &rows);
+      for (const std::pair<int, int>& row : rows) {
+        core::Rect piece(column.first, row.first, column.second, row.second);
+        if (tryGlyphRect(piece, pb))
+          sent.assign_union(piece);
+      }
+    }
+  }
+
+  changed->assign_subtract(sent);
+
+  // Something that isn't text, or text on a grid we haven't found yet
+  if ((glyphUpdateCells >= 16) && (glyphUpdateKnown * 2 < glyphUpdateCells))
+    glyphPhaseStale = true;
+}
+
+bool EncodeManager::tryGlyphRect(const core::Rect& rect, const PixelBuffer* pb) {
+  const PixelFormat& clientPF = conn->client.pf();
+  cache::GlyphLayout layout;
+  std::vector<std::pair<uint16_t, int>> newGlyphs;
+  size_t stride, rowBytes, cellBytes;
+  int cells, known, level;
+  uint8_t flags;
+
+  layout.width = rect.width();
+  layout.height = rect.height();
+  layout.cellW = glyphCellW;
+  layout.cellH = glyphCellH;
+  layout.ox = floorMod(glyphPhase.x - rect.tl.x, glyphCellW);
+  layout.oy = floorMod(glyphPhase.y - rect.tl.y, glyphCellH);
+  layout.bytesPerPixel = clientPF.bpp / 8;
+
+  cells = layout.columns() * layout.rows();
+  if (cells < GlyphMinCells)
+    return false;
+
+  stride = (size_t)layout.width * layout.bytesPerPixel;
+  rowBytes = (size_t)layout.cellW * layout.bytesPerPixel;
+  cellBytes = layout.cellBytes();
+
+  glyphPixels.resize((size_t)rect.area() * layout.bytesPerPixel);
+  pb->getImage(clientPF, glyphPixels.data(), rect);
+
+  glyphCell.resize(cellBytes);
+  glyphHashes.resize(cells);
+  glyphIndices.resize(cells);
+  glyphSeen.clear();
+
+  // Look everything up first without touching the dictionary, as we
+  // might still give up on this rect. Glyph indices go in
+  // glyphIndices, or the number of the first cell with the same
+  // content as -1 - cell for a new glyph.
+  known = 0;
+  for (int cell = 0; cell < cells; cell++) {
+    std::unordered_map<uint64_t, int>::const_iterator seen;
+    const uint8_t* pixels;
+    int index;
+
+    pixels = glyphPixels.data() + (size_t)(layout.oy + cell / layout.columns() * layout.cellH) * stride +
+             (size_t)(layout.ox + cell % layout.columns() * layout.cellW) * layout.bytesPerPixel;
+
+    glyphHashes[cell] = cache::GlyphDictionary::hashCell(pixels, rowBytes, stride, layout.cellH);
+
+    seen = glyphSeen.find(glyphHashes[cell]);
+    if (seen != glyphSeen.end()) {
+      const uint8_t* first;
+
+      first = glyphPixels.data() + (size_t)(layout.oy + seen->second / layout.columns() * layout.cellH) * stride +
+              (size_t)(layout.ox + seen->second % layout.columns() * layout.cellW) * layout.bytesPerPixel;
+
+      // Not worth handling two glyphs with the same hash in one rect
+      if (!sameCell(pixels, first, rowBytes, stride, layout.cellH))
+        return false;
+
+      glyphIndices[cell] = glyphIndices[seen->second];
+      known++;
+    } else {
+      for (int y = 0; y < layout.cellH; y++)
+        memcpy(glyphCell.data() + y * rowBytes, pixels + y * stride, rowBytes);
+
+      index = glyphs.find(glyphHashes[cell], glyphCell.data(), cellBytes);
+      if (index >= 0) {
+        glyphIndices[cell] = index;
+        known++;
+      } else {
+        glyphIndices[cell] = -1 - cell;
+      }
+
+      glyphSeen[glyphHashes[cell]] = cell;
+    }
+
+    // Give up early on anything that clearly isn't text
+    if ((cell == 31) && (known * 4 < 32)) {
+      glyphUpdateCells += 32;
+      glyphUpdateKnown += known;
+      return false;
+    }
+  }
+
+  glyphUpdateCells += cells;
+  glyphUpdateKnown += known;
+
+  // Defining most of the glyphs costs more than the pixels themselves
+  if (known * 2 < cells)
+    return false;
+
+  // Mark the hits as used first so that the new glyphs can't take
+  // their indices
+  for (int cell = 0; cell < cells; cell++) {
+    if (glyphIndices[cell] >= 0)
+      glyphs.touch(glyphIndices[cell]);
+  }
+
+  glyphCells.resize(cells);
+  for (int cell = 0; cell < cells; cell++) {
+    int index;
+
+    index = glyphIndices[cell];
+    if (index == -1 - cell) {
+      const uint8_t* pixels;
+
+      pixels = glyphPixels.data() + (size_t)(layout.oy + cell / layout.columns() * layout.cellH) * stride +
+               (size_t)(layout.ox + cell % layout.columns() * layout.cellW) * layout.bytesPerPixel;
+      for (int y = 0; y < layout.cellH; y++)
+        memcpy(glyphCell.data() + y * rowBytes, pixels + y * stride, rowBytes);
+
+      index = glyphs.add(glyphHashes[cell], glyphCell.data(), cellBytes);
+      glyphIndices[cell] = index;
+      newGlyphs.push_back(std::make_pair((uint16_t)index, cell));
+    } else if (index < 0) {
+      // Defined by an earlier cell
+      index = glyphIndices[-1 - index];
+    }
+
+    glyphCells[cell] = index;
+  }
+
+  level = zlibLevel();
+
+  cache::encodeGlyphRect(layout, glyphPixels.data(), glyphCells, newGlyphs, level, &glyphData);
+
+  flags = 0;
+  if (glyphReset)
+    flags |= glyphRectFlagReset;
+  glyphReset = false;
+
+  conn->writer()->writeGlyphRect(rect, flags, layout.cellW, layout.cellH, layout.ox, layout.oy, glyphData.data(),
+                                 glyphData.size());
+
+  glyphStats.rects++;
+  glyphStats.cells += cells;
+  glyphStats.newGlyphs += newGlyphs.size();
+  // Rect header, grid and the length
+  glyphStats.bytes += 12 + 5 + 4 + glyphData.size();
+  glyphStats.equivalent += 12 + (size_t)rect.area() * layout.bytesPerPixel;
+
+  // The result is exact
+  lossyRegion.assign_subtract(rect);
+  pendingRefreshRegion.assign_subtract(rect);
+
+  return true;
+}
+
+void EncodeManager::findGlyphPhase(const core::Rect& rect, const PixelBuffer* pb) {
+  core::Rect sample;
+  core::Point centre, best;
+  int bestScore;
+
+  glyphPhaseStale = false;
+  glyphPhaseSearchAt = updates + GlyphPhaseRetryUpdates;
+
+  // Text continues around the damage, so look at a few lines of it
+  // even if just one has changed
+  centre.x = (rect.tl.x + rect.br.x) / 2;
+  centre.y = (rect.tl.y + rect.br.y) / 2;
+  sample.tl.x = centre.x - 16 * glyphCellW;
+  sample.tl.y = centre.y - 4 * glyphCellH;
+  sample.br.x = centre.x + 16 * glyphCellW;
+  sample.br.y = centre.y + 4 * glyphCellH;
+  sample = sample.intersect(pb->getRect());
+
+  if ((sample.width() < 4 * glyphCellW) || (sample.height() < 2 * glyphCellH))
+    return;
+
+  glyphStats.phaseSearches++;
+
+  // The grid that gives the fewest distinct cells is the one the text
+  // is drawn on. Rows first, then columns.
+  best = glyphPhase;
+  bestScore = distinctCellsPermille(pb, sample, best, glyphCellW, glyphCellH);
+
+  for (int y = 0; y < glyphCellH; y++) {
+    core::Point phase(best.x, y);
+    int score;
+
+    score = distinctCellsPermille(pb, sample, phase, glyphCellW, glyphCellH);
+    if (score < bestScore) {
+      bestScore = score;
+      best = phase;
+    }
+  }
+
+  for (int x = 0; x < glyphCellW; x++) {
+    core::Point phase(x, best.y);
+    int score;
+
+    score = distinctCellsPermille(pb, sample, phase, glyphCellW, glyphCellH);
+    if (score < bestScore) {
+      bestScore = score;
+      best = phase;
+    }
+  }
+
+  if (!(best == glyphPhase))
+    vlog.debug("Glyph grid moved from %d,%d to %d,%d", glyphPhase.x, glyphPhase.y, best.x, best.y);
+
+  glyphPhase = best;
+}
+
 // Minimum rectangle area (in pixels) to attempt whole-rectangle cache lookup.
 // Rectangles smaller than this will be handled by the normal subrect path.
 // Set higher than the subrect split threshold to only catch "large" rects.
 static const int WholeRectCacheMinArea = 10000;
 
+void EncodeManager::writeRefinementRects(core::Region* changed, const PixelBuffer* pb) {
+  core::Region sent;
+
+  if (!conn->client.supportsEncoding(encodingLossyRefinement))
+    return;
+  if (!Server::lossyRefinement)
+    return;
+  if (refinements.size() == 0)
+    return;
+
+  refinements.find(*changed, &refinementEntries);
+  for (const LossyRefinementStore::Entry& entry : refinementEntries) {
+    if (tryRefinementRect(entry, pb))
+      sent.assign_union(entry.rect);
+  }
+
+  changed->assign_subtract(sent);
+}
+
+bool EncodeManager::tryRefinementRect(const LossyRefinementStore::Entry& entry, const PixelBuffer* pb) {
+  const core::Rect& rect = entry.rect;
+  PixelBuffer* ppb;
+  struct RectInfo info;
+  EncoderType type;
+  size_t count, reference;
+  struct timeval start;
+  int level;
+
+  // Few colours are cheaper to send again with a palette than any
+  // difference, as are areas that became solid
+  selectEncoderForRect(rect, pb, ppb, &info, type);
+  if (type != encoderFullColour)
+    return false;
+
+  gettimeofday(&start, nullptr);
+
+  count = rect.area();
+  refinementLossy.resize(count * 4);
+  refinementExact.resize(count * 4);
+
+  refinements.reproduce(pb, entry, refinementLossy.data());
+  pb->getImage(lossyRefinementPF, refinementExact.data(), rect);
+
+  level = zlibLevel();
+
+  encodeRefinement(refinementLossy.data(), refinementExact.data(), count, level, &refinementData);
+  // Full colour is sent as zlib compressed RGB by Tight, so this is a
+  // fair guess at what sending it again costs
+  reference = refinementReferenceSize(refinementExact.data(), count, level);
+
+  refinementStats.candidates++;
+  refinementStats.encodeUs += core::usSince(&start);
+
+  if (refinementData.size() >= reference)
+    return false;
+
+  conn->writer()->writeLossyRefinement(rect, hashRefinementBase(refinementLossy.data(), count),
+                                       refinementData.data(), refinementData.size());
+
+  refinementStats.rects++;
+  refinementStats.pixels += count;
+  // Rect header, hash and the length
+  refinementStats.bytes += 12 + 8 + 4 + refinementData.size();
+  refinementStats.equivalent += 12 + reference;
+
+  // The result is exact
+  lossyRegion.assign_subtract(rect);
+  pendingRefreshRegion.assign_subtract(rect);
+
+  return true;
+}
+
 void EncodeManager::writeRects(const core::Region& changed, const PixelBuffer* pb) {
   std::vector<core::Rect> rects;
   std::vector<core::Rect>::const_iterator rect;
@@ -1365,7 +2089,7 @@ void EncodeManager::writeRects(const core::Region& changed, const PixelBuffer* p
   // pseudo-encoding (-321) or the legacy ContentCache pseudo-encoding (-320).
   // In this fork they share the cache-engine path; PersistentCache uses
   // CacheKey wire messages, and the difference is viewer policy.
-  bool clientSupportsCache = conn->client.supportsEncoding(pseudoEncodingPersistentCache);
+  bool clientSupportsCache = conn->client.supportsEncoding(pseudoEncodingPersistentCache) && !encodingVolatile;
 
   // Work on a mutable copy of the damage so cache hits can remove regions that
   // are fully satisfied by references while still allowing other dirty areas in
@@ -1406,8 +2130,11 @@ void EncodeManager::writeRects(const core::Region& changed, const PixelBuffer* p
               "bbox area=%d)",
               pb->width(), pb->height(), damageBbox.area());
 
-    // Detect bordered regions in the full framebuffer
-    borderedRegions = ContentHash::detectBorderedRegions(pb, 5, 50000);
+    // Detection only depends on the framebuffer geometry, so the tracker
+    // can keep the result (and the content hashes) between updates
+    if (borderedTracker == nullptr)
+      borderedTracker = new cache::BorderedRegionTracker(5, 50000);
+    borderedRegions = borderedTracker->regions(pb);
 
     if (!borderedRegions.empty()) {
       vlog.info("BORDERED: Detected %d bordered regions", (int)borderedRegions.size());
@@ -1422,7 +2149,8 @@ void EncodeManager::writeRects(const core::Region& changed, const PixelBuffer* p
 
   if (!borderedRegions.empty()) {
     // Check if any detected regions match cached content
-    for (const auto& region : borderedRegions) {
+    for (size_t regionIndex = 0; regionIndex < borderedRegions.size(); regionIndex++) {
+      const ContentHash::BorderedRegion& region = borderedRegions[regionIndex];
       const core::Rect& contentRect = region.contentRect;
 
       // Only process if the remaining damage intersects this content area
@@ -1433,7 +2161,7 @@ void EncodeManager::writeRects(const core::Region& changed, const PixelBuffer* p
 
       // Compute content hash for this bordered region first, so we can check
       // if we've already seeded it before applying coverage heuristics.
-      std::vector<uint8_t> contentHash = ContentHash::computeRect(pb, contentRect);
+      std::vector<uint8_t> contentHash = borderedTracker->contentHash(pb, regionIndex);
       CacheKey contentKey = cacheKeyFromHash(contentHash);
       uint64_t contentId = cacheKeyToU64(contentKey);
 
@@ -1554,7 +2282,7 @@ void EncodeManager::writeRects(const core::Region& changed, const PixelBuffer* p
         // If we kept content in lossyRegion but removed from
         // pendingRefreshRegion, and the timer isn't running, re-add to pending
         // (same pattern as forceRefresh).
-        if (hasLossyMapping && !recentChangeTimer.isStarted()) {
+        if (hasLossyMapping && !recentChangeActive()) {
           pendingRefreshRegion.assign_union(contentRect);
         }
 
@@ -1691,7 +2419,7 @@ void EncodeManager::writeRects(const core::Region& changed, const PixelBuffer* p
           // If we kept content in lossyRegion but removed from
           // pendingRefreshRegion, and the timer isn't running, re-add to
           // pending (same pattern as forceRefresh).
-          if (hasLossyBboxMapping && !recentChangeTimer.isStarted()) {
+          if (hasLossyBboxMapping && !recentChangeActive()) {
             pendingRefreshRegion.assign_union(bbox);
           }
           return; // Entire region handled by one cache hit!
@@ -1734,6 +2462,8 @@ void EncodeManager::writeRects(const core::Region& changed, const PixelBuffer* p
     }
   }
 
+  std::vector<core::Rect> subrects;
+
   work.get_rects(&rects);
   for (rect = rects.begin(); rect != rects.end(); ++rect) {
     int w, h, sw, sh;
@@ -1745,7 +2475,7 @@ void EncodeManager::writeRects(const core::Region& changed, const PixelBuffer* p
     // No split necessary?
     if (((w * h) < SubRectMaxArea) && (w < SubRectMaxWidth)) {
       vlog.debug("CC rect no-split: (%s) area=%d", strRect(*rect), w * h);
-      writeSubRect(*rect, pb);
+      subrects.push_back(*rect);
       continue;
     }
 
@@ -1754,7 +2484,7 @@ void EncodeManager::writeRects(const core::Region& changed, const PixelBuffer* p
     else
       sw = SubRectMaxWidth;
 
-    sh = SubRectMaxArea / sw;
+    sh = subRectHeight(sw);
 
     vlog.debug("CC rect split: parent (%s) tileSize=%dx%d", strRect(*rect), sw, sh);
 
@@ -1769,11 +2499,19 @@ void EncodeManager::writeRects(const core::Region& changed, const PixelBuffer* p
           sr.br.x = rect->br.x;
 
         vlog.debug("CC subrect: (%s) from parent (%s)", strRect(sr), strRect(*rect));
-        writeSubRect(sr, pb);
+        subrects.push_back(sr);
       }
     }
   }
 
+  if (useParallelEncoding(subrects))
+    prepareEncodeJobs(subrects, pb);
+
+  for (const core::Rect& subrect : subrects)
+    writeSubRect(subrect, pb);
+
+  encodeJobs.clear();
+
   // TILING ENHANCEMENT: Seed the bounding box hash after encoding all damage
   // rects. Always seed with canonical hash. For lossy encodings, the client
   // will compute the actual lossy hash after decode, detect the mismatch, and
@@ -1795,11 +2533,11 @@ void EncodeManager::writeRects(const core::Region& changed, const PixelBuffer* p
   // so that future identical content can be served from cache.
   // Always seed with canonical hash. For lossy encodings, the client will
   // compute the actual lossy hash after decode and report back via message 247.
-  for (const auto& region : borderedRegions) {
-    const core::Rect& contentRect = region.contentRect;
+  for (size_t regionIndex = 0; regionIndex < borderedRegions.size(); regionIndex++) {
+    const core::Rect& contentRect = borderedRegions[regionIndex].contentRect;
 
-    // Compute content hash
-    std::vector<uint8_t> contentHash = ContentHash::computeRect(pb, contentRect);
+    // Usually already computed for the lookup above
+    const std::vector<uint8_t>& contentHash = borderedTracker->contentHash(pb, regionIndex);
     CacheKey contentKey = cacheKeyFromHash(contentHash);
     uint64_t contentId = cacheKeyToU64(contentKey);
 
@@ -1816,6 +2554,166 @@ void EncodeManager::writeRects(const core::Region& changed, const PixelBuffer* p
                 contentRect.tl.x, contentRect.tl.y, contentRect.br.x, contentRect.br.y, hex64(contentId));
     }
   }
+
+  if (borderedTracker != nullptr)
+    cache::ScanTelemetry::logIfEnabled("bordered", borderedTracker->takeStats());
+}
+
+void EncodeManager::writeVolatileRects(const core::Region& changed, const PixelBuffer* pb) {
+  Encoder* jpeg;
+  int interval, reduction;
+  int before;
+  struct timeval start;
+  std::vector<core::Rect> rects;
+  unsigned long long pixels;
+  core::Region rest;
+
+  if (changed.is_empty())
+    return;
+
+  // Video rarely has a useful palette, so this mostly affects what
+  // full colour rects get sent as. Lower the quality more the faster
+  // the area changes, as each frame is visible for a shorter time.
+  jpeg = encoders[encoderTightJPEG];
+  if (jpeg->isSupported() && (conn->client.pf().bpp >= 16)) {
+    activeEncoders[encoderFullColour] = encoderTightJPEG;
+
+    interval = volatilityMap->updateIntervalMs(changed.get_bounding_rect());
+    if ((interval > 0) && (interval <= 1000 / 24))
+      reduction = 3;
+    else if ((interval > 0) && (interval <= 1000 / 12))
+      reduction = 2;
+    else
+      reduction = 1;
+
+    if (controller.qualityLevel() != -1)
+      jpeg->setQualityLevel(
+          std::max(controller.qualityLevel() - reduction, std::min(controller.qualityLevel(), VolatileMinQuality)));
+    if (controller.fineQualityLevel() != -1)
+      jpeg->setFineQualityLevel(std::max(controller.fineQualityLevel() - reduction * 10,
+                                         std::min(controller.fineQualityLevel(), VolatileMinFineQuality)),
+                                controller.subsampling());
+  }
+
+  pixels = 0;
+  before = conn->getOutStream()->length();
+  gettimeofday(&start, nullptr);
+
+  rest = changed;
+  writeVideoRect(&rest, pb);
+
+  encodingVolatile = true;
+  writeRects(rest, pb);
+  encodingVolatile = false;
+
+  changed.get_rects(&rects);
+  for (const core::Rect& r : rects)
+    pixels += r.area();
+
+  volatileStats.updates++;
+  volatileStats.pixels += pixels;
+  volatileStats.equivalent += 12 * rects.size() + pixels * (conn->client.pf().bpp / 8);
+  volatileStats.bytes += conn->getOutStream()->length() - before;
+  if (usePersistentCache && conn->client.supportsEncoding(pseudoEncodingPersistentCache))
+    volatileStats.hashSkipped += pixels;
+  volatileStats.encodeUs += core::usSince(&start);
+
+  // Restore the normal encoder setup for the rest of the update
+  prepareEncoders(true);
+}
+
+void EncodeManager::writeVideoRect(core::Region* changed, const PixelBuffer* pb) {
+#ifdef HAVE_H264
+  H264Encoder* h264;
+  core::Rect candidate;
+  std::vector<core::Rect> rects;
+  int volatileArea;
+  size_t bandwidth;
+  PixelBuffer* ppb;
+  int fullColour;
+
+  h264 = (H264Encoder*)encoders[encoderH264];
+  if (!h264->isSupported() || !rfb::Server::enableH264)
+    return;
+
+  // A stream has to cover the same area for every frame, so wait
+  // until the volatile area has kept its shape for a while
+  candidate = volatileRegion.get_bounding_rect();
+  // 4:2:0 chroma subsampling needs even dimensions
+  candidate.br.x -= candidate.width() % 2;
+  candidate.br.y -= candidate.height() % 2;
+
+  if (candidate == videoRect) {
+    if (videoRectUpdates < H264StableUpdates)
+      videoRectUpdates++;
+  } else {
+    videoRect = candidate;
+    videoRectUpdates = 1;
+  }
+
+  if (videoRectUpdates < H264StableUpdates)
+    return;
+  if (candidate.area() < rfb::Server::h264MinArea)
+    return;
+  if (changed->intersect(candidate).is_empty())
+    return;
+
+  // Don't drag large static areas in to the stream just because the
+  // bounding box happens to cover them
+  volatileArea = 0;
+  volatileRegion.intersect(candidate).get_rects(&rects);
+  for (const core::Rect& r : rects)
+    volatileArea += r.area();
+  if (volatileArea < candidate.area() * 3 / 4)
+    return;
+
+  // Leave a quarter of the bandwidth for everything else
+  bandwidth = conn->getBandwidthEstimate();
+  if (bandwidth != 0)
+    h264->setBitrate(std::min(std::max(bandwidth * 8 * 3 / 4, (size_t)H264MinBitrate), (size_t)H264MaxBitrate));
+
+  // Nothing can be sent yet, as the rect header commits us to H.264.
+  // A failure leaves the area to the normal encoders.
+  if (!h264->setRect(candidate))
+    return;
+
+  fullColour = activeEncoders[encoderFullColour];
+  activeEncoders[encoderFullColour] = encoderH264;
+
+  // The whole stream area is sent, as a frame cannot be partial
+  startRect(candidate, encoderFullColour);
+  ppb = preparePixelBuffer(candidate, pb, false);
+  h264->writeRect(ppb, Palette());
+  endRect();
+
+  changed->assign_subtract(candidate);
+
+  activeEncoders[encoderFullColour] = fullColour;
+#else
+  (void)changed;
+  (void)pb;
+#endif
+}
+
+void EncodeManager::noteVolatileDamage(const core::Region& changed, const PixelBuffer* pb) {
+  std::vector<core::Rect> rects;
+  uint64_t now;
+
+  if (!rfb::Server::enableVolatilityMap || (pb == nullptr))
+    return;
+
+  if (volatilityMap == nullptr) {
+    volatilityMap = new cache::VolatilityMap(pb->width(), pb->height(), rfb::Server::volatilityGridSize,
+                                             rfb::Server::volatilityWindowMs);
+  } else if ((pb->width() != volatilityMap->width()) || (pb->height() != volatilityMap->height())) {
+    volatilityMap->resize(pb->width(), pb->height());
+  }
+
+  now = core::usSince(&volatilityEpoch) / 1000;
+
+  changed.get_rects(&rects);
+  for (const core::Rect& r : rects)
+    volatilityMap->noteDamage(r, now);
 }
 
 void EncodeManager::writeSubRect(const core::Rect& rect, const PixelBuffer* pb) {
@@ -1831,7 +2729,10 @@ void EncodeManager::writeSubRect(const core::Rect& rect, const PixelBuffer* pb)
               yesNo(clientSupportsUnifiedCache));
   }
 
-  if (usePersistentCache && clientSupportsUnifiedCache) {
+  // Results from the parallel encoding stage, if it ran
+  activeJob = takeEncodeJob(rect);
+
+  if (usePersistentCache && clientSupportsUnifiedCache && !encodingVolatile) {
     // Use unified cache protocol whenever the client has negotiated the
     // PersistentCache encoding.
     vlog.debug("CC attempt unified cache lookup for rect (%s)", strRect(rect));
@@ -1842,8 +2743,10 @@ void EncodeManager::writeSubRect(const core::Rect& rect, const PixelBuffer* pb)
                 rect.br.x, rect.br.y);
     }
 
-    if (tryPersistentCacheLookup(rect, pb))
+    if (tryPersistentCacheLookup(rect, pb)) {
+      activeJob = nullptr;
       return;
+    }
   }
 
   PixelBuffer* ppb;
@@ -1851,6 +2754,32 @@ void EncodeManager::writeSubRect(const core::Rect& rect, const PixelBuffer* pb)
   struct RectInfo info;
   EncoderType type;
 
+  bool share;
+
+  // Another client with the same settings might have done the work
+  share = sharingEncodes && !encodingVolatile && (pb == sharedEncodes->getFramebuffer());
+  if (share && writeSharedRect(rect)) {
+    activeJob = nullptr;
+    return;
+  }
+
+  if ((activeJob != nullptr) && activeJob->encoded) {
+    startRect(rect, activeJob->type);
+    conn->getOutStream()->writeBytes(activeJob->data.data(), activeJob->data.size());
+    endRect();
+
+    if (share && isShareable(activeJob->type)) {
+      sharedEncodes->insert(sharedFingerprint, rect, activeJob->type, activeJob->data.data(),
+                            activeJob->data.size());
+      sharedStats.published++;
+    }
+
+    activeJob = nullptr;
+    return;
+  }
+
+  activeJob = nullptr;
+
   // Shared encoder selection for normal and cache INIT paths
   selectEncoderForRect(rect, pb, ppb, &info, type);
 
@@ -1864,7 +2793,25 @@ void EncodeManager::writeSubRect(const core::Rect& rect, const PixelBuffer* pb)
   if (encoder->flags & EncoderUseNativePF)
     ppb = preparePixelBuffer(rect, pb, false);
 
-  encoder->writeRect(ppb, info.palette);
+  encoder->setSmoothHint(info.smooth);
+
+  if (share && isShareable(type)) {
+    sharedBuffer.clear();
+    encoder->setOutStream(&sharedBuffer);
+    try {
+      encoder->writeRect(ppb, info.palette);
+    } catch (...) {
+      encoder->setOutStream(nullptr);
+      throw;
+    }
+    encoder->setOutStream(nullptr);
+
+    conn->getOutStream()->writeBytes(sharedBuffer.data(), sharedBuffer.length());
+    sharedEncodes->insert(sharedFingerprint, rect, type, sharedBuffer.data(), sharedBuffer.length());
+    sharedStats.published++;
+  } else {
+    encoder->writeRect(ppb, info.palette);
+  }
 
   endRect();
 
@@ -1894,6 +2841,289 @@ void EncodeManager::writeSubRect(const core::Rect& rect, const PixelBuffer* pb)
   }
 }
 
+void EncodeManager::setSharedEncodes(SharedEncodeCache* cache) {
+  if ((sharedEncodes != nullptr) && !sharedFingerprint.empty())
+    sharedEncodes->leave(sharedFingerprint);
+
+  sharedEncodes = cache;
+  sharedFingerprint.clear();
+  sharingEncodes = false;
+  updateTightMode();
+}
+
+void EncodeManager::setKeyDictionary(cache::CacheKeyDictionary* dict) {
+  clientKnownIds_.setDictionary(dict);
+}
+
+std::string EncodeManager::encodeFingerprint() {
+  std::string fingerprint;
+  char buf[256];
+
+  // Everything that can make the output of writeSubRect() differ
+  conn->client.pf().print(buf, sizeof(buf));
+  fingerprint = buf;
+
+  snprintf(buf, sizeof(buf), "/%d/%d", conn->client.compressLevel, controller.compressLevel());
+  fingerprint += buf;
+
+  for (int klass : activeEncoders) {
+    Encoder* encoder;
+
+    encoder = encoders[klass];
+    snprintf(buf, sizeof(buf), "/%d:%d:%d:%d:%d", klass, encoder->getCompressLevel(), encoder->getQualityLevel(),
+             encoder->getFineQualityLevel(), encoder->getFineSubsampling());
+    fingerprint += buf;
+  }
+
+  return fingerprint;
+}
+
+void EncodeManager::updateSharing() {
+  std::string fingerprint;
+
+  if (sharedEncodes == nullptr)
+    return;
+
+  if (rfb::Server::shareEncodedUpdates)
+    fingerprint = encodeFingerprint();
+
+  if (fingerprint != sharedFingerprint) {
+    if (!sharedFingerprint.empty())
+      sharedEncodes->leave(sharedFingerprint);
+    if (!fingerprint.empty())
+      sharedEncodes->join(fingerprint);
+    sharedFingerprint = fingerprint;
+  }
+
+  // Sharing makes Tight a bit less efficient, so only do it when
+  // there is someone to share with
+  sharingEncodes = !sharedFingerprint.empty() && (sharedEncodes->groupSize(sharedFingerprint) > 1);
+  updateTightMode();
+}
+
+bool EncodeManager::isShareable(EncoderType type) {
+  int klass;
+
+  klass = activeEncoders[type];
+
+  // Tight is made independent per rect whilst sharing
+  if (klass == encoderTight)
+    return true;
+
+  return encoders[klass]->flags & EncoderStateless;
+}
+
+bool EncodeManager::writeSharedRect(const core::Rect& rect) {
+  std::vector<uint8_t> data;
+  int type;
+
+  if (!sharedEncodes->lookup(sharedFingerprint, rect, &type, &data))
+    return false;
+
+  startRect(rect, type);
+  conn->getOutStream()->writeBytes(data.data(), data.size());
+  endRect();
+
+  sharedStats.rects++;
+  sharedStats.bytes += data.size();
+
+  return true;
+}
+
+void EncodeManager::updateTightMode() {
+  ((TightEncoder*)encoders[encoderTight])->setIndependentRects(parallelEncoding || sharingEncodes);
+}
+
+bool EncodeManager::useParallelEncoding(const std::vector<core::Rect>& subrects) {
+  bool enable;
+  size_t pixels;
+
+  enable = (rfb::Server::encodeThreads != 1) && (core::WorkerPool::defaultConcurrency(2) > 1);
+
+  // Tight rects must stay independent of each other for as long as
+  // other threads might be producing some of them
+  if (enable != parallelEncoding) {
+    parallelEncoding = enable;
+    updateTightMode();
+  }
+
+  if (!enable || (subrects.size() < 2))
+    return false;
+
+  pixels = 0;
+  for (const core::Rect& r : subrects)
+    pixels += r.area();
+
+  return pixels >= ParallelEncodeMinArea;
+}
+
+void EncodeManager::prepareEncodeJobs(const std::vector<core::Rect>& subrects, const PixelBuffer* pb) {
+  std::atomic<size_t> next;
+
+  if (encodeWorkers == nullptr) {
+    size_t concurrency;
+
+    concurrency = rfb::Server::encodeThreads;
+    if (concurrency == 0)
+      concurrency = core::WorkerPool::defaultConcurrency(16);
+
+    vlog.debug("Using %d thread(s) for encoding", (int)concurrency);
+    encodeWorkers = new core::WorkerPool(concurrency);
+
+    // Only encoders without state between rects can run on their own
+    // instance, the others are left to writeSubRect()
+    for (size_t i = 0; i < encodeWorkers->concurrency(); i++) {
+      EncodeSlot* slot;
+      TightEncoder* tight;
+
+      slot = new EncodeSlot;
+      slot->encoders.resize(encoderClassMax, nullptr);
+      slot->encoders[encoderRaw] = new RawEncoder(conn);
+      slot->encoders[encoderRRE] = new RREEncoder(conn);
+      slot->encoders[encoderHextile] = new HextileEncoder(conn);
+      slot->encoders[encoderTight] = tight = new TightEncoder(conn);
+      slot->encoders[encoderTightJPEG] = new TightJPEGEncoder(conn);
+
+      tight->setIndependentRects(true);
+      for (Encoder* encoder : slot->encoders) {
+        if (encoder != nullptr)
+          encoder->setOutStream(&slot->out);
+      }
+
+      encodeSlots.push_back(slot);
+    }
+  }
+
+  // Same settings as the encoders of the connection
+  for (EncodeSlot* slot : encodeSlots) {
+    for (size_t i = 0; i < slot->encoders.size(); i++) {
+      if (slot->encoders[i] == nullptr)
+        continue;
+
+      slot->encoders[i]->setCompressLevel(controller.compressLevel());
+      slot->encoders[i]->setQualityLevel(encoders[i]->getQualityLevel());
+      slot->encoders[i]->setFineQualityLevel(encoders[i]->getFineQualityLevel(), encoders[i]->getFineSubsampling());
+    }
+  }
+
+  encodeJobs.resize(subrects.size());
+  for (size_t i = 0; i < subrects.size(); i++) {
+    encodeJobs[i].rect = subrects[i];
+    encodeJobs[i].hash.clear();
+    encodeJobs[i].encoded = false;
+    encodeJobs[i].data.clear();
+  }
+  nextEncodeJob = 0;
+
+  next = 0;
+  encodeWorkers->run(encodeSlots.size(), [this, &next, pb](size_t n) {
+    size_t job;
+    while ((job = next++) < encodeJobs.size())
+      encodeJob(&encodeJobs[job], encodeSlots[n], pb);
+  });
+}
+
+void EncodeManager::encodeJob(EncodeJob* job, EncodeSlot* slot, const PixelBuffer* pb) {
+  PixelBuffer* ppb;
+  Encoder* encoder;
+  struct RectInfo info;
+
+  // Mirror the lookup in writeSubRect() so it doesn't have to hash,
+  // and don't bother encoding what the client already has
+  if (usePersistentCache && conn->client.supportsEncoding(pseudoEncodingPersistentCache) && !encodingVolatile &&
+      (job->rect.area() >= Server::persistentCacheMinRectSize)) {
+    uint64_t cacheId;
+
+    job->hash = ContentHash::computeRect(pb, job->rect);
+
+    cacheId = cacheKeyToU64(cacheKeyFromHash(job->hash));
+    if (conn->knowsPersistentId(cacheId) && !conn->clientRequestedPersistent(cacheId))
+      return;
+  }
+
+  selectEncoderForRect(job->rect, pb, ppb, &info, job->type, &slot->convertedPixelBuffer, &slot->offsetPixelBuffer);
+
+  encoder = slot->encoders[activeEncoders[job->type]];
+  if (encoder == nullptr)
+    return;
+
+  if (encoder->flags & EncoderUseNativePF)
+    ppb = preparePixelBuffer(job->rect, pb, false, &slot->convertedPixelBuffer, &slot->offsetPixelBuffer);
+
+  slot->out.clear();
+  encoder->setSmoothHint(info.smooth);
+  encoder->writeRect(ppb, info.palette);
+
+  job->data.assign(slot->out.data(), slot->out.data() + slot->out.length());
+  job->encoded = true;
+}
+
+EncodeManager::EncodeJob* EncodeManager::takeEncodeJob(const core::Rect& rect) {
+  if (nextEncodeJob >= encodeJobs.size())
+    return nullptr;
+  if (!(encodeJobs[nextEncodeJob].rect == rect))
+    return nullptr;
+
+  return &encodeJobs[nextEncodeJob++];
+}
+
+void EncodeManager::writeInitPayload(const core::Rect& rect, const CacheKey& cacheKey, Encoder* encoder,
+                                     PixelBuffer* ppb, const Palette& palette, const PixelBuffer* pb) {
+  cache::EncodedPayloadCache* payloadCache;
+  std::string key;
+  std::vector<uint8_t> data;
+  unsigned encodeUs;
+  struct timeval start;
+
+  if ((activeJob != nullptr) && activeJob->encoded) {
+    conn->getOutStream()->writeBytes(activeJob->data.data(), activeJob->data.size());
+    return;
+  }
+
+  payloadCache = cache::EncodedPayloadCache::instance();
+
+  // Raw is as cheap to produce as it is to copy
+  if ((payloadCache == nullptr) || !(encoder->flags & EncoderStateless) || (encoder->encoding == encodingRaw)) {
+    if (encoder->flags & EncoderUseNativePF)
+      ppb = preparePixelBuffer(rect, pb, false);
+    encoder->writeRect(ppb, palette);
+    return;
+  }
+
+  key = cache::EncodedPayloadCache::makeKey(cacheKey, pb->getPF(), conn->client.pf(), encoder);
+
+  payloadCacheStats.lookups++;
+
+  if (payloadCache->lookup(key, &data, &encodeUs)) {
+    conn->getOutStream()->writeBytes(data.data(), data.size());
+
+    payloadCacheStats.hits++;
+    payloadCacheStats.bytes += data.size();
+    payloadCacheStats.savedUs += encodeUs;
+    return;
+  }
+
+  gettimeofday(&start, nullptr);
+
+  if (encoder->flags & EncoderUseNativePF)
+    ppb = preparePixelBuffer(rect, pb, false);
+
+  payloadBuffer.clear();
+  encoder->setOutStream(&payloadBuffer);
+  try {
+    encoder->writeRect(ppb, palette);
+  } catch (...) {
+    encoder->setOutStream(nullptr);
+    throw;
+  }
+  encoder->setOutStream(nullptr);
+
+  encodeUs = core::usSince(&start);
+
+  conn->getOutStream()->writeBytes(payloadBuffer.data(), payloadBuffer.length());
+  payloadCache->insert(key, payloadBuffer.data(), payloadBuffer.length(), encodeUs);
+}
+
 bool EncodeManager::checkSolidTile(const core::Rect& r, const uint8_t* colourValue, const PixelBuffer* pb) {
   const uint8_t* buffer;
   int stride;
@@ -2003,18 +3233,23 @@ void EncodeManager::extendSolidAreaByPixel(const core::Rect& r, const core::Rect
 }
 
 PixelBuffer* EncodeManager::preparePixelBuffer(const core::Rect& rect, const PixelBuffer* pb, bool convert) {
+  return preparePixelBuffer(rect, pb, convert, &convertedPixelBuffer, &offsetPixelBuffer);
+}
+
+PixelBuffer* EncodeManager::preparePixelBuffer(const core::Rect& rect, const PixelBuffer* pb, bool convert,
+                                               ManagedPixelBuffer* converted, OffsetPixelBuffer* offset) {
   const uint8_t* buffer;
   int stride;
 
   // Do wo need to convert the data?
   if (convert && conn->client.pf() != pb->getPF()) {
-    convertedPixelBuffer.setPF(conn->client.pf());
-    convertedPixelBuffer.setSize(rect.width(), rect.height());
+    converted->setPF(conn->client.pf());
+    converted->setSize(rect.width(), rect.height());
 
     buffer = pb->getBuffer(rect, &stride);
-    convertedPixelBuffer.imageRect(pb->getPF(), convertedPixelBuffer.getRect(), buffer, stride);
+    converted->imageRect(pb->getPF(), converted->getRect(), buffer, stride);
 
-    return &convertedPixelBuffer;
+    return converted;
   }
 
   // Otherwise we still need to shift the coordinates. We have our own
@@ -2022,29 +3257,101 @@ PixelBuffer* EncodeManager::preparePixelBuffer(const core::Rect& rect, const Pix
 
   buffer = pb->getBuffer(rect, &stride);
 
-  offsetPixelBuffer.update(pb->getPF(), rect.width(), rect.height(), buffer, stride);
+  offset->update(pb->getPF(), rect.width(), rect.height(), buffer, stride);
+
+  return offset;
+}
+
+// Samples a few rows of the rectangle and checks what the Tight
+// gradient filter would leave of them. Photographic content leaves
+// mostly small differences, whereas synthetic content leaves either
+// nothing at all or large jumps at the edges of things.
+static bool isSmoothRect(const PixelBuffer* pb) {
+  const int sampleWidth = 256;
+  const int sampleStep = 8;
+
+  uint8_t above[sampleWidth * 3], below[sampleWidth * 3];
+  uint8_t residuals[sampleWidth * 3];
+
+  const uint8_t* buffer;
+  int stride, width;
+  unsigned small, large;
+
+  if (!pb->getPF().is888())
+    return false;
+  if ((pb->width() < 8) || (pb->height() < 8))
+    return false;
+
+  width = std::min(pb->width(), sampleWidth);
 
-  return &offsetPixelBuffer;
+  buffer = pb->getBuffer(pb->getRect(), &stride);
+  stride *= pb->getPF().bpp / 8;
+
+  small = large = 0;
+  for (int y = 1; y < pb->height(); y += sampleStep) {
+    const uint8_t* row;
+    int x;
+
+    // Move the sample around in wide rectangles
+    x = (y * 61) % (pb->width() - width + 1);
+    row = buffer + y * stride + x * 4;
+
+    pb->getPF().rgbFromBuffer(above, row - stride, width);
+    pb->getPF().rgbFromBuffer(below, row, width);
+    tightGradientPredictRow(above, below, residuals, width);
+
+    // The first pixel has nothing to its left in the sample
+    for (int i = 3; i < width * 3; i++) {
+      int diff;
+
+      diff = abs((int8_t)residuals[i]);
+      if (diff == 0)
+        continue;
+      if (diff < 16)
+        small++;
+      else
+        large++;
+    }
+  }
+
+  return small > large * 2;
 }
 
 bool EncodeManager::analyseRect(const PixelBuffer* pb, struct RectInfo* info, int maxColours) {
   const uint8_t* buffer;
   int stride;
+  bool fits;
 
   buffer = pb->getBuffer(pb->getRect(), &stride);
 
   switch (pb->getPF().bpp) {
   case 32:
-    return analyseRect(pb->width(), pb->height(), (const uint32_t*)buffer, stride, info, maxColours);
+    fits = analyseRect(pb->width(), pb->height(), (const uint32_t*)buffer, stride, info, maxColours);
+    break;
   case 16:
-    return analyseRect(pb->width(), pb->height(), (const uint16_t*)buffer, stride, info, maxColours);
+    fits = analyseRect(pb->width(), pb->height(), (const uint16_t*)buffer, stride, info, maxColours);
+    break;
   default:
-    return analyseRect(pb->width(), pb->height(), (const uint8_t*)buffer, stride, info, maxColours);
+    fits = analyseRect(pb->width(), pb->height(), (const uint8_t*)buffer, stride, info, maxColours);
   }
+
+  // Only plain Tight can make use of knowing that the rectangle is
+  // smooth, so don't waste time on it otherwise
+  info->smooth = false;
+  if (!fits && (activeEncoders[encoderFullColour] == encoderTight))
+    info->smooth = isSmoothRect(pb);
+
+  return fits;
 }
 
 void EncodeManager::selectEncoderForRect(const core::Rect& rect, const PixelBuffer* pb, PixelBuffer*& ppb,
                                          struct RectInfo* info, EncoderType& type) {
+  selectEncoderForRect(rect, pb, ppb, info, type, &convertedPixelBuffer, &offsetPixelBuffer);
+}
+
+void EncodeManager::selectEncoderForRect(const core::Rect& rect, const PixelBuffer* pb, PixelBuffer*& ppb,
+                                         struct RectInfo* info, EncoderType& type, ManagedPixelBuffer* converted,
+                                         OffsetPixelBuffer* offset) {
   unsigned int divisor, maxColours;
   bool useRLE;
 
@@ -2080,7 +3387,7 @@ void EncodeManager::selectEncoderForRect(const core::Rect& rect, const PixelBuff
   if (maxColours > encoder->maxPaletteSize)
     maxColours = encoder->maxPaletteSize;
 
-  ppb = preparePixelBuffer(rect, pb, true);
+  ppb = preparePixelBuffer(rect, pb, true, converted, offset);
 
   if (!analyseRect(ppb, info, maxColours))
     info->palette.clear();
@@ -2210,8 +3517,13 @@ bool EncodeManager::tryPersistentCacheLookup(const core::Rect& rect, const Pixel
   persistentCacheStats.cacheLookups++;
   pcoffCounters.lookups++;
 
-  // Compute content hash using ContentHash utility (same as ContentCache)
-  std::vector<uint8_t> fullHash = ContentHash::computeRect(pb, rect);
+  // Compute content hash using ContentHash utility (same as ContentCache),
+  // unless the parallel encoding stage already did so
+  std::vector<uint8_t> fullHash;
+  if ((activeJob != nullptr) && !activeJob->hash.empty())
+    fullHash = activeJob->hash;
+  else
+    fullHash = ContentHash::computeRect(pb, rect);
 
   CacheKey cacheKey = cacheKeyFromHash(fullHash);
   uint64_t cacheId = cacheKeyToU64(cacheKey);
@@ -2303,12 +3615,13 @@ bool EncodeManager::tryPersistentCacheLookup(const core::Rect& rect, const Pixel
     // refresh.
     if (!hasLossyMatch) {
       lossyRegion.assign_subtract(rect);
+      deltaRefs.touch(matchedId);
     }
     pendingRefreshRegion.assign_subtract(rect);
     // If we kept content in lossyRegion but removed from pendingRefreshRegion,
     // and the timer isn't running, re-add to pending (same pattern as
     // forceRefresh).
-    if (hasLossyMatch && !recentChangeTimer.isStarted()) {
+    if (hasLossyMatch && !recentChangeActive()) {
       pendingRefreshRegion.assign_union(rect);
     }
     return true;
@@ -2323,13 +3636,21 @@ bool EncodeManager::tryPersistentCacheLookup(const core::Rect& rect, const Pixel
               rect.br.x, rect.br.y, hex64(cacheId));
   }
 
+  if (tryPersistentCacheDelta(rect, cacheKey, pb))
+    return true;
+
   // Choose payload encoder using the shared selection logic
   PixelBuffer* ppb;
   Encoder* payloadEnc;
   struct RectInfo info;
   EncoderType type;
 
-  selectEncoderForRect(rect, pb, ppb, &info, type);
+  if ((activeJob != nullptr) && activeJob->encoded) {
+    ppb = nullptr;
+    type = activeJob->type;
+  } else {
+    selectEncoderForRect(rect, pb, ppb, &info, type);
+  }
 
   payloadEnc = encoders[activeEncoders[type]];
 
@@ -2356,11 +3677,11 @@ bool EncodeManager::tryPersistentCacheLookup(const core::Rect& rect, const Pixel
   // native_format is not used so the client can parse v2 headers reliably.
   uint8_t initFlags = 0;
   conn->writer()->writePersistentCachedRectInit(rect, cacheKey, payloadEnc->encoding, initFlags, nullptr);
-  // Prepare pixel buffer respecting native-PF usage for the payload encoder
-  if (payloadEnc->flags & EncoderUseNativePF)
-    ppb = preparePixelBuffer(rect, pb, false);
-  // Write the encoded pixel payload
-  payloadEnc->writeRect(ppb, info.palette);
+  // Write the encoded pixel payload, possibly one encoded earlier for
+  // another client
+  if (ppb != nullptr)
+    payloadEnc->setSmoothHint(info.smooth);
+  writeInitPayload(rect, cacheKey, payloadEnc, ppb, info.palette, pb);
   // Close the PersistentCachedRectInit rectangle
   conn->writer()->endRect();
 
@@ -2384,12 +3705,15 @@ bool EncodeManager::tryPersistentCacheLookup(const core::Rect& rect, const Pixel
       ((payloadEnc->losslessQuality == -1) || (payloadEnc->getQualityLevel() < payloadEnc->losslessQuality));
   if (!payloadEncoderIsLossy) {
     lossyRegion.assign_subtract(rect);
+    // The client now has these exact pixels to apply a delta to
+    if (conn->client.supportsEncoding(encodingPersistentCachedRectDelta))
+      deltaRefs.insert(cacheKey, rect, pb);
   }
   pendingRefreshRegion.assign_subtract(rect);
   // If we kept content in lossyRegion but removed from pendingRefreshRegion,
   // and the timer isn't running, re-add to pending (same pattern as
   // forceRefresh).
-  if (payloadEncoderIsLossy && !recentChangeTimer.isStarted()) {
+  if (payloadEncoderIsLossy && !recentChangeActive()) {
     pendingRefreshRegion.assign_union(rect);
   }
 
@@ -2398,32 +3722,235 @@ bool EncodeManager::tryPersistentCacheLookup(const core::Rect& rect, const Pixel
   return true;
 }
 
+bool EncodeManager::tryPersistentCacheDelta(const core::Rect& rect, const CacheKey& cacheKey, const PixelBuffer* pb) {
+  const PixelFormat& clientPF = conn->client.pf();
+  const cache::DeltaReferenceStore::Entry* base;
+  const uint8_t* basePixels;
+  uint64_t cacheId;
+  size_t length, normal, written;
+  int level;
+
+  if (!conn->client.supportsEncoding(encodingPersistentCachedRectDelta))
+    return false;
+  if (deltaRefs.size() == 0)
+    return false;
+
+  // The client can only rebuild the exact pixels if it has them at
+  // full depth
+  if (clientPF.bpp < 24)
+    return false;
+
+  // A query means the client could not use what we sent last time, so
+  // don't risk sending it the same delta again
+  cacheId = cacheKeyToU64(cacheKey);
+  if (conn->clientRequestedPersistent(cacheId))
+    return false;
+
+  // Half of the tiles unchanged is where a residual starts reliably
+  // beating a fresh encoding
+  base = deltaRefs.findBase(rect, pb, 500, [this](const CacheKey& key) {
+    uint64_t id = cacheKeyToU64(key);
+    return conn->knowsPersistentId(id) && !conn->clientRequestedPersistent(id);
+  });
+  if (base == nullptr)
+    return false;
+
+  deltaStats.candidates++;
+
+  length = (size_t)rect.area() * (clientPF.bpp / 8);
+
+  if (base->pf == clientPF) {
+    basePixels = base->pixels.data();
+  } else {
+    deltaBase.resize(length);
+    clientPF.bufferFromBuffer(deltaBase.data(), base->pf, base->pixels.data(), rect.area());
+    basePixels = deltaBase.data();
+  }
+
+  deltaPixels.resize(length);
+  pb->getImage(clientPF, deltaPixels.data(), rect);
+
+  level = zlibLevel();
+
+  cache::encodeResidual(basePixels, deltaPixels.data(), length, level, &deltaData);
+
+  // Compare against what we would send otherwise. A parallel encoding
+  // gives us the exact size, but trying out the normal encoders here
+  // would upset the zlib streams of those that keep state, so we use
+  // plain zlib as the reference and want a clear win over it.
+  if ((activeJob != nullptr) && activeJob->encoded) {
+    normal = activeJob->data.size();
+    if (deltaData.size() >= normal)
+      return false;
+  } else {
+    normal = cache::compressedSize(deltaPixels.data(), length, level);
+    if (deltaData.size() * 2 >= normal)
+      return false;
+  }
+
+  if (deltaData.size() >= length)
+    return false;
+
+  conn->writer()->writePersistentCachedRectDelta(rect, base->key, cacheKey, deltaData.data(), deltaData.size());
+
+  // Rect header, two keys and the length
+  written = 12 + 16 + 16 + 4 + deltaData.size();
+
+  deltaStats.rects++;
+  deltaStats.bytes += written;
+  if (normal > written) {
+    deltaStats.bytesSaved += normal - written;
+    persistentCacheStats.bytesSaved += normal - written;
+  }
+
+  vlog.debug("PersistentCache DELTA: rect [%d,%d-%d,%d] id=%s base=%016llx %zu bytes instead of %zu", rect.tl.x,
+             rect.tl.y, rect.br.x, rect.br.y, hex64(cacheId), (unsigned long long)cacheKeyToU64(base->key), written,
+             normal);
+
+  conn->markPersistentIdKnown(cacheId);
+  clientKnownIds_.add(cacheId);
+  conn->onCachedRectRef(cacheId, rect);
+
+  // The result is exact, so this is as good as a lossless encoding
+  lossyRegion.assign_subtract(rect);
+  pendingRefreshRegion.assign_subtract(rect);
+
+  deltaRefs.insert(cacheKey, rect, pb);
+
+  return true;
+}
+
 void EncodeManager::addClientKnownHash(uint64_t cacheId) {
   clientKnownIds_.add(cacheId);
 }
 
+void EncodeManager::addClientKnownHashes(const std::vector<uint64_t>& cacheIds) {
+  clientKnownIds_.addMultiple(cacheIds);
+}
+
 void EncodeManager::removeClientKnownHash(uint64_t cacheId) {
   clientKnownIds_.remove(cacheId);
+  deltaRefs.remove(cacheId);
 }
 
 bool EncodeManager::clientKnowsHash(uint64_t cacheId) const {
   return clientKnownIds_.has(cacheId);
 }
 
+#if defined(SOLID_AVX2)
+// Same check as the pixel conversions, which is safe to make during
+// static initialisation
+static const bool haveAVX2 = convKernelsSupported(convAVX2);
+
+// Returns the offset of the first byte at or after i that differs from
+// the repeated pattern, or where it stopped if there are fewer than 32
+// bytes left
+__attribute__((target("avx2"))) static int findByteChangeAVX2(const uint8_t* bytes, int i, int len,
+                                                              uint32_t pattern) {
+  __m256i wide;
+
+  wide = _mm256_set1_epi32((int)pattern);
+
+  for (; i + 32 <= len; i += 32) {
+    unsigned mask;
+
+    mask = (unsigned)_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(bytes + i)), wide));
+    if (mask != 0xffffffff)
+      return i + __builtin_ctz(~mask);
+  }
+
+  return i;
+}
+#endif
+
+// Returns the index of the first pixel at or after start in row that
+// differs from colour, or width if they all match. The colour is
+// repeated over a whole vector, and as every vector starts on a pixel
+// boundary the first differing byte is always in the first differing
+// pixel.
 template <class T>
-inline bool EncodeManager::checkSolidTile(int width, int height, const T* buffer, int stride, const T colourValue) {
-  int pad;
+static inline int findColourChange(const T* row, int start, int width, T colour) {
+  const uint8_t* bytes;
+  int i, len;
+
+  bytes = (const uint8_t*)row;
+  i = start * sizeof(T);
+  len = width * sizeof(T);
+
+#if defined(SOLID_AVX2)
+  if (haveAVX2) {
+    uint32_t pattern;
+
+    if (sizeof(T) == 4)
+      pattern = colour;
+    else if (sizeof(T) == 2)
+      pattern = (uint32_t)colour * 0x00010001;
+    else
+      pattern = (uint32_t)colour * 0x01010101;
 
-  pad = stride - width;
+    // Back up to the start of the pixel, so that the code below
+    // still works on whole pixels
+    i = findByteChangeAVX2(bytes, i, len, pattern);
+    i -= i % sizeof(T);
+  }
+#endif
 
+#if defined(__SSE2__)
+  __m128i pattern;
+
+  if (sizeof(T) == 4)
+    pattern = _mm_set1_epi32((int)colour);
+  else if (sizeof(T) == 2)
+    pattern = _mm_set1_epi16((short)colour);
+  else
+    pattern = _mm_set1_epi8((char)colour);
+
+  for (; i + 16 <= len; i += 16) {
+    unsigned mask;
+
+    mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(bytes + i)), pattern));
+    if (mask != 0xffff)
+      return (i + __builtin_ctz(~mask)) / sizeof(T);
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  uint8x16_t pattern;
+
+  if (sizeof(T) == 4)
+    pattern = vreinterpretq_u8_u32(vdupq_n_u32(colour));
+  else if (sizeof(T) == 2)
+    pattern = vreinterpretq_u8_u16(vdupq_n_u16(colour));
+  else
+    pattern = vdupq_n_u8(colour);
+
+  for (; i + 16 <= len; i += 16) {
+    uint8x16_t eq;
+    uint64_t mask;
+
+    eq = vceqq_u8(vld1q_u8(bytes + i), pattern);
+    if (vminvq_u8(eq) == 0xff)
+      continue;
+
+    // Narrow to four bits per byte to get something ctz can work on
+    mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+    return (i + __builtin_ctzll(~mask) / 4) / sizeof(T);
+  }
+#endif
+
+  for (i /= sizeof(T); i < width; i++) {
+    if (row[i] != colour)
+      return i;
+  }
+
+  return width;
+}
+
+template <class T>
+inline bool EncodeManager::checkSolidTile(int width, int height, const T* buffer, int stride, const T colourValue) {
   while (height--) {
-    int width_ = width;
-    while (width_--) {
-      if (*buffer != colourValue)
-        return false;
-      buffer++;
-    }
-    buffer += pad;
+    if (findColourChange(buffer, 0, width, colourValue) != width)
+      return false;
+    buffer += stride;
   }
 
   return true;
@@ -2432,38 +3959,40 @@ inline bool EncodeManager::checkSolidTile(int width, int height, const T* buffer
 template <class T>
 inline bool EncodeManager::analyseRect(int width, int height, const T* buffer, int stride, struct RectInfo* info,
                                        int maxColours) {
-  int pad;
-
   T colour;
   int count;
 
   info->rleRuns = 0;
   info->palette.clear();
 
-  pad = stride - width;
-
   // For efficiency, we only update the palette on changes in colour
   colour = buffer[0];
   count = 0;
   while (height--) {
-    int w_ = width;
-    while (w_--) {
-      if (*buffer != colour) {
-        if (!info->palette.insert(colour, count))
-          return false;
-        if (info->palette.size() > maxColours)
-          return false;
-
-        // FIXME: This doesn't account for switching lines
-        info->rleRuns++;
-
-        colour = *buffer;
-        count = 0;
-      }
-      buffer++;
-      count++;
+    int x;
+
+    x = 0;
+    while (true) {
+      int next;
+
+      next = findColourChange(buffer, x, width, colour);
+      count += next - x;
+      if (next == width)
+        break;
+
+      if (!info->palette.insert(colour, count))
+        return false;
+      if (info->palette.size() > maxColours)
+        return false;
+
+      // FIXME: This doesn't account for switching lines
+      info->rleRuns++;
+
+      colour = buffer[next];
+      count = 1;
+      x = next + 1;
     }
-    buffer += pad;
+    buffer += stride;
   }
 
   // Make sure the final pixels also get counted
@@ -21,17 +21,29 @@
 #define __RFB_ENCODEMANAGER_H__
 
 #include <queue>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include <stdint.h>
+#include <sys/time.h>
 
 #include <core/Region.h>
 #include <core/Timer.h>
+#include <rdr/MemOutStream.h>
+#include <rfb/CacheKey.h>
+#include <rfb/EncodeController.h>
+#include <rfb/LossyRefinement.h>
 #include <rfb/Palette.h>
 #include <rfb/PixelBuffer.h>
-#include <rfb/cache/ServerHashSet.h>
+#include <rfb/cache/CacheDelta.h>
+#include <rfb/cache/CacheKeyDictionary.h>
+#include <rfb/cache/GlyphDictionary.h>
+
+namespace core {
+class WorkerPool;
+}
 
 namespace rfb {
 
@@ -40,6 +52,12 @@ class Encoder;
 class UpdateInfo;
 class PixelBuffer;
 class RenderedCursor;
+class SharedEncodeCache;
+
+namespace cache {
+class BorderedRegionTracker;
+class VolatilityMap;
+}
 
 // Encoder classes and types shared between implementation and stats
 enum EncoderClass {
@@ -49,6 +67,7 @@ enum EncoderClass {
   encoderTight,
   encoderTightJPEG,
   encoderZRLE,
+  encoderH264,
   encoderClassMax,
 };
 
@@ -65,6 +84,8 @@ enum EncoderType {
 struct RectInfo {
   int rleRuns;
   Palette palette;
+  // Photo-like, see EncodeManager::analyseRect()
+  bool smooth;
 };
 
 class EncodeManager : public core::Timer::Callback {
@@ -91,8 +112,18 @@ public:
   void writeLosslessRefresh(const core::Region& req, const PixelBuffer* pb, const RenderedCursor* renderedCursor,
                             size_t maxUpdateSize);
 
+  // Must see every framebuffer change, including those not yet sent
+  void noteFramebufferDamage(const core::Region& damage);
+
+  // Brackets a writeUpdate() that runs on another thread. Nothing else
+  // may use the EncodeManager in between, and our timers are held back
+  // until endThreadedUpdate() has been called on the main thread.
+  void beginThreadedUpdate();
+  void endThreadedUpdate();
+
   // PersistentCache protocol support - public interface (64-bit IDs)
   void addClientKnownHash(uint64_t cacheId);
+  void addClientKnownHashes(const std::vector<uint64_t>& cacheIds);
   void removeClientKnownHash(uint64_t cacheId);
   bool clientKnowsHash(uint64_t cacheId) const;
   void setUsePersistentCache(bool enable) {
@@ -102,6 +133,17 @@ public:
     nativeFormatCacheSupported = enable;
   }
 
+  // Rects of the shared cache's framebuffer will be taken from, and
+  // given to, other clients with the same encoding parameters
+  void setSharedEncodes(SharedEncodeCache* cache);
+
+  // Known cache IDs are kept as indices into this server wide
+  // dictionary, so clients with the same cache share the storage
+  void setKeyDictionary(cache::CacheKeyDictionary* dict);
+  size_t getKnownKeyMemory() const {
+    return clientKnownIds_.memoryUsage();
+  }
+
 protected:
   void handleTimeout(core::Timer* t) override;
 
@@ -119,18 +161,46 @@ protected:
   void writeCopyRects(const core::Region& copied, const core::Point& delta);
   void writeSolidRects(core::Region* changed, const PixelBuffer* pb);
   void findSolidRect(const core::Rect& rect, core::Region* changed, const PixelBuffer* pb);
+  // Sends text-like areas as GlyphRects and removes them from changed.
+  // Nothing is sent over avoid, where the client shows the cursor.
+  void writeGlyphRects(core::Region* changed, const PixelBuffer* pb, const core::Rect& avoid);
+  bool tryGlyphRect(const core::Rect& rect, const PixelBuffer* pb);
+  // Finds the cell grid of the text around rect
+  void findGlyphPhase(const core::Rect& rect, const PixelBuffer* pb);
+  // Sends the areas the client has as JPEG as a difference to what it
+  // decoded, where that is smaller, and removes them from changed
+  void writeRefinementRects(core::Region* changed, const PixelBuffer* pb);
+  bool tryRefinementRect(const LossyRefinementStore::Entry& entry, const PixelBuffer* pb);
   void writeRects(const core::Region& changed, const PixelBuffer* pb);
+  // Volatile (video/animation) areas: no cache lookups and a reduced
+  // JPEG quality matching the rate they change at
+  void writeVolatileRects(const core::Region& changed, const PixelBuffer* pb);
+  void noteVolatileDamage(const core::Region& changed, const PixelBuffer* pb);
+  // Sends a stable volatile area as H.264, if possible, and removes it
+  // from changed
+  void writeVideoRect(core::Region* changed, const PixelBuffer* pb);
 
   void writeSubRect(const core::Rect& rect, const PixelBuffer* pb);
 
+  class OffsetPixelBuffer;
+
   // Shared encoder selection for both normal rects and cache INIT
   // paths (ContentCache and PersistentCache). Populates ppb, info
   // and type for the given rect.
   void selectEncoderForRect(const core::Rect& rect, const PixelBuffer* pb, PixelBuffer*& ppb, struct RectInfo* info,
                             EncoderType& type);
+  void selectEncoderForRect(const core::Rect& rect, const PixelBuffer* pb, PixelBuffer*& ppb, struct RectInfo* info,
+                            EncoderType& type, ManagedPixelBuffer* converted, OffsetPixelBuffer* offset);
 
   // Unified cache protocol support (PersistentCache-style, 64-bit IDs)
   bool tryPersistentCacheLookup(const core::Rect& rect, const PixelBuffer* pb);
+  // Sends new content as a residual against similar content the client
+  // already has, if that is smaller than encoding it normally
+  bool tryPersistentCacheDelta(const core::Rect& rect, const CacheKey& cacheKey, const PixelBuffer* pb);
+  // Encodes (or reuses an earlier encoding of) the payload of a
+  // PersistentCachedRectInit
+  void writeInitPayload(const core::Rect& rect, const CacheKey& cacheKey, Encoder* encoder, PixelBuffer* ppb,
+                        const Palette& palette, const PixelBuffer* pb);
   // Shift-tolerant cache scan (emit tiles): attempt to emit cache references
   // for translated/reappearing content and subtract emitted regions from work.
   void runShiftTolerantCacheScan(core::Region* changed, const PixelBuffer* pb, bool clientSupportsCache);
@@ -139,6 +209,8 @@ protected:
   void runOffsetTilePrepass(core::Region* changed, const PixelBuffer* pb);
   // Check if encoding produces lossy output
   bool isLossyEncoding(int encoding) const;
+  // Compression level for the zlib data in our own rect types
+  int zlibLevel() const;
 
   bool checkSolidTile(const core::Rect& r, const uint8_t* colourValue, const PixelBuffer* pb);
   void extendSolidAreaByBlock(const core::Rect& r, const uint8_t* colourValue, const PixelBuffer* pb, core::Rect* er);
@@ -146,6 +218,8 @@ protected:
                               const PixelBuffer* pb, core::Rect* er);
 
   PixelBuffer* preparePixelBuffer(const core::Rect& rect, const PixelBuffer* pb, bool convert);
+  PixelBuffer* preparePixelBuffer(const core::Rect& rect, const PixelBuffer* pb, bool convert,
+                                  ManagedPixelBuffer* converted, OffsetPixelBuffer* offset);
 
   bool analyseRect(const PixelBuffer* pb, struct RectInfo* info, int maxColours);
 
@@ -171,6 +245,25 @@ protected:
   core::Timer recentChangeTimer;
   core::Timer cacheStatsTimer;
 
+  // The timer list belongs to the main thread, so encoding on another
+  // thread looks at these instead
+  bool recentChangeActive();
+  void startRecentChangeTimer();
+  bool threadedUpdate;
+  bool recentChangeStarted;
+
+  // Encoding settings adapted to the CPU and bandwidth budget
+  // (AdaptiveEncoding)
+  EncodeController controller;
+
+  cache::VolatilityMap* volatilityMap;
+  struct timeval volatilityEpoch; // Time zero for volatilityMap
+  cache::BorderedRegionTracker* borderedTracker;
+  core::Region volatileRegion; // Volatile tiles at the start of this update
+  bool encodingVolatile;
+  core::Rect videoRect; // Candidate area for H.264
+  unsigned videoRectUpdates;
+
   struct EncoderStats {
     unsigned rects;
     unsigned long long bytes;
@@ -199,6 +292,49 @@ protected:
   OffsetPixelBuffer offsetPixelBuffer;
   ManagedPixelBuffer convertedPixelBuffer;
 
+  // Parallel encoding (EncodeThreads): the subrects of an update are
+  // analysed and encoded up front by a worker pool, and the results
+  // are then written out in order by writeSubRect()
+  struct EncodeJob {
+    core::Rect rect;
+    std::vector<uint8_t> hash; // Content hash, if the cache is in use
+    bool encoded;
+    EncoderType type;
+    std::vector<uint8_t> data;
+  };
+
+  struct EncodeSlot {
+    std::vector<Encoder*> encoders; // nullptr for stateful encoders
+    OffsetPixelBuffer offsetPixelBuffer;
+    ManagedPixelBuffer convertedPixelBuffer;
+    rdr::MemOutStream out;
+  };
+
+  bool useParallelEncoding(const std::vector<core::Rect>& subrects);
+  void prepareEncodeJobs(const std::vector<core::Rect>& subrects, const PixelBuffer* pb);
+  void encodeJob(EncodeJob* job, EncodeSlot* slot, const PixelBuffer* pb);
+  EncodeJob* takeEncodeJob(const core::Rect& rect);
+
+  core::WorkerPool* encodeWorkers;
+  std::vector<EncodeSlot*> encodeSlots;
+  std::vector<EncodeJob> encodeJobs;
+  size_t nextEncodeJob;
+  EncodeJob* activeJob; // Job for the subrect being written, if any
+  bool parallelEncoding;
+
+  // Encode-once for identical clients (ShareEncodedUpdates)
+  std::string encodeFingerprint();
+  void updateSharing();
+  bool isShareable(EncoderType type);
+  bool writeSharedRect(const core::Rect& rect);
+
+  void updateTightMode();
+
+  SharedEncodeCache* sharedEncodes;
+  std::string sharedFingerprint; // Group we are registered in, if any
+  bool sharingEncodes;
+  rdr::MemOutStream sharedBuffer;
+
   // Last framebuffer size we saw; used to detect resolution changes.
   core::Rect lastFramebufferRect;
 
@@ -212,7 +348,7 @@ protected:
   // Set of 64-bit content IDs known to be present on the client. This
   // mirrors the ContentCache cacheId tracking logic, but for
   // cross-session PersistentCache entries.
-  ServerHashSet<uint64_t, std::hash<uint64_t>> clientKnownIds_;
+  cache::KnownKeySet clientKnownIds_;
   std::queue<std::pair<uint64_t, core::Rect>> pendingPersistentQueries_;
 
   struct PersistentCacheStats {
@@ -222,6 +358,93 @@ protected:
     unsigned long long bytesSaved;
   };
   PersistentCacheStats persistentCacheStats;
+
+  struct VolatileStats {
+    unsigned updates;
+    unsigned long long pixels;
+    unsigned long long bytes;
+    unsigned long long equivalent;
+    unsigned long long hashSkipped; // Pixels that bypassed content hashing
+    unsigned long long encodeUs;
+  };
+  VolatileStats volatileStats;
+
+  struct PayloadCacheStats {
+    unsigned lookups;
+    unsigned hits;
+    unsigned long long bytes;
+    unsigned long long savedUs; // Encoding time the hits would have cost
+  };
+  PayloadCacheStats payloadCacheStats;
+
+  // Recently sent content that new content can be given as a
+  // difference against
+  cache::DeltaReferenceStore deltaRefs;
+  std::vector<uint8_t> deltaBase;
+  std::vector<uint8_t> deltaPixels;
+  std::vector<uint8_t> deltaData;
+
+  struct DeltaStats {
+    unsigned candidates; // Misses with a similar entry to compare against
+    unsigned rects;      // Sent as a delta
+    unsigned long long bytes;
+    unsigned long long bytesSaved; // Compared to encoding them normally
+  };
+  DeltaStats deltaStats;
+
+  // Glyph cells the client holds, in glyphPF and of the given size
+  cache::GlyphDictionary glyphs;
+  PixelFormat glyphPF;
+  int glyphCellW, glyphCellH;
+  bool glyphReset; // Client must be told to forget its glyphs
+  core::Point glyphPhase; // Framebuffer position of a cell corner
+  bool glyphPhaseStale;
+  unsigned glyphPhaseSearchAt; // Earliest update for a new search
+  unsigned glyphUpdateCells, glyphUpdateKnown;
+  std::vector<uint8_t> glyphPixels;
+  std::vector<uint8_t> glyphCell;
+  std::vector<uint64_t> glyphHashes;
+  std::vector<int> glyphIndices;
+  std::vector<uint16_t> glyphCells;
+  std::unordered_map<uint64_t, int> glyphSeen;
+  std::vector<uint8_t> glyphData;
+
+  struct GlyphStats {
+    unsigned rects;
+    unsigned phaseSearches;
+    unsigned long long cells;
+    unsigned long long newGlyphs; // Cells sent with their pixels
+    unsigned long long bytes;
+    unsigned long long equivalent;
+  };
+  GlyphStats glyphStats;
+
+  // Rects the client has as JPEG, that can be refined rather than
+  // sent again
+  LossyRefinementStore refinements;
+  std::vector<LossyRefinementStore::Entry> refinementEntries;
+  std::vector<uint8_t> refinementLossy;
+  std::vector<uint8_t> refinementExact;
+  std::vector<uint8_t> refinementData;
+
+  struct RefinementStats {
+    unsigned candidates;
+    unsigned rects; // Sent as a difference
+    unsigned long long pixels;
+    unsigned long long bytes;
+    unsigned long long equivalent; // Estimate for sending them again
+    unsigned long long encodeUs;
+  };
+  RefinementStats refinementStats;
+
+  struct SharedStats {
+    unsigned rects; // Copied from another client's encoding
+    unsigned long long bytes;
+    unsigned published; // Encoded here and offered to others
+  };
+  SharedStats sharedStats;
+
+  rdr::MemOutStream payloadBuffer;
 };
 
 } // namespace rfb
@@ -24,16 +24,27 @@
 #include <rfb/Encoder.h>
 #include <rfb/Palette.h>
 #include <rfb/PixelBuffer.h>
+#include <rfb/SConnection.h>
 
 using namespace rfb;
 
 Encoder::Encoder(SConnection* conn_, int encoding_, enum EncoderFlags flags_, unsigned int maxPaletteSize_,
                  int losslessQuality_)
     : encoding(encoding_), flags(flags_), maxPaletteSize(maxPaletteSize_), losslessQuality(losslessQuality_),
-      conn(conn_) {}
+      conn(conn_), outStream(nullptr) {}
 
 Encoder::~Encoder() {}
 
+void Encoder::setOutStream(rdr::OutStream* os) {
+  outStream = os;
+}
+
+rdr::OutStream* Encoder::getOutStream() {
+  if (outStream != nullptr)
+    return outStream;
+  return conn->getOutStream();
+}
+
 void Encoder::writeSolidRect(int width, int height, const PixelFormat& pf, const uint8_t* colour) {
   ManagedPixelBuffer buffer(pf, width, height);
 
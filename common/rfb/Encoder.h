@@ -22,6 +22,10 @@
 
 #include <stdint.h>
 
+namespace rdr {
+class OutStream;
+}
+
 namespace rfb {
 class SConnection;
 class PixelBuffer;
@@ -36,6 +40,9 @@ enum EncoderFlags {
   EncoderUseNativePF = 1 << 0,
   // Encoder does not encode pixels perfectly accurate
   EncoderLossy = 1 << 1,
+  // Output only depends on the rectangle and the encoder settings,
+  // i.e. there is no stream state that carries between rectangles
+  EncoderStateless = 1 << 2,
 };
 
 class Encoder {
@@ -53,12 +60,23 @@ public:
   virtual void setQualityLevel(int /*level*/){};
   virtual void setFineQualityLevel(int /*quality*/, int /*subsampling*/){};
 
+  // setSmoothHint() tells the encoder if the rectangle given to the
+  // next writeRect() looks photographic, i.e. if its pixels can mostly
+  // be predicted from their neighbours.
+  virtual void setSmoothHint(bool /*smooth*/){};
+
   virtual int getCompressLevel() {
     return -1;
   };
   virtual int getQualityLevel() {
     return -1;
   };
+  virtual int getFineQualityLevel() {
+    return -1;
+  };
+  virtual int getFineSubsampling() {
+    return -1;
+  };
 
   // writeRect() is the main interface that encodes the given rectangle
   // with data from the PixelBuffer onto the SConnection given at
@@ -84,7 +102,14 @@ public:
   // efficient short cut.
   virtual void writeSolidRect(int width, int height, const PixelFormat& pf, const uint8_t* colour) = 0;
 
+  // setOutStream() makes the encoder write to the given stream instead
+  // of the connection's, e.g. to encode on another thread. Pass nullptr
+  // to go back to the connection's stream.
+  void setOutStream(rdr::OutStream* os);
+
 protected:
+  rdr::OutStream* getOutStream();
+
   // Helper method for redirecting a single colour palette to the
   // short cut method.
   void writeSolidRect(const PixelBuffer* pb, const Palette& palette);
@@ -102,6 +127,9 @@ public:
 
 protected:
   SConnection* conn;
+
+private:
+  rdr::OutStream* outStream;
 };
 } // namespace rfb
 
@@ -23,6 +23,7 @@
 #include <core/LogWriter.h>
 #include <rfb/GlobalClientPersistentCache.h>
 #include <rfb/cache/ArcCache.h>
+#include <rfb/cache/IdListCodec.h>
 
 #include <algorithm>
 #include <cstring>
@@ -754,6 +755,21 @@ std::string GlobalClientPersistentCache::getIndexPath() const {
   return cacheDir_ + "/index.dat";
 }
 
+std::string GlobalClientPersistentCache::getEpochPath(const std::string& server) const {
+  uint64_t hash;
+  char buf[32];
+
+  // FNV-1a, as server names may contain anything
+  hash = 0xcbf29ce484222325ULL;
+  for (unsigned char c : server) {
+    hash ^= c;
+    hash *= 0x100000001b3ULL;
+  }
+
+  snprintf(buf, sizeof(buf), "/epoch_%016llx.dat", (unsigned long long)hash);
+  return cacheDir_ + buf;
+}
+
 std::string GlobalClientPersistentCache::getShardPath(uint16_t shardId) const {
   char buf[32];
   snprintf(buf, sizeof(buf), "/shard_%04u.dat", shardId);
@@ -1783,6 +1799,109 @@ bool GlobalClientPersistentCache::saveToDisk() {
   return true;
 }
 
+namespace {
+struct EpochHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t token;
+  uint32_t count;
+  uint32_t length;
+  uint8_t riceBits;
+  uint8_t reserved[7];
+};
+} // namespace
+
+static const uint32_t epochMagic = 0x50434550; // "PCEP"
+
+bool GlobalClientPersistentCache::loadEpoch(const std::string& server, uint64_t* token,
+                                            std::vector<uint64_t>* ids) const {
+  std::string path = getEpochPath(server);
+  EpochHeader header;
+  std::vector<uint8_t> data;
+
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+
+  if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != epochMagic || header.version != 1 ||
+      header.token == 0 || header.length > cache::maxIdListLength(header.count)) {
+    vlog.debug("PersistentCache: ignoring invalid epoch file %s", path.c_str());
+    fclose(f);
+    return false;
+  }
+
+  data.resize(header.length);
+  if (fread(data.data(), 1, data.size(), f) != data.size()) {
+    vlog.debug("PersistentCache: truncated epoch file %s", path.c_str());
+    fclose(f);
+    return false;
+  }
+
+  fclose(f);
+
+  if (!cache::decodeIdList(data.data(), data.size(), header.count, header.riceBits, ids)) {
+    vlog.debug("PersistentCache: corrupt epoch file %s", path.c_str());
+    return false;
+  }
+
+  *token = header.token;
+  return true;
+}
+
+bool GlobalClientPersistentCache::saveEpoch(const std::string& server, uint64_t token,
+                                            const std::vector<uint64_t>& ids) {
+  EpochHeader header;
+  std::vector<uint8_t> data;
+
+  if (!ensureCacheDir())
+    return false;
+
+  std::string path = getEpochPath(server);
+  std::string tmpPath = path + ".tmp";
+
+  memset(&header, 0, sizeof(header));
+  header.magic = epochMagic;
+  header.version = 1;
+  header.token = token;
+  header.count = ids.size();
+  header.riceBits = cache::chooseRiceBits(ids.data(), ids.size());
+  cache::encodeIdList(ids.data(), ids.size(), header.riceBits, &data);
+  header.length = data.size();
+
+  FILE* f = fopen(tmpPath.c_str(), "wb");
+  if (!f) {
+    vlog.error("PersistentCache: failed to open %s for writing: %s", tmpPath.c_str(), strerror(errno));
+    return false;
+  }
+
+  if (fwrite(&header, sizeof(header), 1, f) != 1 || fwrite(data.data(), 1, data.size(), f) != data.size()) {
+    vlog.error("PersistentCache: failed writing %s: %s", tmpPath.c_str(), strerror(errno));
+    fclose(f);
+    remove(tmpPath.c_str());
+    return false;
+  }
+
+  if (fclose(f) != 0) {
+    vlog.error("PersistentCache: failed to close %s: %s", tmpPath.c_str(), strerror(errno));
+    remove(tmpPath.c_str());
+    return false;
+  }
+
+  if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+    vlog.error("PersistentCache: failed to rename %s to %s: %s", tmpPath.c_str(), path.c_str(), strerror(errno));
+    remove(tmpPath.c_str());
+    return false;
+  }
+
+  vlog.debug("PersistentCache: saved epoch with %zu IDs in %zu bytes", ids.size(), data.size());
+
+  return true;
+}
+
+void GlobalClientPersistentCache::clearEpoch(const std::string& server) {
+  remove(getEpochPath(server).c_str());
+}
+
 uint32_t GlobalClientPersistentCache::getCurrentTime() const {
   return (uint32_t)time(nullptr);
 }
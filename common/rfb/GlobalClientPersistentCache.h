@@ -208,6 +208,13 @@ public:
   // std::vector<uint64_t> getAllContentIds() const;
   std::vector<CacheKey> getAllKeys() const; // All known keys (16-byte)
 
+  // Cache epoch a server handed out for the IDs we last advertised to
+  // it, which lets the next connection send only what changed since.
+  // Stored per server as the ID sets differ between them.
+  bool loadEpoch(const std::string& server, uint64_t* token, std::vector<uint64_t>* ids) const;
+  bool saveEpoch(const std::string& server, uint64_t token, const std::vector<uint64_t>& ids);
+  void clearEpoch(const std::string& server);
+
   // Statistics
   struct Stats {
     size_t totalEntries;
@@ -362,6 +369,7 @@ private:
   // Helper methods
   std::string getShardPath(uint16_t shardId) const;
   std::string getIndexPath() const;
+  std::string getEpochPath(const std::string& server) const;
   bool ensureCacheDir();
   bool openCurrentShard();
   void closeCurrentShard();
@@ -0,0 +1,188 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdexcept>
+
+#include <core/LogWriter.h>
+
+#include <rdr/MemOutStream.h>
+#include <rdr/OutStream.h>
+#include <rfb/H264Encoder.h>
+#include <rfb/H264EncoderContext.h>
+#include <rfb/Palette.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/SConnection.h>
+#include <rfb/encodings.h>
+
+using namespace rfb;
+
+static core::LogWriter vlog("H264Encoder");
+
+// Well below the 64 contexts H264Decoder keeps, so the client never
+// has to throw away a stream we still use
+#define MAX_H264_STREAMS 8
+
+enum rectFlags {
+  resetContext = 0x1,
+  resetAllContexts = 0x2,
+};
+
+H264Encoder::H264Encoder(SConnection* conn_)
+    : Encoder(conn_, encodingH264, (EncoderFlags)(EncoderUseNativePF | EncoderLossy)), bitrate(0), resetAll(false),
+      newContext(false), unusable(false) {}
+
+H264Encoder::~H264Encoder() {
+  deleteContexts();
+}
+
+bool H264Encoder::isSupported() {
+#ifdef H264_LIBAV
+  if (unusable)
+    return false;
+  return conn->client.supportsEncoding(encodingH264);
+#else
+  return false;
+#endif
+}
+
+void H264Encoder::setBitrate(unsigned bitrate_) {
+  if (bitrate_ == bitrate)
+    return;
+
+  bitrate = bitrate_;
+
+  for (H264EncoderContext* context : contexts)
+    context->setBitrate(bitrate / contexts.size());
+}
+
+void H264Encoder::resetContexts() {
+  deleteContexts();
+  resetAll = true;
+}
+
+void H264Encoder::deleteContexts() {
+  for (H264EncoderContext* context : contexts)
+    delete context;
+  contexts.clear();
+}
+
+H264EncoderContext* H264Encoder::findContext(const core::Rect& r) {
+  for (H264EncoderContext* context : contexts)
+    if (context->isEqualRect(r))
+      return context;
+  return nullptr;
+}
+
+bool H264Encoder::setRect(const core::Rect& r) {
+  H264EncoderContext* ctx;
+
+  nextRect = r;
+
+  ctx = findContext(nextRect);
+  if (ctx != nullptr) {
+    // Keep the most recently used stream last, so it is evicted last
+    contexts.remove(ctx);
+    contexts.push_back(ctx);
+    return true;
+  }
+
+  // A stream that overlaps the new geometry is most likely the same
+  // content after a move or resize, and will not be needed again
+  for (std::list<H264EncoderContext*>::iterator iter = contexts.begin(); iter != contexts.end();) {
+    if ((*iter)->getRect().overlaps(nextRect)) {
+      delete *iter;
+      iter = contexts.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+
+  if (contexts.size() >= MAX_H264_STREAMS) {
+    delete contexts.front();
+    contexts.pop_front();
+  }
+
+  // libavcodec might lack a usable encoder, which there is no point
+  // in finding out again for every frame
+  try {
+    ctx = H264EncoderContext::createContext(nextRect);
+  } catch (std::exception& e) {
+    vlog.error("Failed to create H.264 stream: %s", e.what());
+    ctx = nullptr;
+  }
+  if (ctx == nullptr) {
+    vlog.info("Disabling H.264 for this connection");
+    unusable = true;
+    nextRect = core::Rect();
+    return false;
+  }
+
+  vlog.debug("New stream for %dx%d at %d,%d", nextRect.width(), nextRect.height(), nextRect.tl.x, nextRect.tl.y);
+
+  contexts.push_back(ctx);
+  if (bitrate != 0) {
+    for (H264EncoderContext* context : contexts)
+      context->setBitrate(bitrate / contexts.size());
+  }
+
+  // The client might still have an old stream for this exact rect
+  newContext = true;
+
+  return true;
+}
+
+void H264Encoder::writeRect(const PixelBuffer* pb, const Palette& /*palette*/) {
+  H264EncoderContext* ctx;
+  uint32_t flags;
+  rdr::MemOutStream buf;
+  rdr::OutStream* os;
+
+  ctx = findContext(nextRect);
+  if ((ctx == nullptr) || (nextRect.width() != pb->width()) || (nextRect.height() != pb->height()))
+    throw std::logic_error("H264Encoder: Rect not set before writeRect()");
+
+  flags = 0;
+  if (resetAll) {
+    flags |= resetAllContexts;
+    resetAll = false;
+  }
+  if (newContext) {
+    flags |= resetContext;
+    newContext = false;
+  }
+
+  ctx->encode(pb, &buf);
+
+  os = getOutStream();
+  os->writeU32(buf.length());
+  os->writeU32(flags);
+  os->writeBytes(buf.data(), buf.length());
+
+  nextRect = core::Rect();
+}
+
+void H264Encoder::writeSolidRect(int width, int height, const PixelFormat& pf, const uint8_t* colour) {
+  ManagedPixelBuffer solid(pf, width, height);
+
+  solid.fillRect(solid.getRect(), colour);
+  writeRect(&solid, Palette());
+}
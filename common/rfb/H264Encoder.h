@@ -0,0 +1,72 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef __RFB_H264ENCODER_H__
+#define __RFB_H264ENCODER_H__
+
+#include <list>
+
+#include <core/Rect.h>
+
+#include <rfb/Encoder.h>
+
+namespace rfb {
+class H264EncoderContext;
+
+// H.264 is only used for volatile areas (video, 3D viewports) that
+// keep the same geometry over many updates. Every distinct area gets
+// its own stream, mirroring the per-rect contexts of H264Decoder.
+class H264Encoder : public Encoder {
+public:
+  H264Encoder(SConnection* conn);
+  virtual ~H264Encoder();
+
+  bool isSupported() override;
+
+  // Screen area covered by the next writeRect(), as the PixelBuffer
+  // given to it is always positioned at 0,0. Sets up the stream for
+  // it, and must be called before anything is written for the rect.
+  // Returns false, and stops claiming to be supported, if no stream
+  // can be created.
+  bool setRect(const core::Rect& r);
+
+  // Target bitrate for all streams together, in bits per second
+  void setBitrate(unsigned bitrate);
+
+  // Drops all streams, and tells the client to do the same with the
+  // next rect (e.g. after a framebuffer resize)
+  void resetContexts();
+
+  void writeRect(const PixelBuffer* pb, const Palette& palette) override;
+  void writeSolidRect(int width, int height, const PixelFormat& pf, const uint8_t* colour) override;
+
+private:
+  H264EncoderContext* findContext(const core::Rect& r);
+  void deleteContexts();
+
+  std::list<H264EncoderContext*> contexts;
+
+  core::Rect nextRect;
+  unsigned bitrate;
+  bool resetAll;
+  bool newContext;
+  bool unusable;
+};
+} // namespace rfb
+
+#endif
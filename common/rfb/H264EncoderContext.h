@@ -0,0 +1,65 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef __RFB_H264ENCODERCONTEXT_H__
+#define __RFB_H264ENCODERCONTEXT_H__
+
+#include <stdint.h>
+
+#include <core/Rect.h>
+
+namespace rdr {
+class OutStream;
+}
+
+namespace rfb {
+
+class PixelBuffer;
+
+class H264EncoderContext {
+public:
+  // Returns nullptr if there is no H.264 encoder available on this
+  // platform
+  static H264EncoderContext* createContext(const core::Rect& r);
+
+  virtual ~H264EncoderContext() = 0;
+
+  // Encodes the next frame of the stream. The first frame of a
+  // context is always an IDR frame, so a new context can be decoded
+  // by a fresh decoder context on the client.
+  virtual void encode(const PixelBuffer* pb, rdr::OutStream* os) = 0;
+
+  // Target bitrate in bits per second
+  virtual void setBitrate(unsigned bitrate) = 0;
+
+  inline bool isEqualRect(const core::Rect& r) const {
+    return r == rect;
+  }
+  inline const core::Rect& getRect() const {
+    return rect;
+  }
+
+protected:
+  core::Rect rect;
+
+  H264EncoderContext(const core::Rect& r) : rect(r) {}
+};
+
+} // namespace rfb
+
+#endif
@@ -0,0 +1,175 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/time.h>
+
+#include <stdexcept>
+
+extern "C" {
+#include <libavutil/opt.h>
+}
+
+#include <core/time.h>
+
+#include <rdr/OutStream.h>
+#include <rfb/H264LibavEncoderContext.h>
+#include <rfb/PixelBuffer.h>
+
+using namespace rfb;
+
+// Bitrate used until the first estimate arrives
+static const unsigned DefaultBitrate = 2000000;
+
+// We only ever send an IDR frame when a stream is (re)started, as the
+// transport is reliable
+static const int KeyframeInterval = 3600;
+
+// Byte order B, G, R, X, which libswscale knows as AV_PIX_FMT_BGR0
+static const PixelFormat bgrxPF(32, 24, false, true, 255, 255, 255, 16, 8, 0);
+
+H264LibavEncoderContext::H264LibavEncoderContext(const core::Rect& r) : H264EncoderContext(r) {
+  const AVCodec* codec;
+
+  sws = nullptr;
+  lastPts = -1;
+  gettimeofday(&start, nullptr);
+
+  // Prefer x264 as it has a proper low latency mode, but accept
+  // whatever else (e.g. OpenH264) libavcodec was built with
+  codec = avcodec_find_encoder_by_name("libx264");
+  if (!codec)
+    codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+  if (!codec)
+    throw std::runtime_error("H.264 encoder not found");
+
+  avctx = avcodec_alloc_context3(codec);
+  if (!avctx)
+    throw std::runtime_error("Could not allocate video codec context");
+
+  avctx->width = r.width();
+  avctx->height = r.height();
+  avctx->pix_fmt = AV_PIX_FMT_YUV420P;
+  avctx->time_base = {1, 1000};
+  avctx->gop_size = KeyframeInterval;
+  avctx->max_b_frames = 0;
+  avctx->bit_rate = DefaultBitrate;
+  avctx->rc_max_rate = DefaultBitrate;
+  avctx->rc_buffer_size = DefaultBitrate;
+
+  // Every frame must come out immediately; these fail harmlessly on
+  // encoders other than x264
+  av_opt_set(avctx->priv_data, "preset", "ultrafast", 0);
+  av_opt_set(avctx->priv_data, "tune", "zerolatency", 0);
+
+  if (avcodec_open2(avctx, codec, nullptr) < 0) {
+    avcodec_free_context(&avctx);
+    throw std::runtime_error("Could not open video codec");
+  }
+
+  frame = av_frame_alloc();
+  if (!frame) {
+    avcodec_free_context(&avctx);
+    throw std::runtime_error("Could not allocate video frame");
+  }
+
+  frame->format = avctx->pix_fmt;
+  frame->width = avctx->width;
+  frame->height = avctx->height;
+  if (av_frame_get_buffer(frame, 0) < 0) {
+    av_frame_free(&frame);
+    avcodec_free_context(&avctx);
+    throw std::runtime_error("Could not allocate video frame data");
+  }
+
+  packet = av_packet_alloc();
+  if (!packet) {
+    av_frame_free(&frame);
+    avcodec_free_context(&avctx);
+    throw std::runtime_error("Could not allocate video packet");
+  }
+}
+
+H264LibavEncoderContext::~H264LibavEncoderContext() {
+  av_packet_free(&packet);
+  av_frame_free(&frame);
+  avcodec_free_context(&avctx);
+  sws_freeContext(sws);
+}
+
+void H264LibavEncoderContext::setBitrate(unsigned bitrate) {
+  // libx264 picks up changes to these on the next frame
+  avctx->bit_rate = bitrate;
+  avctx->rc_max_rate = bitrate;
+  avctx->rc_buffer_size = bitrate;
+}
+
+void H264LibavEncoderContext::encode(const PixelBuffer* pb, rdr::OutStream* os) {
+  const uint8_t* buffer;
+  int stride, lineSize;
+  int64_t pts;
+  int ret;
+
+  if ((pb->width() != avctx->width) || (pb->height() != avctx->height))
+    throw std::logic_error("H.264 frame does not match the stream size");
+
+  if (pb->getPF() == bgrxPF) {
+    buffer = pb->getBuffer(pb->getRect(), &stride);
+  } else {
+    convBuffer.resize((size_t)pb->width() * pb->height() * 4);
+    pb->getImage(bgrxPF, convBuffer.data(), pb->getRect());
+    buffer = convBuffer.data();
+    stride = pb->width();
+  }
+  lineSize = stride * 4;
+
+  sws = sws_getCachedContext(sws, avctx->width, avctx->height, AV_PIX_FMT_BGR0, avctx->width, avctx->height,
+                             avctx->pix_fmt, SWS_POINT, nullptr, nullptr, nullptr);
+  if (!sws)
+    throw std::runtime_error("Could not create colour conversion context");
+
+  if (av_frame_make_writable(frame) < 0)
+    throw std::runtime_error("Could not make video frame writable");
+
+  sws_scale(sws, &buffer, &lineSize, 0, avctx->height, frame->data, frame->linesize);
+
+  // Real time stamps lets the rate control account for how long each
+  // frame is shown
+  pts = core::msSince(&start);
+  if (pts <= lastPts)
+    pts = lastPts + 1;
+  frame->pts = lastPts = pts;
+
+  ret = avcodec_send_frame(avctx, frame);
+  if (ret < 0)
+    throw std::runtime_error("Could not encode H.264 frame");
+
+  while (true) {
+    ret = avcodec_receive_packet(avctx, packet);
+    if ((ret == AVERROR(EAGAIN)) || (ret == AVERROR_EOF))
+      break;
+    if (ret < 0)
+      throw std::runtime_error("Could not encode H.264 frame");
+
+    os->writeBytes(packet->data, packet->size);
+    av_packet_unref(packet);
+  }
+}
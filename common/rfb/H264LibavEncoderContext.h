@@ -0,0 +1,53 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef __RFB_H264LIBAVENCODER_H__
+#define __RFB_H264LIBAVENCODER_H__
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+#include <vector>
+
+#include <rfb/H264EncoderContext.h>
+
+namespace rfb {
+class H264LibavEncoderContext : public H264EncoderContext {
+public:
+  H264LibavEncoderContext(const core::Rect& r);
+  ~H264LibavEncoderContext();
+
+  void encode(const PixelBuffer* pb, rdr::OutStream* os) override;
+  void setBitrate(unsigned bitrate) override;
+
+private:
+  AVCodecContext* avctx;
+  AVFrame* frame;
+  AVPacket* packet;
+  SwsContext* sws;
+
+  std::vector<uint8_t> convBuffer;
+
+  struct timeval start;
+  int64_t lastPts;
+};
+} // namespace rfb
+
+#endif
@@ -45,7 +45,7 @@ core::BoolParameter improvedHextile("ImprovedHextile",
                                     "CPU time",
                                     true);
 
-HextileEncoder::HextileEncoder(SConnection* conn_) : Encoder(conn_, encodingHextile, EncoderPlain) {}
+HextileEncoder::HextileEncoder(SConnection* conn_) : Encoder(conn_, encodingHextile, EncoderStateless) {}
 
 HextileEncoder::~HextileEncoder() {}
 
@@ -54,7 +54,7 @@ bool HextileEncoder::isSupported() {
 }
 
 void HextileEncoder::writeRect(const PixelBuffer* pb, const Palette& /*palette*/) {
-  rdr::OutStream* os = conn->getOutStream();
+  rdr::OutStream* os = getOutStream();
   switch (pb->getPF().bpp) {
   case 8:
     if (improvedHextile) {
@@ -84,7 +84,7 @@ void HextileEncoder::writeSolidRect(int width, int height, const PixelFormat& pf
   rdr::OutStream* os;
   int tiles;
 
-  os = conn->getOutStream();
+  os = getOutStream();
 
   tiles = ((width + 15) / 16) * ((height + 15) / 16);
 
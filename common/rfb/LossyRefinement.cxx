@@ -0,0 +1,182 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <algorithm>
+
+#include <rdr/InStream.h>
+#include <rdr/MemOutStream.h>
+#include <rdr/ZlibOutStream.h>
+
+#include <rfb/LossyRefinement.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/cache/ZlibHelpers.h>
+
+using namespace rfb;
+
+// Little endian, so R, G and B are the first three bytes on any host
+const PixelFormat rfb::lossyRefinementPF(32, 24, false, true, 255, 255, 255, 0, 8, 16);
+
+const size_t LossyRefinementStore::MaxEntries;
+
+LossyRefinementStore::LossyRefinementStore() {}
+
+LossyRefinementStore::~LossyRefinementStore() {}
+
+void LossyRefinementStore::add(const core::Rect& rect, int quality, int subsampling) {
+  Entry entry;
+
+  remove(rect);
+
+  entry.rect = rect;
+  entry.quality = quality;
+  entry.subsampling = subsampling;
+  entries.push_back(entry);
+
+  while (entries.size() > MaxEntries)
+    entries.pop_front();
+}
+
+void LossyRefinementStore::discard(const core::Region& region) {
+  if (region.is_empty())
+    return;
+
+  entries.remove_if([&region](const Entry& entry) { return !region.intersect(entry.rect).is_empty(); });
+}
+
+void LossyRefinementStore::remove(const core::Rect& rect) {
+  entries.remove_if([&rect](const Entry& entry) { return entry.rect.overlaps(rect); });
+}
+
+void LossyRefinementStore::clear() {
+  entries.clear();
+}
+
+void LossyRefinementStore::find(const core::Region& region, std::vector<Entry>* found) const {
+  found->clear();
+
+  for (const Entry& entry : entries) {
+    if (core::Region(entry.rect).subtract(region).is_empty())
+      found->push_back(entry);
+  }
+}
+
+void LossyRefinementStore::reproduce(const PixelBuffer* pb, const Entry& entry, uint8_t* pixels) {
+  const uint8_t* buffer;
+  int stride;
+
+  buffer = pb->getBuffer(entry.rect, &stride);
+
+  // Same as TightJPEGEncoder::writeRect()
+  jc.clear();
+  jc.compress(buffer, stride, entry.rect, pb->getPF(), entry.quality, entry.subsampling);
+
+  // And TightDecoder on the client
+  jd.decompress(jc.data(), jc.length(), pixels, entry.rect.width(), entry.rect, lossyRefinementPF);
+}
+
+uint64_t rfb::hashRefinementBase(const uint8_t* pixels, size_t count) {
+  uint64_t hash;
+
+  // FNV-1a, leaving out the unused byte whatever it might contain
+  hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < count; i++) {
+    hash = (hash ^ pixels[0]) * 1099511628211ULL;
+    hash = (hash ^ pixels[1]) * 1099511628211ULL;
+    hash = (hash ^ pixels[2]) * 1099511628211ULL;
+    pixels += 4;
+  }
+
+  return hash;
+}
+
+// Compresses the R, G and B bytes of count pixels, minus those of
+// base if there is one
+static void deflateRGB(const uint8_t* pixels, const uint8_t* base, size_t count, int level, rdr::MemOutStream* out) {
+  rdr::ZlibOutStream zos(out, level);
+  uint8_t buffer[3 * 1024];
+
+  while (count > 0) {
+    size_t n;
+
+    n = std::min(count, sizeof(buffer) / 3);
+    for (size_t i = 0; i < n; i++) {
+      buffer[i * 3 + 0] = pixels[0];
+      buffer[i * 3 + 1] = pixels[1];
+      buffer[i * 3 + 2] = pixels[2];
+      if (base != nullptr) {
+        buffer[i * 3 + 0] -= base[0];
+        buffer[i * 3 + 1] -= base[1];
+        buffer[i * 3 + 2] -= base[2];
+        base += 4;
+      }
+      pixels += 4;
+    }
+    zos.writeBytes(buffer, n * 3);
+
+    count -= n;
+  }
+
+  zos.flush();
+}
+
+void rfb::encodeRefinement(const uint8_t* lossy, const uint8_t* exact, size_t count, int level,
+                           std::vector<uint8_t>* out) {
+  rdr::MemOutStream mos;
+
+  deflateRGB(exact, lossy, count, level, &mos);
+
+  out->assign(mos.data(), mos.data() + mos.length());
+}
+
+bool rfb::applyRefinement(const uint8_t* data, size_t length, uint8_t* pixels, size_t count) {
+  return cache::inflateExactly(data, length, [pixels, count](rdr::InStream* in) mutable {
+    uint8_t buffer[3 * 1024];
+
+    while (count > 0) {
+      size_t n;
+
+      n = std::min(count, sizeof(buffer) / 3);
+      if (!in->hasData(n * 3))
+        return false;
+      in->readBytes(buffer, n * 3);
+      for (size_t i = 0; i < n; i++) {
+        pixels[0] += buffer[i * 3 + 0];
+        pixels[1] += buffer[i * 3 + 1];
+        pixels[2] += buffer[i * 3 + 2];
+        pixels[3] = 0;
+        pixels += 4;
+      }
+
+      count -= n;
+    }
+
+    return true;
+  });
+}
+
+size_t rfb::refinementReferenceSize(const uint8_t* pixels, size_t count, int level) {
+  rdr::MemOutStream mos;
+
+  deflateRGB(pixels, nullptr, count, level, &mos);
+
+  return mos.length();
+}
@@ -0,0 +1,116 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef __RFB_LOSSYREFINEMENT_H__
+#define __RFB_LOSSYREFINEMENT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <vector>
+
+#include <core/Rect.h>
+#include <core/Region.h>
+#include <rfb/JpegCompressor.h>
+#include <rfb/JpegDecompressor.h>
+#include <rfb/PixelFormat.h>
+
+namespace rfb {
+
+class PixelBuffer;
+
+// Rather than sending an area that went out as JPEG all over again
+// once it has settled, the server can work out exactly what the
+// client decoded and send only the difference to the real pixels.
+// JPEG errors are small, so the difference compresses far better than
+// the pixels themselves.
+//
+// Nothing is kept of the JPEG data. As long as the framebuffer hasn't
+// changed, compressing it again with the same settings gives the same
+// JPEG, which is then decoded the way the client does.
+//
+// All of this is done on 8 bit RGB, so that it doesn't matter how the
+// client lays out its framebuffer. The client checks a hash of its
+// pixels before applying the difference, in case its JPEG decoder
+// doesn't agree with ours.
+
+// Pixels are handled as R, G, B and one unused byte in this format
+extern const PixelFormat lossyRefinementPF;
+
+class LossyRefinementStore {
+public:
+  static const size_t MaxEntries = 4096;
+
+  struct Entry {
+    core::Rect rect;
+    int quality;
+    int subsampling;
+  };
+
+  LossyRefinementStore();
+  ~LossyRefinementStore();
+
+  // Records a rect just sent as JPEG, replacing anything it covers
+  void add(const core::Rect& rect, int quality, int subsampling);
+  // Forgets every rect with new content somewhere in it
+  void discard(const core::Region& region);
+  void remove(const core::Rect& rect);
+  void clear();
+
+  // Rects lying entirely within region, oldest first
+  void find(const core::Region& region, std::vector<Entry>* entries) const;
+
+  size_t size() const {
+    return entries.size();
+  }
+
+  // Compresses and decodes rect of pb like the client does, giving
+  // rect.area() pixels in lossyRefinementPF
+  void reproduce(const PixelBuffer* pb, const Entry& entry, uint8_t* pixels);
+
+private:
+  // Oldest first
+  std::list<Entry> entries;
+
+  JpegCompressor jc;
+  JpegDecompressor jd;
+};
+
+// Hash of the RGB values of count pixels in lossyRefinementPF
+uint64_t hashRefinementBase(const uint8_t* pixels, size_t count);
+
+// The difference is exact minus lossy for each colour channel, modulo
+// 256, which makes the usual small JPEG errors a few distinct byte
+// values
+void encodeRefinement(const uint8_t* lossy, const uint8_t* exact, size_t count, int level,
+                      std::vector<uint8_t>* out);
+
+// Adds a difference to count pixels in lossyRefinementPF, clearing
+// the unused byte like the lossless decoders do. Returns
+// false, leaving pixels in an undefined state, if it does not
+// decompress to exactly the expected length.
+bool applyRefinement(const uint8_t* data, size_t length, uint8_t* pixels, size_t count);
+
+// What plain zlib makes of the RGB values, as a lossless encoder
+// would send them, for comparison with a difference
+size_t refinementReferenceSize(const uint8_t* pixels, size_t count, int level);
+
+} // namespace rfb
+
+#endif
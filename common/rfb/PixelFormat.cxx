@@ -27,6 +27,7 @@
 #include <rdr/OutStream.h>
 #include <rfb/Exception.h>
 #include <rfb/PixelFormat.h>
+#include <rfb/PixelFormatSIMD.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -240,9 +241,21 @@ void PixelFormat::bufferFromRGB(uint8_t* dst, const uint8_t* src, int w, int str
       x = dst + (48 - redShift - greenShift - blueShift) / 8;
     }
 
+    const uint8_t offsets[3] = {(uint8_t)(r - dst), (uint8_t)(g - dst), (uint8_t)(b - dst)};
+
     int dstPad = (stride - w) * 4;
     while (h--) {
-      int w_ = w;
+      int w_;
+
+      // Vectorised kernels do as much as they can
+      w_ = conv888FromRGB(r - offsets[0], src, w, offsets);
+      src += w_ * 3;
+      r += w_ * 4;
+      g += w_ * 4;
+      b += w_ * 4;
+      x += w_ * 4;
+
+      w_ = w - w_;
       while (w_--) {
         *r = *(src++);
         *g = *(src++);
@@ -300,9 +313,19 @@ void PixelFormat::rgbFromBuffer(uint8_t* dst, const uint8_t* src, int w, int str
       b = src + blueShift / 8;
     }
 
+    const uint8_t offsets[3] = {(uint8_t)(r - src), (uint8_t)(g - src), (uint8_t)(b - src)};
+
     int srcPad = (stride - w) * 4;
     while (h--) {
-      int w_ = w;
+      int w_;
+
+      w_ = convRGBFrom888(dst, r - offsets[0], w, offsets);
+      dst += w_ * 3;
+      r += w_ * 4;
+      g += w_ * 4;
+      b += w_ * 4;
+
+      w_ = w - w_;
       while (w_--) {
         *(dst++) = *r;
         *(dst++) = *g;
@@ -362,6 +385,7 @@ void PixelFormat::bufferFromBuffer(uint8_t* dst, const PixelFormat& srcPF, const
   } else if (is888() && srcPF.is888()) {
     // Optimised common case A: byte shuffling (e.g. endian conversion)
     uint8_t *d[4], *s[4];
+    uint8_t order[4];
     int dstPad, srcPad;
 
     if (bigEndian) {
@@ -388,10 +412,22 @@ void PixelFormat::bufferFromBuffer(uint8_t* dst, const PixelFormat& srcPF, const
       d[(48 - srcPF.redShift - srcPF.greenShift - srcPF.blueShift) / 8] = s[3];
     }
 
+    for (int i = 0; i < 4; i++)
+      order[d[i] - dst] = i;
+
     dstPad = (dstStride - w) * 4;
     srcPad = (srcStride - w) * 4;
     while (h--) {
-      int w_ = w;
+      int w_;
+
+      w_ = convSwizzle888(d[order[0]], src, w, order);
+      src += w_ * 4;
+      d[0] += w_ * 4;
+      d[1] += w_ * 4;
+      d[2] += w_ * 4;
+      d[3] += w_ * 4;
+
+      w_ = w - w_;
       while (w_--) {
         *d[0] = *(src++);
         *d[1] = *(src++);
@@ -681,6 +717,8 @@ void PixelFormat::directBufferFromBufferFrom888(T* dst, const PixelFormat& srcPF
 
   const uint8_t *redDownTable, *greenDownTable, *blueDownTable;
 
+  ConvFormat format;
+
   redDownTable = &downconvTable[(redBits - 1) * 256];
   greenDownTable = &downconvTable[(greenBits - 1) * 256];
   blueDownTable = &downconvTable[(blueBits - 1) * 256];
@@ -695,10 +733,25 @@ void PixelFormat::directBufferFromBufferFrom888(T* dst, const PixelFormat& srcPF
     b = src + srcPF.blueShift / 8;
   }
 
+  const uint8_t offsets[3] = {(uint8_t)(r - src), (uint8_t)(g - src), (uint8_t)(b - src)};
+
+  format = {bpp, endianMismatch, {redShift, greenShift, blueShift}, {redBits, greenBits, blueBits}};
+
   dstPad = (dstStride - w);
   srcPad = (srcStride - w) * 4;
   while (h--) {
-    int w_ = w;
+    int w_;
+
+    // There are only vectorised kernels for 8 and 16 bit
+    w_ = 0;
+    if (sizeof(T) < 4)
+      w_ = convSmallFrom888((uint8_t*)dst, format, r - offsets[0], offsets, w);
+    dst += w_;
+    r += w_ * 4;
+    g += w_ * 4;
+    b += w_ * 4;
+
+    w_ = w - w_;
     while (w_--) {
       T d;
 
@@ -731,6 +784,8 @@ void PixelFormat::directBufferFromBufferTo888(uint8_t* dst, const PixelFormat& s
 
   const uint8_t *redUpTable, *greenUpTable, *blueUpTable;
 
+  ConvFormat format;
+
   redUpTable = &upconvTable[(srcPF.redBits - 1) * 256];
   greenUpTable = &upconvTable[(srcPF.greenBits - 1) * 256];
   blueUpTable = &upconvTable[(srcPF.blueBits - 1) * 256];
@@ -747,10 +802,28 @@ void PixelFormat::directBufferFromBufferTo888(uint8_t* dst, const PixelFormat& s
     x = dst + (48 - redShift - greenShift - blueShift) / 8;
   }
 
+  const uint8_t offsets[3] = {(uint8_t)(r - dst), (uint8_t)(g - dst), (uint8_t)(b - dst)};
+
+  format = {srcPF.bpp,
+            srcPF.endianMismatch,
+            {srcPF.redShift, srcPF.greenShift, srcPF.blueShift},
+            {srcPF.redBits, srcPF.greenBits, srcPF.blueBits}};
+
   dstPad = (dstStride - w) * 4;
   srcPad = (srcStride - w);
   while (h--) {
-    int w_ = w;
+    int w_;
+
+    w_ = 0;
+    if (sizeof(T) < 4)
+      w_ = conv888FromSmall(r - offsets[0], offsets, (const uint8_t*)src, format, w);
+    r += w_ * 4;
+    g += w_ * 4;
+    b += w_ * 4;
+    x += w_ * 4;
+    src += w_;
+
+    w_ = w - w_;
     while (w_--) {
       T s;
 
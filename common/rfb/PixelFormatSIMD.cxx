@@ -0,0 +1,700 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rfb/PixelFormatSIMD.h>
+
+// The kernels treat pixels as little endian integers in their lanes
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define CONV_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define CONV_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace rfb;
+
+// Factors for v * 255 / max, rounded down, computed as the high half
+// of (v << (9 - bits)) * factor. Verified for every value of every
+// channel size.
+static const uint16_t upFactors[8] = {65280, 43520, 37303, 34816, 33693, 33159, 32898, 32768};
+
+static ConvKernels detectKernels() {
+#if defined(CONV_X86)
+  // Might be called before the runtime has done this itself
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return convAVX2;
+  return convSSE2;
+#elif defined(CONV_NEON)
+  return convNEON;
+#else
+  return convScalar;
+#endif
+}
+
+// Conversions done during static initialisation see zero here, and
+// hence use the scalar code
+static ConvKernels activeKernels = detectKernels();
+
+ConvKernels rfb::convBestKernels() {
+  static const ConvKernels best = detectKernels();
+  return best;
+}
+
+bool rfb::convKernelsSupported(ConvKernels kernels) {
+  switch (kernels) {
+  case convScalar:
+    return true;
+  case convSSE2:
+    return (convBestKernels() == convSSE2) || (convBestKernels() == convAVX2);
+  case convAVX2:
+    return convBestKernels() == convAVX2;
+  case convNEON:
+    return convBestKernels() == convNEON;
+  }
+
+  return false;
+}
+
+const char* rfb::convKernelsName(ConvKernels kernels) {
+  switch (kernels) {
+  case convScalar:
+    return "Scalar";
+  case convSSE2:
+    return "SSE2";
+  case convAVX2:
+    return "AVX2";
+  case convNEON:
+    return "NEON";
+  }
+
+  return "Unknown";
+}
+
+ConvKernels rfb::convActiveKernels() {
+  return activeKernels;
+}
+
+bool rfb::setConvKernels(ConvKernels kernels) {
+  if (!convKernelsSupported(kernels))
+    return false;
+
+  activeKernels = kernels;
+  return true;
+}
+
+#if defined(CONV_X86)
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+static int swizzle888SSE2(uint8_t* dst, const uint8_t* src, int pixels, const uint8_t order[4]) {
+  __m128i masks[4], left[4], right[4];
+  int i;
+
+  // Without a byte shuffle, every byte is masked out and shifted in
+  // to place separately
+  for (i = 0; i < 4; i++) {
+    int delta;
+
+    masks[i] = _mm_set1_epi32((int)(0xffu << (order[i] * 8)));
+
+    delta = (i - order[i]) * 8;
+    left[i] = _mm_cvtsi32_si128(delta > 0 ? delta : 0);
+    right[i] = _mm_cvtsi32_si128(delta < 0 ? -delta : 0);
+  }
+
+  for (i = 0; i + 4 <= pixels; i += 4) {
+    __m128i in, out;
+
+    in = _mm_loadu_si128((const __m128i*)(src + i * 4));
+    out = _mm_setzero_si128();
+
+    for (int j = 0; j < 4; j++) {
+      __m128i b;
+
+      b = _mm_and_si128(in, masks[j]);
+      b = _mm_srl_epi32(_mm_sll_epi32(b, left[j]), right[j]);
+      out = _mm_or_si128(out, b);
+    }
+
+    _mm_storeu_si128((__m128i*)(dst + i * 4), out);
+  }
+
+  return i;
+}
+
+static inline __m128i smallFrom888SSE2(__m128i px, const __m128i srcShift[3], const __m128i maxes[3],
+                                       const __m128i dstShift[3]) {
+  const __m128i mask = _mm_set1_epi32(0xff);
+  const __m128i round = _mm_set1_epi32(128);
+  const __m128i one = _mm_set1_epi32(1);
+
+  __m128i out;
+
+  out = _mm_setzero_si128();
+
+  for (int c = 0; c < 3; c++) {
+    __m128i v;
+
+    v = _mm_and_si128(_mm_srl_epi32(px, srcShift[c]), mask);
+
+    // (v * max + 128) / 255, with the division done as
+    // (x + 1 + (x >> 8)) >> 8, which is exact for every x here
+    v = _mm_add_epi32(_mm_mullo_epi16(v, maxes[c]), round);
+    v = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(v, one), _mm_srli_epi32(v, 8)), 8);
+
+    out = _mm_or_si128(out, _mm_sll_epi32(v, dstShift[c]));
+  }
+
+  return out;
+}
+
+static int smallFrom888SSE2(uint8_t* dst, const ConvFormat& dstFormat, const uint8_t* src, const uint8_t offsets[3],
+                            int pixels) {
+  __m128i srcShift[3], maxes[3], dstShift[3];
+  int i;
+
+  for (int c = 0; c < 3; c++) {
+    srcShift[c] = _mm_cvtsi32_si128(offsets[c] * 8);
+    maxes[c] = _mm_set1_epi32((1 << dstFormat.bits[c]) - 1);
+    dstShift[c] = _mm_cvtsi32_si128(dstFormat.shift[c]);
+  }
+
+  for (i = 0; i + 8 <= pixels; i += 8) {
+    __m128i lo, hi, out;
+
+    lo = smallFrom888SSE2(_mm_loadu_si128((const __m128i*)(src + i * 4)), srcShift, maxes, dstShift);
+    hi = smallFrom888SSE2(_mm_loadu_si128((const __m128i*)(src + i * 4 + 16)), srcShift, maxes, dstShift);
+
+    // Sign extend so that the saturation doesn't touch 16 bit values
+    lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+    hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+    out = _mm_packs_epi32(lo, hi);
+
+    if (dstFormat.bpp == 16) {
+      if (dstFormat.swap)
+        out = _mm_or_si128(_mm_slli_epi16(out, 8), _mm_srli_epi16(out, 8));
+      _mm_storeu_si128((__m128i*)(dst + i * 2), out);
+    } else {
+      _mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(out, out));
+    }
+  }
+
+  return i;
+}
+
+static inline __m128i x888FromSmallSSE2(__m128i px, const __m128i srcShift[3], const __m128i maxes[3],
+                                        const __m128i pre[3], const __m128i factors[3], const __m128i dstShift[3]) {
+  __m128i out;
+
+  out = _mm_setzero_si128();
+
+  for (int c = 0; c < 3; c++) {
+    __m128i v;
+
+    v = _mm_and_si128(_mm_srl_epi32(px, srcShift[c]), maxes[c]);
+    v = _mm_mulhi_epu16(_mm_sll_epi32(v, pre[c]), factors[c]);
+
+    out = _mm_or_si128(out, _mm_sll_epi32(v, dstShift[c]));
+  }
+
+  return out;
+}
+
+static int x888FromSmallSSE2(uint8_t* dst, const uint8_t offsets[3], const uint8_t* src, const ConvFormat& srcFormat,
+                             int pixels) {
+  const __m128i zero = _mm_setzero_si128();
+
+  __m128i srcShift[3], maxes[3], pre[3], factors[3], dstShift[3];
+  int i;
+
+  for (int c = 0; c < 3; c++) {
+    srcShift[c] = _mm_cvtsi32_si128(srcFormat.shift[c]);
+    maxes[c] = _mm_set1_epi32((1 << srcFormat.bits[c]) - 1);
+    pre[c] = _mm_cvtsi32_si128(9 - srcFormat.bits[c]);
+    factors[c] = _mm_set1_epi32(upFactors[srcFormat.bits[c] - 1]);
+    dstShift[c] = _mm_cvtsi32_si128(offsets[c] * 8);
+  }
+
+  for (i = 0; i + 8 <= pixels; i += 8) {
+    __m128i in;
+
+    if (srcFormat.bpp == 16) {
+      in = _mm_loadu_si128((const __m128i*)(src + i * 2));
+      if (srcFormat.swap)
+        in = _mm_or_si128(_mm_slli_epi16(in, 8), _mm_srli_epi16(in, 8));
+    } else {
+      in = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + i)), zero);
+    }
+
+    _mm_storeu_si128((__m128i*)(dst + i * 4),
+                     x888FromSmallSSE2(_mm_unpacklo_epi16(in, zero), srcShift, maxes, pre, factors, dstShift));
+    _mm_storeu_si128((__m128i*)(dst + i * 4 + 16),
+                     x888FromSmallSSE2(_mm_unpackhi_epi16(in, zero), srcShift, maxes, pre, factors, dstShift));
+  }
+
+  return i;
+}
+
+TARGET_AVX2 static int swizzle888AVX2(uint8_t* dst, const uint8_t* src, int pixels, const uint8_t order[4]) {
+  uint8_t shuffle[32];
+  __m256i mask;
+  int i;
+
+  // The shuffle works within each 16 byte half
+  for (i = 0; i < 32; i++)
+    shuffle[i] = (i % 16) / 4 * 4 + order[i % 4];
+  mask = _mm256_loadu_si256((const __m256i*)shuffle);
+
+  for (i = 0; i + 8 <= pixels; i += 8) {
+    __m256i in;
+
+    in = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+    _mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_shuffle_epi8(in, mask));
+  }
+
+  return i;
+}
+
+TARGET_AVX2 static int rgbFrom888AVX2(uint8_t* rgb, const uint8_t* src, int pixels, const uint8_t offsets[3]) {
+  uint8_t shuffle[32];
+  __m256i mask, pack;
+  int i;
+
+  // Each half packs its four pixels in to its first 12 bytes, and
+  // then the two halves are moved together
+  for (i = 0; i < 32; i++) {
+    if (i % 16 < 12)
+      shuffle[i] = (i % 16) / 3 * 4 + offsets[(i % 16) % 3];
+    else
+      shuffle[i] = 0x80;
+  }
+  mask = _mm256_loadu_si256((const __m256i*)shuffle);
+  pack = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+
+  for (i = 0; i + 8 <= pixels; i += 8) {
+    __m256i v;
+
+    v = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+    v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, mask), pack);
+
+    _mm_storeu_si128((__m128i*)(rgb + i * 3), _mm256_castsi256_si128(v));
+    _mm_storel_epi64((__m128i*)(rgb + i * 3 + 16), _mm256_extracti128_si256(v, 1));
+  }
+
+  return i;
+}
+
+TARGET_AVX2 static int x888FromRGBAVX2(uint8_t* dst, const uint8_t* rgb, int pixels, const uint8_t offsets[3]) {
+  uint8_t shuffle[32];
+  __m256i mask;
+  int i;
+
+  // The second half is loaded from byte 8, so that nothing past the
+  // 24 bytes of input is read, which puts its pixels at byte 4
+  for (i = 0; i < 32; i++)
+    shuffle[i] = 0x80;
+  for (i = 0; i < 8; i++) {
+    for (int c = 0; c < 3; c++)
+      shuffle[i * 4 + offsets[c]] = (i < 4 ? 0 : 4) + (i % 4) * 3 + c;
+  }
+  mask = _mm256_loadu_si256((const __m256i*)shuffle);
+
+  for (i = 0; i + 8 <= pixels; i += 8) {
+    __m128i lo, hi;
+    __m256i v;
+
+    lo = _mm_loadu_si128((const __m128i*)(rgb + i * 3));
+    hi = _mm_loadu_si128((const __m128i*)(rgb + i * 3 + 8));
+    v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+    _mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_shuffle_epi8(v, mask));
+  }
+
+  return i;
+}
+
+TARGET_AVX2 static inline __m256i smallFrom888AVX2(__m256i px, const __m128i srcShift[3], const __m256i maxes[3],
+                                                   const __m128i dstShift[3]) {
+  const __m256i mask = _mm256_set1_epi32(0xff);
+  const __m256i round = _mm256_set1_epi32(128);
+  const __m256i one = _mm256_set1_epi32(1);
+
+  __m256i out;
+
+  out = _mm256_setzero_si256();
+
+  for (int c = 0; c < 3; c++) {
+    __m256i v;
+
+    v = _mm256_and_si256(_mm256_srl_epi32(px, srcShift[c]), mask);
+
+    v = _mm256_add_epi32(_mm256_mullo_epi16(v, maxes[c]), round);
+    v = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(v, one), _mm256_srli_epi32(v, 8)), 8);
+
+    out = _mm256_or_si256(out, _mm256_sll_epi32(v, dstShift[c]));
+  }
+
+  return out;
+}
+
+TARGET_AVX2 static int smallFrom888AVX2(uint8_t* dst, const ConvFormat& dstFormat, const uint8_t* src,
+                                        const uint8_t offsets[3], int pixels) {
+  __m128i srcShift[3], dstShift[3];
+  __m256i maxes[3];
+  int i;
+
+  for (int c = 0; c < 3; c++) {
+    srcShift[c] = _mm_cvtsi32_si128(offsets[c] * 8);
+    maxes[c] = _mm256_set1_epi32((1 << dstFormat.bits[c]) - 1);
+    dstShift[c] = _mm_cvtsi32_si128(dstFormat.shift[c]);
+  }
+
+  for (i = 0; i + 16 <= pixels; i += 16) {
+    __m256i lo, hi, out;
+
+    lo = smallFrom888AVX2(_mm256_loadu_si256((const __m256i*)(src + i * 4)), srcShift, maxes, dstShift);
+    hi = smallFrom888AVX2(_mm256_loadu_si256((const __m256i*)(src + i * 4 + 32)), srcShift, maxes, dstShift);
+
+    lo = _mm256_srai_epi32(_mm256_slli_epi32(lo, 16), 16);
+    hi = _mm256_srai_epi32(_mm256_slli_epi32(hi, 16), 16);
+
+    // Packing works within each half, so the middle needs swapping
+    out = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xd8);
+
+    if (dstFormat.bpp == 16) {
+      if (dstFormat.swap)
+        out = _mm256_or_si256(_mm256_slli_epi16(out, 8), _mm256_srli_epi16(out, 8));
+      _mm256_storeu_si256((__m256i*)(dst + i * 2), out);
+    } else {
+      _mm_storeu_si128((__m128i*)(dst + i),
+                       _mm_packus_epi16(_mm256_castsi256_si128(out), _mm256_extracti128_si256(out, 1)));
+    }
+  }
+
+  return i;
+}
+
+TARGET_AVX2 static inline __m256i x888FromSmallAVX2(__m256i px, const __m128i srcShift[3], const __m256i maxes[3],
+                                                    const __m128i pre[3], const __m256i factors[3],
+                                                    const __m128i dstShift[3]) {
+  __m256i out;
+
+  out = _mm256_setzero_si256();
+
+  for (int c = 0; c < 3; c++) {
+    __m256i v;
+
+    v = _mm256_and_si256(_mm256_srl_epi32(px, srcShift[c]), maxes[c]);
+    v = _mm256_mulhi_epu16(_mm256_sll_epi32(v, pre[c]), factors[c]);
+
+    out = _mm256_or_si256(out, _mm256_sll_epi32(v, dstShift[c]));
+  }
+
+  return out;
+}
+
+TARGET_AVX2 static int x888FromSmallAVX2(uint8_t* dst, const uint8_t offsets[3], const uint8_t* src,
+                                         const ConvFormat& srcFormat, int pixels) {
+  __m128i srcShift[3], pre[3], dstShift[3];
+  __m256i maxes[3], factors[3];
+  int i;
+
+  for (int c = 0; c < 3; c++) {
+    srcShift[c] = _mm_cvtsi32_si128(srcFormat.shift[c]);
+    maxes[c] = _mm256_set1_epi32((1 << srcFormat.bits[c]) - 1);
+    pre[c] = _mm_cvtsi32_si128(9 - srcFormat.bits[c]);
+    factors[c] = _mm256_set1_epi32(upFactors[srcFormat.bits[c] - 1]);
+    dstShift[c] = _mm_cvtsi32_si128(offsets[c] * 8);
+  }
+
+  for (i = 0; i + 16 <= pixels; i += 16) {
+    __m256i lo, hi;
+
+    if (srcFormat.bpp == 16) {
+      __m256i in;
+
+      in = _mm256_loadu_si256((const __m256i*)(src + i * 2));
+      if (srcFormat.swap)
+        in = _mm256_or_si256(_mm256_slli_epi16(in, 8), _mm256_srli_epi16(in, 8));
+
+      lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(in));
+      hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(in, 1));
+    } else {
+      __m128i in;
+
+      in = _mm_loadu_si128((const __m128i*)(src + i));
+
+      lo = _mm256_cvtepu8_epi32(in);
+      hi = _mm256_cvtepu8_epi32(_mm_srli_si128(in, 8));
+    }
+
+    _mm256_storeu_si256((__m256i*)(dst + i * 4),
+                        x888FromSmallAVX2(lo, srcShift, maxes, pre, factors, dstShift));
+    _mm256_storeu_si256((__m256i*)(dst + i * 4 + 32),
+                        x888FromSmallAVX2(hi, srcShift, maxes, pre, factors, dstShift));
+  }
+
+  return i;
+}
+
+#elif defined(CONV_NEON)
+
+static int swizzle888NEON(uint8_t* dst, const uint8_t* src, int pixels, const uint8_t order[4]) {
+  uint8_t shuffle[16];
+  uint8x16_t table;
+  int i;
+
+  for (i = 0; i < 16; i++)
+    shuffle[i] = i / 4 * 4 + order[i % 4];
+  table = vld1q_u8(shuffle);
+
+  for (i = 0; i + 4 <= pixels; i += 4)
+    vst1q_u8(dst + i * 4, vqtbl1q_u8(vld1q_u8(src + i * 4), table));
+
+  return i;
+}
+
+static int rgbFrom888NEON(uint8_t* rgb, const uint8_t* src, int pixels, const uint8_t offsets[3]) {
+  int i;
+
+  for (i = 0; i + 16 <= pixels; i += 16) {
+    uint8x16x4_t in;
+    uint8x16x3_t out;
+
+    in = vld4q_u8(src + i * 4);
+    for (int c = 0; c < 3; c++)
+      out.val[c] = in.val[offsets[c]];
+    vst3q_u8(rgb + i * 3, out);
+  }
+
+  return i;
+}
+
+static int x888FromRGBNEON(uint8_t* dst, const uint8_t* rgb, int pixels, const uint8_t offsets[3]) {
+  int i;
+
+  for (i = 0; i + 16 <= pixels; i += 16) {
+    uint8x16x3_t in;
+    uint8x16x4_t out;
+
+    in = vld3q_u8(rgb + i * 3);
+    for (int c = 0; c < 4; c++)
+      out.val[c] = vdupq_n_u8(0);
+    for (int c = 0; c < 3; c++)
+      out.val[offsets[c]] = in.val[c];
+    vst4q_u8(dst + i * 4, out);
+  }
+
+  return i;
+}
+
+static inline uint16x8_t smallFrom888NEON(uint8x8_t v, uint8x8_t max, int16x8_t shift) {
+  uint16x8_t x;
+
+  // (v * max + 128) / 255, like on x86
+  x = vaddq_u16(vmull_u8(v, max), vdupq_n_u16(128));
+  x = vshrq_n_u16(vaddq_u16(vaddq_u16(x, vdupq_n_u16(1)), vshrq_n_u16(x, 8)), 8);
+
+  return vshlq_u16(x, shift);
+}
+
+static int smallFrom888NEON(uint8_t* dst, const ConvFormat& dstFormat, const uint8_t* src, const uint8_t offsets[3],
+                            int pixels) {
+  uint8x8_t maxes[3];
+  int16x8_t shifts[3];
+  int i;
+
+  for (int c = 0; c < 3; c++) {
+    maxes[c] = vdup_n_u8((1 << dstFormat.bits[c]) - 1);
+    shifts[c] = vdupq_n_s16(dstFormat.shift[c]);
+  }
+
+  for (i = 0; i + 16 <= pixels; i += 16) {
+    uint8x16x4_t in;
+    uint16x8_t lo, hi;
+
+    in = vld4q_u8(src + i * 4);
+
+    lo = hi = vdupq_n_u16(0);
+    for (int c = 0; c < 3; c++) {
+      lo = vorrq_u16(lo, smallFrom888NEON(vget_low_u8(in.val[offsets[c]]), maxes[c], shifts[c]));
+      hi = vorrq_u16(hi, smallFrom888NEON(vget_high_u8(in.val[offsets[c]]), maxes[c], shifts[c]));
+    }
+
+    if (dstFormat.bpp == 16) {
+      uint8x16_t lo8, hi8;
+
+      lo8 = vreinterpretq_u8_u16(lo);
+      hi8 = vreinterpretq_u8_u16(hi);
+      if (dstFormat.swap) {
+        lo8 = vrev16q_u8(lo8);
+        hi8 = vrev16q_u8(hi8);
+      }
+
+      vst1q_u8(dst + i * 2, lo8);
+      vst1q_u8(dst + i * 2 + 16, hi8);
+    } else {
+      vst1q_u8(dst + i, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+    }
+  }
+
+  return i;
+}
+
+static inline uint8x8_t x888FromSmallNEON(uint16x8_t px, int16x8_t shift, uint16x8_t max, int16x8_t pre,
+                                          uint16x4_t factor) {
+  uint16x8_t v;
+  uint16x4_t lo, hi;
+
+  v = vandq_u16(vshlq_u16(px, shift), max);
+  v = vshlq_u16(v, pre);
+
+  // v * 255 / max, like on x86
+  lo = vshrn_n_u32(vmull_u16(vget_low_u16(v), factor), 16);
+  hi = vshrn_n_u32(vmull_u16(vget_high_u16(v), factor), 16);
+
+  return vmovn_u16(vcombine_u16(lo, hi));
+}
+
+static int x888FromSmallNEON(uint8_t* dst, const uint8_t offsets[3], const uint8_t* src, const ConvFormat& srcFormat,
+                             int pixels) {
+  int16x8_t shifts[3], pre[3];
+  uint16x8_t maxes[3];
+  uint16x4_t factors[3];
+  int i;
+
+  for (int c = 0; c < 3; c++) {
+    // Negative shifts go right
+    shifts[c] = vdupq_n_s16(-srcFormat.shift[c]);
+    maxes[c] = vdupq_n_u16((1 << srcFormat.bits[c]) - 1);
+    pre[c] = vdupq_n_s16(9 - srcFormat.bits[c]);
+    factors[c] = vdup_n_u16(upFactors[srcFormat.bits[c] - 1]);
+  }
+
+  for (i = 0; i + 8 <= pixels; i += 8) {
+    uint16x8_t in;
+    uint8x8x4_t out;
+
+    if (srcFormat.bpp == 16) {
+      uint8x16_t in8;
+
+      in8 = vld1q_u8(src + i * 2);
+      if (srcFormat.swap)
+        in8 = vrev16q_u8(in8);
+      in = vreinterpretq_u16_u8(in8);
+    } else {
+      in = vmovl_u8(vld1_u8(src + i));
+    }
+
+    for (int c = 0; c < 4; c++)
+      out.val[c] = vdup_n_u8(0);
+    for (int c = 0; c < 3; c++)
+      out.val[offsets[c]] = x888FromSmallNEON(in, shifts[c], maxes[c], pre[c], factors[c]);
+    vst4_u8(dst + i * 4, out);
+  }
+
+  return i;
+}
+
+#endif
+
+int rfb::convSwizzle888(uint8_t* dst, const uint8_t* src, int pixels, const uint8_t order[4]) {
+  switch (activeKernels) {
+#if defined(CONV_X86)
+  case convAVX2:
+    return swizzle888AVX2(dst, src, pixels, order);
+  case convSSE2:
+    return swizzle888SSE2(dst, src, pixels, order);
+#elif defined(CONV_NEON)
+  case convNEON:
+    return swizzle888NEON(dst, src, pixels, order);
+#endif
+  default:
+    return 0;
+  }
+}
+
+int rfb::convRGBFrom888(uint8_t* rgb, const uint8_t* src, int pixels, const uint8_t offsets[3]) {
+  switch (activeKernels) {
+#if defined(CONV_X86)
+  // Not worth it without a byte shuffle, so no SSE2
+  case convAVX2:
+    return rgbFrom888AVX2(rgb, src, pixels, offsets);
+#elif defined(CONV_NEON)
+  case convNEON:
+    return rgbFrom888NEON(rgb, src, pixels, offsets);
+#endif
+  default:
+    return 0;
+  }
+}
+
+int rfb::conv888FromRGB(uint8_t* dst, const uint8_t* rgb, int pixels, const uint8_t offsets[3]) {
+  switch (activeKernels) {
+#if defined(CONV_X86)
+  case convAVX2:
+    return x888FromRGBAVX2(dst, rgb, pixels, offsets);
+#elif defined(CONV_NEON)
+  case convNEON:
+    return x888FromRGBNEON(dst, rgb, pixels, offsets);
+#endif
+  default:
+    return 0;
+  }
+}
+
+int rfb::convSmallFrom888(uint8_t* dst, const ConvFormat& dstFormat, const uint8_t* src, const uint8_t offsets[3],
+                          int pixels) {
+  switch (activeKernels) {
+#if defined(CONV_X86)
+  case convAVX2:
+    return smallFrom888AVX2(dst, dstFormat, src, offsets, pixels);
+  case convSSE2:
+    return smallFrom888SSE2(dst, dstFormat, src, offsets, pixels);
+#elif defined(CONV_NEON)
+  case convNEON:
+    return smallFrom888NEON(dst, dstFormat, src, offsets, pixels);
+#endif
+  default:
+    return 0;
+  }
+}
+
+int rfb::conv888FromSmall(uint8_t* dst, const uint8_t offsets[3], const uint8_t* src, const ConvFormat& srcFormat,
+                          int pixels) {
+  switch (activeKernels) {
+#if defined(CONV_X86)
+  case convAVX2:
+    return x888FromSmallAVX2(dst, offsets, src, srcFormat, pixels);
+  case convSSE2:
+    return x888FromSmallSSE2(dst, offsets, src, srcFormat, pixels);
+#elif defined(CONV_NEON)
+  case convNEON:
+    return x888FromSmallNEON(dst, offsets, src, srcFormat, pixels);
+#endif
+  default:
+    return 0;
+  }
+}
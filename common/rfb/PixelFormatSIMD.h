@@ -0,0 +1,80 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// PixelFormatSIMD - vectorised kernels for the common cases of the
+// PixelFormat conversions. The kernels work on a single row, convert
+// as many pixels as they can, and return that count, leaving the
+// rest of the row for the scalar code. They are only used internally
+// by PixelFormat, apart from the functions to pick the instruction
+// set that tests and benchmarks use.
+//
+
+#ifndef __RFB_PIXELFORMATSIMD_H__
+#define __RFB_PIXELFORMATSIMD_H__
+
+#include <stdint.h>
+
+namespace rfb {
+
+enum ConvKernels {
+  convScalar,
+  convSSE2,
+  convAVX2,
+  convNEON,
+};
+
+// The best instruction set this CPU supports, which is also what is
+// used unless something else is set
+ConvKernels convBestKernels();
+bool convKernelsSupported(ConvKernels kernels);
+const char* convKernelsName(ConvKernels kernels);
+
+ConvKernels convActiveKernels();
+// Returns false, and changes nothing, if the CPU lacks support
+bool setConvKernels(ConvKernels kernels);
+
+// An 8 or 16 bit true colour format
+struct ConvFormat {
+  int bpp;
+  // Pixels are stored in the other byte order than the host's
+  bool swap;
+  int shift[3];
+  int bits[3];
+};
+
+// Between two 888 formats, where destination byte i of every pixel is
+// source byte order[i]
+int convSwizzle888(uint8_t* dst, const uint8_t* src, int pixels, const uint8_t order[4]);
+
+// Between an 888 format and packed RGB, where offsets are the bytes
+// holding red, green and blue in the 888 format. The fourth byte is
+// cleared when writing 888 pixels.
+int convRGBFrom888(uint8_t* rgb, const uint8_t* src, int pixels, const uint8_t offsets[3]);
+int conv888FromRGB(uint8_t* dst, const uint8_t* rgb, int pixels, const uint8_t offsets[3]);
+
+// Between an 888 format and an 8 or 16 bit format, rounding like
+// PixelFormat's lookup tables do
+int convSmallFrom888(uint8_t* dst, const ConvFormat& dstFormat, const uint8_t* src, const uint8_t offsets[3],
+                     int pixels);
+int conv888FromSmall(uint8_t* dst, const uint8_t offsets[3], const uint8_t* src, const ConvFormat& srcFormat,
+                     int pixels);
+
+} // namespace rfb
+
+#endif
@@ -31,7 +31,7 @@
 
 using namespace rfb;
 
-RREEncoder::RREEncoder(SConnection* conn_) : Encoder(conn_, encodingRRE, EncoderPlain) {}
+RREEncoder::RREEncoder(SConnection* conn_) : Encoder(conn_, encodingRRE, EncoderStateless) {}
 
 RREEncoder::~RREEncoder() {}
 
@@ -84,7 +84,7 @@ void RREEncoder::writeRect(const PixelBuffer* pb, const Palette& palette) {
 
   bufferCopy.commitBufferRW(pb->getRect());
 
-  rdr::OutStream* os = conn->getOutStream();
+  rdr::OutStream* os = getOutStream();
   os->writeU32(nSubrects);
   os->writeBytes(mos.data(), mos.length());
   mos.clear();
@@ -93,7 +93,7 @@ void RREEncoder::writeRect(const PixelBuffer* pb, const Palette& palette) {
 void RREEncoder::writeSolidRect(int /*width*/, int /*height*/, const PixelFormat& pf, const uint8_t* colour) {
   rdr::OutStream* os;
 
-  os = conn->getOutStream();
+  os = getOutStream();
 
   os->writeU32(0);
   os->writeBytes(colour, pf.bpp / 8);
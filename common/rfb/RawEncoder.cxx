@@ -29,7 +29,7 @@
 
 using namespace rfb;
 
-RawEncoder::RawEncoder(SConnection* conn_) : Encoder(conn_, encodingRaw, EncoderPlain) {}
+RawEncoder::RawEncoder(SConnection* conn_) : Encoder(conn_, encodingRaw, EncoderStateless) {}
 
 RawEncoder::~RawEncoder() {}
 
@@ -47,7 +47,7 @@ void RawEncoder::writeRect(const PixelBuffer* pb, const Palette& /*palette*/) {
 
   buffer = pb->getBuffer(pb->getRect(), &stride);
 
-  os = conn->getOutStream();
+  os = getOutStream();
 
   h = pb->height();
   line_bytes = pb->width() * pb->getPF().bpp / 8;
@@ -62,7 +62,7 @@ void RawEncoder::writeSolidRect(int width, int height, const PixelFormat& pf, co
   rdr::OutStream* os;
   int pixels, pixel_size;
 
-  os = conn->getOutStream();
+  os = getOutStream();
 
   pixels = width * height;
   pixel_size = pf.bpp / 8;
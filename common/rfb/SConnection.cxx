@@ -533,6 +533,11 @@ void SConnection::handlePersistentHashList(uint32_t /*sequenceId*/, uint16_t /*t
   // Default no-op: servers that implement PersistentCache override this.
 }
 
+void SConnection::handlePersistentIdList(uint8_t /*flags*/, uint64_t /*baseToken*/, uint16_t /*totalChunks*/,
+                                         uint16_t /*chunkIndex*/, const std::vector<uint64_t>& /*cacheIds*/) {
+  // Default no-op: servers that implement PersistentCache override this.
+}
+
 void SConnection::supportsLocalCursor() {}
 
 void SConnection::supportsFence() {}
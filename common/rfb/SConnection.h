@@ -179,6 +179,12 @@ public:
   }
   virtual void cacheLossyHash(uint64_t /*canonical*/, const CacheKey& /*lossyKey*/) {}
 
+  // Current estimate of the connection's bandwidth in bytes per
+  // second, or 0 if unknown (default)
+  virtual size_t getBandwidthEstimate() {
+    return 0;
+  }
+
 protected:
   // Overridden from SMsgHandler
 
@@ -196,6 +202,8 @@ protected:
   void handlePersistentCacheQuery(const std::vector<uint64_t>& cacheIds) override;
   void handlePersistentHashList(uint32_t sequenceId, uint16_t totalChunks, uint16_t chunkIndex,
                                 const std::vector<uint64_t>& cacheIds) override;
+  void handlePersistentIdList(uint8_t flags, uint64_t baseToken, uint16_t totalChunks, uint16_t chunkIndex,
+                              const std::vector<uint64_t>& cacheIds) override;
   void handlePersistentCacheEviction(const std::vector<uint64_t>& cacheIds) override;
 
   // Methods to be overridden in a derived class
@@ -63,6 +63,10 @@ public:
   virtual void handlePersistentCacheQuery(const std::vector<uint64_t>& cacheIds) = 0;
   virtual void handlePersistentHashList(uint32_t sequenceId, uint16_t totalChunks, uint16_t chunkIndex,
                                         const std::vector<uint64_t>& cacheIds) = 0;
+  // Compressed ID list, either the client's full set or the changes
+  // since baseToken (see idListFlagDelta)
+  virtual void handlePersistentIdList(uint8_t flags, uint64_t baseToken, uint16_t totalChunks, uint16_t chunkIndex,
+                                      const std::vector<uint64_t>& cacheIds) = 0;
   virtual void handlePersistentCacheEviction(const std::vector<uint64_t>& cacheIds) = 0;
   virtual void handlePersistentCacheHashReport(const CacheKey& canonicalKey, const CacheKey& actualKey) = 0;
 
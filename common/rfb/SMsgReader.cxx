@@ -42,6 +42,7 @@
 #include <rfb/clipboardTypes.h>
 #include <rfb/msgTypes.h>
 #include <rfb/qemuTypes.h>
+#include <rfb/cache/IdListCodec.h>
 
 using namespace rfb;
 
@@ -126,6 +127,9 @@ bool SMsgReader::readMsg() {
   case msgTypePersistentCacheHashList:
     ret = readPersistentHashList();
     break;
+  case msgTypePersistentCacheIdList:
+    ret = readPersistentIdList();
+    break;
   case msgTypePersistentCacheEviction:
     ret = readPersistentCacheEviction();
     break;
@@ -581,6 +585,49 @@ bool SMsgReader::readPersistentHashList() {
   return true;
 }
 
+bool SMsgReader::readPersistentIdList() {
+  uint8_t flags, riceBits;
+  uint16_t totalChunks, chunkIndex;
+  uint64_t baseToken;
+  uint32_t count, length;
+  std::vector<uint8_t> data;
+  std::vector<uint64_t> cacheIds;
+
+  if (!is->hasData(1 + 1 + 2 + 2 + 8 + 4 + 4))
+    return false;
+
+  is->setRestorePoint();
+
+  flags = is->readU8();
+  riceBits = is->readU8();
+  totalChunks = is->readU16();
+  chunkIndex = is->readU16();
+  baseToken = (uint64_t)is->readU32() << 32;
+  baseToken |= is->readU32();
+  count = is->readU32();
+  length = is->readU32();
+
+  if ((count > 65536) || (length > cache::maxIdListLength(count)))
+    throw protocol_error("Invalid PersistentCache ID list size");
+  if (chunkIndex >= totalChunks)
+    throw protocol_error("Invalid PersistentCache ID list chunk");
+
+  if (!is->hasDataOrRestore(length))
+    return false;
+  is->clearRestorePoint();
+
+  data.resize(length);
+  is->readBytes(data.data(), length);
+
+  if (!cache::decodeIdList(data.data(), length, count, riceBits, &cacheIds))
+    throw protocol_error("Invalid PersistentCache ID list data");
+
+  vlog.debug("Client sent %u persistent cache IDs in %u bytes (chunk %d/%d, flags 0x%x)", count, length,
+             chunkIndex + 1, totalChunks, flags);
+  handler->handlePersistentIdList(flags, baseToken, totalChunks, chunkIndex, cacheIds);
+  return true;
+}
+
 bool SMsgReader::readPersistentCacheEviction() {
   if (!is->hasData(1 + 2))
     return false;
@@ -63,6 +63,7 @@ protected:
   bool readExtendedClipboard(int32_t len);
   bool readPersistentCacheQuery();
   bool readPersistentHashList();
+  bool readPersistentIdList();
   bool readPersistentCacheEviction();
   bool readPersistentCacheHashReport();
   bool readDebugDumpRequest();
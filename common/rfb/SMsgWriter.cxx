@@ -36,6 +36,7 @@
 #include <rfb/Encoder.h>
 #include <rfb/SMsgWriter.h>
 #include <rfb/ScreenSet.h>
+#include <rfb/SharedPixelBuffer.h>
 #include <rfb/UpdateTracker.h>
 #include <rfb/clipboardTypes.h>
 #include <rfb/encodings.h>
@@ -49,7 +50,8 @@ static core::LogWriter vlog("SMsgWriter");
 
 SMsgWriter::SMsgWriter(ClientParams* client_, rdr::OutStream* os_)
     : client(client_), os(os_), nRectsInUpdate(0), nRectsInHeader(0), needSetDesktopName(false), needCursor(false),
-      needCursorPos(false), needLEDState(false), needQEMUKeyEvent(false), needExtMouseButtonsEvent(false) {}
+      needCursorPos(false), needLEDState(false), needQEMUKeyEvent(false), needExtMouseButtonsEvent(false),
+      needCacheEpoch(false), cacheEpoch(0) {}
 
 SMsgWriter::~SMsgWriter() {}
 
@@ -275,6 +277,76 @@ void SMsgWriter::writeCachedRectSeed(const core::Rect& r, const CacheKey& key) {
   endRect();
 }
 
+void SMsgWriter::writePersistentCachedRectDelta(const core::Rect& r, const CacheKey& baseKey, const CacheKey& newKey,
+                                                const uint8_t* data, size_t length) {
+  // Server → client: new content as a residual against a cached entry.
+  // Wire format: rect header + 16-byte base CacheKey + 16-byte new
+  // CacheKey + U32 length + residual
+  if (!client->supportsEncoding(encodingPersistentCachedRectDelta))
+    throw std::logic_error("Client does not support cache deltas");
+
+  startRect(r, encodingPersistentCachedRectDelta);
+  os->writeBytes(baseKey.bytes.data(), 16);
+  os->writeBytes(newKey.bytes.data(), 16);
+  os->writeU32(length);
+  os->writeBytes(data, length);
+  endRect();
+}
+
+void SMsgWriter::writeGlyphRect(const core::Rect& r, uint8_t flags, uint8_t cellW, uint8_t cellH, uint8_t ox,
+                                uint8_t oy, const uint8_t* data, size_t length) {
+  // Wire format: rect header + U8 flags + U8 cellW + U8 cellH + U8 ox +
+  // U8 oy + U32 length + zlib data
+  if (!client->supportsEncoding(encodingGlyphRect))
+    throw std::logic_error("Client does not support glyph rects");
+
+  startRect(r, encodingGlyphRect);
+  os->writeU8(flags);
+  os->writeU8(cellW);
+  os->writeU8(cellH);
+  os->writeU8(ox);
+  os->writeU8(oy);
+  os->writeU32(length);
+  os->writeBytes(data, length);
+  endRect();
+}
+
+void SMsgWriter::writeLossyRefinement(const core::Rect& r, uint64_t baseHash, const uint8_t* data, size_t length) {
+  // Wire format: rect header + U64 base hash + U32 length + zlib data
+  if (!client->supportsEncoding(encodingLossyRefinement))
+    throw std::logic_error("Client does not support lossy refinement");
+
+  startRect(r, encodingLossyRefinement);
+  os->writeU32(baseHash >> 32);
+  os->writeU32(baseHash & 0xffffffff);
+  os->writeU32(length);
+  os->writeBytes(data, length);
+  endRect();
+}
+
+void SMsgWriter::writeSharedMemorySetup(uint32_t generation, const SharedPixelBuffer* pb) {
+  // Wire format: rect header + U32 generation + U32 stride +
+  // PIXEL_FORMAT, with the file descriptor alongside
+  if (!client->supportsEncoding(pseudoEncodingSharedMemory))
+    throw std::logic_error("Client does not support shared memory");
+
+  startRect(pb->getRect(), pseudoEncodingSharedMemory);
+  os->writeU32(generation);
+  os->writeU32(pb->getStride());
+  pb->getPF().write(os);
+  endRect();
+}
+
+void SMsgWriter::writeSharedMemoryRect(const core::Rect& r, uint32_t generation) {
+  // Wire format: rect header + U32 generation
+  if (!client->supportsEncoding(pseudoEncodingSharedMemory))
+    throw std::logic_error("Client does not support shared memory");
+
+  startRect(r, encodingSharedMemory);
+  os->writeU32(generation);
+  endRect();
+}
+
 void SMsgWriter::writeDesktopSize(uint16_t reason, uint16_t result) {
   ExtendedDesktopSizeMsg msg;
 
@@ -333,6 +405,14 @@ void SMsgWriter::writeExtendedMouseButtonsSupport() {
   needExtMouseButtonsEvent = true;
 }
 
+void SMsgWriter::writePersistentCacheEpoch(uint64_t token) {
+  if (!client->supportsEncoding(pseudoEncodingPersistentCacheEpoch))
+    throw std::logic_error("Client does not support PersistentCache epochs");
+
+  needCacheEpoch = true;
+  cacheEpoch = token;
+}
+
 bool SMsgWriter::needFakeUpdate() {
   if (needSetDesktopName)
     return true;
@@ -346,6 +426,8 @@ bool SMsgWriter::needFakeUpdate() {
     return true;
   if (needExtMouseButtonsEvent)
     return true;
+  if (needCacheEpoch)
+    return true;
   if (needNoDataUpdate())
     return true;
 
@@ -393,6 +475,8 @@ void SMsgWriter::writeFramebufferUpdateStart(int nRects) {
       nRects++;
     if (needExtMouseButtonsEvent)
       nRects++;
+    if (needCacheEpoch)
+      nRects++;
   }
 
   os->writeU16(nRects);
@@ -525,6 +609,11 @@ void SMsgWriter::writePseudoRects() {
     writeExtendedMouseButtonsRect();
     needExtMouseButtonsEvent = false;
   }
+
+  if (needCacheEpoch) {
+    writePersistentCacheEpochRect(cacheEpoch);
+    needCacheEpoch = false;
+  }
 }
 
 void SMsgWriter::writeNoDataRects() {
@@ -745,3 +834,18 @@ void SMsgWriter::writeExtendedMouseButtonsRect() {
   os->writeU16(0);
   os->writeU32(pseudoEncodingExtendedMouseButtons);
 }
+
+void SMsgWriter::writePersistentCacheEpochRect(uint64_t token) {
+  if (!client->supportsEncoding(pseudoEncodingPersistentCacheEpoch))
+    throw std::logic_error("Client does not support PersistentCache epochs");
+  if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
+    throw std::logic_error("SMsgWriter::writePersistentCacheEpochRect: nRects out of sync");
+
+  os->writeS16(0);
+  os->writeS16(0);
+  os->writeU16(0);
+  os->writeU16(0);
+  os->writeU32(pseudoEncodingPersistentCacheEpoch);
+  os->writeU32(token >> 32);
+  os->writeU32(token);
+}
@@ -40,6 +40,7 @@ namespace rfb {
 
 class ClientParams;
 class PixelFormat;
+class SharedPixelBuffer;
 struct ScreenSet;
 
 class SMsgWriter {
@@ -47,6 +48,12 @@ public:
   SMsgWriter(ClientParams* client, rdr::OutStream* os);
   virtual ~SMsgWriter();
 
+  // setOutStream() redirects everything written from now on, e.g. to
+  // collect an update in memory before it is put on the connection
+  void setOutStream(rdr::OutStream* os_) {
+    os = os_;
+  }
+
   // writeServerInit() must only be called at the appropriate time in the
   // protocol initialisation.
   void writeServerInit(uint16_t width, uint16_t height, const PixelFormat& pf, const char* name);
@@ -98,6 +105,10 @@ public:
   // let the client know we support extended mouse button support
   void writeExtendedMouseButtonsSupport();
 
+  // Gives the client a token it can later refer to when sending only
+  // the changes to its cache, or 0 if it needs to send everything
+  void writePersistentCacheEpoch(uint64_t token);
+
   // needFakeUpdate() returns true when an immediate update is needed in
   // order to flush out pseudo-rectangles to the client.
   bool needFakeUpdate();
@@ -139,6 +150,26 @@ public:
   // with CacheKey. No pixel payload follows - client uses its own framebuffer.
   void writeCachedRectSeed(const core::Rect& r, const CacheKey& key);
 
+  // Cache delta: new content as a compressed residual against the
+  // client's entry for baseKey, to be stored as newKey
+  void writePersistentCachedRectDelta(const core::Rect& r, const CacheKey& baseKey, const CacheKey& newKey,
+                                      const uint8_t* data, size_t length);
+
+  // Glyph rect: text-like content as indices into the client's glyph
+  // dictionary, see cache/GlyphDictionary.h for the payload
+  void writeGlyphRect(const core::Rect& r, uint8_t flags, uint8_t cellW, uint8_t cellH, uint8_t ox, uint8_t oy,
+                      const uint8_t* data, size_t length);
+
+  // Lossy refinement: the difference between what the client decoded
+  // from a JPEG and the real pixels, see LossyRefinement.h
+  void writeLossyRefinement(const core::Rect& r, uint64_t baseHash, const uint8_t* data, size_t length);
+
+  // Shared memory transport: announces a new buffer, whose file
+  // descriptor must already have been handed to the socket, and then
+  // the parts of it that have changed
+  void writeSharedMemorySetup(uint32_t generation, const SharedPixelBuffer* pb);
+  void writeSharedMemoryRect(const core::Rect& r, uint32_t generation);
+
   // Encoders should call these to mark the start and stop of individual
   // rects.
   void startRect(const core::Rect& r, int enc);
@@ -163,6 +194,7 @@ protected:
   void writeLEDStateRect(uint8_t state);
   void writeQEMUKeyEventRect();
   void writeExtendedMouseButtonsRect();
+  void writePersistentCacheEpochRect(uint64_t token);
 
   ClientParams* client;
   rdr::OutStream* os;
@@ -176,6 +208,9 @@ protected:
   bool needLEDState;
   bool needQEMUKeyEvent;
   bool needExtMouseButtonsEvent;
+  bool needCacheEpoch;
+
+  uint64_t cacheEpoch;
 
   typedef struct {
     uint16_t reason, result;
@@ -165,6 +165,9 @@ bool SSecurityTLS::processMsg() {
 
   vlog.debug("TLS handshake completed with %s", gnutls_session_get_desc(session));
 
+  if (Security::KernelTLS)
+    tlssock->enableKernelTLS();
+
   sc->setStreams(&tlssock->inStream(), &tlssock->outStream());
 
   return true;
@@ -39,6 +39,9 @@ static core::LogWriter vlog("Security");
 core::StringParameter
     Security::GnuTLSPriority("GnuTLSPriority",
                              "GnuTLS priority string that controls the TLS session’s handshake algorithms", "");
+core::BoolParameter Security::KernelTLS("KernelTLS",
+                                        "Let the kernel encrypt and decrypt TLS sessions, if it supports it",
+                                        false);
 #endif
 
 Security::Security() {}
@@ -27,6 +27,7 @@
 #include <list>
 
 namespace core {
+class BoolParameter;
 class EnumListParameter;
 class StringParameter;
 } // namespace core
@@ -114,6 +115,7 @@ public:
 
 #ifdef HAVE_GNUTLS
   static core::StringParameter GnuTLSPriority;
+  static core::BoolParameter KernelTLS;
 #endif
 
 private:
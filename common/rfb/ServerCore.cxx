@@ -47,8 +47,36 @@ core::IntParameter rfb::Server::compareFB("CompareFB",
                                           "Perform pixel comparison on framebuffer to reduce unnecessary updates "
                                           "(0: never, 1: always, 2: auto)",
                                           2, 0, 2);
+core::IntParameter rfb::Server::compareFBThreads("CompareFBThreads",
+                                                 "Number of threads used for framebuffer comparison "
+                                                 "(0: automatic)",
+                                                 0, 0, 64);
+core::IntParameter rfb::Server::encodeThreads("EncodeThreads",
+                                              "Number of threads used to encode the rectangles of each update "
+                                              "(0: automatic)",
+                                              1, 0, 64);
+core::IntParameter rfb::Server::compressThreads("CompressThreads",
+                                                "Number of threads used to deflate large Tight and ZRLE "
+                                                "rectangles (0: automatic)",
+                                                1, 0, 64);
+core::BoolParameter rfb::Server::shareEncodedUpdates("ShareEncodedUpdates",
+                                                     "Encode updates only once for all clients that use the same "
+                                                     "pixel format and encoding settings",
+                                                     true);
+core::BoolParameter rfb::Server::clientThreads("ClientThreads",
+                                               "Encode the updates of each client on a thread of its own, so that "
+                                               "slow clients do not hold up the rest of the server",
+                                               false);
 core::IntParameter rfb::Server::frameRate("FrameRate", "The maximum number of updates per second sent to each client",
                                           60, 0, INT_MAX);
+core::BoolParameter rfb::Server::adaptiveEncoding("AdaptiveEncoding",
+                                                  "Adapt the compression level, JPEG quality and use of JPEG for "
+                                                  "each client to how long its updates take to encode and send",
+                                                  false);
+core::BoolParameter rfb::Server::adaptiveUpdateRate("AdaptiveUpdateRate",
+                                                    "Send updates less often than FrameRate to clients that cannot "
+                                                    "encode or receive them that fast",
+                                                    false);
 core::BoolParameter rfb::Server::protocol3_3("Protocol3.3",
                                              "Always use protocol version 3.3 for backwards compatibility with "
                                              "badly-behaved clients",
@@ -85,6 +113,37 @@ core::IntParameter
     rfb::Server::persistentCacheMinRectSize("PersistentCacheMinRectSize",
                                             "Minimum rectangle size (pixels) to consider for persistent caching", 2048,
                                             0, INT_MAX);
+core::IntParameter
+    rfb::Server::encodedPayloadCacheSize("EncodedPayloadCacheSize",
+                                         "Memory (MiB) used to keep encoded PersistentCache payloads for reuse by "
+                                         "other clients, or 0 to disable",
+                                         64, 0, INT_MAX);
+core::IntParameter
+    rfb::Server::persistentCacheDeltaSize("PersistentCacheDeltaSize",
+                                          "Memory (MiB) per client used to keep recently sent PersistentCache "
+                                          "content that new content can be sent as a difference against, or 0 to "
+                                          "disable",
+                                          16, 0, INT_MAX);
+core::IntParameter rfb::Server::glyphCacheSize("GlyphCacheSize",
+                                               "Number of text glyph cells per client that can be sent as short "
+                                               "dictionary references, or 0 to disable",
+                                               4096, 0, 16384);
+core::IntParameter rfb::Server::glyphCellWidth("GlyphCellWidth", "Width in pixels of the text cells looked for", 8,
+                                               4, 32);
+core::IntParameter rfb::Server::glyphCellHeight("GlyphCellHeight", "Height in pixels of the text cells looked for",
+                                                16, 4, 32);
+core::BoolParameter rfb::Server::lossyRefinement("LossyRefinement",
+                                                 "Turn areas sent as JPEG into the exact pixels by sending only "
+                                                 "what the JPEG got wrong, rather than all of them again",
+                                                 true);
+core::BoolParameter rfb::Server::tightGradient("TightGradient",
+                                               "Send photo-like areas as the difference to a prediction from "
+                                               "their neighbours when Tight is used without JPEG",
+                                               true);
+core::BoolParameter rfb::Server::sharedMemory("SharedMemory",
+                                              "Give viewers on the same host connected via a Unix socket the "
+                                              "framebuffer in shared memory, rather than encoding it",
+                                              true);
 core::BoolParameter rfb::Server::enableBBoxCache(
     "EnableBBoxCache", "Enable Bounding Box cache optimization (coalesce updates into single cacheable rect)", true);
 
@@ -126,3 +185,22 @@ core::BoolParameter
                                              "Emit cached rectangles largest-first to reduce rectangle count", true);
 
 core::BoolParameter rfb::Server::cacheScanLogStats("CacheScanLogStats", "Log per-frame scan statistics", false);
+
+// Volatile (video/animation) region classification
+core::BoolParameter rfb::Server::enableVolatilityMap("EnableVolatilityMap",
+                                                     "Detect rapidly changing areas and send them lossy without "
+                                                     "cache lookups or lossless refresh",
+                                                     true);
+core::IntParameter rfb::Server::volatilityGridSize("VolatilityGridSize",
+                                                   "Size in pixels of the tiles used to detect volatile areas", 64, 16,
+                                                   512);
+core::IntParameter rfb::Server::volatilityWindowMs("VolatilityWindowMs",
+                                                   "Longest interval in ms between updates of an area that is "
+                                                   "still considered volatile",
+                                                   100, 20, 5000);
+core::BoolParameter rfb::Server::enableH264("EnableH264",
+                                            "Send stable volatile areas as H.264 streams to clients that support it",
+                                            false);
+core::IntParameter rfb::Server::h264MinArea("H264MinArea",
+                                            "Smallest volatile area in pixels that is sent as an H.264 stream",
+                                            320 * 240, 0, INT_MAX);
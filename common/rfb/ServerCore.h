@@ -35,7 +35,14 @@ public:
   static core::IntParameter maxConnectionTime;
   static core::IntParameter maxIdleTime;
   static core::IntParameter compareFB;
+  static core::IntParameter compareFBThreads;
+  static core::IntParameter encodeThreads;
+  static core::IntParameter compressThreads;
+  static core::BoolParameter shareEncodedUpdates;
+  static core::BoolParameter clientThreads;
   static core::IntParameter frameRate;
+  static core::BoolParameter adaptiveEncoding;
+  static core::BoolParameter adaptiveUpdateRate;
   static core::BoolParameter protocol3_3;
   static core::BoolParameter alwaysShared;
   static core::BoolParameter neverShared;
@@ -50,6 +57,22 @@ public:
   // PersistentCache parameters (cross-session, content hashes)
   static core::BoolParameter enablePersistentCache;
   static core::IntParameter persistentCacheMinRectSize;
+  static core::IntParameter encodedPayloadCacheSize;
+  static core::IntParameter persistentCacheDeltaSize;
+
+  // Glyph dictionary for text-like content
+  static core::IntParameter glyphCacheSize;
+  static core::IntParameter glyphCellWidth;
+  static core::IntParameter glyphCellHeight;
+
+  // Lossless refresh of JPEG areas as a difference
+  static core::BoolParameter lossyRefinement;
+
+  // Tight gradient filter for lossless photo-like content
+  static core::BoolParameter tightGradient;
+
+  // Framebuffer in shared memory for viewers on the same host
+  static core::BoolParameter sharedMemory;
 
   // Tiling optimization (EnableBBoxCache)
   static core::BoolParameter enableBBoxCache;
@@ -65,6 +88,13 @@ public:
   static core::IntParameter cacheScanCoverageThresholdPermille;
   static core::BoolParameter cacheScanPreferLargestFirst;
   static core::BoolParameter cacheScanLogStats;
+
+  // Volatile (video/animation) region classification
+  static core::BoolParameter enableVolatilityMap;
+  static core::IntParameter volatilityGridSize;
+  static core::IntParameter volatilityWindowMs;
+  static core::BoolParameter enableH264;
+  static core::IntParameter h264MinArea;
 };
 
 }; // namespace rfb
@@ -0,0 +1,176 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+
+#include <core/Region.h>
+
+#include <rfb/SharedEncodeCache.h>
+
+using namespace rfb;
+
+// Only data for the current frame or two is useful, so anything
+// beyond this is just a sign of clients that have fallen behind
+static const size_t MaxBytes = 32 * 1024 * 1024;
+
+SharedEncodeCache::SharedEncodeCache() : framebuffer(nullptr), totalBytes(0) {
+  stats.lookups = 0;
+  stats.hits = 0;
+  stats.bytes = 0;
+}
+
+SharedEncodeCache::~SharedEncodeCache() {}
+
+void SharedEncodeCache::setFramebuffer(const PixelBuffer* pb) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  framebuffer = pb;
+  entries.clear();
+  totalBytes = 0;
+}
+
+void SharedEncodeCache::invalidate(const core::Region& damage) {
+  std::map<std::string, Entry>::iterator iter;
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (damage.is_empty())
+    return;
+
+  iter = entries.begin();
+  while (iter != entries.end()) {
+    if (damage.intersect(iter->second.rect).is_empty()) {
+      ++iter;
+      continue;
+    }
+
+    totalBytes -= iter->second.data.size();
+    iter = entries.erase(iter);
+  }
+}
+
+void SharedEncodeCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  entries.clear();
+  totalBytes = 0;
+}
+
+void SharedEncodeCache::join(const std::string& fingerprint) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  groups[fingerprint]++;
+}
+
+void SharedEncodeCache::leave(const std::string& fingerprint) {
+  std::map<std::string, unsigned>::iterator iter;
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  iter = groups.find(fingerprint);
+  if (iter == groups.end())
+    return;
+
+  if (--iter->second == 0)
+    groups.erase(iter);
+}
+
+unsigned SharedEncodeCache::groupSize(const std::string& fingerprint) {
+  std::map<std::string, unsigned>::const_iterator iter;
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  iter = groups.find(fingerprint);
+  if (iter == groups.end())
+    return 0;
+
+  return iter->second;
+}
+
+unsigned SharedEncodeCache::groupCount() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  return groups.size();
+}
+
+bool SharedEncodeCache::lookup(const std::string& fingerprint, const core::Rect& rect, int* type,
+                               std::vector<uint8_t>* data) {
+  std::map<std::string, Entry>::const_iterator iter;
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  stats.lookups++;
+
+  iter = entries.find(makeKey(fingerprint, rect));
+  if (iter == entries.end())
+    return false;
+
+  *type = iter->second.type;
+  *data = iter->second.data;
+
+  stats.hits++;
+  stats.bytes += data->size();
+
+  return true;
+}
+
+void SharedEncodeCache::insert(const std::string& fingerprint, const core::Rect& rect, int type,
+                               const uint8_t* data, size_t length) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if ((totalBytes + length) > MaxBytes) {
+    entries.clear();
+    totalBytes = 0;
+  }
+
+  Entry& entry = entries[makeKey(fingerprint, rect)];
+
+  totalBytes -= entry.data.size();
+
+  entry.rect = rect;
+  entry.type = type;
+  entry.data.assign(data, data + length);
+
+  totalBytes += length;
+}
+
+SharedEncodeCache::Stats SharedEncodeCache::takeStats() {
+  Stats result;
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  result = stats;
+
+  stats.lookups = 0;
+  stats.hits = 0;
+  stats.bytes = 0;
+
+  return result;
+}
+
+std::string SharedEncodeCache::makeKey(const std::string& fingerprint, const core::Rect& rect) {
+  char buf[64];
+
+  snprintf(buf, sizeof(buf), "@%d,%d-%d,%d", rect.tl.x, rect.tl.y, rect.br.x, rect.br.y);
+
+  return fingerprint + buf;
+}
@@ -0,0 +1,100 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef __RFB_SHAREDENCODECACHE_H__
+#define __RFB_SHAREDENCODECACHE_H__
+
+#include <stdint.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <core/Rect.h>
+
+namespace core {
+class Region;
+}
+
+namespace rfb {
+
+class PixelBuffer;
+
+// Encoded rects of the server's framebuffer, shared by all clients
+// that use the same encoding parameters (the "fingerprint"). The first
+// client to need a rect encodes it, and the others just copy the
+// bytes. An entry stays valid until the framebuffer is damaged where
+// the rect is.
+//
+// Clients register their fingerprint so that they know if there is
+// anyone to share with, as sharing has a cost for encoders that
+// otherwise keep state between rects.
+
+class SharedEncodeCache {
+public:
+  SharedEncodeCache();
+  ~SharedEncodeCache();
+
+  // Changing the framebuffer drops everything
+  void setFramebuffer(const PixelBuffer* pb);
+  const PixelBuffer* getFramebuffer() const {
+    return framebuffer;
+  }
+
+  void invalidate(const core::Region& damage);
+  void clear();
+
+  void join(const std::string& fingerprint);
+  void leave(const std::string& fingerprint);
+  unsigned groupSize(const std::string& fingerprint);
+  unsigned groupCount();
+
+  bool lookup(const std::string& fingerprint, const core::Rect& rect, int* type, std::vector<uint8_t>* data);
+  void insert(const std::string& fingerprint, const core::Rect& rect, int type, const uint8_t* data, size_t length);
+
+  struct Stats {
+    unsigned lookups;
+    unsigned hits;
+    unsigned long long bytes; // Sent from the cache rather than encoded
+  };
+
+  Stats takeStats();
+
+private:
+  struct Entry {
+    core::Rect rect;
+    int type;
+    std::vector<uint8_t> data;
+  };
+
+  static std::string makeKey(const std::string& fingerprint, const core::Rect& rect);
+
+  std::mutex mutex;
+
+  const PixelBuffer* framebuffer;
+  std::map<std::string, Entry> entries;
+  size_t totalBytes;
+  std::map<std::string, unsigned> groups;
+
+  Stats stats;
+};
+
+} // namespace rfb
+
+#endif
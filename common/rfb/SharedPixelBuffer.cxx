@@ -0,0 +1,167 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <stdexcept>
+
+#include <core/Exception.h>
+
+#include <rfb/SharedPixelBuffer.h>
+
+using namespace rfb;
+
+SharedPixelBuffer::SharedPixelBuffer(const PixelFormat& pf, int width, int height)
+    : FullFramePixelBuffer(pf, 0, 0, nullptr, 0), fd(-1), readOnly(false), mapping(nullptr), size(0) {
+#if defined(WIN32) || !defined(MFD_CLOEXEC)
+  (void)width;
+  (void)height;
+  throw std::runtime_error("Shared memory buffers are not supported on this system");
+#else
+  int seals, ret;
+
+  if ((width <= 0) || (height <= 0))
+    throw std::invalid_argument("Invalid shared buffer size");
+
+  size = (size_t)width * height * (pf.bpp / 8);
+
+  fd = memfd_create("vnc-framebuffer", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0)
+    throw core::posix_error("memfd_create", errno);
+
+  try {
+    if (ftruncate(fd, size) < 0)
+      throw core::posix_error("ftruncate", errno);
+
+    mapping = (uint8_t*)mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+      mapping = nullptr;
+      throw core::posix_error("mmap", errno);
+    }
+
+    // The client gets the same file, so it must not be able to change
+    // its size under our feet, nor write to it where that is possible
+    seals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+    ret = -1;
+#ifdef F_SEAL_FUTURE_WRITE
+    ret = fcntl(fd, F_ADD_SEALS, seals | F_SEAL_FUTURE_WRITE);
+#endif
+    if ((ret < 0) && (fcntl(fd, F_ADD_SEALS, seals) < 0))
+      throw core::posix_error("fcntl", errno);
+
+    setBuffer(width, height, mapping, width);
+  } catch (...) {
+    if (mapping != nullptr)
+      munmap(mapping, size);
+    close(fd);
+    throw;
+  }
+#endif
+}
+
+SharedPixelBuffer::SharedPixelBuffer(int fd_, const PixelFormat& pf, int width, int height, int stride_)
+    : FullFramePixelBuffer(pf, 0, 0, nullptr, 0), fd(fd_), readOnly(true), mapping(nullptr), size(0) {
+#ifdef WIN32
+  (void)width;
+  (void)height;
+  (void)stride_;
+  throw std::runtime_error("Shared memory buffers are not supported on this system");
+#else
+  struct stat st;
+
+  try {
+    if ((width <= 0) || (height <= 0) || (stride_ < width))
+      throw std::invalid_argument("Invalid shared buffer layout");
+
+    size = (size_t)stride_ * height * (pf.bpp / 8);
+
+    if (fstat(fd, &st) < 0)
+      throw core::posix_error("fstat", errno);
+    if (!S_ISREG(st.st_mode) || ((uint64_t)st.st_size < size))
+      throw std::invalid_argument("Shared buffer is too small");
+
+#ifdef F_GET_SEALS
+    int seals;
+
+    // Reading beyond the end of a mapped file is fatal, so the other
+    // end must not be able to shrink it
+    seals = fcntl(fd, F_GET_SEALS);
+    if ((seals < 0) || !(seals & F_SEAL_SHRINK))
+      throw std::invalid_argument("Shared buffer can be resized");
+#endif
+
+    mapping = (uint8_t*)mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+      mapping = nullptr;
+      throw core::posix_error("mmap", errno);
+    }
+
+    setBuffer(width, height, mapping, stride_);
+  } catch (...) {
+    if (mapping != nullptr)
+      munmap(mapping, size);
+    close(fd);
+    throw;
+  }
+#endif
+}
+
+SharedPixelBuffer::~SharedPixelBuffer() {
+#ifndef WIN32
+  if (mapping != nullptr)
+    munmap(mapping, size);
+  if (fd >= 0)
+    close(fd);
+#endif
+}
+
+int SharedPixelBuffer::dupFd() const {
+#ifdef WIN32
+  throw std::logic_error("Shared memory buffers are not supported on this system");
+#else
+  int newFd;
+
+  newFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+  if (newFd < 0)
+    throw core::posix_error("fcntl", errno);
+
+  return newFd;
+#endif
+}
+
+int SharedPixelBuffer::getStride() const {
+  int stride_;
+  getBuffer(getRect(), &stride_);
+  return stride_;
+}
+
+uint8_t* SharedPixelBuffer::getBufferRW(const core::Rect& r, int* stride_) {
+  if (readOnly)
+    throw std::logic_error("Shared pixel buffer is read-only");
+  return FullFramePixelBuffer::getBufferRW(r, stride_);
+}
@@ -0,0 +1,58 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+// -=- SharedPixelBuffer.h
+//
+// A pixel buffer in anonymous shared memory, for clients on the same
+// host. The server keeps a copy of its framebuffer in one and hands
+// the client a file descriptor for it over a Unix socket. After that,
+// updates only need to say which parts have changed.
+
+#ifndef __RFB_SHAREDPIXELBUFFER_H__
+#define __RFB_SHAREDPIXELBUFFER_H__
+
+#include <rfb/PixelBuffer.h>
+
+namespace rfb {
+
+class SharedPixelBuffer : public FullFramePixelBuffer {
+public:
+  // Creates a new buffer, throwing if the system cannot provide one
+  SharedPixelBuffer(const PixelFormat& pf, int width, int height);
+  // Maps a buffer created by the other end read-only. Takes over the
+  // file descriptor, and throws if it isn't a buffer of this layout
+  // that is safe to map.
+  SharedPixelBuffer(int fd, const PixelFormat& pf, int width, int height, int stride_);
+  virtual ~SharedPixelBuffer();
+
+  // Returns a new file descriptor for the buffer, to hand on
+  int dupFd() const;
+  int getStride() const;
+
+  uint8_t* getBufferRW(const core::Rect& r, int* stride_) override;
+
+private:
+  int fd;
+  bool readOnly;
+  uint8_t* mapping;
+  size_t size;
+};
+
+} // namespace rfb
+
+#endif
@@ -25,6 +25,7 @@
 
 #include <assert.h>
 
+#include <algorithm>
 #include <vector>
 
 #include <core/string.h>
@@ -39,6 +40,7 @@
 #include <rfb/ServerParams.h>
 #include <rfb/TightConstants.h>
 #include <rfb/TightDecoder.h>
+#include <rfb/TightGradient.h>
 
 using namespace rfb;
 
@@ -490,44 +492,23 @@ uint32_t TightDecoder::readCompact(rdr::InStream* is) {
 
 void TightDecoder::FilterGradient24(const uint8_t* inbuf, const PixelFormat& pf, uint32_t* outbuf, int stride,
                                     const core::Rect& r) {
-  int x, y, c;
-  uint8_t prevRow[TIGHT_MAX_WIDTH * 3];
-  uint8_t thisRow[TIGHT_MAX_WIDTH * 3];
-  uint8_t pix[3];
-  int est[3];
-
-  memset(prevRow, 0, sizeof(prevRow));
+  int y;
+  uint8_t rows[2][TIGHT_MAX_WIDTH * 3];
+  uint8_t *prevRow, *thisRow;
 
   // Set up shortcut variables
   int rectHeight = r.height();
   int rectWidth = r.width();
 
-  for (y = 0; y < rectHeight; y++) {
-    for (x = 0; x < rectWidth; x++) {
-      /* First pixel in a row */
-      if (x == 0) {
-        for (c = 0; c < 3; c++) {
-          pix[c] = inbuf[y * rectWidth * 3 + c] + prevRow[c];
-          thisRow[c] = pix[c];
-        }
-        pf.bufferFromRGB((uint8_t*)&outbuf[y * stride], pix, 1);
-        continue;
-      }
+  prevRow = rows[0];
+  thisRow = rows[1];
 
-      for (c = 0; c < 3; c++) {
-        est[c] = prevRow[x * 3 + c] + pix[c] - prevRow[(x - 1) * 3 + c];
-        if (est[c] > 0xff) {
-          est[c] = 0xff;
-        } else if (est[c] < 0) {
-          est[c] = 0;
-        }
-        pix[c] = inbuf[(y * rectWidth + x) * 3 + c] + est[c];
-        thisRow[x * 3 + c] = pix[c];
-      }
-      pf.bufferFromRGB((uint8_t*)&outbuf[y * stride + x], pix, 1);
-    }
+  memset(prevRow, 0, rectWidth * 3);
 
-    memcpy(prevRow, thisRow, sizeof(prevRow));
+  for (y = 0; y < rectHeight; y++) {
+    tightGradientRestoreRow(prevRow, &inbuf[y * rectWidth * 3], thisRow, rectWidth);
+    pf.bufferFromRGB((uint8_t*)&outbuf[y * stride], thisRow, rectWidth);
+    std::swap(prevRow, thisRow);
   }
 }
 
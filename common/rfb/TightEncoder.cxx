@@ -23,13 +23,18 @@
 #endif
 
 #include <assert.h>
+#include <string.h>
+
+#include <algorithm>
 
 #include <rdr/OutStream.h>
 #include <rfb/Palette.h>
 #include <rfb/PixelBuffer.h>
 #include <rfb/SConnection.h>
+#include <rfb/ServerCore.h>
 #include <rfb/TightConstants.h>
 #include <rfb/TightEncoder.h>
+#include <rfb/TightGradient.h>
 #include <rfb/encodings.h>
 
 using namespace rfb;
@@ -60,7 +65,8 @@ static const TightConf conf[10] = {
     {9, 9, 9}  // 9
 };
 
-TightEncoder::TightEncoder(SConnection* conn_) : Encoder(conn_, encodingTight, EncoderPlain, 256) {
+TightEncoder::TightEncoder(SConnection* conn_)
+    : Encoder(conn_, encodingTight, EncoderPlain, 256), independentRects(false), pendingResets(0), smoothHint(false) {
   setCompressLevel(-1);
 }
 
@@ -79,10 +85,34 @@ void TightEncoder::setCompressLevel(int level) {
   rawZlibLevel = conf[level].rawZlibLevel;
 }
 
+void TightEncoder::setSmoothHint(bool smooth) {
+  smoothHint = smooth;
+}
+
+void TightEncoder::setIndependentRects(bool enable) {
+  // The client's streams no longer match ours, so they need a reset
+  // on first use
+  if (independentRects && !enable)
+    pendingResets = 0x0f;
+
+  independentRects = enable;
+}
+
 void TightEncoder::writeRect(const PixelBuffer* pb, const Palette& palette) {
+  bool smooth;
+
+  // The hint only covers this rectangle
+  smooth = smoothHint;
+  smoothHint = false;
+
   switch (palette.size()) {
   case 0:
-    writeFullColourRect(pb);
+    // The gradient filter gains nothing without compression, and
+    // other formats are predicted differently by different clients
+    if (smooth && Server::tightGradient && (rawZlibLevel > 0) && pb->getPF().is888())
+      writeGradientRect(pb);
+    else
+      writeFullColourRect(pb);
     break;
   case 1:
     Encoder::writeSolidRect(pb, palette);
@@ -98,7 +128,7 @@ void TightEncoder::writeRect(const PixelBuffer* pb, const Palette& palette) {
 void TightEncoder::writeSolidRect(int /*width*/, int /*height*/, const PixelFormat& pf, const uint8_t* colour) {
   rdr::OutStream* os;
 
-  os = conn->getOutStream();
+  os = getOutStream();
 
   os->writeU8(tightFill << 4);
   writePixels(colour, pf, 1, os);
@@ -151,16 +181,16 @@ void TightEncoder::writeFullColourRect(const PixelBuffer* pb) {
   const uint8_t* buffer;
   int stride, h;
 
-  os = conn->getOutStream();
-
-  os->writeU8(streamId << 4);
+  os = getOutStream();
 
-  // Set up compression
   if ((pb->getPF().bpp != 32) || !pb->getPF().is888())
     length = pb->getRect().area() * pb->getPF().bpp / 8;
   else
     length = pb->getRect().area() * 3;
 
+  os->writeU8((streamId << 4) | streamResets(streamId, rawZlibLevel, length));
+
+  // Set up compression
   zos = getZlibOutStream(streamId, rawZlibLevel, length);
 
   // And then just dump all the raw pixels
@@ -176,6 +206,52 @@ void TightEncoder::writeFullColourRect(const PixelBuffer* pb) {
   flushZlibOutStream(zos);
 }
 
+void TightEncoder::writeGradientRect(const PixelBuffer* pb) {
+  const int streamId = 3;
+
+  rdr::OutStream* os;
+  rdr::OutStream* zos;
+  int length;
+
+  const uint8_t* buffer;
+  int stride, width, h;
+  uint8_t *prevRow, *thisRow, *residuals;
+
+  os = getOutStream();
+
+  width = pb->width();
+  length = pb->getRect().area() * 3;
+
+  os->writeU8(((streamId | tightExplicitFilter) << 4) | streamResets(streamId, rawZlibLevel, length));
+  os->writeU8(tightFilterGradient);
+
+  // Set up compression
+  zos = getZlibOutStream(streamId, rawZlibLevel, length);
+
+  gradientRows.resize(width * 3 * 3);
+  prevRow = gradientRows.data();
+  thisRow = prevRow + width * 3;
+  residuals = thisRow + width * 3;
+
+  // The row above the first one is black
+  memset(prevRow, 0, width * 3);
+
+  buffer = pb->getBuffer(pb->getRect(), &stride);
+  h = pb->height();
+
+  while (h--) {
+    pb->getPF().rgbFromBuffer(thisRow, buffer, width);
+    tightGradientPredictRow(prevRow, thisRow, residuals, width);
+    zos->writeBytes(residuals, width * 3);
+
+    std::swap(prevRow, thisRow);
+    buffer += stride * pb->getPF().bpp / 8;
+  }
+
+  // Finish the zlib stream
+  flushZlibOutStream(zos);
+}
+
 void TightEncoder::writePixels(const uint8_t* buffer, const PixelFormat& pf, unsigned int count, rdr::OutStream* os) {
   uint8_t rgb[2048];
 
@@ -216,17 +292,33 @@ void TightEncoder::writeCompact(rdr::OutStream* os, uint32_t value) {
   }
 }
 
+uint8_t TightEncoder::streamResets(int streamId, int level, size_t length) {
+  // Short data is sent uncompressed and leaves the stream alone
+  if (length < 12)
+    return 0;
+
+  if (!independentRects && !(pendingResets & (1 << streamId)))
+    return 0;
+
+  zlibStreams[streamId].setCompressionLevel(level);
+  zlibStreams[streamId].reset();
+  pendingResets &= ~(1 << streamId);
+
+  return 1 << streamId;
+}
+
 rdr::OutStream* TightEncoder::getZlibOutStream(int streamId, int level, size_t length) {
   // Minimum amount of data to be compressed. This value should not be
   // changed, doing so will break compatibility with existing clients.
   if (length < 12)
-    return conn->getOutStream();
+    return getOutStream();
 
   assert(streamId >= 0);
   assert(streamId < 4);
 
   zlibStreams[streamId].setUnderlying(&memStream);
   zlibStreams[streamId].setCompressionLevel(level);
+  zlibStreams[streamId].setThreads(Server::compressThreads);
   zlibStreams[streamId].cork(true);
 
   return &zlibStreams[streamId];
@@ -244,7 +336,7 @@ void TightEncoder::flushZlibOutStream(rdr::OutStream* os_) {
   zos->flush();
   zos->setUnderlying(nullptr);
 
-  os = conn->getOutStream();
+  os = getOutStream();
 
   writeCompact(os, memStream.length());
   os->writeBytes(memStream.data(), memStream.length());
@@ -264,9 +356,11 @@ void TightEncoder::writeMonoRect(int width, int height, const T* buffer, int str
 
   assert(palette.size() == 2);
 
-  os = conn->getOutStream();
+  os = getOutStream();
 
-  os->writeU8((streamId | tightExplicitFilter) << 4);
+  length = (width + 7) / 8 * height;
+
+  os->writeU8(((streamId | tightExplicitFilter) << 4) | streamResets(streamId, monoZlibLevel, length));
   os->writeU8(tightFilterPalette);
 
   // Write the palette
@@ -277,7 +371,6 @@ void TightEncoder::writeMonoRect(int width, int height, const T* buffer, int str
   writePixels((uint8_t*)pal, pf, 2, os);
 
   // Set up compression
-  length = (width + 7) / 8 * height;
   zos = getZlibOutStream(streamId, monoZlibLevel, length);
 
   // Encode the data
@@ -348,9 +441,9 @@ void TightEncoder::writeIndexedRect(int width, int height, const T* buffer, int
   assert(palette.size() > 0);
   assert(palette.size() <= 256);
 
-  os = conn->getOutStream();
+  os = getOutStream();
 
-  os->writeU8((streamId | tightExplicitFilter) << 4);
+  os->writeU8(((streamId | tightExplicitFilter) << 4) | streamResets(streamId, idxZlibLevel, width * height));
   os->writeU8(tightFilterPalette);
 
   // Write the palette
@@ -20,6 +20,8 @@
 #ifndef __RFB_TIGHTENCODER_H__
 #define __RFB_TIGHTENCODER_H__
 
+#include <vector>
+
 #include <rdr/MemOutStream.h>
 #include <rdr/ZlibOutStream.h>
 #include <rfb/Encoder.h>
@@ -34,19 +36,27 @@ public:
   bool isSupported() override;
 
   void setCompressLevel(int level) override;
+  void setSmoothHint(bool smooth) override;
 
   void writeRect(const PixelBuffer* pb, const Palette& palette) override;
   void writeSolidRect(int width, int height, const PixelFormat& pf, const uint8_t* colour) override;
 
+  // Resets the zlib stream at the start of every rectangle, so that
+  // each one can be decoded without the ones before it. This allows
+  // rectangles to be encoded in parallel, at some cost in compression.
+  void setIndependentRects(bool enable);
+
 protected:
   void writeMonoRect(const PixelBuffer* pb, const Palette& palette);
   void writeIndexedRect(const PixelBuffer* pb, const Palette& palette);
   void writeFullColourRect(const PixelBuffer* pb);
+  void writeGradientRect(const PixelBuffer* pb);
 
   void writePixels(const uint8_t* buffer, const PixelFormat& pf, unsigned int count, rdr::OutStream* os);
 
   void writeCompact(rdr::OutStream* os, uint32_t value);
 
+  uint8_t streamResets(int streamId, int level, size_t length);
   rdr::OutStream* getZlibOutStream(int streamId, int level, size_t length);
   void flushZlibOutStream(rdr::OutStream* os);
 
@@ -62,6 +72,12 @@ protected:
   rdr::MemOutStream memStream;
 
   int idxZlibLevel, monoZlibLevel, rawZlibLevel;
+
+  bool independentRects;
+  unsigned pendingResets;
+
+  bool smoothHint;
+  std::vector<uint8_t> gradientRows;
 };
 
 } // namespace rfb
@@ -0,0 +1,175 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <rfb/TightGradient.h>
+
+using namespace rfb;
+
+static inline uint8_t predict(int left, int above, int aboveLeft) {
+  int est;
+
+  est = left + above - aboveLeft;
+  if (est < 0)
+    return 0;
+  if (est > 255)
+    return 255;
+  return est;
+}
+
+static inline uint32_t load32(const uint8_t* ptr) {
+  uint32_t value;
+  memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+static inline void store32(uint8_t* ptr, uint32_t value) {
+  memcpy(ptr, &value, sizeof(value));
+}
+
+void rfb::tightGradientPredictRow(const uint8_t* prevRow, const uint8_t* thisRow, uint8_t* out, int width) {
+  int i, len;
+
+  if (width <= 0)
+    return;
+
+  len = width * 3;
+
+  // The first pixel only has the one above it
+  for (i = 0; i < 3; i++)
+    out[i] = thisRow[i] - prevRow[i];
+
+  // Every input is known here, so whole rows can be done in parallel
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+
+  for (; i + 16 <= len; i += 16) {
+    __m128i cur, left, above, aboveLeft;
+    __m128i lo, hi;
+
+    cur = _mm_loadu_si128((const __m128i*)(thisRow + i));
+    left = _mm_loadu_si128((const __m128i*)(thisRow + i - 3));
+    above = _mm_loadu_si128((const __m128i*)(prevRow + i));
+    aboveLeft = _mm_loadu_si128((const __m128i*)(prevRow + i - 3));
+
+    lo = _mm_add_epi16(_mm_unpacklo_epi8(left, zero), _mm_unpacklo_epi8(above, zero));
+    lo = _mm_sub_epi16(lo, _mm_unpacklo_epi8(aboveLeft, zero));
+    hi = _mm_add_epi16(_mm_unpackhi_epi8(left, zero), _mm_unpackhi_epi8(above, zero));
+    hi = _mm_sub_epi16(hi, _mm_unpackhi_epi8(aboveLeft, zero));
+
+    // Saturating to unsigned is exactly the clamp we need
+    _mm_storeu_si128((__m128i*)(out + i), _mm_sub_epi8(cur, _mm_packus_epi16(lo, hi)));
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  for (; i + 16 <= len; i += 16) {
+    uint8x16_t cur, left, above, aboveLeft;
+    int16x8_t lo, hi;
+
+    cur = vld1q_u8(thisRow + i);
+    left = vld1q_u8(thisRow + i - 3);
+    above = vld1q_u8(prevRow + i);
+    aboveLeft = vld1q_u8(prevRow + i - 3);
+
+    lo = vreinterpretq_s16_u16(vsubq_u16(vaddl_u8(vget_low_u8(left), vget_low_u8(above)),
+                                         vmovl_u8(vget_low_u8(aboveLeft))));
+    hi = vreinterpretq_s16_u16(vsubq_u16(vaddl_u8(vget_high_u8(left), vget_high_u8(above)),
+                                         vmovl_u8(vget_high_u8(aboveLeft))));
+
+    vst1q_u8(out + i, vsubq_u8(cur, vcombine_u8(vqmovun_s16(lo), vqmovun_s16(hi))));
+  }
+#endif
+
+  for (; i < len; i++)
+    out[i] = thisRow[i] - predict(thisRow[i - 3], prevRow[i], prevRow[i - 3]);
+}
+
+void rfb::tightGradientRestoreRow(const uint8_t* prevRow, const uint8_t* in, uint8_t* thisRow, int width) {
+  int x, c;
+
+  if (width <= 0)
+    return;
+
+  for (c = 0; c < 3; c++)
+    thisRow[c] = in[c] + prevRow[c];
+
+  x = 1;
+
+  // Each pixel depends on the one to its left, so the best we can do
+  // is handle all channels of a pixel at once. Every access is four
+  // bytes, which is fine as long as there is another pixel after the
+  // current one, and the stray byte written is replaced on the next
+  // step.
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  __m128i left;
+
+  left = _mm_unpacklo_epi8(_mm_cvtsi32_si128(load32(thisRow)), zero);
+
+  for (; x < width - 1; x++) {
+    __m128i above, aboveLeft, est, pix;
+
+    above = _mm_unpacklo_epi8(_mm_cvtsi32_si128(load32(prevRow + x * 3)), zero);
+    aboveLeft = _mm_unpacklo_epi8(_mm_cvtsi32_si128(load32(prevRow + x * 3 - 3)), zero);
+
+    est = _mm_sub_epi16(_mm_add_epi16(left, above), aboveLeft);
+    est = _mm_packus_epi16(est, est);
+
+    pix = _mm_add_epi8(_mm_cvtsi32_si128(load32(in + x * 3)), est);
+    store32(thisRow + x * 3, _mm_cvtsi128_si32(pix));
+
+    left = _mm_unpacklo_epi8(pix, zero);
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  int16x8_t left;
+
+  left = vreinterpretq_s16_u16(vmovl_u8(vcreate_u8(load32(thisRow))));
+
+  for (; x < width - 1; x++) {
+    int16x8_t above, aboveLeft;
+    uint8x8_t est, pix;
+
+    above = vreinterpretq_s16_u16(vmovl_u8(vcreate_u8(load32(prevRow + x * 3))));
+    aboveLeft = vreinterpretq_s16_u16(vmovl_u8(vcreate_u8(load32(prevRow + x * 3 - 3))));
+
+    est = vqmovun_s16(vsubq_s16(vaddq_s16(left, above), aboveLeft));
+
+    pix = vadd_u8(vcreate_u8(load32(in + x * 3)), est);
+    store32(thisRow + x * 3, vget_lane_u32(vreinterpret_u32_u8(pix), 0));
+
+    left = vreinterpretq_s16_u16(vmovl_u8(pix));
+  }
+#endif
+
+  for (; x < width; x++) {
+    for (c = 0; c < 3; c++) {
+      int i = x * 3 + c;
+      thisRow[i] = in[i] + predict(thisRow[i - 3], prevRow[i], prevRow[i - 3]);
+    }
+  }
+}
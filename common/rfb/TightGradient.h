@@ -0,0 +1,44 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef __RFB_TIGHTGRADIENT_H__
+#define __RFB_TIGHTGRADIENT_H__
+
+#include <stdint.h>
+
+namespace rfb {
+
+// Kernels for the Tight gradient filter. Every channel of a pixel is
+// predicted as left + above - above-left, clamped to 0..255, and only
+// the difference to that prediction is sent, which leaves mostly
+// small values for zlib in smooth, photographic content.
+//
+// Rows are packed R,G,B triplets. For the first row of a rectangle
+// prevRow should be all zeroes, and the pixels left of the first
+// column also count as zero.
+
+// Computes the residuals for thisRow, wrapping around modulo 256
+void tightGradientPredictRow(const uint8_t* prevRow, const uint8_t* thisRow, uint8_t* out, int width);
+
+// Reverses tightGradientPredictRow(), reconstructing thisRow from the
+// residuals in
+void tightGradientRestoreRow(const uint8_t* prevRow, const uint8_t* in, uint8_t* thisRow, int width);
+
+} // namespace rfb
+
+#endif
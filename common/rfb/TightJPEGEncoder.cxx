@@ -68,8 +68,8 @@ static const struct TightJPEGConfiguration conf[10] = {
 };
 
 TightJPEGEncoder::TightJPEGEncoder(SConnection* conn_)
-    : Encoder(conn_, encodingTight, (EncoderFlags)(EncoderUseNativePF | EncoderLossy), -1, 9), qualityLevel(-1),
-      fineQuality(-1), fineSubsampling(subsampleUndefined) {}
+    : Encoder(conn_, encodingTight, (EncoderFlags)(EncoderUseNativePF | EncoderLossy | EncoderStateless), -1, 9),
+      qualityLevel(-1), fineQuality(-1), fineSubsampling(subsampleUndefined) {}
 
 TightJPEGEncoder::~TightJPEGEncoder() {}
 
@@ -102,6 +102,30 @@ int TightJPEGEncoder::getQualityLevel() {
   return qualityLevel;
 }
 
+int TightJPEGEncoder::getFineQualityLevel() {
+  return fineQuality;
+}
+
+int TightJPEGEncoder::getFineSubsampling() {
+  return fineSubsampling;
+}
+
+void TightJPEGEncoder::getJpegSettings(int* quality, int* subsampling) {
+  if (qualityLevel >= 0 && qualityLevel <= 9) {
+    *quality = conf[qualityLevel].quality;
+    *subsampling = conf[qualityLevel].subsampling;
+  } else {
+    *quality = -1;
+    *subsampling = subsampleUndefined;
+  }
+
+  // Fine settings trump level
+  if (fineQuality != -1)
+    *quality = fineQuality;
+  if (fineSubsampling != subsampleUndefined)
+    *subsampling = fineSubsampling;
+}
+
 void TightJPEGEncoder::writeRect(const PixelBuffer* pb, const Palette& /*palette*/) {
   const uint8_t* buffer;
   int stride;
@@ -112,24 +136,12 @@ void TightJPEGEncoder::writeRect(const PixelBuffer* pb, const Palette& /*palette
 
   buffer = pb->getBuffer(pb->getRect(), &stride);
 
-  if (qualityLevel >= 0 && qualityLevel <= 9) {
-    quality = conf[qualityLevel].quality;
-    subsampling = conf[qualityLevel].subsampling;
-  } else {
-    quality = -1;
-    subsampling = subsampleUndefined;
-  }
-
-  // Fine settings trump level
-  if (fineQuality != -1)
-    quality = fineQuality;
-  if (fineSubsampling != subsampleUndefined)
-    subsampling = fineSubsampling;
+  getJpegSettings(&quality, &subsampling);
 
   jc.clear();
   jc.compress(buffer, stride, pb->getRect(), pb->getPF(), quality, subsampling);
 
-  os = conn->getOutStream();
+  os = getOutStream();
 
   os->writeU8(tightJpeg << 4);
 
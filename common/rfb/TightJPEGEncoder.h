@@ -36,6 +36,11 @@ public:
   void setFineQualityLevel(int quality, int subsampling) override;
 
   int getQualityLevel() override;
+  int getFineQualityLevel() override;
+  int getFineSubsampling() override;
+
+  // The JPEG settings writeRect() currently uses
+  void getJpegSettings(int* quality, int* subsampling);
 
   void writeRect(const PixelBuffer* pb, const Palette& palette) override;
   void writeSolidRect(int width, int height, const PixelFormat& pf, const uint8_t* colour) override;
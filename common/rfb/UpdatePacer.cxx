@@ -0,0 +1,174 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <core/time.h>
+
+#include <rfb/UpdatePacer.h>
+
+using namespace rfb;
+
+// Even the slowest client gets an update this often
+static const unsigned MaxInterval = 1000000;
+
+// How often statistics are collected, in milliseconds
+static const unsigned StatsInterval = 10000;
+
+UpdatePacer::UpdatePacer()
+    : started(false), damaged(false), updateDamaged(false), encodeUs(0), bytes(0), updates(0), statsUpdates(0),
+      statsStaleness(0), statsMaxStaleness(0), statsStalenessCount(0) {
+  memset(&lastStart, 0, sizeof(lastStart));
+  memset(&damageTime, 0, sizeof(damageTime));
+  memset(&updateDamageTime, 0, sizeof(updateDamageTime));
+  memset(&statsStart, 0, sizeof(statsStart));
+}
+
+void UpdatePacer::noteDamage(const struct timeval* now) {
+  if (damaged)
+    return;
+
+  damaged = true;
+  damageTime = *now;
+}
+
+void UpdatePacer::startUpdate(const struct timeval* now) {
+  if (!started)
+    statsStart = *now;
+
+  started = true;
+  lastStart = *now;
+
+  updateDamaged = damaged;
+  updateDamageTime = damageTime;
+  damaged = false;
+}
+
+void UpdatePacer::updateSent(const struct timeval* now, size_t bytes_, size_t bandwidth, unsigned rtt) {
+  uint64_t encodeUs_;
+
+  encodeUs_ = core::usBetween(&lastStart, now);
+
+  if (updates == 0) {
+    encodeUs = encodeUs_;
+    bytes = bytes_;
+  } else {
+    encodeUs = (encodeUs * 3 + encodeUs_) / 4;
+    bytes = (bytes * 3 + bytes_) / 4;
+  }
+  updates++;
+
+  statsUpdates++;
+
+  // The changes still have to make it through the link, and then half
+  // a round trip to go
+  if (updateDamaged) {
+    uint64_t staleness;
+
+    staleness = core::usBetween(&updateDamageTime, now) + rtt / 2;
+    if (bandwidth != 0)
+      staleness += (uint64_t)bytes_ * 1000000 / bandwidth;
+    staleness /= 1000;
+
+    statsStaleness += staleness;
+    if (staleness > statsMaxStaleness)
+      statsMaxStaleness = staleness;
+    statsStalenessCount++;
+
+    updateDamaged = false;
+  }
+}
+
+unsigned UpdatePacer::getInterval(size_t bandwidth, unsigned frameRate) const {
+  uint64_t interval, sendUs;
+
+  interval = 0;
+  if (frameRate != 0)
+    interval = 1000000 / frameRate;
+
+  // The next update can be encoded whilst the previous one is still
+  // on its way, so it is whichever is slower that sets the pace
+  if (encodeUs > interval)
+    interval = encodeUs;
+
+  sendUs = 0;
+  if (bandwidth != 0)
+    sendUs = bytes * 1000000 / bandwidth;
+  if (sendUs > interval)
+    interval = sendUs;
+
+  if (interval > MaxInterval)
+    interval = MaxInterval;
+
+  return interval;
+}
+
+int UpdatePacer::msToNextUpdate(const struct timeval* now, size_t bandwidth, unsigned frameRate) const {
+  unsigned interval, frameInterval;
+  uint64_t elapsed;
+
+  if (!started || (frameRate == 0))
+    return 0;
+
+  interval = getInterval(bandwidth, frameRate);
+  frameInterval = 1000000 / frameRate;
+  if (interval <= frameInterval)
+    return 0;
+
+  elapsed = core::usBetween(&lastStart, now);
+  if (elapsed >= interval)
+    return 0;
+
+  // Close enough to go out with the others on this wakeup
+  if ((interval - elapsed) * 4 <= frameInterval)
+    return 0;
+
+  return (interval - elapsed + 999) / 1000;
+}
+
+bool UpdatePacer::takeStats(const struct timeval* now, size_t bandwidth, unsigned frameRate, Stats* stats) {
+  uint64_t elapsed;
+  unsigned interval;
+
+  if (!started)
+    return false;
+
+  elapsed = core::usBetween(&statsStart, now);
+  if (elapsed < StatsInterval * 1000ULL)
+    return false;
+
+  stats->updateRate = statsUpdates * 1000000.0 / elapsed;
+  interval = getInterval(bandwidth, frameRate);
+  stats->targetRate = interval != 0 ? 1000000.0 / interval : 0;
+  stats->avgStaleness = 0;
+  if (statsStalenessCount != 0)
+    stats->avgStaleness = statsStaleness / statsStalenessCount;
+  stats->maxStaleness = statsMaxStaleness;
+
+  statsStart = *now;
+  statsUpdates = 0;
+  statsStaleness = 0;
+  statsMaxStaleness = 0;
+  statsStalenessCount = 0;
+
+  return true;
+}
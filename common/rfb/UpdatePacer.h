@@ -0,0 +1,94 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef __RFB_UPDATEPACER_H__
+#define __RFB_UPDATEPACER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+namespace rfb {
+
+// Keeps track of how fast a single client can take updates, so that a
+// client on a slow link isn't pushed at the same rate as one on the
+// local network. An update is due once the previous one has had time
+// to be encoded, and to be sent, or once a frame has passed if that
+// is longer.
+//
+// It also measures the update rate the client actually gets, and how
+// old the changes are by the time they reach it.
+
+class UpdatePacer {
+public:
+  UpdatePacer();
+
+  // noteDamage() must be called when there are new changes for the
+  // client, startUpdate() when an update with those changes is
+  // started, and updateSent() when it has been written out.
+  void noteDamage(const struct timeval* now);
+  void startUpdate(const struct timeval* now);
+  void updateSent(const struct timeval* now, size_t bytes, size_t bandwidth, unsigned rtt);
+
+  // getInterval() returns the time in microseconds that updates
+  // should be spaced by, given the bandwidth in bytes per second.
+  unsigned getInterval(size_t bandwidth, unsigned frameRate) const;
+
+  // msToNextUpdate() returns the number of milliseconds until the next
+  // update is due, or 0 if it is due now, or close enough that it
+  // might as well be sent together with those of other clients.
+  // Clients that can keep up with the frame rate are always due.
+  int msToNextUpdate(const struct timeval* now, size_t bandwidth, unsigned frameRate) const;
+
+  struct Stats {
+    // Updates per second
+    double updateRate;
+    double targetRate;
+    // Age of changes on arrival, in milliseconds
+    unsigned avgStaleness;
+    unsigned maxStaleness;
+  };
+
+  // takeStats() returns true, and fills in stats, once every few
+  // seconds
+  bool takeStats(const struct timeval* now, size_t bandwidth, unsigned frameRate, Stats* stats);
+
+private:
+  bool started;
+  struct timeval lastStart;
+
+  bool damaged;
+  struct timeval damageTime;
+  bool updateDamaged;
+  struct timeval updateDamageTime;
+
+  // Smoothed cost of an update
+  uint64_t encodeUs;
+  uint64_t bytes;
+  unsigned updates;
+
+  struct timeval statsStart;
+  unsigned statsUpdates;
+  uint64_t statsStaleness;
+  unsigned statsMaxStaleness;
+  unsigned statsStalenessCount;
+};
+
+} // namespace rfb
+
+#endif
@@ -22,17 +22,23 @@
 #include <config.h>
 #endif
 
+#include <assert.h>
+
 #include <cstring>
 #include <sys/stat.h>
 
 #include <core/LogWriter.h>
 #include <core/string.h>
 #include <core/time.h>
+#include <core/WorkerThread.h>
 
 #include <rdr/FdInStream.h>
 #include <rdr/FdOutStream.h>
 
 #include <network/TcpSocket.h>
+#ifndef WIN32
+#include <network/UnixSocket.h>
+#endif
 
 #include <rfb/ComparingUpdateTracker.h>
 #include <rfb/Encoder.h>
@@ -42,11 +48,13 @@
 #include <rfb/SMsgWriter.h>
 #include <rfb/Security.h>
 #include <rfb/ServerCore.h>
+#include <rfb/SharedPixelBuffer.h>
 #include <rfb/VNCSConnectionST.h>
 #include <rfb/VNCServerST.h>
 #include <rfb/encodings.h>
 #include <rfb/fenceTypes.h>
 #include <rfb/ledStates.h>
+#include <rfb/msgTypes.h>
 #include <rfb/screenTypes.h>
 #define XK_LATIN1
 #define XK_MISCELLANY
@@ -60,16 +68,26 @@ static core::LogWriter vlog("VNCSConnST");
 static Cursor emptyCursor(0, 0, {0, 0}, nullptr);
 
 VNCSConnectionST::VNCSConnectionST(VNCServerST* server_, network::Socket* s, bool reverse, AccessRights ar)
-    : SConnection(ar), sock(s), reverseConnection(reverse), inProcessMessages(false), pendingSyncFence(false),
-      syncFence(false), fenceFlags(0), fenceDataLen(0), fenceData(nullptr), congestionTimer(this), losslessTimer(this),
-      server(server_), updateRenderedCursor(false), removeRenderedCursor(false), continuousUpdates(false),
-      encodeManager(this), updateCount_(0), idleTimer(this), pointerEventTime(0), clientHasCursor(false) {
+    : SConnection(ar), idListSync_(nullptr), idListSyncFailed_(false), sock(s), reverseConnection(reverse),
+      inProcessMessages(false), pendingSyncFence(false), syncFence(false), fenceFlags(0), fenceDataLen(0),
+      fenceData(nullptr), congestionTimer(this), losslessTimer(this), server(server_), updateRenderedCursor(false),
+      removeRenderedCursor(false), continuousUpdates(false), encodeManager(this), updateThread(nullptr),
+      updateTimer(this), updateOut(nullptr), updateBandwidth(0), deferredMessages(false), updateDeferred(false),
+      updateStartPos(0), sharedFB(nullptr), sharedGeneration(0), sharedFBFailed(false), updateCount_(0),
+      idleTimer(this), pointerEventTime(0), clientHasCursor(false) {
   // Record session start for aggregate per-client bandwidth statistics
   gettimeofday(&sessionStartTime_, nullptr);
 
   setStreams(&sock->inStream(), &sock->outStream());
   peerEndpoint = sock->getPeerEndpoint();
 
+  encodeManager.setSharedEncodes(server->getSharedEncodes());
+  encodeManager.setKeyDictionary(server->getKeyDictionary());
+  knownPersistentIds_.setDictionary(server->getKeyDictionary());
+
+  if (rfb::Server::clientThreads)
+    updateThread = new core::WorkerThread();
+
   // Kick off the idle timer
   if (rfb::Server::idleTimeout) {
     // minimum of 15 seconds while authenticating
@@ -81,6 +99,11 @@ VNCSConnectionST::VNCSConnectionST(VNCServerST* server_, network::Socket* s, boo
 }
 
 VNCSConnectionST::~VNCSConnectionST() {
+  abortThreadedUpdate();
+  delete updateThread;
+  delete idListSync_;
+  delete sharedFB;
+
   // If we reach here then VNCServerST is deleting us!
   if (!closeReason.empty())
     vlog.info("Closing %s: %s", peerEndpoint.c_str(), closeReason.c_str());
@@ -142,6 +165,9 @@ bool VNCSConnectionST::accessCheck(AccessRights ar) const {
 }
 
 void VNCSConnectionST::close(const char* reason) {
+  // Whatever the worker is writing will never be sent
+  abortThreadedUpdate();
+
   SConnection::close(reason);
 
   // Log the reason for the close
@@ -172,6 +198,12 @@ void VNCSConnectionST::processMessages() {
   if (state() == RFBSTATE_CLOSING)
     return;
   try {
+    if (updateInFlight()) {
+      if (!processInput() || (state() == RFBSTATE_CLOSING))
+        return;
+    }
+    deferredMessages = false;
+
     inProcessMessages = true;
 
     // Get the underlying transport to build large packets if we send
@@ -208,6 +240,59 @@ void VNCSConnectionST::processMessages() {
   }
 }
 
+// processInput() handles the messages that can be dealt with whilst
+// an update is in flight, i.e. key and pointer events, and responses to
+// our fences. Anything else might need the encoder or want to write
+// something, so it has to wait until the update is done. Returns true
+// if that has already happened and normal processing can continue.
+
+bool VNCSConnectionST::processInput() {
+  rdr::InStream* in;
+
+  in = getInStream();
+
+  while (updateInFlight()) {
+    const uint8_t* msg;
+    bool safe;
+
+    if (!in->hasData(1))
+      return false;
+
+    msg = in->getptr(1);
+    safe = (msg[0] == msgTypeKeyEvent) || (msg[0] == msgTypePointerEvent);
+
+    if (msg[0] == msgTypeClientFence) {
+      uint32_t flags;
+
+      if (!in->hasData(1 + 3 + 4))
+        return false;
+
+      msg = in->getptr(1 + 3 + 4);
+      flags = msg[4] << 24 | msg[5] << 16 | msg[6] << 8 | msg[7];
+      safe = !(flags & fenceFlagRequest);
+    }
+
+    if (safe) {
+      if (!processMsg())
+        return false;
+      continue;
+    }
+
+    deferredMessages = true;
+
+    // Keep draining the socket meanwhile, unless the client is
+    // flooding us
+    if (sock->inStream().avail() < 65536) {
+      sock->inStream().hasData(sock->inStream().avail() + 1);
+      return false;
+    }
+
+    finishThreadedUpdate();
+  }
+
+  return true;
+}
+
 void VNCSConnectionST::flushSocket() {
   if (state() == RFBSTATE_CLOSING)
     return;
@@ -224,6 +309,7 @@ void VNCSConnectionST::flushSocket() {
 
 void VNCSConnectionST::pixelBufferChange() {
   try {
+    finishThreadedUpdate();
     if (state() != RFBSTATE_NORMAL)
       return;
     if (client.width() && client.height() &&
@@ -261,6 +347,8 @@ void VNCSConnectionST::pixelBufferChange() {
     }
     // Just update the whole screen at the moment because we're too lazy to
     // work out what's actually changed.
+    encodeManager.noteFramebufferDamage(server->getPixelBuffer()->getRect());
+    snapshotDamage = server->getPixelBuffer()->getRect();
     updates.clear();
     updates.add_changed(server->getPixelBuffer()->getRect());
     writeFramebufferUpdate();
@@ -279,6 +367,7 @@ void VNCSConnectionST::writeFramebufferUpdateOrClose() {
 
 void VNCSConnectionST::screenLayoutChangeOrClose(uint16_t reason) {
   try {
+    finishThreadedUpdate();
     screenLayoutChange(reason);
     writeFramebufferUpdate();
   } catch (std::exception& e) {
@@ -288,8 +377,10 @@ void VNCSConnectionST::screenLayoutChangeOrClose(uint16_t reason) {
 
 void VNCSConnectionST::bellOrClose() {
   try {
-    if (state() == RFBSTATE_NORMAL)
-      writer()->writeBell();
+    if (state() != RFBSTATE_NORMAL)
+      return;
+    finishThreadedUpdate();
+    writer()->writeBell();
   } catch (std::exception& e) {
     close(e.what());
   }
@@ -297,6 +388,7 @@ void VNCSConnectionST::bellOrClose() {
 
 void VNCSConnectionST::setDesktopNameOrClose(const char* name) {
   try {
+    finishThreadedUpdate();
     setDesktopName(name);
     writeFramebufferUpdate();
   } catch (std::exception& e) {
@@ -306,6 +398,7 @@ void VNCSConnectionST::setDesktopNameOrClose(const char* name) {
 
 void VNCSConnectionST::setCursorOrClose() {
   try {
+    finishThreadedUpdate();
     setCursor();
     writeFramebufferUpdate();
   } catch (std::exception& e) {
@@ -315,6 +408,7 @@ void VNCSConnectionST::setCursorOrClose() {
 
 void VNCSConnectionST::setLEDStateOrClose(unsigned int state) {
   try {
+    finishThreadedUpdate();
     setLEDState(state);
     writeFramebufferUpdate();
   } catch (std::exception& e) {
@@ -326,6 +420,7 @@ void VNCSConnectionST::requestClipboardOrClose() {
   try {
     if (state() != RFBSTATE_NORMAL)
       return;
+    finishThreadedUpdate();
     requestClipboard();
   } catch (std::exception& e) {
     close(e.what());
@@ -336,6 +431,7 @@ void VNCSConnectionST::announceClipboardOrClose(bool available) {
   try {
     if (state() != RFBSTATE_NORMAL)
       return;
+    finishThreadedUpdate();
     announceClipboard(available);
   } catch (std::exception& e) {
     close(e.what());
@@ -346,6 +442,7 @@ void VNCSConnectionST::sendClipboardDataOrClose(const char* data) {
   try {
     if (state() != RFBSTATE_NORMAL)
       return;
+    finishThreadedUpdate();
     sendClipboardData(data);
   } catch (std::exception& e) {
     close(e.what());
@@ -362,6 +459,12 @@ void VNCSConnectionST::desktopReadyOrClose() {
   }
 }
 
+void VNCSConnectionST::writeDeferredUpdateOrClose() {
+  // If it still isn't time, then it gets deferred again
+  updateDeferred = false;
+  writeFramebufferUpdateOrClose();
+}
+
 bool VNCSConnectionST::getComparerState() {
   // We interpret a low compression level as an indication that the client
   // wants to prioritise CPU usage over bandwidth, and hence disable the
@@ -369,6 +472,16 @@ bool VNCSConnectionST::getComparerState() {
   return (client.compressLevel == -1) || (client.compressLevel > 1);
 }
 
+int VNCSConnectionST::msToUpdateDue() {
+  struct timeval now;
+
+  if (!updateDeferred)
+    return -1;
+
+  gettimeofday(&now, nullptr);
+  return pacer.msToNextUpdate(&now, getBandwidthEstimate(), rfb::Server::frameRate);
+}
+
 // renderedCursorChange() is called whenever the server-side rendered cursor
 // changes shape or position.  It ensures that the next update will clean up
 // the old rendered cursor and if necessary draw the new rendered cursor.
@@ -393,9 +506,45 @@ void VNCSConnectionST::renderedCursorChange() {
 // it will arrange for the new cursor position to be sent to the client.
 
 void VNCSConnectionST::cursorPositionChange() {
+  try {
+    finishThreadedUpdate();
+  } catch (std::exception& e) {
+    close(e.what());
+    return;
+  }
   setCursorPos();
 }
 
+void VNCSConnectionST::add_changed(const core::Region& region) {
+  if (updateInFlight())
+    deferredDamage.assign_union(region);
+  else
+    encodeManager.noteFramebufferDamage(region);
+  if (updateThread != nullptr)
+    snapshotDamage.assign_union(region);
+  if (!region.is_empty()) {
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    pacer.noteDamage(&now);
+  }
+  updates.add_changed(region);
+}
+
+void VNCSConnectionST::add_copied(const core::Region& dest, const core::Point& delta) {
+  if (updateInFlight())
+    deferredDamage.assign_union(dest);
+  else
+    encodeManager.noteFramebufferDamage(dest);
+  if (updateThread != nullptr)
+    snapshotDamage.assign_union(dest);
+  if (!dest.is_empty()) {
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    pacer.noteDamage(&now);
+  }
+  updates.add_copied(dest, delta);
+}
+
 // needRenderedCursor() returns true if this client needs the server-side
 // rendered cursor.  This may be because it does not support local cursor or
 // because the current cursor position has not been set by this client.
@@ -442,6 +591,7 @@ void VNCSConnectionST::desktopReady() {
 
 void VNCSConnectionST::approveConnectionOrClose(bool accept, const char* reason) {
   try {
+    finishThreadedUpdate();
     approveConnection(accept, reason);
   } catch (std::exception& e) {
     close(e.what());
@@ -496,11 +646,8 @@ void VNCSConnectionST::setEncodings(int nEncodings, const int32_t* encodings) {
   // EncodeManager may not yet have been configured to use the protocol.
   // Re-apply any known IDs here so the first updates can use references
   // rather than sending unnecessary INITs.
-  if (clientWantsPersistent && Server::enablePersistentCache && !knownPersistentIds_.empty()) {
-    for (uint64_t id : knownPersistentIds_) {
-      encodeManager.addClientKnownHash(id);
-    }
-  }
+  if (clientWantsPersistent && Server::enablePersistentCache && !knownPersistentIds_.empty())
+    encodeManager.addClientKnownHashes(knownPersistentIds_.getKeys());
 
   if (clientWantsPersistent && Server::enablePersistentCache) {
     vlog.info("PersistentCache enabled for this connection (server allows persistence)");
@@ -829,6 +976,20 @@ void VNCSConnectionST::handleTimeout(core::Timer* t) {
   try {
     if ((t == &congestionTimer) || (t == &losslessTimer))
       writeFramebufferUpdate();
+
+    if (t == &updateTimer) {
+      if (!updateThread->finished()) {
+        t->repeat();
+        return;
+      }
+
+      finishThreadedUpdate();
+
+      if (deferredMessages)
+        processMessages();
+      else
+        writeFramebufferUpdate();
+    }
   } catch (std::exception& e) {
     close(e.what());
   }
@@ -859,7 +1020,7 @@ void VNCSConnectionST::handlePersistentCacheQuery(const std::vector<uint64_t>& c
 
   // Track requested IDs so the encoder can choose to send inits
   for (uint64_t id : cacheIds) {
-    clientRequestedPersistentIds_.insert(id);
+    clientRequestedPersistentIds_.add(id);
 
     // Trigger targeted refresh if we know where this ID was used.
     // This ensures the encoder revisits the region and sends an INIT.
@@ -879,13 +1040,106 @@ void VNCSConnectionST::handlePersistentHashList(uint32_t sequenceId, uint16_t to
 
   // Treat the advertised ID list as authoritative for this session so the
   // encoder can emit references immediately (avoids unnecessary INITs on reconnect).
-  for (uint64_t id : cacheIds) {
-    // Mark as known in unified tracking and in the encoder.
-    markPersistentIdKnown(id);
-    encodeManager.addClientKnownHash(id);
-  }
+  knownPersistentIds_.addMultiple(cacheIds);
+  encodeManager.addClientKnownHashes(cacheIds);
   vlog.info("Received ID list: %d IDs (session tracking now has %zu total)", (int)cacheIds.size(),
             knownPersistentIds_.size());
+
+  // Viewers only use the HashList until they know we understand ID
+  // lists, so answer with an epoch to let them switch next time
+  if (!client.supportsEncoding(pseudoEncodingPersistentCacheEpoch))
+    return;
+
+  cache::CacheEpochStore* epochs;
+
+  epochs = server->getCacheEpochs();
+
+  if (chunkIndex == 0) {
+    delete idListSync_;
+    idListSync_ = new cache::KnownKeySet(epochs->getDictionary());
+    idListSyncFailed_ = false;
+  }
+
+  if (idListSync_ != nullptr)
+    idListSync_->addMultiple(cacheIds);
+
+  if (chunkIndex + 1 != totalChunks)
+    return;
+
+  uint64_t token;
+
+  token = 0;
+  if (idListSync_ != nullptr) {
+    token = epochs->store(idListSync_);
+    idListSync_ = nullptr;
+  }
+
+  writer()->writePersistentCacheEpoch(token);
+}
+
+void VNCSConnectionST::handlePersistentIdList(uint8_t flags, uint64_t baseToken, uint16_t totalChunks,
+                                              uint16_t chunkIndex, const std::vector<uint64_t>& cacheIds) {
+  cache::CacheEpochStore* epochs;
+
+  vlog.debug("Client sent %zu persistent cache IDs (chunk %d/%d, flags 0x%x)", cacheIds.size(), chunkIndex + 1,
+             totalChunks, flags);
+
+  epochs = server->getCacheEpochs();
+
+  if (chunkIndex == 0) {
+    delete idListSync_;
+    idListSync_ = nullptr;
+    idListSyncFailed_ = false;
+
+    if (flags & idListFlagDelta) {
+      idListSync_ = epochs->take(baseToken);
+      if (idListSync_ == nullptr) {
+        // Probably restarted or evicted since; the viewer will fall
+        // back to a full list once it sees the zero token
+        vlog.info("Unknown cache epoch in ID list delta, requesting full list");
+        idListSyncFailed_ = true;
+      } else {
+        std::vector<uint64_t> base;
+
+        base = idListSync_->getKeys();
+        knownPersistentIds_.addMultiple(base);
+        encodeManager.addClientKnownHashes(base);
+      }
+    } else {
+      idListSync_ = new cache::KnownKeySet(epochs->getDictionary());
+    }
+  }
+
+  // Even a failed delta tells us something about the client's cache
+  if (flags & idListFlagRemoved) {
+    if (idListSync_ != nullptr)
+      idListSync_->removeMultiple(cacheIds);
+    for (uint64_t id : cacheIds) {
+      knownPersistentIds_.remove(id);
+      encodeManager.removeClientKnownHash(id);
+    }
+  } else {
+    if (idListSync_ != nullptr)
+      idListSync_->addMultiple(cacheIds);
+    knownPersistentIds_.addMultiple(cacheIds);
+    encodeManager.addClientKnownHashes(cacheIds);
+  }
+
+  if (chunkIndex + 1 != totalChunks)
+    return;
+
+  uint64_t token;
+
+  token = 0;
+  if (idListSync_ != nullptr && !idListSyncFailed_) {
+    token = epochs->store(idListSync_);
+    idListSync_ = nullptr;
+  }
+
+  vlog.info("Received ID list: session tracking now has %zu IDs", knownPersistentIds_.size());
+
+  if (client.supportsEncoding(pseudoEncodingPersistentCacheEpoch))
+    writer()->writePersistentCacheEpoch(token);
 }
 
 void VNCSConnectionST::handlePersistentCacheEviction(const std::vector<uint64_t>& cacheIds) {
@@ -896,11 +1150,9 @@ void VNCSConnectionST::handlePersistentCacheEviction(const std::vector<uint64_t>
   size_t removed = 0;
   for (uint64_t id : cacheIds) {
     encodeManager.removeClientKnownHash(id);
-    knownPersistentIds_.erase(id);
+    knownPersistentIds_.remove(id);
     lastCachedRectRef_.erase(id);
-    auto it = clientRequestedPersistentIds_.find(id);
-    if (it != clientRequestedPersistentIds_.end())
-      clientRequestedPersistentIds_.erase(it);
+    clientRequestedPersistentIds_.remove(id);
     removed++;
   }
 
@@ -984,7 +1236,7 @@ void VNCSConnectionST::handleDebugDumpRequest(uint32_t timestamp) {
     // Dump first 50 known persistent IDs
     fprintf(f, "\n=== Known Persistent IDs (first 50) ===\n");
     int count = 0;
-    for (const auto& id : knownPersistentIds_) {
+    for (const auto& id : knownPersistentIds_.getKeys()) {
       fprintf(f, "  %016llx\n", (unsigned long long)id);
       if (++count >= 50) {
         fprintf(f, "  ... (%zu total)\n", knownPersistentIds_.size());
@@ -1072,6 +1324,10 @@ bool VNCSConnectionST::isCongested() {
 }
 
 void VNCSConnectionST::writeFramebufferUpdate() {
+  // We'll be back once the worker is done with the previous update
+  if (updateInFlight())
+    return;
+
   congestion.updatePosition(sock->outStream().length());
 
   // We're in the middle of processing a command that's supposed to be
@@ -1129,6 +1385,7 @@ void VNCSConnectionST::writeDataUpdate() {
   UpdateInfo ui;
   bool needNewUpdateInfo;
   const RenderedCursor* cursor;
+  struct timeval now;
 
   // See what the client has requested (if anything)
   if (continuousUpdates)
@@ -1139,6 +1396,11 @@ void VNCSConnectionST::writeDataUpdate() {
   if (req.is_empty())
     return;
 
+  // A client that cannot keep up with the frame rate is better off
+  // with fewer updates than with a growing backlog of stale ones
+  if (!updates.is_empty() && !updateDue())
+    return;
+
   // Get the lists of updates. Prior to exporting the data to the `ui' object,
   // getUpdateInfo() will normalize the `updates' object such way that its
   // `changed' and `copied' regions would not intersect.
@@ -1222,8 +1484,30 @@ void VNCSConnectionST::writeDataUpdate() {
 
   // We have something to send, so let's get to it
 
+  gettimeofday(&now, nullptr);
+  pacer.startUpdate(&now);
+  updateStartPos = sock->outStream().length();
+
   writeRTTPing();
 
+  // Nothing to encode for a client with a shared framebuffer
+  if (writeSharedUpdate(ui, cursor)) {
+    writeRTTPing();
+
+    updates.subtract(req);
+    requested.clear();
+
+    updateSent();
+    return;
+  }
+
+  if (updateThread != nullptr) {
+    startThreadedUpdate(ui, cursor != nullptr);
+    updates.subtract(req);
+    requested.clear();
+    return;
+  }
+
   encodeManager.writeUpdate(ui, server->getPixelBuffer(), cursor);
 
   writeRTTPing();
@@ -1234,10 +1518,141 @@ void VNCSConnectionST::writeDataUpdate() {
 
   requested.clear();
 
+  updateSent();
+}
+
+// writeSharedUpdate() copies the changes to the client's shared
+// framebuffer, and only tells it where they are. Returns false if the
+// client can't have one, and the update needs encoding as usual.
+
+bool VNCSConnectionST::writeSharedUpdate(const UpdateInfo& ui, const RenderedCursor* cursor) {
+  const PixelBuffer* pb;
+  bool usable, setup;
+  core::Region damage, copy;
+  std::vector<core::Rect> rects;
+  int nRects;
+
+  usable = rfb::Server::sharedMemory && !sharedFBFailed && client.supportsEncoding(pseudoEncodingSharedMemory) &&
+           client.supportsEncoding(encodingSharedMemory);
+#ifdef WIN32
+  usable = false;
+#else
+  // The file descriptor can only be passed over a Unix socket
+  if (dynamic_cast<network::UnixSocket*>(sock) == nullptr)
+    usable = false;
+#endif
+
+  if (!usable) {
+    delete sharedFB;
+    sharedFB = nullptr;
+    return false;
+  }
+
+  pb = server->getPixelBuffer();
+
+  setup = false;
+  if ((sharedFB == nullptr) || (sharedFB->getRect() != pb->getRect()) || (sharedFB->getPF() != client.pf())) {
+    delete sharedFB;
+    sharedFB = nullptr;
+
+    try {
+      sharedFB = new SharedPixelBuffer(client.pf(), pb->width(), pb->height());
+    } catch (std::exception& e) {
+      vlog.error("%s: unable to use shared memory: %s", peerEndpoint.c_str(), e.what());
+      sharedFBFailed = true;
+      return false;
+    }
+
+    sharedGeneration++;
+    setup = true;
+
+    vlog.info("%s: using a %dx%d shared framebuffer (generation %u)", peerEndpoint.c_str(), pb->width(),
+              pb->height(), sharedGeneration);
+  }
+
+  damage = ui.changed.union_(ui.copied);
+
+  // A new buffer has to be filled completely, but the client still
+  // only needs to hear about what has changed
+  if (setup)
+    copy = pb->getRect();
+  else
+    copy = damage;
+
+  copy.get_rects(&rects);
+  for (const core::Rect& r : rects) {
+    const uint8_t* data;
+    int stride;
+
+    data = pb->getBuffer(r, &stride);
+    sharedFB->imageRect(pb->getPF(), r, data, stride);
+  }
+
+  if (cursor != nullptr) {
+    copy.intersect(cursor->getEffectiveRect()).get_rects(&rects);
+    for (const core::Rect& r : rects) {
+      const uint8_t* data;
+      int stride;
+
+      data = cursor->getBuffer(r, &stride);
+      sharedFB->imageRect(cursor->getPF(), r, data, stride);
+    }
+  }
+
+  damage.get_rects(&rects);
+
+  nRects = rects.size();
+  if (setup)
+    nRects++;
+
+  writer()->writeFramebufferUpdateStart(nRects);
+
+  if (setup) {
+    sock->outStream().passFd(sharedFB->dupFd());
+    writer()->writeSharedMemorySetup(sharedGeneration, sharedFB);
+  }
+
+  for (const core::Rect& r : rects)
+    writer()->writeSharedMemoryRect(r, sharedGeneration);
+
+  writer()->writeFramebufferUpdateEnd();
+
+  return true;
+}
+
+bool VNCSConnectionST::updateDue() {
+  struct timeval now;
+
+  if (!rfb::Server::adaptiveUpdateRate)
+    return true;
+
+  gettimeofday(&now, nullptr);
+  if (pacer.msToNextUpdate(&now, getBandwidthEstimate(), rfb::Server::frameRate) == 0) {
+    updateDeferred = false;
+    return true;
+  }
+
+  updateDeferred = true;
+  server->schedulePacedUpdates();
+
+  return false;
+}
+
+void VNCSConnectionST::updateSent() {
+  struct timeval now;
+  UpdatePacer::Stats stats;
+
   // Frame update completed successfully - confirm any pending cache IDs
   // (viewer didn't send RequestCachedData, so it has these IDs)
   confirmPendingIds();
 
+  gettimeofday(&now, nullptr);
+  pacer.updateSent(&now, sock->outStream().length() - updateStartPos, getBandwidthEstimate(), congestion.getMinRTT());
+  if (pacer.takeStats(&now, getBandwidthEstimate(), rfb::Server::frameRate, &stats)) {
+    vlog.debug("%s: %.1f updates/s (%.1f possible), changes were %u ms old on arrival on average, %u ms at most",
+               peerEndpoint.c_str(), stats.updateRate, stats.targetRate, stats.avgStaleness, stats.maxStaleness);
+  }
+
   // Periodic cache tracking logging (every 100 updates)
   updateCount_++;
   if (updateCount_ % 100 == 0) {
@@ -1300,8 +1715,9 @@ void VNCSConnectionST::writeLosslessRefresh() {
   if (nextUpdate == 0)
     return;
 
-  // FIXME: Bandwidth estimation without congestion control
-  bandwidth = congestion.getBandwidth();
+  // The refresh fills otherwise idle time on the link, so it can go
+  // as fast as we are currently probing for
+  bandwidth = congestion.getPacingRate();
 
   // FIXME: Hard coded value for maximum CPU throughput
   if (bandwidth > 5000000)
@@ -1318,6 +1734,126 @@ void VNCSConnectionST::writeLosslessRefresh() {
   requested.clear();
 }
 
+bool VNCSConnectionST::updateInFlight() {
+  return (updateThread != nullptr) && updateThread->busy();
+}
+
+void VNCSConnectionST::startThreadedUpdate(const UpdateInfo& ui, bool renderCursor) {
+  const RenderedCursor* cursor;
+
+  assert(!updateInFlight());
+
+  // The worker must not see the framebuffer change under its feet, so
+  // it gets a copy that we only touch between updates
+  syncSnapshot();
+
+  cursor = nullptr;
+  if (renderCursor) {
+    snapshotCursor.update(&snapshot, const_cast<Cursor*>(server->getCursor()), server->getCursorPos());
+    cursor = &snapshotCursor;
+  }
+
+  // Fence responses are still processed meanwhile
+  updateBandwidth = congestion.getBandwidth();
+
+  updateOut = getOutStream();
+  updateBuffer.clear();
+  setStreams(getInStream(), &updateBuffer);
+  writer()->setOutStream(&updateBuffer);
+
+  encodeManager.beginThreadedUpdate();
+
+  updateThread->start([this, ui, cursor]() { encodeManager.writeUpdate(ui, &snapshot, cursor); });
+
+  updateTimer.start(1);
+}
+
+void VNCSConnectionST::finishThreadedUpdate() {
+  if (!updateInFlight())
+    return;
+
+  updateTimer.stop();
+
+  try {
+    updateThread->wait();
+  } catch (std::exception&) {
+    abortThreadedUpdate();
+    throw;
+  }
+
+  setStreams(getInStream(), updateOut);
+  writer()->setOutStream(updateOut);
+  updateOut = nullptr;
+  encodeManager.endThreadedUpdate();
+
+  if (!deferredDamage.is_empty()) {
+    encodeManager.noteFramebufferDamage(deferredDamage);
+    deferredDamage.clear();
+  }
+
+  getOutStream()->cork(true);
+
+  getOutStream()->writeBytes(updateBuffer.data(), updateBuffer.length());
+  updateBuffer.clear();
+
+  writeRTTPing();
+
+  getOutStream()->cork(false);
+
+  congestion.updatePosition(sock->outStream().length());
+
+  updateSent();
+}
+
+void VNCSConnectionST::abortThreadedUpdate() {
+  // Also called after a failed wait(), when the thread is already idle
+  if (updateOut == nullptr)
+    return;
+
+  updateTimer.stop();
+
+  try {
+    updateThread->wait();
+  } catch (std::exception& e) {
+    vlog.debug("Discarding failed update for %s: %s", peerEndpoint.c_str(), e.what());
+  }
+
+  setStreams(getInStream(), updateOut);
+  writer()->setOutStream(updateOut);
+  updateOut = nullptr;
+  encodeManager.endThreadedUpdate();
+
+  encodeManager.noteFramebufferDamage(deferredDamage);
+  deferredDamage.clear();
+
+  updateBuffer.clear();
+}
+
+void VNCSConnectionST::syncSnapshot() {
+  const PixelBuffer* pb;
+  std::vector<core::Rect> rects;
+
+  pb = server->getPixelBuffer();
+
+  if ((snapshot.getPF() != pb->getPF()) || (snapshot.getRect() != pb->getRect())) {
+    snapshot.setPF(pb->getPF());
+    snapshot.setSize(pb->width(), pb->height());
+    snapshotDamage = pb->getRect();
+  }
+
+  snapshotDamage.assign_intersect(pb->getRect());
+  snapshotDamage.get_rects(&rects);
+  for (const core::Rect& r : rects) {
+    const uint8_t* data;
+    int stride;
+
+    data = pb->getBuffer(r, &stride);
+    snapshot.imageRect(r, data, stride);
+  }
+
+  snapshotDamage.clear();
+}
+
 void VNCSConnectionST::screenLayoutChange(uint16_t reason) {
   if (state() != RFBSTATE_NORMAL)
     return;
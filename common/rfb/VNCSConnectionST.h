@@ -33,11 +33,23 @@
 
 #include <core/Timer.h>
 
+#include <rdr/MemOutStream.h>
+
 #include <rfb/Congestion.h>
+#include <rfb/Cursor.h>
 #include <rfb/EncodeManager.h>
+#include <rfb/PixelBuffer.h>
 #include <rfb/SConnection.h>
+#include <rfb/UpdatePacer.h>
+#include <rfb/cache/CacheKeyDictionary.h>
+#include <rfb/cache/ServerHashSet.h>
+
+namespace core {
+class WorkerThread;
+}
 
 namespace rfb {
+class SharedPixelBuffer;
 class VNCServerST;
 
 class VNCSConnectionST : private SConnection, public core::Timer::Callback {
@@ -83,9 +95,15 @@ public:
   void announceClipboardOrClose(bool available);
   void sendClipboardDataOrClose(const char* data);
   void desktopReadyOrClose();
+  void writeDeferredUpdateOrClose();
 
   // The following methods never throw exceptions
 
+  // msToUpdateDue() returns the number of milliseconds until the update
+  // held back because of AdaptiveUpdateRate can be sent, or -1 if no
+  // update is being held back.
+  int msToUpdateDue();
+
   // getComparerState() returns if this client would like the framebuffer
   // comparer to be enabled.
   bool getComparerState();
@@ -110,14 +128,15 @@ public:
     return sock;
   }
 
+  // Memory used by this client's share of the known cache IDs
+  size_t getKnownKeyMemory() const {
+    return knownPersistentIds_.memoryUsage() + encodeManager.getKnownKeyMemory();
+  }
+
   // Change tracking
 
-  void add_changed(const core::Region& region) {
-    updates.add_changed(region);
-  }
-  void add_copied(const core::Region& dest, const core::Point& delta) {
-    updates.add_copied(dest, delta);
-  }
+  void add_changed(const core::Region& region);
+  void add_copied(const core::Region& dest, const core::Point& delta);
 
   const char* getPeerEndpoint() const {
     return peerEndpoint.c_str();
@@ -152,18 +171,18 @@ private:
   void handlePersistentCacheQuery(const std::vector<uint64_t>& cacheIds) override;
   void handlePersistentHashList(uint32_t sequenceId, uint16_t totalChunks, uint16_t chunkIndex,
                                 const std::vector<uint64_t>& cacheIds) override;
+  void handlePersistentIdList(uint8_t flags, uint64_t baseToken, uint16_t totalChunks, uint16_t chunkIndex,
+                              const std::vector<uint64_t>& cacheIds) override;
   void handlePersistentCacheEviction(const std::vector<uint64_t>& cacheIds) override;
   void handlePersistentCacheHashReport(const CacheKey& canonicalKey, const CacheKey& actualKey) override;
   void handleDebugDumpRequest(uint32_t timestamp) override;
 
   // PersistentCache request helpers used by encoder
   bool clientRequestedPersistent(uint64_t id) const override {
-    return clientRequestedPersistentIds_.find(id) != clientRequestedPersistentIds_.end();
+    return clientRequestedPersistentIds_.has(id);
   }
   void clearClientPersistentRequest(uint64_t id) override {
-    auto it = clientRequestedPersistentIds_.find(id);
-    if (it != clientRequestedPersistentIds_.end())
-      clientRequestedPersistentIds_.erase(it);
+    clientRequestedPersistentIds_.remove(id);
   }
 
   // Unified cache ID tracking for both ContentCache and PersistentCache.
@@ -171,12 +190,12 @@ private:
   // ephemeral policy of the same engine. We therefore treat "persistent"
   // and "content" IDs as aliases over a single ID space.
   bool knowsPersistentId(uint64_t id) const override {
-    return (knownPersistentIds_.find(id) != knownPersistentIds_.end());
+    return knownPersistentIds_.has(id);
   }
 
   // Record that the client now knows this cache ID (INIT/seed sent).
   void markPersistentIdKnown(uint64_t id) override {
-    knownPersistentIds_.insert(id);
+    knownPersistentIds_.add(id);
   }
 
   // Lossy hash cache management
@@ -192,6 +211,12 @@ private:
     return false;
   }
 
+  size_t getBandwidthEstimate() override {
+    if (updateInFlight())
+      return updateBandwidth;
+    return congestion.getBandwidth();
+  }
+
   // Viewer confirmation tracking
   bool viewerHasConfirmed(uint64_t id) const {
     return viewerConfirmedCache_.find(id) != viewerConfirmedCache_.end();
@@ -213,11 +238,16 @@ private:
   }
 
 private:
-  std::unordered_set<uint64_t> clientRequestedPersistentIds_;
+  ServerHashSet<uint64_t> clientRequestedPersistentIds_;
 
   // Session-scoped tracking of persistent IDs known by client
   // (from initial inventory OR sent via PersistentCachedRectInit this session)
-  std::unordered_set<uint64_t> knownPersistentIds_;
+  cache::KnownKeySet knownPersistentIds_;
+
+  // Snapshot being built from an incoming ID list, which is handed to
+  // the server's epoch store once the last chunk has arrived
+  cache::KnownKeySet* idListSync_;
+  bool idListSyncFailed_;
 
   // Lossy hash cache: canonical hash (lossless) -> lossy hash (post-decode)
   // Used when encoding with lossy compression (e.g. JPEG) to map from
@@ -256,6 +286,19 @@ private:
   void writeNoDataUpdate();
   void writeDataUpdate();
   void writeLosslessRefresh();
+  bool writeSharedUpdate(const UpdateInfo& ui, const RenderedCursor* cursor);
+  bool updateDue();
+  void updateSent();
+
+  // Threaded updates (ClientThreads). Whilst an update is in flight
+  // the worker owns the encoder and the protocol writer, so anything
+  // else that wants to write to the client must finish it first.
+  bool updateInFlight();
+  bool processInput();
+  void startThreadedUpdate(const UpdateInfo& ui, bool renderCursor);
+  void finishThreadedUpdate();
+  void abortThreadedUpdate();
+  void syncSnapshot();
 
   void screenLayoutChange(uint16_t reason);
   void setCursor();
@@ -289,6 +332,27 @@ private:
   core::Region cuRegion;
   EncodeManager encodeManager;
 
+  core::WorkerThread* updateThread;
+  core::Timer updateTimer;
+  ManagedPixelBuffer snapshot; // Stable copy of the framebuffer for the worker
+  core::Region snapshotDamage;
+  RenderedCursor snapshotCursor;
+  core::Region deferredDamage; // Not yet seen by encodeManager
+  rdr::MemOutStream updateBuffer;
+  rdr::OutStream* updateOut; // Real stream whilst an update is in flight
+  size_t updateBandwidth;
+  bool deferredMessages;
+
+  // Per client update rate (AdaptiveUpdateRate)
+  UpdatePacer pacer;
+  bool updateDeferred;
+  size_t updateStartPos;
+
+  // Framebuffer in shared memory (SharedMemory)
+  SharedPixelBuffer* sharedFB;
+  uint32_t sharedGeneration;
+  bool sharedFBFailed;
+
   // Track last referenced rectangle per cacheId for targeted refresh on miss
   std::unordered_map<uint64_t, core::Rect> lastCachedRectRef_;
 
@@ -54,6 +54,7 @@
 #include <stdlib.h>
 
 #include <core/LogWriter.h>
+#include <core/string.h>
 #include <core/time.h>
 
 #include <rdr/FdOutStream.h>
@@ -86,7 +87,8 @@ VNCServerST::VNCServerST(const char* name_, SDesktop* desktop_)
       pb(nullptr), ledState(ledUnknown), name(name_), pointerClient(nullptr), clipboardClient(nullptr),
       pointerClientTime(0), comparer(nullptr), cursor(new Cursor(0, 0, {}, nullptr)), renderedCursorInvalid(false),
       keyRemapper(&KeyRemapper::defInstance), idleTimer(this), disconnectTimer(this), connectTimer(this), msc(0),
-      queuedMsc(0), frameTimer(this) {
+      queuedMsc(0), frameTimer(this), pacingTimer(this), cacheEpochs(&keyDictionary), updateCpuTime(0),
+      updateFrames(0), updateClients(0) {
   slog.debug("Creating single-threaded server %s", name.c_str());
 
   desktop_->init(this);
@@ -271,6 +273,8 @@ void VNCServerST::setPixelBuffer(PixelBuffer* pb_, const ScreenSet& layout) {
   delete comparer;
   comparer = nullptr;
 
+  sharedEncodes.setFramebuffer(pb);
+
   if (!pb) {
     screenLayout = ScreenSet();
 
@@ -441,6 +445,7 @@ void VNCServerST::add_changed(const core::Region& region) {
     return;
 
   comparer->add_changed(region);
+  sharedEncodes.invalidate(region);
   startFrameClock();
 }
 
@@ -449,6 +454,7 @@ void VNCServerST::add_copied(const core::Region& dest, const core::Point& delta)
     return;
 
   comparer->add_copied(dest, delta);
+  sharedEncodes.invalidate(dest);
   startFrameClock();
 }
 
@@ -697,6 +703,14 @@ void VNCServerST::handleTimeout(core::Timer* t) {
 
     msc++;
     desktop->frameTick(msc);
+  } else if (t == &pacingTimer) {
+    // Everyone who is due around now is handled on the same wakeup
+    for (VNCSConnectionST* client : clients) {
+      if (client->msToUpdateDue() == 0)
+        client->writeDeferredUpdateOrClose();
+    }
+
+    schedulePacedUpdates();
   } else if (t == &idleTimer) {
     slog.info("MaxIdleTime reached, exiting");
     desktop->terminate();
@@ -833,6 +847,32 @@ int VNCServerST::msToNextUpdate() {
     return frameTimer.getRemainingMs();
 }
 
+void VNCServerST::schedulePacedUpdates() {
+  int next;
+
+  next = -1;
+  for (VNCSConnectionST* client : clients) {
+    int ms;
+
+    ms = client->msToUpdateDue();
+    if (ms < 0)
+      continue;
+
+    if ((next < 0) || (ms < next))
+      next = ms;
+  }
+
+  if (next < 0) {
+    pacingTimer.stop();
+    return;
+  }
+
+  if (pacingTimer.isStarted() && (pacingTimer.getRemainingMs() <= next))
+    return;
+
+  pacingTimer.start(next);
+}
+
 // writeUpdate() is called on a regular interval in order to see what
 // updates are pending and propagates them to the update tracker for
 // each client. It uses the ComparingUpdateTracker's compare() method
@@ -843,6 +883,7 @@ int VNCServerST::msToNextUpdate() {
 void VNCServerST::writeUpdate() {
   UpdateInfo ui;
   core::Region toCheck;
+  clock_t start;
 
   std::list<VNCSConnectionST*>::iterator ci;
 
@@ -874,11 +915,46 @@ void VNCServerST::writeUpdate() {
 
   comparer->clear();
 
+  start = clock();
+
   for (ci = clients.begin(); ci != clients.end(); ++ci) {
     (*ci)->add_copied(ui.copied, ui.copy_delta);
     (*ci)->add_changed(ui.changed);
     (*ci)->writeFramebufferUpdateOrClose();
   }
+
+  updateCpuTime += clock() - start;
+  updateFrames++;
+  updateClients += clients.size();
+
+  if (updateFrames >= 256) {
+    SharedEncodeCache::Stats stats;
+
+    stats = sharedEncodes.takeStats();
+    slog.debug("Updates for %.1f clients (%u groups) took %.2f ms of CPU per frame, "
+               "%u of %u rects shared",
+               (double)updateClients / updateFrames, sharedEncodes.groupCount(),
+               1000.0 * updateCpuTime / CLOCKS_PER_SEC / updateFrames, stats.hits, stats.lookups);
+
+    if (keyDictionary.size() != 0) {
+      size_t clientBytes;
+
+      clientBytes = 0;
+      for (ci = clients.begin(); ci != clients.end(); ++ci)
+        clientBytes += (*ci)->getKnownKeyMemory();
+
+      slog.debug("%zu known cache IDs use %s shared and %s across %zu clients", keyDictionary.size(),
+                 core::iecPrefix(keyDictionary.memoryUsage(), "B").c_str(), core::iecPrefix(clientBytes, "B").c_str(),
+                 clients.size());
+      if (cacheEpochs.size() != 0)
+        slog.debug("%zu cache epoch snapshots use %s", cacheEpochs.size(),
+                   core::iecPrefix(cacheEpochs.memoryUsage(), "B").c_str());
+    }
+
+    updateCpuTime = 0;
+    updateFrames = 0;
+    updateClients = 0;
+  }
 }
 
 // checkUpdate() is called by clients to see if it is safe to read from
@@ -25,13 +25,17 @@
 #define __RFB_VNCSERVERST_H__
 
 #include <sys/time.h>
+#include <time.h>
 
 #include <core/Timer.h>
 
 #include <rfb/Blacklist.h>
 #include <rfb/Cursor.h>
 #include <rfb/ScreenSet.h>
+#include <rfb/SharedEncodeCache.h>
 #include <rfb/VNCServer.h>
+#include <rfb/cache/CacheEpochStore.h>
+#include <rfb/cache/CacheKeyDictionary.h>
 
 namespace rfb {
 
@@ -156,6 +160,10 @@ public:
   // to clients
   int msToNextUpdate();
 
+  // schedulePacedUpdates() makes sure we wake up in time for the next
+  // client whose updates are held back because of AdaptiveUpdateRate
+  void schedulePacedUpdates();
+
   // Part of the framebuffer that has been modified but is not yet
   // ready to be sent to clients
   core::Region getPendingRegion();
@@ -164,6 +172,21 @@ public:
   // side rendered cursor buffer
   const RenderedCursor* getRenderedCursor();
 
+  // Encoded rects that clients with identical settings can share
+  SharedEncodeCache* getSharedEncodes() {
+    return &sharedEncodes;
+  }
+
+  // Cache IDs known by clients, stored once for all of them
+  cache::CacheKeyDictionary* getKeyDictionary() {
+    return &keyDictionary;
+  }
+
+  // Snapshots of advertised cache IDs, for delta sync on reconnect
+  cache::CacheEpochStore* getCacheEpochs() {
+    return &cacheEpochs;
+  }
+
 protected:
   // Timer callbacks
   void handleTimeout(core::Timer* t) override;
@@ -222,6 +245,16 @@ protected:
 
   uint64_t msc, queuedMsc;
   core::Timer frameTimer;
+  core::Timer pacingTimer;
+
+  SharedEncodeCache sharedEncodes;
+  cache::CacheKeyDictionary keyDictionary;
+  cache::CacheEpochStore cacheEpochs;
+
+  // Cost of sending out updates, relative to the number of clients
+  clock_t updateCpuTime;
+  unsigned updateFrames;
+  unsigned updateClients;
 };
 
 }; // namespace rfb
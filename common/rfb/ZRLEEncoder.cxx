@@ -28,6 +28,7 @@
 #include <rfb/Palette.h>
 #include <rfb/PixelBuffer.h>
 #include <rfb/SConnection.h>
+#include <rfb/ServerCore.h>
 #include <rfb/ZRLEEncoder.h>
 #include <rfb/encodings.h>
 
@@ -71,6 +72,8 @@ void ZRLEEncoder::writeRect(const PixelBuffer* pb, const Palette& palette) {
     return;
   }
 
+  zos.setThreads(Server::compressThreads);
+
   for (y = 0; y < pb->height(); y += 64) {
     tile.tl.y = y;
     tile.br.y = y + 64;
@@ -94,7 +97,7 @@ void ZRLEEncoder::writeRect(const PixelBuffer* pb, const Palette& palette) {
 
   zos.flush();
 
-  os = conn->getOutStream();
+  os = getOutStream();
 
   os->writeU32(mos.length());
   os->writeBytes(mos.data(), mos.length());
@@ -116,7 +119,7 @@ void ZRLEEncoder::writeSolidRect(int width, int height, const PixelFormat& pf, c
 
   zos.flush();
 
-  os = conn->getOutStream();
+  os = getOutStream();
 
   os->writeU32(mos.length());
   os->writeBytes(mos.data(), mos.length());
@@ -0,0 +1,106 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include <sys/time.h>
+
+#include <core/time.h>
+
+#include <rfb/PixelBuffer.h>
+#include <rfb/cache/BorderedRegionTracker.h>
+
+using namespace rfb;
+using namespace rfb::cache;
+
+BorderedRegionTracker::BorderedRegionTracker(int minBorderWidth_, int minArea_)
+    : minBorderWidth(minBorderWidth_), minArea(minArea_), lastPb(nullptr), detected(false) {}
+
+void BorderedRegionTracker::noteDamage(const core::Region& damage) {
+  for (size_t i = 0; i < cachedRegions.size(); i++) {
+    if (!hashValid[i])
+      continue;
+    if (!damage.intersect(cachedRegions[i].contentRect).is_empty())
+      hashValid[i] = false;
+  }
+}
+
+void BorderedRegionTracker::reset() {
+  lastPb = nullptr;
+  lastRect = core::Rect();
+  detected = false;
+  cachedRegions.clear();
+  cachedHashes.clear();
+  hashValid.clear();
+}
+
+const std::vector<ContentHash::BorderedRegion>& BorderedRegionTracker::regions(const PixelBuffer* pb) {
+  struct timeval start;
+
+  // The detector only looks at the framebuffer geometry, so a new
+  // buffer of the same size gives the same regions, but the hashes
+  // are no longer valid
+  if (pb != lastPb) {
+    for (size_t i = 0; i < hashValid.size(); i++)
+      hashValid[i] = false;
+    lastPb = pb;
+  }
+
+  if (detected && (pb != nullptr) && (pb->getRect() == lastRect))
+    return cachedRegions;
+
+  gettimeofday(&start, nullptr);
+
+  cachedRegions = ContentHash::detectBorderedRegions(pb, minBorderWidth, minArea);
+  cachedHashes.assign(cachedRegions.size(), std::vector<uint8_t>());
+  hashValid.assign(cachedRegions.size(), false);
+
+  lastRect = pb ? pb->getRect() : core::Rect();
+  detected = true;
+
+  stats.blocksConsidered += cachedRegions.size();
+  stats.timeUs += core::usSince(&start);
+
+  return cachedRegions;
+}
+
+const std::vector<uint8_t>& BorderedRegionTracker::contentHash(const PixelBuffer* pb, size_t index) {
+  struct timeval start;
+
+  if (hashValid[index]) {
+    stats.blocksHit++;
+    return cachedHashes[index];
+  }
+
+  gettimeofday(&start, nullptr);
+
+  cachedHashes[index] = ContentHash::computeRect(pb, cachedRegions[index].contentRect);
+  hashValid[index] = true;
+
+  stats.rectsHashed++;
+  stats.timeUs += core::usSince(&start);
+
+  return cachedHashes[index];
+}
+
+ScanStats BorderedRegionTracker::takeStats() {
+  ScanStats result;
+
+  result = stats;
+  stats = ScanStats();
+
+  return result;
+}
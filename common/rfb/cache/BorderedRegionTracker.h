@@ -0,0 +1,75 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef COMMON_RFB_CACHE_BORDEREDREGIONTRACKER_H_
+#define COMMON_RFB_CACHE_BORDEREDREGIONTRACKER_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <core/Rect.h>
+#include <core/Region.h>
+#include <rfb/ContentHash.h>
+#include <rfb/cache/ShiftTolerantScan.h>
+
+namespace rfb {
+
+class PixelBuffer;
+
+namespace cache {
+
+// Keeps the results of ContentHash::detectBorderedRegions() between
+// updates, together with the content hash of each region. Detection
+// is redone only when the framebuffer geometry changes, and a hash
+// only when damage has touched its region since it was computed.
+class BorderedRegionTracker {
+public:
+  BorderedRegionTracker(int minBorderWidth, int minArea);
+
+  // Must be told about every change to the framebuffer
+  void noteDamage(const core::Region& damage);
+  void reset();
+
+  // Identical to ContentHash::detectBorderedRegions(pb, ...)
+  const std::vector<ContentHash::BorderedRegion>& regions(const PixelBuffer* pb);
+  // Identical to ContentHash::computeRect(pb, regions(pb)[index].contentRect)
+  const std::vector<uint8_t>& contentHash(const PixelBuffer* pb, size_t index);
+
+  // Work done since the last call, for ScanTelemetry
+  ScanStats takeStats();
+
+private:
+  int minBorderWidth;
+  int minArea;
+
+  const PixelBuffer* lastPb;
+  core::Rect lastRect;
+  bool detected;
+
+  std::vector<ContentHash::BorderedRegion> cachedRegions;
+  std::vector<std::vector<uint8_t>> cachedHashes;
+  std::vector<bool> hashValid;
+
+  ScanStats stats;
+};
+
+} // namespace cache
+} // namespace rfb
+
+#endif // COMMON_RFB_CACHE_BORDEREDREGIONTRACKER_H_
@@ -0,0 +1,275 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <rdr/InStream.h>
+#include <rdr/MemOutStream.h>
+#include <rdr/ZlibOutStream.h>
+
+#include <rfb/PixelBuffer.h>
+#include <rfb/cache/CacheDelta.h>
+#include <rfb/cache/ZlibHelpers.h>
+
+using namespace rfb;
+using namespace rfb::cache;
+
+// Enough to find the previous content at the same spot or a recently
+// moved copy, without comparing against everything on every miss
+static const int MaxCandidates = 8;
+
+const int DeltaReferenceStore::TileSize;
+
+static uint64_t keyId(const CacheKey& key) {
+  uint64_t id;
+  memcpy(&id, key.bytes.data(), sizeof(id));
+  return id;
+}
+
+DeltaReferenceStore::DeltaReferenceStore(size_t maxBytes_) : maxBytes(maxBytes_), usedBytes(0) {}
+
+DeltaReferenceStore::~DeltaReferenceStore() {}
+
+void DeltaReferenceStore::setMaxBytes(size_t maxBytes_) {
+  maxBytes = maxBytes_;
+  trim();
+}
+
+void DeltaReferenceStore::insert(const CacheKey& key, const core::Rect& rect, const PixelBuffer* pb) {
+  const PixelFormat& pf = pb->getPF();
+  size_t length;
+
+  length = (size_t)rect.area() * (pf.bpp / 8);
+  if ((length == 0) || (length > maxBytes))
+    return;
+
+  remove(keyId(key));
+
+  entries.emplace_front();
+
+  Entry& entry = entries.front();
+  entry.key = key;
+  entry.rect = rect;
+  entry.pf = pf;
+  entry.pixels.resize(length);
+  pb->getImage(entry.pixels.data(), rect);
+  computeTiles(entry.pixels.data(), rect.width(), rect.height(), pf.bpp, &entry.tiles);
+
+  index[keyId(key)] = entries.begin();
+  usedBytes += entrySize(entry);
+
+  trim();
+}
+
+void DeltaReferenceStore::remove(uint64_t id) {
+  auto iter = index.find(id);
+  if (iter == index.end())
+    return;
+
+  usedBytes -= entrySize(*iter->second);
+  entries.erase(iter->second);
+  index.erase(iter);
+}
+
+void DeltaReferenceStore::touch(uint64_t id) {
+  auto iter = index.find(id);
+  if (iter == index.end())
+    return;
+
+  entries.splice(entries.begin(), entries, iter->second);
+}
+
+void DeltaReferenceStore::clear() {
+  entries.clear();
+  index.clear();
+  usedBytes = 0;
+}
+
+const DeltaReferenceStore::Entry* DeltaReferenceStore::findBase(const core::Rect& rect, const PixelBuffer* pb,
+                                                                int minPermille,
+                                                                const std::function<bool(const CacheKey&)>& accept) {
+  const PixelFormat& pf = pb->getPF();
+  std::list<Entry>::iterator best;
+  size_t bestMatches;
+  int candidates;
+
+  if (entries.empty())
+    return nullptr;
+
+  scratch.resize((size_t)rect.area() * (pf.bpp / 8));
+  pb->getImage(scratch.data(), rect);
+  computeTiles(scratch.data(), rect.width(), rect.height(), pf.bpp, &scratchTiles);
+
+  best = entries.end();
+  bestMatches = 0;
+  candidates = 0;
+
+  for (auto iter = entries.begin(); iter != entries.end(); ++iter) {
+    size_t matches;
+
+    if ((iter->rect.width() != rect.width()) || (iter->rect.height() != rect.height()))
+      continue;
+    if (iter->pf != pf)
+      continue;
+    if (!accept(iter->key))
+      continue;
+
+    matches = 0;
+    for (size_t i = 0; i < scratchTiles.size(); i++) {
+      if (iter->tiles[i] == scratchTiles[i])
+        matches++;
+    }
+
+    // Identical content would have been an exact cache hit, unless
+    // the client has asked for it again
+    if ((matches > bestMatches) && (iter->pixels != scratch)) {
+      best = iter;
+      bestMatches = matches;
+    }
+
+    if (++candidates >= MaxCandidates)
+      break;
+  }
+
+  if (best == entries.end())
+    return nullptr;
+  if (bestMatches * 1000 < scratchTiles.size() * minPermille)
+    return nullptr;
+
+  entries.splice(entries.begin(), entries, best);
+
+  return &*best;
+}
+
+void DeltaReferenceStore::computeTiles(const uint8_t* pixels, int width, int height, int bpp,
+                                       std::vector<uint64_t>* tiles) {
+  int tilesX, tilesY;
+  size_t bytesPerPixel, stride;
+
+  tilesX = (width + TileSize - 1) / TileSize;
+  tilesY = (height + TileSize - 1) / TileSize;
+  bytesPerPixel = bpp / 8;
+  stride = width * bytesPerPixel;
+
+  tiles->assign(tilesX * tilesY, 0);
+
+  for (int ty = 0; ty < tilesY; ty++) {
+    for (int tx = 0; tx < tilesX; tx++) {
+      const uint8_t* row;
+      size_t rowBytes;
+      int rows;
+      uint64_t hash;
+
+      row = pixels + ty * TileSize * stride + tx * TileSize * bytesPerPixel;
+      rowBytes = std::min(TileSize, width - tx * TileSize) * bytesPerPixel;
+      rows = std::min(TileSize, height - ty * TileSize);
+
+      // FNV-1a over 64-bit words, which is plenty to spot changes
+      hash = 0xcbf29ce484222325ULL;
+      for (int y = 0; y < rows; y++) {
+        size_t x;
+
+        for (x = 0; x + 8 <= rowBytes; x += 8) {
+          uint64_t word;
+          memcpy(&word, row + x, sizeof(word));
+          hash = (hash ^ word) * 0x100000001b3ULL;
+        }
+        for (; x < rowBytes; x++)
+          hash = (hash ^ row[x]) * 0x100000001b3ULL;
+
+        row += stride;
+      }
+
+      (*tiles)[ty * tilesX + tx] = hash;
+    }
+  }
+}
+
+size_t DeltaReferenceStore::entrySize(const Entry& entry) {
+  return sizeof(Entry) + entry.pixels.size() + entry.tiles.size() * sizeof(uint64_t);
+}
+
+void DeltaReferenceStore::trim() {
+  while (usedBytes > maxBytes) {
+    usedBytes -= entrySize(entries.back());
+    index.erase(keyId(entries.back().key));
+    entries.pop_back();
+  }
+}
+
+void rfb::cache::encodeResidual(const uint8_t* base, const uint8_t* pixels, size_t length, int level,
+                                std::vector<uint8_t>* out) {
+  rdr::MemOutStream mos;
+  rdr::ZlibOutStream zos(&mos, level);
+  uint8_t buffer[4096];
+
+  while (length > 0) {
+    size_t n;
+
+    n = std::min(length, sizeof(buffer));
+    for (size_t i = 0; i < n; i++)
+      buffer[i] = base[i] ^ pixels[i];
+    zos.writeBytes(buffer, n);
+
+    base += n;
+    pixels += n;
+    length -= n;
+  }
+
+  zos.flush();
+
+  out->assign(mos.data(), mos.data() + mos.length());
+}
+
+size_t rfb::cache::compressedSize(const uint8_t* pixels, size_t length, int level) {
+  rdr::MemOutStream mos;
+  rdr::ZlibOutStream zos(&mos, level);
+
+  zos.writeBytes(pixels, length);
+  zos.flush();
+
+  return mos.length();
+}
+
+bool rfb::cache::applyResidual(const uint8_t* data, size_t dataLength, uint8_t* pixels, size_t length) {
+  return inflateExactly(data, dataLength, [pixels, length](rdr::InStream* in) mutable {
+    uint8_t buffer[4096];
+
+    while (length > 0) {
+      size_t n;
+
+      n = std::min(length, sizeof(buffer));
+      if (!in->hasData(n))
+        return false;
+      in->readBytes(buffer, n);
+      for (size_t i = 0; i < n; i++)
+        pixels[i] ^= buffer[i];
+
+      pixels += n;
+      length -= n;
+    }
+
+    return true;
+  });
+}
@@ -0,0 +1,121 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef COMMON_RFB_CACHE_CACHEDELTA_H_
+#define COMMON_RFB_CACHE_CACHEDELTA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include <core/Rect.h>
+#include <rfb/CacheKey.h>
+#include <rfb/PixelFormat.h>
+
+namespace rfb {
+
+class PixelBuffer;
+
+namespace cache {
+
+// Near-duplicate content, like a document page with a line edited or a
+// toolbar with a toggled button, misses the exact match cache although
+// it differs from something the client already has in only a few
+// places. DeltaReferenceStore keeps the pixels of rects recently sent
+// to a client under a cache key so that such content can be sent as a
+// compressed difference against them instead.
+//
+// Candidates are found by comparing cheap signatures of small tiles.
+// Only rects of the same size are compared, but they may be anywhere
+// on screen so content that has also moved is found as well.
+class DeltaReferenceStore {
+public:
+  static const int TileSize = 16;
+
+  struct Entry {
+    CacheKey key;
+    core::Rect rect;
+    PixelFormat pf;
+    std::vector<uint8_t> pixels; // Tightly packed, in pf
+    std::vector<uint64_t> tiles;
+  };
+
+  DeltaReferenceStore(size_t maxBytes = 0);
+  ~DeltaReferenceStore();
+
+  // Zero disables the store
+  void setMaxBytes(size_t maxBytes);
+
+  // Keeps a copy of the rect's pixels as the content of key
+  void insert(const CacheKey& key, const core::Rect& rect, const PixelBuffer* pb);
+  void remove(uint64_t id);
+  void clear();
+  // Marks an entry as recently used, e.g. after a cache hit
+  void touch(uint64_t id);
+
+  // Returns the entry with the most tiles identical to those of rect,
+  // provided that at least minPermille of them are, or nullptr. The
+  // accept function can veto entries, e.g. ones the client no longer
+  // has.
+  const Entry* findBase(const core::Rect& rect, const PixelBuffer* pb, int minPermille,
+                        const std::function<bool(const CacheKey&)>& accept);
+
+  size_t size() const {
+    return entries.size();
+  }
+  size_t memoryUsage() const {
+    return usedBytes;
+  }
+
+  static void computeTiles(const uint8_t* pixels, int width, int height, int bpp, std::vector<uint64_t>* tiles);
+
+private:
+  static size_t entrySize(const Entry& entry);
+  void trim();
+
+  // Most recently used first
+  std::list<Entry> entries;
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+
+  size_t maxBytes;
+  size_t usedBytes;
+
+  std::vector<uint8_t> scratch;
+  std::vector<uint64_t> scratchTiles;
+};
+
+// The residual is the XOR of the old and new pixels in the client's
+// pixel format, which is zero wherever nothing changed and therefore
+// compresses very well
+void encodeResidual(const uint8_t* base, const uint8_t* pixels, size_t length, int level, std::vector<uint8_t>* out);
+
+// What plain zlib makes of the pixels, for comparison with a residual
+size_t compressedSize(const uint8_t* pixels, size_t length, int level);
+
+// XORs a residual into pixels. Returns false, leaving pixels in an
+// undefined state, if it does not decompress to exactly length bytes.
+bool applyResidual(const uint8_t* data, size_t dataLength, uint8_t* pixels, size_t length);
+
+} // namespace cache
+} // namespace rfb
+
+#endif // COMMON_RFB_CACHE_CACHEDELTA_H_
@@ -0,0 +1,100 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rfb/cache/CacheEpochStore.h>
+#include <rfb/cache/CacheKeyDictionary.h>
+
+using namespace rfb::cache;
+
+const size_t CacheEpochStore::MaxSnapshots;
+
+CacheEpochStore::CacheEpochStore(CacheKeyDictionary* dict_) : dict(dict_) {
+  std::random_device rd;
+
+  // Tokens should not be guessable from one connection to the next
+  random.seed(((uint64_t)rd() << 32) | rd());
+}
+
+CacheEpochStore::~CacheEpochStore() {
+  for (auto& snapshot : snapshots)
+    delete snapshot.second;
+}
+
+uint64_t CacheEpochStore::store(KnownKeySet* keys) {
+  std::lock_guard<std::mutex> lock(mutex);
+  uint64_t token;
+  bool unique;
+
+  do {
+    token = random();
+    unique = token != 0;
+    for (const auto& snapshot : snapshots) {
+      if (snapshot.first == token)
+        unique = false;
+    }
+  } while (!unique);
+
+  snapshots.push_back(std::make_pair(token, keys));
+
+  while (snapshots.size() > MaxSnapshots) {
+    delete snapshots.front().second;
+    snapshots.pop_front();
+  }
+
+  return token;
+}
+
+KnownKeySet* CacheEpochStore::take(uint64_t token) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (token == 0)
+    return nullptr;
+
+  for (auto iter = snapshots.begin(); iter != snapshots.end(); ++iter) {
+    KnownKeySet* keys;
+
+    if (iter->first != token)
+      continue;
+
+    keys = iter->second;
+    snapshots.erase(iter);
+    return keys;
+  }
+
+  return nullptr;
+}
+
+size_t CacheEpochStore::size() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return snapshots.size();
+}
+
+size_t CacheEpochStore::memoryUsage() {
+  std::lock_guard<std::mutex> lock(mutex);
+  size_t total;
+
+  total = 0;
+  for (const auto& snapshot : snapshots)
+    total += sizeof(KnownKeySet) + snapshot.second->memoryUsage();
+
+  return total;
+}
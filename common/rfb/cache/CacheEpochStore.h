@@ -0,0 +1,77 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef COMMON_RFB_CACHE_CACHEEPOCHSTORE_H_
+#define COMMON_RFB_CACHE_CACHEEPOCHSTORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <mutex>
+#include <random>
+#include <utility>
+
+namespace rfb {
+namespace cache {
+
+class CacheKeyDictionary;
+class KnownKeySet;
+
+// Snapshots of the IDs viewers have advertised, kept so that a viewer
+// reconnecting later only needs to send what changed since. Each
+// snapshot is handed out under a random token which the viewer stores
+// next to its cache. A token can only be redeemed once, since the
+// viewer's next advertisement replaces it with a new one.
+//
+// Snapshots share the server's key dictionary, so the IDs themselves
+// are only stored once no matter how many snapshots refer to them.
+class CacheEpochStore {
+public:
+  static const size_t MaxSnapshots = 64;
+
+  CacheEpochStore(CacheKeyDictionary* dict);
+  ~CacheEpochStore();
+
+  CacheKeyDictionary* getDictionary() const {
+    return dict;
+  }
+
+  // Takes ownership of the set and returns a non-zero token for it.
+  // The oldest snapshot is dropped once there are too many.
+  uint64_t store(KnownKeySet* keys);
+
+  // Returns the snapshot and gives up ownership of it, or nullptr if
+  // the token is unknown or has already been used
+  KnownKeySet* take(uint64_t token);
+
+  size_t size();
+  size_t memoryUsage();
+
+private:
+  CacheKeyDictionary* dict;
+
+  std::mutex mutex;
+  std::mt19937_64 random;
+  std::list<std::pair<uint64_t, KnownKeySet*>> snapshots;
+};
+
+} // namespace cache
+} // namespace rfb
+
+#endif // COMMON_RFB_CACHE_CACHEEPOCHSTORE_H_
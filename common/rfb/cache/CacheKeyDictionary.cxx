@@ -0,0 +1,454 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <algorithm>
+
+#include <rfb/cache/CacheKeyDictionary.h>
+
+using namespace rfb;
+using namespace rfb::cache;
+
+// Blocks switch to a bitmap once the sorted array would be larger, and
+// back again only when well below that, to avoid flapping
+static const size_t ArrayMax = 4096;
+static const size_t ArrayMin = 2048;
+
+static const size_t BitmapWords = 65536 / 64;
+
+const uint32_t CacheKeyDictionary::NoIndex;
+
+CacheKeyDictionary::CacheKeyDictionary() : count(0) {}
+
+CacheKeyDictionary::~CacheKeyDictionary() {}
+
+uint32_t CacheKeyDictionary::find(uint64_t key) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return lookup(key);
+}
+
+uint32_t CacheKeyDictionary::acquire(uint64_t key) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return ref(key);
+}
+
+void CacheKeyDictionary::acquireMultiple(const std::vector<uint64_t>& keys_, std::vector<uint32_t>* indices) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  grow(count + keys_.size());
+
+  indices->resize(keys_.size());
+  for (size_t i = 0; i < keys_.size(); i++)
+    (*indices)[i] = ref(keys_[i]);
+}
+
+void CacheKeyDictionary::release(uint32_t index) {
+  std::lock_guard<std::mutex> lock(mutex);
+  unref(index);
+}
+
+void CacheKeyDictionary::releaseMultiple(const std::vector<uint32_t>& indices) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (uint32_t index : indices)
+    unref(index);
+}
+
+void CacheKeyDictionary::getKeys(const std::vector<uint32_t>& indices, std::vector<uint64_t>* keys_) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  keys_->resize(indices.size());
+  for (size_t i = 0; i < indices.size(); i++)
+    (*keys_)[i] = keys[indices[i]];
+}
+
+size_t CacheKeyDictionary::size() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return count;
+}
+
+size_t CacheKeyDictionary::memoryUsage() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return table.capacity() * sizeof(uint32_t) + keys.capacity() * sizeof(uint64_t) +
+         refs.capacity() * sizeof(uint32_t) + freeIndices.capacity() * sizeof(uint32_t);
+}
+
+size_t CacheKeyDictionary::home(uint64_t key) const {
+  uint64_t h;
+
+  // MurmurHash3 fmix64, as IDs often share their low bits
+  h = key;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+
+  return h & (table.size() - 1);
+}
+
+uint32_t CacheKeyDictionary::lookup(uint64_t key) const {
+  size_t mask;
+
+  if (table.empty())
+    return NoIndex;
+
+  mask = table.size() - 1;
+  for (size_t i = home(key);; i = (i + 1) & mask) {
+    if (table[i] == 0)
+      return NoIndex;
+    if (keys[table[i] - 1] == key)
+      return table[i] - 1;
+  }
+}
+
+uint32_t CacheKeyDictionary::ref(uint64_t key) {
+  uint32_t index;
+
+  index = lookup(key);
+  if (index != NoIndex) {
+    refs[index]++;
+    return index;
+  }
+
+  grow(count + 1);
+
+  if (!freeIndices.empty()) {
+    index = freeIndices.back();
+    freeIndices.pop_back();
+    keys[index] = key;
+    refs[index] = 1;
+  } else {
+    index = keys.size();
+    keys.push_back(key);
+    refs.push_back(1);
+  }
+
+  insert(index);
+  count++;
+
+  return index;
+}
+
+void CacheKeyDictionary::unref(uint32_t index) {
+  size_t mask, i, j;
+
+  if (--refs[index] > 0)
+    return;
+
+  mask = table.size() - 1;
+  for (i = home(keys[index]); table[i] != index + 1; i = (i + 1) & mask)
+    ;
+
+  // Shift back following entries rather than leaving a tombstone
+  for (j = (i + 1) & mask; table[j] != 0; j = (j + 1) & mask) {
+    size_t k;
+
+    k = home(keys[table[j] - 1]);
+    if (((j - k) & mask) < ((j - i) & mask))
+      continue;
+
+    table[i] = table[j];
+    i = j;
+  }
+  table[i] = 0;
+
+  freeIndices.push_back(index);
+  count--;
+}
+
+void CacheKeyDictionary::insert(uint32_t index) {
+  size_t mask, i;
+
+  mask = table.size() - 1;
+  for (i = home(keys[index]); table[i] != 0; i = (i + 1) & mask)
+    ;
+
+  table[i] = index + 1;
+}
+
+void CacheKeyDictionary::grow(size_t n) {
+  size_t capacity;
+
+  // Load factor of at most 3/4
+  capacity = 16;
+  while (capacity * 3 < n * 4)
+    capacity *= 2;
+  if (capacity <= table.size())
+    return;
+
+  table.assign(capacity, 0);
+  for (uint32_t index = 0; index < keys.size(); index++) {
+    if (refs[index] > 0)
+      insert(index);
+  }
+}
+
+KnownKeySet::KnownKeySet(CacheKeyDictionary* dict_)
+    : dict(dict_), ownDict(nullptr), count(0), addedCount(0), evictedCount(0) {
+  if (dict == nullptr)
+    dict = ownDict = new CacheKeyDictionary();
+}
+
+KnownKeySet::~KnownKeySet() {
+  if (ownDict != nullptr)
+    delete ownDict;
+  else
+    clear();
+}
+
+void KnownKeySet::setDictionary(CacheKeyDictionary* dict_) {
+  clear();
+
+  delete ownDict;
+  ownDict = nullptr;
+
+  dict = dict_;
+  if (dict == nullptr)
+    dict = ownDict = new CacheKeyDictionary();
+}
+
+bool KnownKeySet::has(uint64_t key) const {
+  uint32_t index;
+
+  if (count == 0)
+    return false;
+
+  index = dict->find(key);
+  if (index == CacheKeyDictionary::NoIndex)
+    return false;
+
+  return test(index);
+}
+
+void KnownKeySet::add(uint64_t key) {
+  uint32_t index;
+
+  index = dict->acquire(key);
+  if (!set(index)) {
+    dict->release(index);
+    return;
+  }
+
+  addedCount++;
+}
+
+void KnownKeySet::addMultiple(const std::vector<uint64_t>& keys) {
+  std::vector<uint32_t> indices, duplicates;
+
+  dict->acquireMultiple(keys, &indices);
+
+  for (uint32_t index : indices) {
+    if (set(index))
+      addedCount++;
+    else
+      duplicates.push_back(index);
+  }
+
+  if (!duplicates.empty())
+    dict->releaseMultiple(duplicates);
+}
+
+bool KnownKeySet::remove(uint64_t key) {
+  uint32_t index;
+
+  if (count == 0)
+    return false;
+
+  index = dict->find(key);
+  if (index == CacheKeyDictionary::NoIndex)
+    return false;
+
+  if (!reset(index))
+    return false;
+
+  dict->release(index);
+  evictedCount++;
+
+  return true;
+}
+
+size_t KnownKeySet::removeMultiple(const std::vector<uint64_t>& keys) {
+  size_t removed;
+
+  removed = 0;
+  for (uint64_t key : keys) {
+    if (remove(key))
+      removed++;
+  }
+
+  return removed;
+}
+
+void KnownKeySet::clear() {
+  if (count != 0)
+    dict->releaseMultiple(getIndices());
+
+  std::vector<Block>().swap(blocks);
+  count = 0;
+
+  addedCount = 0;
+  evictedCount = 0;
+}
+
+std::vector<uint64_t> KnownKeySet::getKeys() const {
+  std::vector<uint64_t> keys;
+
+  dict->getKeys(getIndices(), &keys);
+
+  return keys;
+}
+
+size_t KnownKeySet::memoryUsage() const {
+  size_t bytes;
+
+  bytes = blocks.capacity() * sizeof(Block);
+  for (const Block& block : blocks)
+    bytes += block.array.capacity() * sizeof(uint16_t) + block.bitmap.capacity() * sizeof(uint64_t);
+
+  return bytes;
+}
+
+KnownKeySet::Stats KnownKeySet::getStats() const {
+  Stats s;
+
+  s.currentSize = count;
+  s.totalAdded = addedCount;
+  s.totalEvicted = evictedCount;
+
+  return s;
+}
+
+bool KnownKeySet::test(uint32_t index) const {
+  uint16_t low;
+
+  if ((index >> 16) >= blocks.size())
+    return false;
+
+  const Block& block = blocks[index >> 16];
+  low = index & 0xffff;
+
+  if (!block.bitmap.empty())
+    return block.bitmap[low / 64] & (1ULL << (low % 64));
+
+  return std::binary_search(block.array.begin(), block.array.end(), low);
+}
+
+bool KnownKeySet::set(uint32_t index) {
+  uint16_t low;
+
+  if ((index >> 16) >= blocks.size())
+    blocks.resize((index >> 16) + 1, Block{0, {}, {}});
+
+  Block& block = blocks[index >> 16];
+  low = index & 0xffff;
+
+  if (!block.bitmap.empty()) {
+    uint64_t bit;
+
+    bit = 1ULL << (low % 64);
+    if (block.bitmap[low / 64] & bit)
+      return false;
+    block.bitmap[low / 64] |= bit;
+  } else {
+    std::vector<uint16_t>::iterator iter;
+
+    iter = std::lower_bound(block.array.begin(), block.array.end(), low);
+    if ((iter != block.array.end()) && (*iter == low))
+      return false;
+    block.array.insert(iter, low);
+
+    if (block.array.size() > ArrayMax) {
+      block.bitmap.assign(BitmapWords, 0);
+      for (uint16_t v : block.array)
+        block.bitmap[v / 64] |= 1ULL << (v % 64);
+      std::vector<uint16_t>().swap(block.array);
+    }
+  }
+
+  block.count++;
+  count++;
+
+  return true;
+}
+
+bool KnownKeySet::reset(uint32_t index) {
+  uint16_t low;
+
+  if ((index >> 16) >= blocks.size())
+    return false;
+
+  Block& block = blocks[index >> 16];
+  low = index & 0xffff;
+
+  if (!block.bitmap.empty()) {
+    uint64_t bit;
+
+    bit = 1ULL << (low % 64);
+    if (!(block.bitmap[low / 64] & bit))
+      return false;
+    block.bitmap[low / 64] &= ~bit;
+
+    if (block.count - 1 < ArrayMin) {
+      for (size_t i = 0; i < BitmapWords; i++) {
+        for (uint64_t word = block.bitmap[i]; word != 0; word &= word - 1)
+          block.array.push_back(i * 64 + __builtin_ctzll(word));
+      }
+      std::vector<uint64_t>().swap(block.bitmap);
+    }
+  } else {
+    std::vector<uint16_t>::iterator iter;
+
+    iter = std::lower_bound(block.array.begin(), block.array.end(), low);
+    if ((iter == block.array.end()) || (*iter != low))
+      return false;
+    block.array.erase(iter);
+
+    if (block.array.empty())
+      std::vector<uint16_t>().swap(block.array);
+  }
+
+  block.count--;
+  count--;
+
+  return true;
+}
+
+std::vector<uint32_t> KnownKeySet::getIndices() const {
+  std::vector<uint32_t> indices;
+
+  indices.reserve(count);
+
+  for (size_t hi = 0; hi < blocks.size(); hi++) {
+    const Block& block = blocks[hi];
+
+    if (!block.bitmap.empty()) {
+      for (size_t i = 0; i < BitmapWords; i++) {
+        for (uint64_t word = block.bitmap[i]; word != 0; word &= word - 1)
+          indices.push_back(hi << 16 | (i * 64 + __builtin_ctzll(word)));
+      }
+    } else {
+      for (uint16_t low : block.array)
+        indices.push_back(hi << 16 | low);
+    }
+  }
+
+  return indices;
+}
@@ -0,0 +1,145 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef COMMON_RFB_CACHE_CACHEKEYDICTIONARY_H_
+#define COMMON_RFB_CACHE_CACHEKEYDICTIONARY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <vector>
+
+namespace rfb {
+namespace cache {
+
+// Server wide mapping of 64-bit cache IDs to small, dense indices.
+// Viewers sharing a cache image advertise largely the same IDs, so
+// each ID is stored once here and every connection only keeps a
+// bitset of indices (see KnownKeySet). Entries are reference counted
+// and their indices reused once the last connection lets go.
+class CacheKeyDictionary {
+public:
+  static const uint32_t NoIndex = 0xffffffff;
+
+  CacheKeyDictionary();
+  ~CacheKeyDictionary();
+
+  // Returns NoIndex if nobody holds the key
+  uint32_t find(uint64_t key);
+
+  // acquire() adds a reference to the key's index, creating it if
+  // needed, and release() drops one again
+  uint32_t acquire(uint64_t key);
+  void acquireMultiple(const std::vector<uint64_t>& keys, std::vector<uint32_t>* indices);
+  void release(uint32_t index);
+  void releaseMultiple(const std::vector<uint32_t>& indices);
+
+  void getKeys(const std::vector<uint32_t>& indices, std::vector<uint64_t>* keys);
+
+  size_t size();
+  size_t memoryUsage();
+
+private:
+  size_t home(uint64_t key) const;
+  uint32_t lookup(uint64_t key) const;
+  uint32_t ref(uint64_t key);
+  void unref(uint32_t index);
+  void insert(uint32_t index);
+  void grow(size_t n);
+
+  std::mutex mutex;
+
+  // Open addressing on the key, holding index + 1 so that 0 is free
+  std::vector<uint32_t> table;
+  std::vector<uint64_t> keys;
+  std::vector<uint32_t> refs;
+  std::vector<uint32_t> freeIndices;
+  size_t count;
+};
+
+// Set of cache IDs a single client knows about, stored as a bitset
+// over the dictionary's indices. The bitset is split in 64k blocks
+// which are kept as a sorted array while sparse and as a plain bitmap
+// once dense, in the manner of Roaring bitmaps.
+//
+// Without a dictionary the set uses a private one, which is handy for
+// code that runs outside of a server.
+class KnownKeySet {
+public:
+  KnownKeySet(CacheKeyDictionary* dict = nullptr);
+  ~KnownKeySet();
+
+  // Switches dictionary, dropping all keys
+  void setDictionary(CacheKeyDictionary* dict);
+
+  bool has(uint64_t key) const;
+  void add(uint64_t key);
+  void addMultiple(const std::vector<uint64_t>& keys);
+  bool remove(uint64_t key);
+  size_t removeMultiple(const std::vector<uint64_t>& keys);
+  void clear();
+
+  size_t size() const {
+    return count;
+  }
+  bool empty() const {
+    return count == 0;
+  }
+
+  std::vector<uint64_t> getKeys() const;
+
+  // Heap memory used by this client's bitset, not counting the
+  // shared dictionary
+  size_t memoryUsage() const;
+
+  struct Stats {
+    size_t currentSize;
+    uint64_t totalAdded;
+    uint64_t totalEvicted;
+  };
+
+  Stats getStats() const;
+
+private:
+  struct Block {
+    size_t count;
+    std::vector<uint16_t> array;  // Sorted, while sparse
+    std::vector<uint64_t> bitmap; // 1024 words, once dense
+  };
+
+  bool test(uint32_t index) const;
+  bool set(uint32_t index);
+  bool reset(uint32_t index);
+
+  std::vector<uint32_t> getIndices() const;
+
+  CacheKeyDictionary* dict;
+  CacheKeyDictionary* ownDict;
+
+  std::vector<Block> blocks;
+  size_t count;
+
+  uint64_t addedCount;
+  uint64_t evictedCount;
+};
+
+} // namespace cache
+} // namespace rfb
+
+#endif // COMMON_RFB_CACHE_CACHEKEYDICTIONARY_H_
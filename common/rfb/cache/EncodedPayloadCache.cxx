@@ -0,0 +1,92 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+
+#include <rfb/Encoder.h>
+#include <rfb/PixelFormat.h>
+#include <rfb/ServerCore.h>
+#include <rfb/cache/EncodedPayloadCache.h>
+
+using namespace rfb;
+using namespace rfb::cache;
+
+EncodedPayloadCache::EncodedPayloadCache(size_t maxBytes)
+    : cache(maxBytes, [](const Entry& e) { return e.data.size() + sizeof(Entry); }) {}
+
+EncodedPayloadCache* EncodedPayloadCache::instance() {
+  static std::once_flag once;
+  static EncodedPayloadCache* payloadCache = nullptr;
+
+  std::call_once(once, []() {
+    if (rfb::Server::encodedPayloadCacheSize > 0)
+      payloadCache = new EncodedPayloadCache((size_t)rfb::Server::encodedPayloadCacheSize * 1024 * 1024);
+  });
+
+  return payloadCache;
+}
+
+std::string EncodedPayloadCache::makeKey(const CacheKey& content, const PixelFormat& nativePF,
+                                         const PixelFormat& clientPF, Encoder* encoder) {
+  std::string key;
+  char buf[256];
+
+  key.assign((const char*)content.bytes.data(), content.bytes.size());
+
+  nativePF.print(buf, sizeof(buf));
+  key += buf;
+  key += '/';
+  clientPF.print(buf, sizeof(buf));
+  key += buf;
+
+  snprintf(buf, sizeof(buf), "/%d/%d/%d/%d/%d", encoder->encoding, encoder->getCompressLevel(),
+           encoder->getQualityLevel(), encoder->getFineQualityLevel(), encoder->getFineSubsampling());
+  key += buf;
+
+  return key;
+}
+
+bool EncodedPayloadCache::lookup(const std::string& key, std::vector<uint8_t>* data, unsigned* encodeUs) {
+  const Entry* entry;
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  entry = cache.get(key);
+  if (entry == nullptr)
+    return false;
+
+  *data = entry->data;
+  *encodeUs = entry->encodeUs;
+
+  return true;
+}
+
+void EncodedPayloadCache::insert(const std::string& key, const uint8_t* data, size_t length, unsigned encodeUs) {
+  Entry entry;
+
+  entry.data.assign(data, data + length);
+  entry.encodeUs = encodeUs;
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  cache.insert(key, std::move(entry));
+}
@@ -0,0 +1,70 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef COMMON_RFB_CACHE_ENCODEDPAYLOADCACHE_H_
+#define COMMON_RFB_CACHE_ENCODEDPAYLOADCACHE_H_
+
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <rfb/CacheKey.h>
+#include <rfb/cache/ArcCache.h>
+
+namespace rfb {
+
+class Encoder;
+class PixelFormat;
+
+namespace cache {
+
+// Encoded PersistentCachedRectInit payloads, shared by all connections
+// in the process. The key covers everything that affects the encoder
+// output, so only encoders flagged EncoderStateless may be used here.
+class EncodedPayloadCache {
+public:
+  EncodedPayloadCache(size_t maxBytes);
+
+  // Process wide instance, or nullptr if disabled by the
+  // EncodedPayloadCacheSize parameter
+  static EncodedPayloadCache* instance();
+
+  static std::string makeKey(const CacheKey& content, const PixelFormat& nativePF, const PixelFormat& clientPF,
+                             Encoder* encoder);
+
+  // Returns false on a miss. encodeUs is the time it took to create
+  // the payload in the first place.
+  bool lookup(const std::string& key, std::vector<uint8_t>* data, unsigned* encodeUs);
+  void insert(const std::string& key, const uint8_t* data, size_t length, unsigned encodeUs);
+
+private:
+  struct Entry {
+    std::vector<uint8_t> data;
+    unsigned encodeUs;
+  };
+
+  std::mutex mutex;
+  ArcCache<std::string, Entry> cache;
+};
+
+} // namespace cache
+} // namespace rfb
+
+#endif // COMMON_RFB_CACHE_ENCODEDPAYLOADCACHE_H_
@@ -0,0 +1,298 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <rdr/InStream.h>
+#include <rdr/MemOutStream.h>
+#include <rdr/ZlibOutStream.h>
+
+#include <rfb/cache/GlyphDictionary.h>
+#include <rfb/cache/ZlibHelpers.h>
+
+using namespace rfb::cache;
+
+const int GlyphDictionary::MaxGlyphs;
+
+GlyphDictionary::GlyphDictionary(size_t maxGlyphs_) : limit(0) {
+  setMaxGlyphs(maxGlyphs_);
+}
+
+GlyphDictionary::~GlyphDictionary() {}
+
+void GlyphDictionary::setMaxGlyphs(size_t maxGlyphs_) {
+  limit = std::min(maxGlyphs_, (size_t)MaxGlyphs);
+  clear();
+}
+
+void GlyphDictionary::clear() {
+  glyphs.clear();
+  byHash.clear();
+  lru.clear();
+}
+
+int GlyphDictionary::find(uint64_t hash, const uint8_t* pixels, size_t length) const {
+  std::unordered_map<uint64_t, int>::const_iterator iter;
+  const Glyph* glyph;
+
+  iter = byHash.find(hash);
+  if (iter == byHash.end())
+    return -1;
+
+  // Wrong content would stay on screen until something else is drawn
+  // there, so don't trust the hash alone
+  glyph = &glyphs[iter->second];
+  if ((glyph->pixels.size() != length) || (memcmp(glyph->pixels.data(), pixels, length) != 0))
+    return -1;
+
+  return iter->second;
+}
+
+void GlyphDictionary::touch(int index) {
+  assert((index >= 0) && ((size_t)index < glyphs.size()));
+  lru.splice(lru.begin(), lru, glyphs[index].lru);
+}
+
+int GlyphDictionary::add(uint64_t hash, const uint8_t* pixels, size_t length) {
+  int index;
+
+  assert(limit > 0);
+
+  if (glyphs.size() < limit) {
+    index = glyphs.size();
+    glyphs.push_back(Glyph());
+    lru.push_front(index);
+  } else {
+    std::unordered_map<uint64_t, int>::iterator iter;
+
+    index = lru.back();
+    lru.splice(lru.begin(), lru, std::prev(lru.end()));
+
+    // A colliding glyph may have taken over the hash already
+    iter = byHash.find(glyphs[index].hash);
+    if ((iter != byHash.end()) && (iter->second == index))
+      byHash.erase(iter);
+  }
+
+  glyphs[index].hash = hash;
+  glyphs[index].pixels.assign(pixels, pixels + length);
+  glyphs[index].lru = lru.begin();
+
+  byHash[hash] = index;
+
+  return index;
+}
+
+uint64_t GlyphDictionary::hashCell(const uint8_t* pixels, size_t rowBytes, size_t stride, int height) {
+  uint64_t hash;
+
+  // FNV-1a over 32-bit words, which is plenty for the few hundred
+  // bytes of a cell as hits are verified anyway
+  hash = 14695981039346656037ULL;
+  for (int y = 0; y < height; y++) {
+    const uint8_t* row;
+    size_t x;
+
+    row = pixels + y * stride;
+    for (x = 0; x + 4 <= rowBytes; x += 4) {
+      uint32_t word;
+      memcpy(&word, row + x, 4);
+      hash = (hash ^ word) * 1099511628211ULL;
+    }
+    for (; x < rowBytes; x++)
+      hash = (hash ^ row[x]) * 1099511628211ULL;
+  }
+
+  return hash;
+}
+
+GlyphTable::GlyphTable() : count(0) {}
+
+void GlyphTable::clear() {
+  glyphs.clear();
+  count = 0;
+}
+
+bool GlyphTable::set(int index, const uint8_t* pixels, size_t length) {
+  if ((index < 0) || (index >= GlyphDictionary::MaxGlyphs))
+    return false;
+
+  if ((size_t)index >= glyphs.size())
+    glyphs.resize(index + 1);
+  if (glyphs[index].empty())
+    count++;
+
+  glyphs[index].assign(pixels, pixels + length);
+
+  return true;
+}
+
+const uint8_t* GlyphTable::get(int index, size_t length) const {
+  if ((index < 0) || ((size_t)index >= glyphs.size()))
+    return nullptr;
+  if (glyphs[index].empty() || (glyphs[index].size() != length))
+    return nullptr;
+  return glyphs[index].data();
+}
+
+// Calls func(offset, length) for each run of literal pixels, i.e.
+// those outside the block of full cells, in row-major order
+template <class T>
+static void forEachLiteral(const GlyphLayout& layout, T func) {
+  int blockX, blockY, blockW, blockH;
+  size_t stride;
+
+  blockX = layout.ox;
+  blockY = layout.oy;
+  blockW = layout.columns() * layout.cellW;
+  blockH = layout.rows() * layout.cellH;
+
+  stride = (size_t)layout.width * layout.bytesPerPixel;
+
+  for (int y = 0; y < layout.height; y++) {
+    size_t row;
+
+    row = y * stride;
+
+    if ((blockW == 0) || (y < blockY) || (y >= blockY + blockH)) {
+      func(row, stride);
+      continue;
+    }
+
+    if (blockX > 0)
+      func(row, (size_t)blockX * layout.bytesPerPixel);
+    if (blockX + blockW < layout.width)
+      func(row + (size_t)(blockX + blockW) * layout.bytesPerPixel,
+           (size_t)(layout.width - blockX - blockW) * layout.bytesPerPixel);
+  }
+}
+
+static size_t cellOffset(const GlyphLayout& layout, int cell) {
+  int cx, cy;
+
+  cx = layout.ox + (cell % layout.columns()) * layout.cellW;
+  cy = layout.oy + (cell / layout.columns()) * layout.cellH;
+
+  return ((size_t)cy * layout.width + cx) * layout.bytesPerPixel;
+}
+
+void rfb::cache::encodeGlyphRect(const GlyphLayout& layout, const uint8_t* pixels, const std::vector<uint16_t>& cells,
+                                 const std::vector<std::pair<uint16_t, int>>& newGlyphs, int level,
+                                 std::vector<uint8_t>* out) {
+  rdr::MemOutStream mos;
+  rdr::ZlibOutStream zos(&mos, level);
+  size_t stride, rowBytes;
+
+  assert(cells.size() == (size_t)layout.columns() * layout.rows());
+
+  stride = (size_t)layout.width * layout.bytesPerPixel;
+  rowBytes = (size_t)layout.cellW * layout.bytesPerPixel;
+
+  zos.writeU16(newGlyphs.size());
+  for (const std::pair<uint16_t, int>& glyph : newGlyphs) {
+    const uint8_t* src;
+
+    zos.writeU16(glyph.first);
+
+    src = pixels + cellOffset(layout, glyph.second);
+    for (int y = 0; y < layout.cellH; y++)
+      zos.writeBytes(src + y * stride, rowBytes);
+  }
+
+  for (uint16_t index : cells)
+    zos.writeU16(index);
+
+  forEachLiteral(layout, [&](size_t offset, size_t length) { zos.writeBytes(pixels + offset, length); });
+
+  zos.flush();
+
+  out->assign(mos.data(), mos.data() + mos.length());
+}
+
+bool rfb::cache::decodeGlyphRect(const GlyphLayout& layout, const uint8_t* data, size_t length, GlyphTable* table,
+                                 uint8_t* pixels) {
+  std::vector<uint8_t> glyph;
+  size_t stride, rowBytes, cellBytes;
+  int cellCount;
+
+  if ((layout.cellW <= 0) || (layout.cellH <= 0) || (layout.ox < 0) || (layout.oy < 0))
+    return false;
+
+  stride = (size_t)layout.width * layout.bytesPerPixel;
+  rowBytes = (size_t)layout.cellW * layout.bytesPerPixel;
+  cellBytes = layout.cellBytes();
+  cellCount = layout.columns() * layout.rows();
+
+  glyph.resize(cellBytes);
+
+  return inflateExactly(data, length, [&](rdr::InStream* in) {
+    unsigned newCount;
+    bool ok;
+
+    if (!in->hasData(2))
+      return false;
+    newCount = in->readU16();
+
+    for (unsigned i = 0; i < newCount; i++) {
+      int index;
+
+      if (!in->hasData(2 + cellBytes))
+        return false;
+      index = in->readU16();
+      in->readBytes(glyph.data(), cellBytes);
+
+      if (!table->set(index, glyph.data(), cellBytes))
+        return false;
+    }
+
+    for (int cell = 0; cell < cellCount; cell++) {
+      const uint8_t* src;
+      uint8_t* dst;
+
+      if (!in->hasData(2))
+        return false;
+      src = table->get(in->readU16(), cellBytes);
+      if (src == nullptr)
+        return false;
+
+      dst = pixels + cellOffset(layout, cell);
+      for (int y = 0; y < layout.cellH; y++)
+        memcpy(dst + y * stride, src + y * rowBytes, rowBytes);
+    }
+
+    ok = true;
+    forEachLiteral(layout, [&](size_t offset, size_t len) {
+      if (!ok)
+        return;
+      if (!in->hasData(len)) {
+        ok = false;
+        return;
+      }
+      in->readBytes(pixels + offset, len);
+    });
+
+    return ok;
+  });
+}
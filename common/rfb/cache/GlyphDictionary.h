@@ -0,0 +1,143 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef COMMON_RFB_CACHE_GLYPHDICTIONARY_H_
+#define COMMON_RFB_CACHE_GLYPHDICTIONARY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace rfb {
+namespace cache {
+
+// Terminal and editor text is drawn on a fixed grid of character cells
+// from a few hundred distinct glyphs, but the rects it changes are far
+// too small for whole-rect cache references to pay off. A GlyphRect
+// instead cuts such a rect into cells and sends each as a short index
+// into a dictionary that the client builds up as new glyphs are
+// defined.
+
+// How a GlyphRect is cut into cells. The full cells form a block that
+// starts at (ox, oy) in the rect; whatever is left around it is sent
+// as literal pixels.
+struct GlyphLayout {
+  int width, height;
+  int cellW, cellH;
+  int ox, oy;
+  int bytesPerPixel;
+
+  int columns() const {
+    return (width > ox) ? (width - ox) / cellW : 0;
+  }
+  int rows() const {
+    return (height > oy) ? (height - oy) / cellH : 0;
+  }
+  size_t cellBytes() const {
+    return (size_t)cellW * cellH * bytesPerPixel;
+  }
+};
+
+// Server side record of the glyphs a client holds. Indices are handed
+// out until the dictionary is full, after which the least recently
+// used glyph gives up its index.
+class GlyphDictionary {
+public:
+  // Indices are sent as U16, with some room for future flags
+  static const int MaxGlyphs = 16384;
+
+  GlyphDictionary(size_t maxGlyphs = 0);
+  ~GlyphDictionary();
+
+  // Zero disables the dictionary. Changing the size forgets
+  // everything, so the client has to be told to do the same.
+  void setMaxGlyphs(size_t maxGlyphs);
+  size_t maxGlyphs() const {
+    return limit;
+  }
+
+  size_t size() const {
+    return byHash.size();
+  }
+  void clear();
+
+  // Returns the index of a glyph with exactly these pixels, or -1
+  int find(uint64_t hash, const uint8_t* pixels, size_t length) const;
+  // Marks a glyph as recently used
+  void touch(int index);
+  // Assigns an index to a new glyph
+  int add(uint64_t hash, const uint8_t* pixels, size_t length);
+
+  static uint64_t hashCell(const uint8_t* pixels, size_t rowBytes, size_t stride, int height);
+
+private:
+  struct Glyph {
+    uint64_t hash;
+    std::vector<uint8_t> pixels;
+    std::list<int>::iterator lru;
+  };
+
+  size_t limit;
+
+  std::vector<Glyph> glyphs;
+  std::unordered_map<uint64_t, int> byHash;
+  // Most recently used first
+  std::list<int> lru;
+};
+
+// Client side glyph storage, indexed as the server tells us
+class GlyphTable {
+public:
+  GlyphTable();
+
+  void clear();
+
+  // Returns false if the index is out of range
+  bool set(int index, const uint8_t* pixels, size_t length);
+  // Returns nullptr if the index has no glyph of this size
+  const uint8_t* get(int index, size_t length) const;
+
+  size_t size() const {
+    return count;
+  }
+
+private:
+  std::vector<std::vector<uint8_t>> glyphs;
+  size_t count;
+};
+
+// Builds the zlib compressed payload of a GlyphRect. pixels holds the
+// whole rect, tightly packed. cells has the glyph index of every full
+// cell in row-major order, and newGlyphs the indices that this rect
+// defines together with the number of a cell that shows them.
+void encodeGlyphRect(const GlyphLayout& layout, const uint8_t* pixels, const std::vector<uint16_t>& cells,
+                     const std::vector<std::pair<uint16_t, int>>& newGlyphs, int level, std::vector<uint8_t>* out);
+
+// Rebuilds the pixels of a GlyphRect, storing the glyphs it defines in
+// table. Returns false if the payload is malformed or refers to glyphs
+// the table does not have.
+bool decodeGlyphRect(const GlyphLayout& layout, const uint8_t* data, size_t length, GlyphTable* table,
+                     uint8_t* pixels);
+
+} // namespace cache
+} // namespace rfb
+
+#endif // COMMON_RFB_CACHE_GLYPHDICTIONARY_H_
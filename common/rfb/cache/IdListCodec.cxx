@@ -0,0 +1,210 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <algorithm>
+
+#include <rfb/cache/IdListCodec.h>
+
+using namespace rfb;
+using namespace rfb::cache;
+
+namespace {
+
+class BitWriter {
+public:
+  BitWriter(std::vector<uint8_t>* out_) : out(out_), acc(0), bits(0) {}
+
+  void write(uint64_t value, unsigned count) {
+    while (count > 0) {
+      unsigned n;
+
+      n = std::min(count, 8 - bits);
+      count -= n;
+      acc = (acc << n) | ((value >> count) & ((1U << n) - 1));
+      bits += n;
+
+      if (bits == 8) {
+        out->push_back(acc);
+        acc = 0;
+        bits = 0;
+      }
+    }
+  }
+
+  void flush() {
+    if (bits != 0)
+      out->push_back(acc << (8 - bits));
+    acc = 0;
+    bits = 0;
+  }
+
+private:
+  std::vector<uint8_t>* out;
+  unsigned acc;
+  unsigned bits;
+};
+
+class BitReader {
+public:
+  BitReader(const uint8_t* data_, size_t length_) : data(data_), length(length_), pos(0) {}
+
+  bool read(unsigned count, uint64_t* value) {
+    if (pos + count > length * 8)
+      return false;
+
+    *value = 0;
+    while (count > 0) {
+      unsigned avail, n;
+
+      avail = 8 - (pos % 8);
+      n = std::min(count, avail);
+      *value = (*value << n) | ((data[pos / 8] >> (avail - n)) & ((1U << n) - 1));
+      pos += n;
+      count -= n;
+    }
+
+    return true;
+  }
+
+private:
+  const uint8_t* data;
+  size_t length;
+  size_t pos;
+};
+
+} // namespace
+
+void rfb::cache::sortIds(std::vector<uint64_t>* ids) {
+  std::sort(ids->begin(), ids->end());
+  ids->erase(std::unique(ids->begin(), ids->end()), ids->end());
+}
+
+uint8_t rfb::cache::chooseRiceBits(const uint64_t* ids, size_t count) {
+  uint64_t mean;
+  uint8_t bits;
+
+  if (count < 2)
+    return 0;
+
+  // The optimal parameter is close to log2 of the mean gap
+  mean = (ids[count - 1] - ids[0]) / (count - 1);
+
+  bits = 0;
+  while ((bits < 63) && ((mean >> (bits + 1)) != 0))
+    bits++;
+
+  return bits;
+}
+
+void rfb::cache::encodeIdList(const uint64_t* ids, size_t count, uint8_t riceBits, std::vector<uint8_t>* out) {
+  BitWriter writer(out);
+
+  if (count == 0)
+    return;
+
+  writer.write(ids[0], 64);
+
+  for (size_t i = 1; i < count; i++) {
+    uint64_t delta, quotient;
+
+    delta = ids[i] - ids[i - 1] - 1;
+    quotient = delta >> riceBits;
+
+    if (quotient >= MaxQuotient) {
+      writer.write((1ULL << MaxQuotient) - 1, MaxQuotient);
+      writer.write(delta, 64);
+      continue;
+    }
+
+    writer.write(((1ULL << quotient) - 1) << 1, quotient + 1);
+    writer.write(delta, riceBits);
+  }
+
+  writer.flush();
+}
+
+bool rfb::cache::decodeIdList(const uint8_t* data, size_t length, size_t count, uint8_t riceBits,
+                              std::vector<uint64_t>* ids) {
+  BitReader reader(data, length);
+  uint64_t id;
+
+  if (riceBits > 63)
+    return false;
+
+  ids->clear();
+
+  if (count == 0)
+    return length == 0;
+
+  // Every ID takes at least one bit, which stops bogus counts from
+  // making us allocate huge amounts of memory
+  if ((length * 8 < 64) || (count - 1 > length * 8 - 64))
+    return false;
+
+  ids->reserve(count);
+
+  if (!reader.read(64, &id))
+    return false;
+  ids->push_back(id);
+
+  for (size_t i = 1; i < count; i++) {
+    uint64_t quotient, bit, delta;
+
+    quotient = 0;
+    while (true) {
+      if (!reader.read(1, &bit))
+        return false;
+      if (bit == 0)
+        break;
+      if (++quotient == MaxQuotient)
+        break;
+    }
+
+    if (quotient == MaxQuotient) {
+      if (!reader.read(64, &delta))
+        return false;
+    } else {
+      uint64_t remainder;
+
+      if (!reader.read(riceBits, &remainder))
+        return false;
+      delta = (quotient << riceBits) | remainder;
+    }
+
+    // Must be strictly increasing, without wrapping around
+    if (delta >= UINT64_MAX - id)
+      return false;
+    id += delta + 1;
+
+    ids->push_back(id);
+  }
+
+  return true;
+}
+
+size_t rfb::cache::maxIdListLength(size_t count) {
+  if (count == 0)
+    return 0;
+
+  // 64 bits for the first ID, and an escaped gap at worst for the rest
+  return (64 + (count - 1) * (MaxQuotient + 64) + 7) / 8;
+}
@@ -0,0 +1,59 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef COMMON_RFB_CACHE_IDLISTCODEC_H_
+#define COMMON_RFB_CACHE_IDLISTCODEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace rfb {
+namespace cache {
+
+// Compact coding of a set of 64-bit cache IDs, used when a viewer
+// advertises its cache. The IDs are sorted and the gaps between them
+// Golomb-Rice coded, which for uniformly spread IDs costs about
+// 66 - log2(count) bits per ID rather than 64.
+//
+// The first ID is stored as is. Every following gap, minus one, is
+// split into a unary coded quotient and riceBits of remainder. Gaps
+// whose quotient would exceed MaxQuotient are escaped and stored in
+// full, so clustered or hostile input can't blow up the size.
+
+static const unsigned MaxQuotient = 32;
+
+// Sorts and removes duplicates
+void sortIds(std::vector<uint64_t>* ids);
+
+// ids must be sorted and free of duplicates
+uint8_t chooseRiceBits(const uint64_t* ids, size_t count);
+void encodeIdList(const uint64_t* ids, size_t count, uint8_t riceBits, std::vector<uint8_t>* out);
+
+// Returns false if the data is malformed, which includes IDs that are
+// not strictly increasing
+bool decodeIdList(const uint8_t* data, size_t length, size_t count, uint8_t riceBits, std::vector<uint64_t>* ids);
+
+// Upper bound for the encoded size of count IDs
+size_t maxIdListLength(size_t count);
+
+} // namespace cache
+} // namespace rfb
+
+#endif // COMMON_RFB_CACHE_IDLISTCODEC_H_
@@ -16,8 +16,23 @@
  * USA.
  */
 
+#include <core/LogWriter.h>
+
+#include <rfb/ServerCore.h>
 #include <rfb/cache/ScanTelemetry.h>
+#include <rfb/cache/ShiftTolerantScan.h>
+
+static core::LogWriter vlog("ScanTelemetry");
+
+void rfb::cache::ScanTelemetry::logIfEnabled(const char* stage, const ScanStats& stats) {
+  if (!rfb::Server::cacheScanLogStats)
+    return;
 
-void rfb::cache::ScanTelemetry::logIfEnabled(const ScanStats& /*stats*/) {
-  // Stub implementation (Phase 0 scaffolding).
+  vlog.info("CACHESCAN %s: blocksHashed=%llu rectsHashed=%llu "
+            "blocksHit=%llu packed=%llu verified=%llu "
+            "emitted=%llu timeUs=%llu",
+            stage, (unsigned long long)stats.blocksHashed, (unsigned long long)stats.rectsHashed,
+            (unsigned long long)stats.blocksHit, (unsigned long long)stats.packedRects,
+            (unsigned long long)stats.rectHitsVerified, (unsigned long long)stats.rectHitsEmitted,
+            (unsigned long long)stats.timeUs);
 }
@@ -28,7 +28,9 @@ struct ScanStats;
 
 class ScanTelemetry {
 public:
-  static void logIfEnabled(const ScanStats& stats);
+  // Logs one line per scan stage and update when CacheScanLogStats is
+  // set
+  static void logIfEnabled(const char* stage, const ScanStats& stats);
 };
 
 } // namespace cache
@@ -1,8 +1,13 @@
 #ifndef __RFB_CACHE_SERVERHASHSET_H__
 #define __RFB_CACHE_SERVERHASHSET_H__
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <functional>
+#include <iterator>
 #include <unordered_set>
+#include <vector>
 
 namespace rfb {
 
@@ -37,6 +42,15 @@ public:
     }
   }
 
+  /**
+   * Add a batch of keys (e.g. one HashList chunk)
+   */
+  void addMultiple(const std::vector<KeyType>& keys) {
+    knownKeys_.reserve(knownKeys_.size() + keys.size());
+    for (const auto& key : keys)
+      add(key);
+  }
+
   /**
    * Remove key from known set (when client sends eviction notification)
    * Returns true if key was present
@@ -79,6 +93,22 @@ public:
     return knownKeys_.size();
   }
 
+  bool empty() const {
+    return knownKeys_.empty();
+  }
+
+  /**
+   * Iteration over the known keys, in no particular order
+   */
+  typedef typename std::unordered_set<KeyType, Hasher>::const_iterator const_iterator;
+
+  const_iterator begin() const {
+    return knownKeys_.begin();
+  }
+  const_iterator end() const {
+    return knownKeys_.end();
+  }
+
   /**
    * Statistics
    */
@@ -102,6 +132,259 @@ private:
   uint64_t evictedCount_; // Total keys ever evicted
 };
 
+/**
+ * ServerHashSet for 64-bit cache IDs
+ *
+ * A viewer with a large PersistentCache can advertise millions of IDs,
+ * so this is a flat open-addressing table rather than one heap node per
+ * key. Linear probing is used and removal shifts the following entries
+ * back instead of leaving tombstones, so lookups never slow down from
+ * churn. Key 0 doubles as the empty slot marker and is tracked
+ * separately.
+ */
+template <typename Hasher> class ServerHashSet<uint64_t, Hasher> {
+public:
+  ServerHashSet() : count_(0), hasZero_(false), knownCount_(0), evictedCount_(0) {}
+  ~ServerHashSet() {}
+
+  bool has(const uint64_t& key) const {
+    size_t i;
+
+    if (key == 0)
+      return hasZero_;
+    if (slots_.empty())
+      return false;
+
+    for (i = home(key);; i = (i + 1) & mask()) {
+      if (slots_[i] == key)
+        return true;
+      if (slots_[i] == 0)
+        return false;
+    }
+  }
+
+  void add(const uint64_t& key) {
+    if (key == 0) {
+      if (!hasZero_) {
+        hasZero_ = true;
+        knownCount_++;
+      }
+      return;
+    }
+
+    if ((count_ + 1) * 4 > slots_.size() * 3)
+      grow(count_ + 1);
+
+    if (insert(key))
+      knownCount_++;
+  }
+
+  void addMultiple(const std::vector<uint64_t>& keys) {
+    reserve(size() + keys.size());
+    for (uint64_t key : keys)
+      add(key);
+  }
+
+  bool remove(const uint64_t& key) {
+    size_t i, j;
+
+    if (key == 0) {
+      if (!hasZero_)
+        return false;
+      hasZero_ = false;
+      evictedCount_++;
+      return true;
+    }
+    if (slots_.empty())
+      return false;
+
+    for (i = home(key);; i = (i + 1) & mask()) {
+      if (slots_[i] == key)
+        break;
+      if (slots_[i] == 0)
+        return false;
+    }
+
+    // Pull back any following entries that would otherwise become
+    // unreachable through the hole we are leaving
+    for (j = (i + 1) & mask(); slots_[j] != 0; j = (j + 1) & mask()) {
+      size_t k;
+
+      k = home(slots_[j]);
+      // Leave the entry if its home lies cyclically in (i, j]
+      if (((j - k) & mask()) < ((j - i) & mask()))
+        continue;
+
+      slots_[i] = slots_[j];
+      i = j;
+    }
+    slots_[i] = 0;
+
+    count_--;
+    evictedCount_++;
+    return true;
+  }
+
+  size_t removeMultiple(const std::vector<uint64_t>& keys) {
+    size_t removed = 0;
+    for (uint64_t key : keys) {
+      if (remove(key))
+        removed++;
+    }
+    return removed;
+  }
+
+  void clear() {
+    std::vector<uint64_t>().swap(slots_);
+    count_ = 0;
+    hasZero_ = false;
+    knownCount_ = 0;
+    evictedCount_ = 0;
+  }
+
+  /**
+   * Make room for n keys without rehashing along the way
+   */
+  void reserve(size_t n) {
+    if (n * 4 > slots_.size() * 3)
+      grow(n);
+  }
+
+  size_t size() const {
+    return count_ + (hasZero_ ? 1 : 0);
+  }
+
+  bool empty() const {
+    return size() == 0;
+  }
+
+  /**
+   * Heap memory used by the table, in bytes
+   */
+  size_t memoryUsage() const {
+    return slots_.capacity() * sizeof(uint64_t);
+  }
+
+  class const_iterator {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef uint64_t value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const uint64_t* pointer;
+    typedef const uint64_t& reference;
+
+    const_iterator(const ServerHashSet* set_, size_t pos_) : set(set_), pos(pos_) { skip(); }
+
+    reference operator*() const {
+      static const uint64_t zero = 0;
+      return pos == 0 ? zero : set->slots_[pos - 1];
+    }
+    const_iterator& operator++() {
+      pos++;
+      skip();
+      return *this;
+    }
+    bool operator==(const const_iterator& other) const { return pos == other.pos; }
+    bool operator!=(const const_iterator& other) const { return pos != other.pos; }
+
+  private:
+    // Position 0 is the separately tracked zero key, the rest map
+    // to slot pos - 1
+    void skip() {
+      if ((pos == 0) && !set->hasZero_)
+        pos++;
+      while ((pos > 0) && (pos <= set->slots_.size()) && (set->slots_[pos - 1] == 0))
+        pos++;
+    }
+
+    const ServerHashSet* set;
+    size_t pos;
+  };
+
+  const_iterator begin() const {
+    return const_iterator(this, 0);
+  }
+  const_iterator end() const {
+    return const_iterator(this, slots_.size() + 1);
+  }
+
+  struct Stats {
+    size_t currentSize;
+    uint64_t totalAdded;
+    uint64_t totalEvicted;
+  };
+
+  Stats getStats() const {
+    Stats s;
+    s.currentSize = size();
+    s.totalAdded = knownCount_;
+    s.totalEvicted = evictedCount_;
+    return s;
+  }
+
+private:
+  size_t mask() const {
+    return slots_.size() - 1;
+  }
+
+  size_t home(uint64_t key) const {
+    uint64_t h;
+
+    // std::hash is the identity for integers, and IDs often share
+    // their low bits, so finish with a proper mix (MurmurHash3 fmix64)
+    h = Hasher()(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h & mask();
+  }
+
+  bool insert(uint64_t key) {
+    size_t i;
+
+    for (i = home(key);; i = (i + 1) & mask()) {
+      if (slots_[i] == key)
+        return false;
+      if (slots_[i] == 0)
+        break;
+    }
+
+    slots_[i] = key;
+    count_++;
+    return true;
+  }
+
+  void grow(size_t n) {
+    std::vector<uint64_t> old;
+    size_t capacity;
+
+    // Keep the load factor at or below 3/4
+    capacity = 16;
+    while (capacity * 3 < n * 4)
+      capacity *= 2;
+    if (capacity <= slots_.size())
+      return;
+
+    old.swap(slots_);
+    slots_.assign(capacity, 0);
+    count_ = 0;
+
+    for (uint64_t key : old) {
+      if (key != 0)
+        insert(key);
+    }
+  }
+
+  std::vector<uint64_t> slots_;
+  size_t count_;          // Non-zero keys in slots_
+  bool hasZero_;          // Key 0 is present
+  uint64_t knownCount_;   // Total keys ever added
+  uint64_t evictedCount_; // Total keys ever evicted
+};
+
 } // namespace rfb
 
 #endif // __RFB_CACHE_SERVERHASHSET_H__
@@ -18,6 +18,7 @@
 
 #include <rfb/cache/ShiftTolerantScan.h>
 
+#include <core/time.h>
 #include <rfb/ContentHash.h>
 #include <rfb/cache/VolatilityMap.h>
 
@@ -26,12 +27,6 @@
 
 namespace {
 
-inline uint64_t nowUs() {
-  struct timeval tv;
-  gettimeofday(&tv, nullptr);
-  return (uint64_t)tv.tv_sec * 1000000ULL + (uint64_t)tv.tv_usec;
-}
-
 inline rfb::CacheKey cacheKeyFromHash(const std::vector<uint8_t>& hash) {
   if (hash.size() < 16)
     return rfb::CacheKey();
@@ -76,10 +71,10 @@ static inline void snapStart(const core::Rect& scan, int T, int ox, int oy, int*
   *y0 = sy;
 }
 
-static inline bool cellIsVolatile(const VolatilityMap* vol, int x, int y) {
+static inline bool cellIsVolatile(const VolatilityMap* vol, const core::Rect& r) {
   if (!vol)
     return false;
-  return vol->isVolatileXY(x, y);
+  return vol->rectTouchesVolatile(r);
 }
 
 static inline int coveragePermille(const core::Region& damage, const core::Rect& rect) {
@@ -128,7 +123,8 @@ std::vector<KeyedRect> ShiftTolerantScanner::scanAndPackImpl(const core::Region&
     return out;
   }
 
-  const uint64_t t0 = nowUs();
+  struct timeval t0;
+  gettimeofday(&t0, nullptr);
 
   std::vector<int> tileSizes = cfg_.tileSizes;
   if (tileSizes.empty())
@@ -155,8 +151,7 @@ std::vector<KeyedRect> ShiftTolerantScanner::scanAndPackImpl(const core::Region&
 
       for (int gy = 0; gy < gridH; ++gy) {
         for (int gx = 0; gx < gridW; ++gx) {
-          const uint64_t now = nowUs();
-          const int elapsedUs = (int)(now - t0);
+          const int elapsedUs = (int)core::usSince(&t0);
           if ((cfg_.budgetUs > 0 && elapsedUs >= cfg_.budgetUs) ||
               (cfg_.maxBlocks > 0 && (int)localStats.blocksHashed >= cfg_.maxBlocks)) {
             goto done;
@@ -172,7 +167,7 @@ std::vector<KeyedRect> ShiftTolerantScanner::scanAndPackImpl(const core::Region&
           if (damage.intersect(r).is_empty())
             continue;
 
-          if (cellIsVolatile(vol, r.tl.x, r.tl.y))
+          if (cellIsVolatile(vol, r))
             continue;
 
           std::vector<uint8_t> hash = ContentHash::computeRect(pb, r);
@@ -260,7 +255,7 @@ std::vector<KeyedRect> ShiftTolerantScanner::scanAndPackImpl(const core::Region&
 
 done:
   localStats.rectHitsEmitted = out.size();
-  localStats.timeUs = nowUs() - t0;
+  localStats.timeUs = core::usSince(&t0);
   if (outStats)
     *outStats = localStats;
   return out;
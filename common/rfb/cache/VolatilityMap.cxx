@@ -18,36 +18,164 @@
 
 #include <rfb/cache/VolatilityMap.h>
 
+// Number of short intervals in a row before a tile counts as volatile.
+// Three rules out a window that is merely being dragged or typed in
+// once or twice.
+static const uint8_t VolatileStreak = 3;
+static const uint8_t MaxStreak = 255;
+
 static inline int ceil_div(int a, int b) {
   return (a + b - 1) / b;
 }
 
 rfb::cache::VolatilityMap::VolatilityMap(int fbWidth, int fbHeight, int gridSize, int windowMs)
-    : gridSize_(gridSize), windowMs_(windowMs) {
-  tilesX_ = ceil_div(fbWidth, gridSize_);
-  tilesY_ = ceil_div(fbHeight, gridSize_);
-  ewma_.assign(tilesX_ * tilesY_, 0);
-  lastMs_.assign(tilesX_ * tilesY_, 0);
+    : gridSize_(gridSize > 0 ? gridSize : 64), windowMs_(windowMs), nowMs_(0) {
+  resize(fbWidth, fbHeight);
 }
 
 void rfb::cache::VolatilityMap::resize(int fbWidth, int fbHeight) {
+  fbWidth_ = fbWidth;
+  fbHeight_ = fbHeight;
   tilesX_ = ceil_div(fbWidth, gridSize_);
   tilesY_ = ceil_div(fbHeight, gridSize_);
   ewma_.assign(tilesX_ * tilesY_, 0);
   lastMs_.assign(tilesX_ * tilesY_, 0);
+  streak_.assign(tilesX_ * tilesY_, 0);
 }
 
-void rfb::cache::VolatilityMap::noteDamage(const core::Rect& /*bbox*/, uint64_t /*nowMs*/) {
-  (void)windowMs_;
-  // Stub implementation (Phase 0 scaffolding).
+void rfb::cache::VolatilityMap::noteDamage(const core::Rect& bbox, uint64_t nowMs) {
+  core::Rect r;
+  int tx0, ty0, tx1, ty1;
+
+  advance(nowMs);
+
+  r = bbox.intersect({0, 0, fbWidth_, fbHeight_});
+  if (r.is_empty())
+    return;
+
+  tx0 = r.tl.x / gridSize_;
+  ty0 = r.tl.y / gridSize_;
+  tx1 = ceil_div(r.br.x, gridSize_);
+  ty1 = ceil_div(r.br.y, gridSize_);
+
+  for (int ty = ty0; ty < ty1; ty++) {
+    for (int tx = tx0; tx < tx1; tx++) {
+      int idx;
+      uint64_t interval;
+
+      idx = tileIndex(tx, ty);
+
+      // Several rects of the same update can hit the same tile
+      if (lastMs_[idx] == nowMs)
+        continue;
+
+      if (lastMs_[idx] == 0) {
+        lastMs_[idx] = nowMs;
+        continue;
+      }
+
+      interval = nowMs - lastMs_[idx];
+      lastMs_[idx] = nowMs;
+
+      if (interval > (uint64_t)windowMs_) {
+        ewma_[idx] = 0;
+        streak_[idx] = 0;
+        continue;
+      }
+
+      if (ewma_[idx] == 0)
+        ewma_[idx] = interval;
+      else
+        ewma_[idx] = (ewma_[idx] * 3 + interval) / 4;
+
+      if (streak_[idx] < MaxStreak)
+        streak_[idx]++;
+    }
+  }
 }
 
-bool rfb::cache::VolatilityMap::isVolatileXY(int /*x*/, int /*y*/) const {
-  // Stub implementation (Phase 0 scaffolding).
-  return false;
+void rfb::cache::VolatilityMap::advance(uint64_t nowMs) {
+  if (nowMs > nowMs_)
+    nowMs_ = nowMs;
+}
+
+bool rfb::cache::VolatilityMap::tileIsVolatile(int idx) const {
+  if (streak_[idx] < VolatileStreak)
+    return false;
+  // Settled?
+  if ((nowMs_ - lastMs_[idx]) > (uint64_t)windowMs_)
+    return false;
+  return true;
+}
+
+bool rfb::cache::VolatilityMap::isVolatileXY(int x, int y) const {
+  if ((x < 0) || (y < 0) || (x >= fbWidth_) || (y >= fbHeight_))
+    return false;
+  return tileIsVolatile(tileIndex(x / gridSize_, y / gridSize_));
 }
 
-bool rfb::cache::VolatilityMap::rectTouchesVolatile(const core::Rect& /*r*/) const {
-  // Stub implementation (Phase 0 scaffolding).
+bool rfb::cache::VolatilityMap::rectTouchesVolatile(const core::Rect& r) const {
+  core::Rect cr;
+
+  cr = r.intersect({0, 0, fbWidth_, fbHeight_});
+  if (cr.is_empty())
+    return false;
+
+  for (int ty = cr.tl.y / gridSize_; ty < ceil_div(cr.br.y, gridSize_); ty++) {
+    for (int tx = cr.tl.x / gridSize_; tx < ceil_div(cr.br.x, gridSize_); tx++) {
+      if (tileIsVolatile(tileIndex(tx, ty)))
+        return true;
+    }
+  }
+
   return false;
 }
+
+core::Region rfb::cache::VolatilityMap::volatileRegion() const {
+  core::Region region;
+  core::Rect fbRect(0, 0, fbWidth_, fbHeight_);
+
+  // Merge runs on each row to keep the region operations cheap
+  for (int ty = 0; ty < tilesY_; ty++) {
+    int tx = 0;
+    while (tx < tilesX_) {
+      int start;
+
+      if (!tileIsVolatile(tileIndex(tx, ty))) {
+        tx++;
+        continue;
+      }
+
+      start = tx;
+      while ((tx < tilesX_) && tileIsVolatile(tileIndex(tx, ty)))
+        tx++;
+
+      region.assign_union(core::Rect(start * gridSize_, ty * gridSize_, tx * gridSize_, (ty + 1) * gridSize_)
+                              .intersect(fbRect));
+    }
+  }
+
+  return region;
+}
+
+int rfb::cache::VolatilityMap::updateIntervalMs(const core::Rect& r) const {
+  core::Rect cr;
+  int interval;
+
+  cr = r.intersect({0, 0, fbWidth_, fbHeight_});
+  if (cr.is_empty())
+    return 0;
+
+  interval = 0;
+  for (int ty = cr.tl.y / gridSize_; ty < ceil_div(cr.br.y, gridSize_); ty++) {
+    for (int tx = cr.tl.x / gridSize_; tx < ceil_div(cr.br.x, gridSize_); tx++) {
+      int idx = tileIndex(tx, ty);
+      if (!tileIsVolatile(idx))
+        continue;
+      if ((interval == 0) || ((int)ewma_[idx] < interval))
+        interval = ewma_[idx];
+    }
+  }
+
+  return interval;
+}
@@ -20,35 +20,62 @@
 #define COMMON_RFB_CACHE_VOLATILITYMAP_H_
 
 #include <core/Rect.h>
+#include <core/Region.h>
 #include <stdint.h>
 #include <vector>
 
 namespace rfb {
 namespace cache {
 
+// Coarse per-tile classification of how often the framebuffer changes.
+//
+// Every damaged tile keeps a smoothed estimate of the interval between
+// its updates. A tile that has been damaged repeatedly with intervals
+// shorter than windowMs is considered volatile (video, animations),
+// and stops being volatile once it has gone windowMs without damage.
 class VolatilityMap {
 public:
   VolatilityMap(int fbWidth, int fbHeight, int gridSize, int windowMs);
 
   void noteDamage(const core::Rect& bbox, uint64_t nowMs);
+  // Advances the clock without any damage so that idle tiles can settle
+  void advance(uint64_t nowMs);
+
   bool isVolatileXY(int x, int y) const;
   bool rectTouchesVolatile(const core::Rect& r) const;
 
+  // Union of all volatile tiles, clipped to the framebuffer
+  core::Region volatileRegion() const;
+  // Shortest smoothed update interval of the volatile tiles touching
+  // r, or 0 if there are none
+  int updateIntervalMs(const core::Rect& r) const;
+
   void resize(int fbWidth, int fbHeight);
 
+  int width() const {
+    return fbWidth_;
+  }
+  int height() const {
+    return fbHeight_;
+  }
+
 private:
-  // cppcheck-suppress unusedStructMember
+  bool tileIsVolatile(int idx) const;
+
   int gridSize_;
-  // cppcheck-suppress unusedStructMember
   int windowMs_;
+  int fbWidth_;
+  int fbHeight_;
   int tilesX_;
-  // cppcheck-suppress unusedStructMember
   int tilesY_;
 
-  // cppcheck-suppress unusedStructMember
+  uint64_t nowMs_;
+
+  // Smoothed interval between damage, in ms
   std::vector<uint32_t> ewma_;
-  // cppcheck-suppress unusedStructMember
   std::vector<uint64_t> lastMs_;
+  // Number of consecutive short intervals
+  std::vector<uint8_t> streak_;
 
   int tileIndex(int tx, int ty) const {
     return ty * tilesX_ + tx;
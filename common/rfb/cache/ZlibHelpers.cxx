@@ -0,0 +1,52 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdexcept>
+
+#include <rdr/MemInStream.h>
+#include <rdr/ZlibInStream.h>
+
+#include <rfb/cache/ZlibHelpers.h>
+
+bool rfb::cache::inflateExactly(const uint8_t* data, size_t length,
+                                const std::function<bool(rdr::InStream* in)>& read) {
+  rdr::MemInStream mis(data, length);
+  rdr::ZlibInStream zis;
+
+  zis.setUnderlying(&mis, length);
+
+  try {
+    if (!read(&zis))
+      return false;
+
+    // Anything left over means the sizes don't agree
+    if (zis.avail() != 0)
+      return false;
+
+    zis.flushUnderlying();
+  } catch (std::exception&) {
+    // Truncated or corrupt
+    return false;
+  }
+
+  return true;
+}
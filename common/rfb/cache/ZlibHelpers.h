@@ -0,0 +1,43 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef COMMON_RFB_CACHE_ZLIBHELPERS_H_
+#define COMMON_RFB_CACHE_ZLIBHELPERS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+
+namespace rdr {
+class InStream;
+}
+
+namespace rfb {
+namespace cache {
+
+// Decompresses a self-contained zlib payload, such as that of a
+// PersistentCachedRectDelta, handing the result to read. Returns false
+// if read does, or if the payload is truncated, corrupt or has more
+// data than read consumed.
+bool inflateExactly(const uint8_t* data, size_t length, const std::function<bool(rdr::InStream* in)>& read);
+
+} // namespace cache
+} // namespace rfb
+
+#endif // COMMON_RFB_CACHE_ZLIBHELPERS_H_
@@ -48,6 +48,14 @@ int rfb::encodingNum(const char* name) {
     return encodingPersistentCachedRectWithOffset;
   if (strcasecmp(name, "PersistentCachedRectInit") == 0)
     return encodingPersistentCachedRectInit;
+  if (strcasecmp(name, "PersistentCachedRectDelta") == 0)
+    return encodingPersistentCachedRectDelta;
+  if (strcasecmp(name, "GlyphRect") == 0)
+    return encodingGlyphRect;
+  if (strcasecmp(name, "LossyRefinement") == 0)
+    return encodingLossyRefinement;
+  if (strcasecmp(name, "SharedMemory") == 0)
+    return encodingSharedMemory;
   if (strcasecmp(name, "CachedRect") == 0)
     return encodingPersistentCachedRect;
   if (strcasecmp(name, "CachedRectWithOffset") == 0)
@@ -81,6 +89,14 @@ const char* rfb::encodingName(int num) {
     return "PersistentCachedRect";
   case encodingPersistentCachedRectInit:
     return "PersistentCachedRectInit";
+  case encodingPersistentCachedRectDelta:
+    return "PersistentCachedRectDelta";
+  case encodingGlyphRect:
+    return "GlyphRect";
+  case encodingLossyRefinement:
+    return "LossyRefinement";
+  case encodingSharedMemory:
+    return "SharedMemory";
   default:
     return "[unknown encoding]";
   }
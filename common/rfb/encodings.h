@@ -53,6 +53,36 @@ const int encodingPersistentCachedRectInit =
 // Wire format: rect header + 16-byte CacheKey
 const int encodingCachedRectSeed = 105;
 
+// TigerVNC cache delta encoding (server→client)
+// New content given as the difference against a lossless entry the
+// client already holds. The residual is the XOR of the old and new
+// pixels in the client's pixel format, zlib compressed.
+// Wire format: rect header + 16-byte base CacheKey + 16-byte new
+// CacheKey + U32 length + residual
+const int encodingPersistentCachedRectDelta = 106;
+
+// TigerVNC glyph encoding (server→client)
+// Text-like content cut into fixed size cells, each sent as an index
+// into a glyph dictionary that the client keeps alongside its cache.
+// Wire format: rect header + U8 flags + U8 cellW + U8 cellH + U8 ox +
+// U8 oy + U32 length + zlib data (see cache/GlyphDictionary.h)
+const int encodingGlyphRect = 107;
+const int glyphRectFlagReset = 1 << 0; // Forget all glyphs first
+
+// TigerVNC lossy refinement (server→client)
+// Turns an area the client has as JPEG into the exact pixels by adding
+// a difference to each 8 bit colour channel (see LossyRefinement.h).
+// Wire format: rect header + U64 hash of the client's current pixels +
+// U32 length + zlib data
+const int encodingLossyRefinement = 108;
+
+// TigerVNC shared memory transport (server→client, Unix sockets only)
+// The server keeps a copy of the framebuffer in a SharedPixelBuffer
+// and passes the client a file descriptor for it, after which updates
+// only say what has changed. Each new buffer gets a new generation.
+// Wire format: rect header + U32 generation
+const int encodingSharedMemory = 109;
+
 const int encodingMax = 255;
 
 const int pseudoEncodingXCursor = -240;
@@ -71,6 +101,15 @@ const int pseudoEncodingQEMUKeyEvent = -258;
 const int pseudoEncodingPersistentCache = -321; // Cross-session, content hashes
 // Native-format (canonical 32bpp) cache init extension negotiated separately
 const int pseudoEncodingNativeFormatCache = -327;
+// Server hands out cache epoch tokens, allowing delta HashLists
+const int pseudoEncodingPersistentCacheEpoch = -328;
+
+// Shared memory transport, see encodingSharedMemory. Also the new
+// buffer in a rect covering all of it, with the file descriptor passed
+// alongside via SCM_RIGHTS.
+// Wire format: rect header + U32 generation + U32 stride (in pixels) +
+// PIXEL_FORMAT
+const int pseudoEncodingSharedMemory = -329;
 
 // TightVNC-specific
 const int pseudoEncodingLastRect = -224;
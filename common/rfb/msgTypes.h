@@ -66,6 +66,15 @@ const int msgTypePersistentCacheHashReport = 247;
 // Payload: U32 timestamp (seconds since epoch) to correlate with client dump
 const int msgTypeDebugDumpRequest = 246;
 
+// PersistentCache ID list (client→server)
+// Compressed replacement for HashList. Either the full set of IDs the
+// client has, or the changes since an epoch token the server gave it.
+const int msgTypePersistentCacheIdList = 245;
+
+// Flags for msgTypePersistentCacheIdList
+const int idListFlagDelta = 1 << 0;    // Relative to baseToken
+const int idListFlagRemoved = 1 << 1;  // IDs the client no longer has
+
 const int msgTypeQEMUClientMessage = 255;
 } // namespace rfb
 #endif
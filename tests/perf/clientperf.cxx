@@ -0,0 +1,521 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+/*
+ * Runs a server with a mix of fast clients and clients that can only
+ * read at a limited rate, and measures how long input from the fast
+ * clients waits before the server gets to it. This shows how much
+ * the server loop is held up by encoding, with and without
+ * ClientThreads. It can also compare the same run with and without
+ * AdaptiveEncoding, AdaptiveUpdateRate or SharedMemory.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <core/Configuration.h>
+#include <core/Logger_stdio.h>
+#include <core/Timer.h>
+
+#include <rdr/FdInStream.h>
+#include <rdr/FdOutStream.h>
+
+#include <network/UnixSocket.h>
+
+#include <rfb/CConnection.h>
+#include <rfb/CMsgWriter.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/SDesktop.h>
+#include <rfb/SecurityClient.h>
+#include <rfb/SecurityServer.h>
+#include <rfb/ServerCore.h>
+#include <rfb/VNCServerST.h>
+#include <rfb/encodings.h>
+
+static core::IntParameter width("width", "Frame buffer width", 1920);
+static core::IntParameter height("height", "Frame buffer height", 1080);
+static core::IntParameter fastClients("fast", "Number of clients reading as fast as they can", 2, 1, 64);
+static core::IntParameter slowClients("slow", "Number of clients reading at a limited rate", 2, 0, 64);
+static core::IntParameter slowRate("rate", "Read rate of the slow clients in KiB/s", 256, 1, 1000000);
+static core::IntParameter changed("changed", "Percentage of the frame buffer changed per frame", 25, 1, 100);
+static core::IntParameter duration("duration", "Seconds to run each mode", 5, 1, 3600);
+static core::IntParameter quality("quality", "JPEG quality level the clients ask for (-1: no JPEG)", 8, -1, 9);
+static core::BoolParameter adaptive("adaptive", "Compare with and without AdaptiveEncoding instead of ClientThreads",
+                                    false);
+static core::BoolParameter paced("paced", "Compare with and without AdaptiveUpdateRate instead of ClientThreads",
+                                 false);
+static core::BoolParameter shm("shm", "Compare with and without SharedMemory instead of ClientThreads", false);
+static core::BoolParameter volatility("volatility",
+                                      "Compare with and without EnableVolatilityMap instead of ClientThreads", false);
+static core::BoolParameter video("video",
+                                 "Play a video in the middle quarter of the frame buffer instead of changing "
+                                 "'changed' percent of it with noise",
+                                 false);
+
+static const rfb::PixelFormat fbPF(32, 24, false, true, 255, 255, 255, 0, 8, 16);
+
+typedef std::chrono::steady_clock Clock;
+
+// Input sent by the fast clients, by keysym
+static std::mutex inputMutex;
+static std::map<uint32_t, Clock::time_point> inputSent;
+static std::vector<double> inputLatency;
+
+static std::atomic<bool> stopClients;
+
+class Desktop : public rfb::SDesktop {
+public:
+  void init(rfb::VNCServer* vs) override {
+    server = vs;
+  }
+  void queryConnection(network::Socket* sock, const char*) override {
+    server->approveConnection(sock, true, nullptr);
+  }
+  void terminate() override {}
+
+  void keyEvent(uint32_t keysym, uint32_t, bool down) override {
+    std::lock_guard<std::mutex> lock(inputMutex);
+    std::map<uint32_t, Clock::time_point>::iterator iter;
+
+    if (!down)
+      return;
+
+    iter = inputSent.find(keysym);
+    if (iter == inputSent.end())
+      return;
+
+    inputLatency.push_back(std::chrono::duration<double, std::milli>(Clock::now() - iter->second).count());
+    inputSent.erase(iter);
+  }
+
+private:
+  rfb::VNCServer* server;
+};
+
+// Changes part of the frame buffer at the frame rate, with content
+// that does not compress well, or that looks like a video
+class Animator : public core::Timer::Callback {
+public:
+  Animator(rfb::ManagedPixelBuffer* pb_, rfb::VNCServer* server_) : pb(pb_), server(server_), timer(this), frame(0) {
+    noise.resize(pb->width() * 2 * pb->height());
+    for (int y = 0; y < pb->height(); y++) {
+      for (int x = 0; x < pb->width() * 2; x++) {
+        uint32_t r, g, b;
+
+        if (!video) {
+          noise[x + y * pb->width() * 2] = rand();
+          continue;
+        }
+
+        // A smooth scene with a little grain, that the video pans across
+        r = (128 + (int)(100 * sin(x / 40.0) * cos(y / 55.0)) + (rand() & 0x03)) & 0xff;
+        g = (128 + (int)(100 * sin((x + y) / 70.0)) + (rand() & 0x03)) & 0xff;
+        b = (96 + (y / 4) % 64 + (rand() & 0x03)) & 0xff;
+        noise[x + y * pb->width() * 2] = (r << 16) | (g << 8) | b;
+      }
+    }
+    timer.start(1000 / rfb::Server::frameRate);
+  }
+
+  void handleTimeout(core::Timer* t) override {
+    core::Rect r;
+
+    if (video) {
+      r.setXYWH(pb->width() / 4, pb->height() / 4, pb->width() / 2, pb->height() / 2);
+      pb->imageRect(r, &noise[(frame * 3) % pb->width()], pb->width() * 2);
+    } else {
+      r.setXYWH(0, 0, pb->width(), pb->height() * changed / 100);
+      r = r.translate({0, (frame * 16) % (pb->height() - r.height() + 1)});
+      pb->imageRect(r, &noise[(frame * 17) % pb->width()], pb->width() * 2);
+    }
+    server->add_changed(r);
+
+    frame++;
+    t->repeat();
+  }
+
+private:
+  rfb::ManagedPixelBuffer* pb;
+  rfb::VNCServer* server;
+  core::Timer timer;
+  int frame;
+  std::vector<uint32_t> noise;
+};
+
+class Client : public rfb::CConnection {
+public:
+  Client(int fd_, int rate_, bool sendInput_)
+      : fd(fd_), in(fd_), out(fd_), rate(rate_), sendInput(sendInput_), updates(0), bytes(0) {
+    supportsPersistentCache = false;
+    setStreams(&in, &out);
+    setShared(true);
+    setPreferredEncoding(rfb::encodingTight);
+    setQualityLevel(quality);
+    if (shm) {
+      in.acceptFds(true);
+      supportsSharedMemory = true;
+    }
+  }
+  ~Client() {
+    ::close(fd);
+  }
+
+  void initDone() override {
+    setFramebuffer(new rfb::ManagedPixelBuffer(server.pf(), server.width(), server.height()));
+  }
+  void framebufferUpdateEnd() override {
+    rfb::CConnection::framebufferUpdateEnd();
+    updates++;
+  }
+  int takePassedFd() override {
+    return in.takeFd();
+  }
+  void setColourMapEntries(int, int, uint16_t*) override {}
+  void bell() override {}
+  void getUserPasswd(bool, std::string*, std::string*) override {}
+  bool showMsgBox(rfb::MsgBoxFlags, const char*, const char*) override {
+    return true;
+  }
+
+  void run();
+
+private:
+  void sendKey();
+
+  int fd;
+  rdr::FdInStream in;
+  rdr::FdOutStream out;
+  int rate;
+  bool sendInput;
+  uint32_t nextKey;
+
+public:
+  std::atomic<unsigned> updates;
+  size_t bytes;
+};
+
+void Client::run() {
+  Clock::time_point start, lastInput;
+
+  start = Clock::now();
+  lastInput = start;
+  nextKey = 0;
+
+  try {
+    initialiseProtocol();
+
+    while (!stopClients) {
+      Clock::time_point now;
+
+      if (!processMsg()) {
+        struct pollfd pfd;
+
+        out.flush();
+
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        poll(&pfd, 1, 5);
+      }
+
+      now = Clock::now();
+
+      if (sendInput && (state() == RFBSTATE_NORMAL) && (now - lastInput) >= std::chrono::milliseconds(10)) {
+        sendKey();
+        lastInput = now;
+      }
+
+      // Pretend to be on a slow link by not reading faster than the
+      // configured rate
+      if (rate != 0) {
+        std::chrono::duration<double> due((double)in.pos() / (rate * 1024));
+        if ((now - start) < due)
+          std::this_thread::sleep_for(due - (now - start));
+      }
+    }
+  } catch (std::exception& e) {
+    if (!stopClients)
+      fprintf(stderr, "Client failed: %s\n", e.what());
+  }
+
+  bytes = in.pos();
+}
+
+void Client::sendKey() {
+  uint32_t keysym;
+
+  // Printable Latin-1 to keep the server's key handling simple
+  keysym = 'a' + nextKey++ % 26;
+
+  {
+    std::lock_guard<std::mutex> lock(inputMutex);
+    // Still waiting for the previous one with this keysym
+    if (inputSent.count(keysym) != 0)
+      return;
+    inputSent[keysym] = Clock::now();
+  }
+
+  writer()->writeKeyEvent(keysym, 0, true);
+  writer()->writeKeyEvent(keysym, 0, false);
+  out.flush();
+}
+
+struct Stats {
+  double avgLatency;
+  double maxLatency;
+  double fastUpdates;
+  double fastUpdateSize;
+  double slowUpdates;
+  double slowUpdateSize;
+  double cpuUsage;
+};
+
+static Stats runTest() {
+  rfb::ManagedPixelBuffer pb(fbPF, width, height);
+  Desktop desktop;
+  rfb::VNCServerST* server;
+  Animator* animator;
+
+  std::list<network::Socket*> sockets;
+  std::vector<Client*> clients;
+  std::vector<std::thread*> threads;
+
+  Clock::time_point start;
+  struct rusage startUsage, endUsage;
+  Stats stats;
+
+  inputSent.clear();
+  inputLatency.clear();
+  stopClients = false;
+
+  server = new rfb::VNCServerST("clientperf", &desktop);
+  server->setPixelBuffer(&pb);
+
+  for (int i = 0; i < fastClients + slowClients; i++) {
+    int fds[2];
+    network::Socket* sock;
+    Client* client;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+      perror("socketpair");
+      exit(1);
+    }
+
+    sock = new network::UnixSocket(fds[0]);
+    sockets.push_back(sock);
+    server->addSocket(sock);
+
+    client = new Client(fds[1], i < fastClients ? 0 : (int)slowRate, i < fastClients);
+    clients.push_back(client);
+    threads.push_back(new std::thread(&Client::run, client));
+  }
+
+  animator = new Animator(&pb, server);
+
+  getrusage(RUSAGE_SELF, &startUsage);
+  start = Clock::now();
+  while ((Clock::now() - start) < std::chrono::seconds(duration)) {
+    std::vector<struct pollfd> pfds;
+    std::list<network::Socket*> active;
+    int timeout;
+
+    server->getSockets(&active);
+
+    for (network::Socket* sock : active) {
+      struct pollfd pfd;
+
+      pfd.fd = sock->getFd();
+      pfd.events = POLLIN;
+      if (sock->outStream().hasBufferedData())
+        pfd.events |= POLLOUT;
+      pfds.push_back(pfd);
+    }
+
+    timeout = core::Timer::checkTimeouts();
+    if ((timeout < 0) || (timeout > 100))
+      timeout = 100;
+
+    poll(pfds.data(), pfds.size(), timeout);
+
+    core::Timer::checkTimeouts();
+
+    for (const struct pollfd& pfd : pfds) {
+      for (network::Socket* sock : active) {
+        if (sock->getFd() != pfd.fd)
+          continue;
+        if (pfd.revents & (POLLIN | POLLHUP | POLLERR))
+          server->processSocketReadEvent(sock);
+        if (pfd.revents & POLLOUT)
+          server->processSocketWriteEvent(sock);
+      }
+    }
+  }
+
+  stopClients = true;
+
+  getrusage(RUSAGE_SELF, &endUsage);
+
+  delete animator;
+  delete server;
+
+  for (network::Socket* sock : sockets)
+    sock->shutdown();
+
+  while (!threads.empty()) {
+    threads.back()->join();
+    delete threads.back();
+    threads.pop_back();
+  }
+
+  stats.avgLatency = 0;
+  stats.maxLatency = 0;
+  for (double latency : inputLatency) {
+    stats.avgLatency += latency;
+    stats.maxLatency = std::max(stats.maxLatency, latency);
+  }
+  if (!inputLatency.empty())
+    stats.avgLatency /= inputLatency.size();
+
+  stats.cpuUsage = (endUsage.ru_utime.tv_sec - startUsage.ru_utime.tv_sec) +
+                   (endUsage.ru_stime.tv_sec - startUsage.ru_stime.tv_sec) +
+                   (endUsage.ru_utime.tv_usec - startUsage.ru_utime.tv_usec) / 1e6 +
+                   (endUsage.ru_stime.tv_usec - startUsage.ru_stime.tv_usec) / 1e6;
+  stats.cpuUsage = stats.cpuUsage * 100 / duration;
+
+  stats.fastUpdates = 0;
+  stats.fastUpdateSize = 0;
+  stats.slowUpdates = 0;
+  stats.slowUpdateSize = 0;
+  for (int i = 0; i < (int)clients.size(); i++) {
+    if (i < fastClients) {
+      stats.fastUpdates += clients[i]->updates;
+      stats.fastUpdateSize += clients[i]->bytes;
+    } else {
+      stats.slowUpdates += clients[i]->updates;
+      stats.slowUpdateSize += clients[i]->bytes;
+    }
+    delete clients[i];
+  }
+  if (stats.fastUpdates > 0)
+    stats.fastUpdateSize /= stats.fastUpdates * 1024;
+  if (stats.slowUpdates > 0)
+    stats.slowUpdateSize /= stats.slowUpdates * 1024;
+  stats.fastUpdates /= (double)fastClients * duration;
+  if (slowClients > 0)
+    stats.slowUpdates /= (double)slowClients * duration;
+
+  for (network::Socket* sock : sockets)
+    delete sock;
+
+  return stats;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Syntax: %s [options]\n", argv0);
+  fprintf(stderr, "Options:\n");
+  core::Configuration::listParams(79, 14);
+  exit(1);
+}
+
+int main(int argc, char** argv) {
+  time_t t;
+  char datebuffer[256];
+  core::initStdIOLoggers();
+
+  for (int i = 1; i < argc;) {
+    int ret;
+
+    ret = core::Configuration::handleParamArg(argc, argv, i);
+    if (ret > 0) {
+      i += ret;
+      continue;
+    }
+
+    usage(argv[0]);
+  }
+
+  // Keep the handshake and the encoding simple
+  rfb::SecurityServer::secTypes.setParam("None");
+  rfb::SecurityClient::secTypes.setParam("None");
+  rfb::Server::enablePersistentCache.setParam(false);
+  rfb::Server::shareEncodedUpdates.setParam(false);
+
+  time(&t);
+  strftime(datebuffer, sizeof(datebuffer), "%Y-%m-%d %H:%M UTC", gmtime(&t));
+
+  printf("# Client Thread Performance Test %s\n", datebuffer);
+  printf("#\n");
+  if (video)
+    printf("# Frame buffer: %dx%d pixels, video in the middle quarter\n", (int)width, (int)height);
+  else
+    printf("# Frame buffer: %dx%d pixels, %d%% changed per frame\n", (int)width, (int)height, (int)changed);
+  printf("# Clients: %d fast, %d limited to %d KiB/s\n", (int)fastClients, (int)slowClients, (int)slowRate);
+  printf("#\n");
+  printf("# Note: Latency is how long key presses from the fast clients\n");
+  printf("#       wait for the server, in ms\n");
+  printf("#       CPU is for the server and all clients, in %% of one core\n");
+  printf("#\n");
+
+  printf("%s,Input latency (avg),Input latency (max),Updates/s (fast),KiB/update (fast),Updates/s (slow),"
+         "KiB/update (slow),CPU\n",
+         volatility ? "VolatilityMap"
+         : shm      ? "SharedMemory"
+         : paced    ? "AdaptiveUpdateRate"
+         : adaptive ? "AdaptiveEncoding"
+                    : "ClientThreads");
+
+  for (int on = 0; on <= 1; on++) {
+    Stats stats;
+
+    if (volatility)
+      rfb::Server::enableVolatilityMap.setParam(on);
+    else if (shm)
+      rfb::Server::sharedMemory.setParam(on);
+    else if (paced)
+      rfb::Server::adaptiveUpdateRate.setParam(on);
+    else if (adaptive)
+      rfb::Server::adaptiveEncoding.setParam(on);
+    else
+      rfb::Server::clientThreads.setParam(on);
+
+    stats = runTest();
+    printf("%s,%g,%g,%g,%g,%g,%g,%g\n", on ? "on" : "off", stats.avgLatency, stats.maxLatency, stats.fastUpdates,
+           stats.fastUpdateSize, stats.slowUpdates, stats.slowUpdateSize, stats.cpuUsage);
+  }
+
+  return 0;
+}
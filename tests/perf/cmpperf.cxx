@@ -0,0 +1,146 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+/*
+ * Measures the throughput of ComparingUpdateTracker, i.e. the
+ * framebuffer comparison the server does for every update when
+ * CompareFB is enabled, across a range of thread counts.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include <core/Configuration.h>
+
+#include <rfb/ComparingUpdateTracker.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/PixelFormat.h>
+#include <rfb/ServerCore.h>
+
+#include "util.h"
+
+static core::IntParameter width("width", "Frame buffer width", 7680);
+static core::IntParameter height("height", "Frame buffer height", 4320);
+static core::IntParameter count("count", "Number of compared frames per thread count", 50);
+static core::IntParameter changed("changed", "Percentage of 64x64 blocks modified per frame", 10, 0, 100);
+static core::IntParameter maxThreads("threads", "Highest thread count to test", 8, 1, 64);
+
+static const rfb::PixelFormat fbPF(32, 24, false, true, 255, 255, 255, 0, 8, 16);
+
+static void dirtyBlocks(rfb::ManagedPixelBuffer* pb) {
+  uint32_t* data;
+  int stride;
+
+  data = (uint32_t*)pb->getBufferRW(pb->getRect(), &stride);
+
+  for (int by = 0; by < pb->height(); by += 64) {
+    for (int bx = 0; bx < pb->width(); bx += 64) {
+      int x, y;
+
+      if ((rand() % 100) >= changed)
+        continue;
+
+      x = bx + rand() % std::min(64, pb->width() - bx);
+      y = by + rand() % std::min(64, pb->height() - by);
+      data[x + y * stride] ^= 0xffffff;
+    }
+  }
+
+  pb->commitBufferRW(pb->getRect());
+}
+
+static double runTest(int threads) {
+  rfb::ManagedPixelBuffer pb(fbPF, width, height);
+  rfb::ComparingUpdateTracker* comparer;
+  double elapsed;
+
+  rfb::Server::compareFBThreads.setParam(threads);
+
+  comparer = new rfb::ComparingUpdateTracker(&pb);
+
+  // The first compare() only takes a copy of the framebuffer
+  comparer->compare();
+  comparer->clear();
+
+  elapsed = 0.0;
+  for (int i = 0; i < count; i++) {
+    dirtyBlocks(&pb);
+    comparer->add_changed(pb.getRect());
+
+    startTimeCounter();
+    comparer->compare();
+    endTimeCounter();
+
+    elapsed += getTimeCounter();
+
+    comparer->clear();
+  }
+
+  delete comparer;
+
+  return (double)pb.getRect().area() * (fbPF.bpp / 8) * count / elapsed;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Syntax: %s [options]\n", argv0);
+  fprintf(stderr, "Options:\n");
+  core::Configuration::listParams(79, 14);
+  exit(1);
+}
+
+int main(int argc, char** argv) {
+  time_t t;
+  char datebuffer[256];
+
+  for (int i = 1; i < argc;) {
+    int ret;
+
+    ret = core::Configuration::handleParamArg(argc, argv, i);
+    if (ret > 0) {
+      i += ret;
+      continue;
+    }
+
+    usage(argv[0]);
+  }
+
+  time(&t);
+  strftime(datebuffer, sizeof(datebuffer), "%Y-%m-%d %H:%M UTC", gmtime(&t));
+
+  printf("# Framebuffer Comparison Performance Test %s\n", datebuffer);
+  printf("#\n");
+  printf("# Frame buffer: %dx%d pixels\n", (int)width, (int)height);
+  printf("# Changed blocks: %d%%\n", (int)changed);
+  printf("#\n");
+  printf("# Note: Results are GB/s of framebuffer compared\n");
+  printf("#\n");
+
+  printf("Threads,Throughput\n");
+
+  for (int threads = 1; threads <= maxThreads; threads++)
+    printf("%d,%g\n", threads, runTest(threads) / 1e9);
+
+  return 0;
+}
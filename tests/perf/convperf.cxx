@@ -26,6 +26,7 @@
 #include <time.h>
 
 #include <rfb/PixelFormat.h>
+#include <rfb/PixelFormatSIMD.h>
 
 #include "util.h"
 
@@ -93,6 +94,13 @@ struct TestEntry tests[] = {
     {"bufferFromRGB", testFromRGB},
 };
 
+static const rfb::ConvKernels kernelLevels[] = {
+    rfb::convScalar,
+    rfb::convSSE2,
+    rfb::convAVX2,
+    rfb::convNEON,
+};
+
 static void doTests(rfb::PixelFormat& dstpf, rfb::PixelFormat& srcpf) {
   size_t i;
   char dstb[256], srcb[256];
@@ -100,14 +108,23 @@ static void doTests(rfb::PixelFormat& dstpf, rfb::PixelFormat& srcpf) {
   dstpf.print(dstb, sizeof(dstb));
   srcpf.print(srcb, sizeof(srcb));
 
-  printf("%s,%s", srcb, dstb);
+  for (rfb::ConvKernels kernels : kernelLevels) {
+    if (!rfb::convKernelsSupported(kernels))
+      continue;
+
+    rfb::setConvKernels(kernels);
 
-  for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
-    printf(",");
-    doTest(tests[i].fn, dstpf, srcpf);
+    printf("%s,%s,%s", srcb, dstb, rfb::convKernelsName(kernels));
+
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+      printf(",");
+      doTest(tests[i].fn, dstpf, srcpf);
+    }
+
+    printf("\n");
   }
 
-  printf("\n");
+  rfb::setConvKernels(rfb::convBestKernels());
 }
 
 int main(int /*argc*/, char** /*argv*/) {
@@ -139,7 +156,7 @@ int main(int /*argc*/, char** /*argv*/) {
   printf("# Note: Results are Mpixels/sec\n");
   printf("#\n");
 
-  printf("Source format,Destination Format");
+  printf("Source format,Destination Format,Kernels");
   for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
     printf(",%s", tests[i].label);
   printf("\n");
@@ -0,0 +1,187 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+/*
+ * Measures what a cache delta costs compared to sending near-duplicate
+ * content afresh, using a synthetic text page where a few words change
+ * between frames.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <core/Configuration.h>
+
+#include <rfb/PixelBuffer.h>
+#include <rfb/PixelFormat.h>
+#include <rfb/cache/CacheDelta.h>
+
+#include "util.h"
+
+static core::IntParameter width("width", "Page width", 1024);
+static core::IntParameter height("height", "Page height", 768);
+static core::IntParameter count("count", "Number of edited frames", 100);
+static core::IntParameter words("words", "Words replaced per frame", 3);
+static core::IntParameter level("level", "zlib compression level", 2, 0, 9);
+
+static const rfb::PixelFormat fbPF(32, 24, false, true, 255, 255, 255, 16, 8, 0);
+
+static const int GlyphWidth = 7;
+static const int LineHeight = 14;
+
+static void drawWord(rfb::ManagedPixelBuffer* pb, int x, int y, int glyphs) {
+  uint32_t* data;
+  int stride;
+
+  core::Rect r(x, y, std::min(x + glyphs * GlyphWidth, pb->width()), std::min(y + LineHeight, pb->height()));
+
+  data = (uint32_t*)pb->getBufferRW(r, &stride);
+  for (int row = 0; row < r.height(); row++) {
+    for (int col = 0; col < r.width(); col++) {
+      // Mostly background with some anti-aliased strokes
+      if ((row < 2) || (row > 11) || (col % GlyphWidth == 6) || (rand() % 3 != 0))
+        data[col + row * stride] = 0xffffff;
+      else
+        data[col + row * stride] = (rand() % 2) ? 0x202020 : 0x909090;
+    }
+  }
+  pb->commitBufferRW(r);
+}
+
+static void drawPage(rfb::ManagedPixelBuffer* pb) {
+  for (int y = 0; y + LineHeight <= pb->height(); y += LineHeight) {
+    int x = 8;
+    while (x < pb->width() - 8) {
+      int glyphs = 2 + rand() % 8;
+      drawWord(pb, x, y, glyphs);
+      x += (glyphs + 1) * GlyphWidth;
+    }
+  }
+}
+
+static rfb::CacheKey makeKey(uint64_t id) {
+  uint8_t bytes[16];
+
+  memset(bytes, 0, sizeof(bytes));
+  memcpy(bytes, &id, sizeof(id));
+
+  return rfb::CacheKey(bytes);
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Syntax: %s [options]\n", argv0);
+  fprintf(stderr, "Options:\n");
+  core::Configuration::listParams(79, 14);
+  exit(1);
+}
+
+int main(int argc, char** argv) {
+  time_t t;
+  char datebuffer[256];
+
+  for (int i = 1; i < argc;) {
+    int ret;
+
+    ret = core::Configuration::handleParamArg(argc, argv, i);
+    if (ret > 0) {
+      i += ret;
+      continue;
+    }
+
+    usage(argv[0]);
+  }
+
+  rfb::ManagedPixelBuffer pb(fbPF, width, height);
+  rfb::cache::DeltaReferenceStore store(64 * 1024 * 1024);
+  std::vector<uint8_t> pixels, residual;
+  unsigned long long rawBytes, zlibBytes, deltaBytes;
+  double zlibTime, deltaTime;
+  int found;
+
+  srand(1);
+  drawPage(&pb);
+
+  store.insert(makeKey(1), pb.getRect(), &pb);
+
+  pixels.resize(pb.getRect().area() * 4);
+
+  rawBytes = zlibBytes = deltaBytes = 0;
+  zlibTime = deltaTime = 0.0;
+  found = 0;
+
+  for (int frame = 0; frame < count; frame++) {
+    const rfb::cache::DeltaReferenceStore::Entry* base;
+
+    for (int i = 0; i < words; i++)
+      drawWord(&pb, 8 + (rand() % (pb.width() / GlyphWidth - 10)) * GlyphWidth,
+               (rand() % (pb.height() / LineHeight)) * LineHeight, 2 + rand() % 8);
+
+    pb.getImage(pixels.data(), pb.getRect());
+
+    startTimeCounter();
+    zlibBytes += rfb::cache::compressedSize(pixels.data(), pixels.size(), level);
+    endTimeCounter();
+    zlibTime += getTimeCounter();
+
+    rawBytes += pixels.size();
+
+    startTimeCounter();
+    base = store.findBase(pb.getRect(), &pb, 500, [](const rfb::CacheKey&) { return true; });
+    if (base != nullptr)
+      rfb::cache::encodeResidual(base->pixels.data(), pixels.data(), pixels.size(), level, &residual);
+    endTimeCounter();
+    deltaTime += getTimeCounter();
+
+    if (base == nullptr)
+      continue;
+
+    found++;
+    deltaBytes += residual.size();
+
+    store.insert(makeKey(frame + 2), pb.getRect(), &pb);
+  }
+
+  time(&t);
+  strftime(datebuffer, sizeof(datebuffer), "%Y-%m-%d %H:%M UTC", gmtime(&t));
+
+  printf("# Cache Delta Performance Test %s\n", datebuffer);
+  printf("#\n");
+  printf("# Page: %dx%d pixels\n", (int)width, (int)height);
+  printf("# Frames: %d, %d words changed per frame\n", (int)count, (int)words);
+  printf("# Bases found: %d\n", found);
+  printf("#\n");
+  printf("# Note: Bytes are per frame, times in ms per frame\n");
+  printf("#\n");
+
+  printf("Method,Bytes,Time\n");
+  printf("Raw,%llu,0\n", rawBytes / count);
+  printf("Zlib,%llu,%g\n", zlibBytes / count, zlibTime * 1000.0 / count);
+  if (found > 0)
+    printf("Delta,%llu,%g\n", deltaBytes / found, deltaTime * 1000.0 / count);
+
+  return 0;
+}
@@ -35,11 +35,18 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
 
 #include <core/Configuration.h>
 
+#include <rdr/BufferedInStream.h>
 #include <rdr/FileInStream.h>
+#include <rdr/MemOutStream.h>
 #include <rdr/OutStream.h>
 
 #include <rfb/AccessRights.h>
@@ -50,6 +57,8 @@
 #include <rfb/PixelFormat.h>
 #include <rfb/SConnection.h>
 #include <rfb/SMsgWriter.h>
+#include <rfb/ServerCore.h>
+#include <rfb/SharedEncodeCache.h>
 #include <rfb/UpdateTracker.h>
 
 #include "util.h"
@@ -62,6 +71,49 @@ static core::StringParameter format("format", "Pixel format (e.g. bgr888)", "");
 
 static core::BoolParameter translate("translate", "Translate 8-bit and 16-bit datasets into 24-bit", true);
 
+static core::BoolParameter h264("h264", "Let the encoder send video areas as H.264 instead of Tight JPEG", false);
+
+static core::IntParameter threads("threads",
+                                  "Also compare encoding with 1 up to this many threads, and check that "
+                                  "the decoded results are identical",
+                                  1, 1, 64);
+
+static core::IntParameter clients("clients",
+                                  "Also compare the CPU time for sending the same updates to 1 up to this "
+                                  "many identical clients, with and without shared encoding",
+                                  1, 1, 256);
+
+static core::BoolParameter jpeg("jpeg",
+                                "Instead of replaying a file, measure the latency of sending a synthetic "
+                                "4K photo-like frame as Tight JPEG at quality 6 and 8, with 1 up to "
+                                "'threads' threads",
+                                false);
+
+static core::BoolParameter terminal("terminal",
+                                    "Instead of replaying a file, measure the bytes and CPU time for a "
+                                    "synthetic terminal that scrolls 'scroll' lines per frame, with and "
+                                    "without glyph rects",
+                                    false);
+static core::IntParameter scroll("scroll", "Lines scrolled per frame in terminal mode", 3, 1, 32);
+
+static core::BoolParameter refresh("refresh",
+                                   "Instead of replaying a file, measure the bytes and CPU time for the "
+                                   "lossless refresh of synthetic photo-like frames sent as Tight JPEG, "
+                                   "with and without lossy refinement",
+                                   false);
+
+static core::BoolParameter gradient("gradient",
+                                    "Instead of replaying a file, measure the bytes and CPU time for sending "
+                                    "synthetic photo-like frames as Tight without JPEG, with and without the "
+                                    "gradient filter",
+                                    false);
+
+static core::BoolParameter video("video",
+                                 "Instead of replaying a file, measure the bytes and CPU time for a synthetic "
+                                 "video playing in part of a still desktop, at FrameRate, with and without "
+                                 "the VolatilityMap, and as H.264 if 'h264' is set",
+                                 false);
+
 // The frame buffer (and output) is always this format
 static const rfb::PixelFormat fbPF(32, 24, false, true, 255, 255, 255, 0, 8, 16);
 
@@ -89,9 +141,51 @@ private:
   uint8_t buf[131072];
 };
 
+// Stream for handing the encoder output over to the Verifier
+class LoopbackInStream : public rdr::BufferedInStream {
+public:
+  LoopbackInStream();
+
+  void feed(const uint8_t* data, size_t length);
+
+private:
+  bool fillBuffer() override;
+
+  std::vector<uint8_t> pending;
+  size_t consumed;
+};
+
+// Decodes what the encoder produced and keeps a checksum of the
+// resulting frame buffer after every update
+class Verifier : public rfb::CConnection {
+public:
+  Verifier(const rfb::PixelFormat& pf);
+  ~Verifier();
+
+  void feed(const uint8_t* data, size_t length);
+  // Is our frame buffer identical to this one?
+  bool matches(const rfb::PixelBuffer* pb);
+
+  void initDone() override{};
+  void resizeFramebuffer() override;
+  void framebufferUpdateEnd() override;
+  void setColourMapEntries(int, int, uint16_t*) override;
+  void bell() override;
+  void serverCutText(const char*) override;
+  virtual void getUserPasswd(bool secure, std::string* user, std::string* password) override;
+  virtual bool showMsgBox(rfb::MsgBoxFlags flags, const char* title, const char* text) override;
+
+public:
+  uint64_t checksum;
+
+protected:
+  LoopbackInStream* in;
+  DummyOutStream* out;
+};
+
 class CConn : public rfb::CConnection {
 public:
-  CConn(const char* filename);
+  CConn(const char* filename, bool verify, int clientCount);
   ~CConn();
 
   void getStats(double& ratio, unsigned long long& bytes, unsigned long long& rawEquivalent);
@@ -110,12 +204,18 @@ public:
 public:
   double decodeTime;
   double encodeTime;
+  double encodeWallTime;
+  unsigned frames;
+
+  Verifier* verifier;
 
 protected:
   rdr::FileInStream* in;
   DummyOutStream* out;
   rfb::SimpleUpdateTracker updates;
+  rfb::SharedEncodeCache sharedEncodes;
   class SConn* sc;
+  std::vector<class SConn*> otherClients;
 };
 
 class Manager : public rfb::EncodeManager {
@@ -127,12 +227,21 @@ public:
 
 class SConn : public rfb::SConnection {
 public:
-  SConn();
+  SConn(Verifier* verifier);
   ~SConn();
 
   void writeUpdate(const rfb::UpdateInfo& ui, const rfb::PixelBuffer* pb);
+  // Makes everything lossy exact again, right away
+  void writeLosslessRefresh(const rfb::PixelBuffer* pb);
+  void verifyUpdate();
+
+  void setSharedEncodes(rfb::SharedEncodeCache* cache);
 
   void getStats(double&, unsigned long long&, unsigned long long&);
+  // Everything passed to the Verifier so far
+  unsigned long long getVerifiedBytes() {
+    return verifiedBytes;
+  }
 
   void setAccessRights(rfb::AccessRights ar) override;
 
@@ -146,8 +255,11 @@ public:
   void handleDebugDumpRequest(uint32_t) override {}
 
 protected:
-  DummyOutStream* out;
+  rdr::OutStream* out;
+  rdr::MemOutStream* captured;
+  Verifier* verifier;
   Manager* manager;
+  unsigned long long verifiedBytes;
 };
 
 DummyOutStream::DummyOutStream() {
@@ -172,9 +284,117 @@ void DummyOutStream::overrun(size_t needed) {
     throw std::out_of_range("Insufficient dummy output buffer");
 }
 
-CConn::CConn(const char* filename) {
+LoopbackInStream::LoopbackInStream() : consumed(0) {}
+
+void LoopbackInStream::feed(const uint8_t* data, size_t length) {
+  pending.insert(pending.end(), data, data + length);
+}
+
+bool LoopbackInStream::fillBuffer() {
+  size_t n;
+
+  n = std::min(availSpace(), pending.size() - consumed);
+  if (n == 0)
+    return false;
+
+  memcpy((uint8_t*)end, pending.data() + consumed, n);
+  end += n;
+  consumed += n;
+
+  if (consumed == pending.size()) {
+    pending.clear();
+    consumed = 0;
+  }
+
+  return true;
+}
+
+Verifier::Verifier(const rfb::PixelFormat& pf) {
+  checksum = 0;
+
+  in = new LoopbackInStream;
+  out = new DummyOutStream;
+  setStreams(in, out);
+
+  setState(RFBSTATE_NORMAL);
+  setReader(new rfb::CMsgReader(this, in));
+  setWriter(new rfb::CMsgWriter(&server, out));
+  server.setPF(pf);
+  setDesktopSize(width, height);
+}
+
+Verifier::~Verifier() {
+  delete in;
+  delete out;
+}
+
+void Verifier::feed(const uint8_t* data, size_t length) {
+  in->feed(data, length);
+  while (processMsg())
+    ;
+}
+
+bool Verifier::matches(const rfb::PixelBuffer* pb) {
+  const uint8_t* expected;
+  const uint8_t* actual;
+  int expectedStride, actualStride;
+  size_t bpp;
+
+  if (pb->getRect() != getFramebuffer()->getRect())
+    return false;
+
+  bpp = pb->getPF().bpp / 8;
+
+  expected = pb->getBuffer(pb->getRect(), &expectedStride);
+  actual = getFramebuffer()->getBuffer(pb->getRect(), &actualStride);
+  for (int y = 0; y < pb->height(); y++) {
+    if (memcmp(expected + y * expectedStride * bpp, actual + y * actualStride * bpp, pb->width() * bpp) != 0)
+      return false;
+  }
+
+  return true;
+}
+
+void Verifier::resizeFramebuffer() {
+  setFramebuffer(new rfb::ManagedPixelBuffer(server.pf(), server.width(), server.height()));
+}
+
+void Verifier::framebufferUpdateEnd() {
+  const uint8_t* buffer;
+  int stride;
+  rfb::PixelBuffer* pb;
+
+  CConnection::framebufferUpdateEnd();
+
+  // FNV-1a over the visible pixels
+  pb = getFramebuffer();
+  buffer = pb->getBuffer(pb->getRect(), &stride);
+  for (int y = 0; y < pb->height(); y++) {
+    const uint8_t* row = buffer + (size_t)y * stride * (pb->getPF().bpp / 8);
+    for (int x = 0; x < pb->width() * (pb->getPF().bpp / 8); x++) {
+      checksum ^= row[x];
+      checksum *= 0x100000001b3ULL;
+    }
+  }
+}
+
+void Verifier::setColourMapEntries(int, int, uint16_t*) {}
+
+void Verifier::bell() {}
+
+void Verifier::serverCutText(const char*) {}
+
+void Verifier::getUserPasswd(bool, std::string*, std::string*) {}
+
+bool Verifier::showMsgBox(rfb::MsgBoxFlags, const char*, const char*) {
+  return true;
+}
+
+CConn::CConn(const char* filename, bool verify, int clientCount) {
   decodeTime = 0.0;
   encodeTime = 0.0;
+  encodeWallTime = 0.0;
+  frames = 0;
 
   in = new rdr::FileInStream(filename);
   out = new DummyOutStream;
@@ -191,13 +411,40 @@ CConn::CConn(const char* filename) {
   server.setPF(pf);
   setDesktopSize(width, height);
 
-  sc = new SConn();
+  verifier = nullptr;
+  if (verify)
+    verifier = new Verifier((bool)translate ? fbPF : pf);
+
+  std::vector<int32_t> encs(encodings, encodings + sizeof(encodings) / sizeof(*encodings));
+#ifdef HAVE_H264
+  if (h264) {
+    encs.push_back(rfb::encodingH264);
+    rfb::Server::enableH264.setParam(true);
+  }
+#endif
+
+  sc = new SConn(verifier);
   sc->client.setPF((bool)translate ? fbPF : pf);
-  ((rfb::SMsgHandler*)sc)->setEncodings(sizeof(encodings) / sizeof(*encodings), encodings);
+  ((rfb::SMsgHandler*)sc)->setEncodings(encs.size(), encs.data());
+  sc->setSharedEncodes(&sharedEncodes);
+
+  for (int i = 1; i < clientCount; i++) {
+    SConn* other;
+
+    other = new SConn(nullptr);
+    other->client.setPF((bool)translate ? fbPF : pf);
+    ((rfb::SMsgHandler*)other)->setEncodings(encs.size(), encs.data());
+    other->setSharedEncodes(&sharedEncodes);
+
+    otherClients.push_back(other);
+  }
 }
 
 CConn::~CConn() {
+  for (SConn* other : otherClients)
+    delete other;
   delete sc;
+  delete verifier;
   delete in;
   delete out;
 }
@@ -211,6 +458,8 @@ void CConn::resizeFramebuffer() {
 
   pb = new rfb::ManagedPixelBuffer((bool)translate ? fbPF : server.pf(), server.width(), server.height());
   setFramebuffer(pb);
+
+  sharedEncodes.setFramebuffer(pb);
 }
 
 void CConn::framebufferUpdateStart() {
@@ -224,6 +473,7 @@ void CConn::framebufferUpdateEnd() {
   rfb::UpdateInfo ui;
   rfb::PixelBuffer* pb = getFramebuffer();
   core::Region clip(pb->getRect());
+  struct timeval start, stop;
 
   CConnection::framebufferUpdateEnd();
 
@@ -233,11 +483,24 @@ void CConn::framebufferUpdateEnd() {
 
   updates.getUpdateInfo(&ui, clip);
 
+  sharedEncodes.invalidate(ui.changed);
+  sharedEncodes.invalidate(ui.copied);
+
+  gettimeofday(&start, nullptr);
   startCpuCounter();
   sc->writeUpdate(ui, pb);
+  for (SConn* other : otherClients)
+    other->writeUpdate(ui, pb);
   endCpuCounter();
+  gettimeofday(&stop, nullptr);
 
   encodeTime += getCpuCounter();
+  encodeWallTime += (double)stop.tv_sec - start.tv_sec;
+  encodeWallTime += ((double)stop.tv_usec - start.tv_usec) / 1000000.0;
+
+  sc->verifyUpdate();
+
+  frames++;
 }
 
 bool CConn::dataRect(const core::Rect& r, int encoding, const rfb::ServerParams* serverOverride) {
@@ -282,8 +545,12 @@ void Manager::getStats(double& ratio, unsigned long long& encodedBytes, unsigned
   rawEquivalent = equivalent;
 }
 
-SConn::SConn() : SConnection(rfb::AccessDefault) {
-  out = new DummyOutStream;
+SConn::SConn(Verifier* verifier_) : SConnection(rfb::AccessDefault), verifier(verifier_), verifiedBytes(0) {
+  captured = nullptr;
+  if (verifier != nullptr)
+    out = captured = new rdr::MemOutStream;
+  else
+    out = new DummyOutStream;
   setStreams(nullptr, out);
 
   setWriter(new rfb::SMsgWriter(&client, out));
@@ -300,6 +567,25 @@ void SConn::writeUpdate(const rfb::UpdateInfo& ui, const rfb::PixelBuffer* pb) {
   manager->writeUpdate(ui, pb, nullptr);
 }
 
+void SConn::writeLosslessRefresh(const rfb::PixelBuffer* pb) {
+  manager->forceImmediateRefresh(pb->getRect());
+  // No limit, as far as the test is concerned
+  manager->writeLosslessRefresh(pb->getRect(), pb, nullptr, 1 << 30);
+}
+
+void SConn::setSharedEncodes(rfb::SharedEncodeCache* cache) {
+  manager->setSharedEncodes(cache);
+}
+
+void SConn::verifyUpdate() {
+  if (verifier == nullptr)
+    return;
+
+  verifier->feed(captured->data(), captured->length());
+  verifiedBytes += captured->length();
+  captured->clear();
+}
+
 void SConn::getStats(double& ratio, unsigned long long& bytes, unsigned long long& rawEquivalent) {
   manager->getStats(ratio, bytes, rawEquivalent);
 }
@@ -315,14 +601,19 @@ void SConn::pointerEvent(const core::Point&, uint16_t) {}
 struct stats {
   double decodeTime;
   double encodeTime;
+  double encodeWallTime;
   double realTime;
 
+  unsigned frames;
+
   double ratio;
   unsigned long long bytes;
   unsigned long long rawEquivalent;
+
+  uint64_t checksum;
 };
 
-static struct stats runTest(const char* fn) {
+static struct stats runTest(const char* fn, bool verify = false, int clientCount = 1) {
   CConn* cc;
   struct stats s;
   struct timeval start, stop;
@@ -330,7 +621,7 @@ static struct stats runTest(const char* fn) {
   gettimeofday(&start, nullptr);
 
   try {
-    cc = new CConn(fn);
+    cc = new CConn(fn, verify, clientCount);
   } catch (std::exception& e) {
     fprintf(stderr, "Failed to open rfb file: %s\n", e.what());
     exit(1);
@@ -349,15 +640,507 @@ static struct stats runTest(const char* fn) {
 
   s.decodeTime = cc->decodeTime;
   s.encodeTime = cc->encodeTime;
+  s.encodeWallTime = cc->encodeWallTime;
+  s.frames = cc->frames;
   s.realTime = (double)stop.tv_sec - start.tv_sec;
   s.realTime += ((double)stop.tv_usec - start.tv_usec) / 1000000.0;
   cc->getStats(s.ratio, s.bytes, s.rawEquivalent);
+  s.checksum = cc->verifier ? cc->verifier->checksum : 0;
 
   delete cc;
 
   return s;
 }
 
+// Fills the frame with smooth gradients plus some noise, which is
+// what makes the encoder pick JPEG, and which changes every frame
+static void drawPhoto(rfb::ManagedPixelBuffer* pb, int frame) {
+  uint32_t* data;
+  int stride;
+  uint32_t seed;
+
+  data = (uint32_t*)pb->getBufferRW(pb->getRect(), &stride);
+
+  seed = 0x9e3779b9 * (frame + 1);
+  for (int y = 0; y < pb->height(); y++) {
+    for (int x = 0; x < pb->width(); x++) {
+      uint32_t r, g, b;
+
+      seed ^= seed << 13;
+      seed ^= seed >> 17;
+      seed ^= seed << 5;
+
+      r = ((x + frame * 8) / 16 + (seed & 0x0f)) & 0xff;
+      g = ((y + frame * 4) / 9 + ((seed >> 8) & 0x0f)) & 0xff;
+      b = ((x + y) / 24 + ((seed >> 16) & 0x0f)) & 0xff;
+
+      data[x + y * stride] = (r << 16) | (g << 8) | b;
+    }
+  }
+
+  pb->commitBufferRW(pb->getRect());
+}
+
+static double runJpegTest(int quality) {
+  rfb::ManagedPixelBuffer pb(fbPF, 3840, 2160);
+  SConn* sc;
+  double elapsed;
+
+  const int32_t encs[] = {rfb::encodingTight, rfb::pseudoEncodingLastRect,
+                          rfb::pseudoEncodingQualityLevel0 + quality, rfb::pseudoEncodingCompressLevel0 + 2};
+
+  sc = new SConn(nullptr);
+  sc->client.setDimensions(pb.width(), pb.height());
+  sc->client.setPF(fbPF);
+  ((rfb::SMsgHandler*)sc)->setEncodings(sizeof(encs) / sizeof(*encs), encs);
+
+  elapsed = 0.0;
+  for (int i = 0; i < count; i++) {
+    rfb::UpdateInfo ui;
+    struct timeval start, stop;
+
+    drawPhoto(&pb, i);
+    ui.changed = pb.getRect();
+
+    gettimeofday(&start, nullptr);
+    sc->writeUpdate(ui, &pb);
+    gettimeofday(&stop, nullptr);
+
+    elapsed += (double)stop.tv_sec - start.tv_sec;
+    elapsed += ((double)stop.tv_usec - start.tv_usec) / 1000000.0;
+  }
+
+  delete sc;
+
+  return elapsed / count;
+}
+
+// A terminal of anti-aliased glyphs in two colours, placed off the
+// 8x16 grid of the frame buffer like a window with decorations
+static const int TermCellW = 8;
+static const int TermCellH = 16;
+static const int TermGlyphs = 64;
+static const core::Point TermOrigin(5, 23);
+
+struct TermState {
+  std::vector<uint32_t> glyphs; // TermGlyphs * 2 colours cells
+  int columns, rows;
+  uint32_t seed;
+};
+
+static uint32_t termRandom(TermState* term) {
+  term->seed ^= term->seed << 13;
+  term->seed ^= term->seed >> 17;
+  term->seed ^= term->seed << 5;
+  return term->seed;
+}
+
+static void makeTermGlyphs(TermState* term) {
+  static const uint32_t bg = 0x202020;
+  static const uint32_t fg[2] = {0xd0d0d0, 0x60c060};
+
+  term->glyphs.resize(TermGlyphs * 2 * TermCellW * TermCellH);
+
+  for (int g = 0; g < TermGlyphs; g++) {
+    uint8_t coarse[TermCellH / 2][TermCellW / 2];
+
+    // Glyph 0 is the space
+    for (int y = 0; y < TermCellH / 2; y++) {
+      for (int x = 0; x < TermCellW / 2; x++)
+        coarse[y][x] = (g != 0) && (y > 0) && (y < TermCellH / 2 - 1) && (termRandom(term) % 5 < 2);
+    }
+
+    for (int c = 0; c < 2; c++) {
+      uint32_t* cell = term->glyphs.data() + (g * 2 + c) * TermCellW * TermCellH;
+
+      for (int y = 0; y < TermCellH; y++) {
+        for (int x = 0; x < TermCellW; x++) {
+          unsigned alpha, pixel;
+
+          // Smoothed upscale, which gives the edges their grey levels
+          alpha = 0;
+          for (int dy = 0; dy < 2; dy++) {
+            for (int dx = 0; dx < 2; dx++) {
+              int cx = std::min((x + dx) / 2, TermCellW / 2 - 1);
+              int cy = std::min((y + dy) / 2, TermCellH / 2 - 1);
+              alpha += coarse[cy][cx] * 255;
+            }
+          }
+          alpha /= 4;
+
+          pixel = 0;
+          for (int shift = 0; shift < 24; shift += 8) {
+            unsigned b = (bg >> shift) & 0xff;
+            unsigned f = (fg[c] >> shift) & 0xff;
+            pixel |= ((b * (255 - alpha) + f * alpha) / 255) << shift;
+          }
+          cell[x + y * TermCellW] = pixel;
+        }
+      }
+    }
+  }
+}
+
+// Fills a terminal line with words of random glyphs
+static void drawTermLine(TermState* term, rfb::ManagedPixelBuffer* pb, int row) {
+  int col, colour;
+
+  colour = termRandom(term) % 4 == 0;
+
+  col = 0;
+  while (col < term->columns) {
+    int word;
+
+    word = termRandom(term) % 9 + 1;
+    // Lines of different lengths
+    if (termRandom(term) % 12 == 0)
+      word = term->columns;
+
+    for (int i = 0; i <= word && col < term->columns; i++, col++) {
+      const uint32_t* cell;
+      int g;
+
+      g = (i == word) ? 0 : termRandom(term) % (TermGlyphs - 1) + 1;
+      cell = term->glyphs.data() + (g * 2 + colour) * TermCellW * TermCellH;
+
+      pb->imageRect(core::Rect(TermOrigin.x + col * TermCellW, TermOrigin.y + row * TermCellH,
+                               TermOrigin.x + (col + 1) * TermCellW, TermOrigin.y + (row + 1) * TermCellH),
+                    cell);
+    }
+  }
+}
+
+static void runTerminalTest(bool glyphs, double* cpuTime, double* bytes) {
+  rfb::ManagedPixelBuffer pb(fbPF, width, height);
+  TermState term;
+  Verifier* verifier;
+  SConn* sc;
+  core::Rect area;
+  std::vector<int32_t> encs;
+  uint32_t bg;
+  int lines;
+
+  encs = {rfb::encodingTight, rfb::encodingCopyRect, rfb::pseudoEncodingLastRect,
+          rfb::pseudoEncodingQualityLevel0 + 8, rfb::pseudoEncodingCompressLevel0 + 2};
+  if (glyphs)
+    encs.push_back(rfb::encodingGlyphRect);
+
+  term.seed = 0x9e3779b9;
+  term.columns = (pb.width() - TermOrigin.x) / TermCellW;
+  term.rows = (pb.height() - TermOrigin.y) / TermCellH;
+  makeTermGlyphs(&term);
+
+  area.setXYWH(TermOrigin.x, TermOrigin.y, term.columns * TermCellW, term.rows * TermCellH);
+
+  bg = 0x202020;
+  pb.fillRect(pb.getRect(), &bg);
+  for (int row = 0; row < term.rows; row++)
+    drawTermLine(&term, &pb, row);
+
+  verifier = new Verifier(fbPF);
+  sc = new SConn(verifier);
+  sc->client.setDimensions(pb.width(), pb.height());
+  sc->client.setPF(fbPF);
+  ((rfb::SMsgHandler*)sc)->setEncodings(encs.size(), encs.data());
+
+  // The initial screen isn't what we're measuring
+  {
+    rfb::UpdateInfo ui;
+    ui.changed = pb.getRect();
+    sc->writeUpdate(ui, &pb);
+    sc->verifyUpdate();
+  }
+
+  *cpuTime = 0.0;
+  *bytes = sc->getVerifiedBytes();
+
+  lines = std::min((int)scroll, term.rows);
+
+  for (int i = 0; i < count * 10; i++) {
+    rfb::UpdateInfo ui;
+    core::Rect moved, exposed;
+
+    moved = area;
+    moved.tl.y += lines * TermCellH;
+    pb.copyRect(moved.translate({0, -lines * TermCellH}), {0, -lines * TermCellH});
+
+    for (int row = term.rows - lines; row < term.rows; row++)
+      drawTermLine(&term, &pb, row);
+
+    exposed = area;
+    exposed.tl.y = area.br.y - lines * TermCellH;
+
+    ui.copied = moved.translate({0, -lines * TermCellH});
+    ui.copy_delta = core::Point(0, -lines * TermCellH);
+    ui.changed = exposed;
+
+    startCpuCounter();
+    sc->writeUpdate(ui, &pb);
+    endCpuCounter();
+
+    *cpuTime += getCpuCounter();
+
+    sc->verifyUpdate();
+
+    if (!verifier->matches(&pb)) {
+      fprintf(stderr, "Decoded terminal differs from the original!\n");
+      exit(1);
+    }
+  }
+
+  *bytes = (sc->getVerifiedBytes() - *bytes) / (count * 10);
+  *cpuTime /= count * 10;
+
+  delete sc;
+  delete verifier;
+}
+
+static void runRefreshTest(int quality, bool refine, double* lossyBytes, double* refreshBytes, double* cpuTime) {
+  rfb::ManagedPixelBuffer pb(fbPF, width, height);
+  Verifier* verifier;
+  SConn* sc;
+  std::vector<int32_t> encs;
+
+  encs = {rfb::encodingTight, rfb::pseudoEncodingLastRect, rfb::pseudoEncodingQualityLevel0 + quality,
+          rfb::pseudoEncodingCompressLevel0 + 2};
+  if (refine)
+    encs.push_back(rfb::encodingLossyRefinement);
+
+  verifier = new Verifier(fbPF);
+  sc = new SConn(verifier);
+  sc->client.setDimensions(pb.width(), pb.height());
+  sc->client.setPF(fbPF);
+  ((rfb::SMsgHandler*)sc)->setEncodings(encs.size(), encs.data());
+
+  *lossyBytes = 0;
+  *refreshBytes = 0;
+  *cpuTime = 0;
+
+  for (int i = 0; i < count; i++) {
+    rfb::UpdateInfo ui;
+    unsigned long long before;
+
+    drawPhoto(&pb, i);
+    ui.changed = pb.getRect();
+
+    before = sc->getVerifiedBytes();
+    sc->writeUpdate(ui, &pb);
+    sc->verifyUpdate();
+    *lossyBytes += sc->getVerifiedBytes() - before;
+
+    before = sc->getVerifiedBytes();
+    startCpuCounter();
+    sc->writeLosslessRefresh(&pb);
+    endCpuCounter();
+    sc->verifyUpdate();
+    *refreshBytes += sc->getVerifiedBytes() - before;
+    *cpuTime += getCpuCounter();
+
+    if (!verifier->matches(&pb)) {
+      fprintf(stderr, "Refreshed frame differs from the original!\n");
+      exit(1);
+    }
+  }
+
+  *lossyBytes /= count;
+  *refreshBytes /= count;
+  *cpuTime /= count;
+
+  delete sc;
+  delete verifier;
+}
+
+static void runGradientTest(bool enable, double* bytes, double* encodeTime, double* decodeTime) {
+  rfb::ManagedPixelBuffer pb(fbPF, width, height);
+  Verifier* verifier;
+  SConn* sc;
+
+  const int32_t encs[] = {rfb::encodingTight, rfb::pseudoEncodingLastRect, rfb::pseudoEncodingCompressLevel0 + 2};
+
+  rfb::Server::tightGradient.setParam(enable);
+
+  verifier = new Verifier(fbPF);
+  sc = new SConn(verifier);
+  sc->client.setDimensions(pb.width(), pb.height());
+  sc->client.setPF(fbPF);
+  ((rfb::SMsgHandler*)sc)->setEncodings(sizeof(encs) / sizeof(*encs), encs);
+
+  *bytes = 0;
+  *encodeTime = 0;
+  *decodeTime = 0;
+
+  for (int i = 0; i < count; i++) {
+    rfb::UpdateInfo ui;
+    unsigned long long before;
+
+    drawPhoto(&pb, i);
+    ui.changed = pb.getRect();
+
+    before = sc->getVerifiedBytes();
+
+    startCpuCounter();
+    sc->writeUpdate(ui, &pb);
+    endCpuCounter();
+    *encodeTime += getCpuCounter();
+
+    startCpuCounter();
+    sc->verifyUpdate();
+    endCpuCounter();
+    *decodeTime += getCpuCounter();
+
+    *bytes += sc->getVerifiedBytes() - before;
+
+    if (!verifier->matches(&pb)) {
+      fprintf(stderr, "Decoded frame differs from the original!\n");
+      exit(1);
+    }
+  }
+
+  *bytes /= count;
+  *encodeTime /= count;
+  *decodeTime /= count;
+
+  delete sc;
+  delete verifier;
+}
+
+// A still desktop with a few windows, which the video area then
+// covers part of
+static void drawDesktop(rfb::ManagedPixelBuffer* pb) {
+  const uint32_t background = 0x705030, window = 0xf0f0f0, panel = 0xe0e0e0, text = 0x202020;
+
+  pb->fillRect(pb->getRect(), &background);
+  pb->fillRect({40, 40, pb->width() / 2, pb->height() - 80}, &window);
+  pb->fillRect({pb->width() / 2 + 40, 40, pb->width() - 40, pb->height() / 3}, &panel);
+
+  // Lines of "text"
+  for (int y = 60; y < pb->height() - 100; y += 16) {
+    for (int x = 60; x < pb->width() / 2 - 60; x += 48)
+      pb->fillRect({x, y, x + 40, y + 8}, &text);
+  }
+}
+
+// Smooth content that pans across the area, with a little grain, like
+// a camera moving over a scene
+static void drawVideo(rfb::ManagedPixelBuffer* pb, const core::Rect& area, int frame) {
+  uint32_t* data;
+  int stride;
+  uint32_t seed;
+
+  data = (uint32_t*)pb->getBufferRW(area, &stride);
+
+  seed = 0x9e3779b9 * (frame + 1);
+  for (int y = 0; y < area.height(); y++) {
+    for (int x = 0; x < area.width(); x++) {
+      uint32_t r, g, b;
+      int sx, sy;
+
+      seed ^= seed << 13;
+      seed ^= seed >> 17;
+      seed ^= seed << 5;
+
+      sx = x + frame * 3;
+      sy = y + frame;
+
+      r = (128 + (int)(100 * sin(sx / 40.0) * cos(sy / 55.0)) + (seed & 0x03)) & 0xff;
+      g = (128 + (int)(100 * sin((sx + sy) / 70.0)) + ((seed >> 8) & 0x03)) & 0xff;
+      b = (96 + (sy / 4) % 64 + ((seed >> 16) & 0x03)) & 0xff;
+
+      data[x + y * stride] = (r << 16) | (g << 8) | b;
+    }
+  }
+
+  pb->commitBufferRW(area);
+}
+
+static void runVideoTest(bool volatility, bool useH264, double* bytes, double* encodeTime, double* decodeTime,
+                         double* latency) {
+  rfb::ManagedPixelBuffer pb(fbPF, width, height);
+  core::Rect area;
+  Verifier* verifier;
+  SConn* sc;
+  std::vector<int32_t> encs;
+  int frames;
+  struct timeval next;
+
+  encs = {rfb::encodingTight, rfb::pseudoEncodingLastRect, rfb::pseudoEncodingQualityLevel0 + 8,
+          rfb::pseudoEncodingCompressLevel0 + 2};
+#ifdef HAVE_H264
+  if (useH264)
+    encs.push_back(rfb::encodingH264);
+  rfb::Server::enableH264.setParam(useH264);
+#else
+  (void)useH264;
+#endif
+
+  rfb::Server::enableVolatilityMap.setParam(volatility);
+
+  verifier = new Verifier(fbPF);
+  sc = new SConn(verifier);
+  sc->client.setDimensions(pb.width(), pb.height());
+  sc->client.setPF(fbPF);
+  ((rfb::SMsgHandler*)sc)->setEncodings(encs.size(), encs.data());
+
+  drawDesktop(&pb);
+  area.setXYWH(pb.width() / 4, pb.height() / 4, pb.width() / 2, pb.height() / 2);
+
+  *bytes = 0;
+  *encodeTime = 0;
+  *decodeTime = 0;
+  *latency = 0;
+
+  // The VolatilityMap goes by the time between updates, so the frames
+  // have to come at a realistic rate
+  frames = count * 10;
+  gettimeofday(&next, nullptr);
+  for (int i = 0; i < frames; i++) {
+    rfb::UpdateInfo ui;
+    unsigned long long before;
+    struct timeval start, stop;
+    long wait;
+
+    drawVideo(&pb, area, i);
+    if (i == 0)
+      ui.changed = pb.getRect();
+    else
+      ui.changed = area;
+
+    before = sc->getVerifiedBytes();
+
+    gettimeofday(&start, nullptr);
+    startCpuCounter();
+    sc->writeUpdate(ui, &pb);
+    endCpuCounter();
+    gettimeofday(&stop, nullptr);
+    *encodeTime += getCpuCounter();
+    *latency += (double)stop.tv_sec - start.tv_sec;
+    *latency += ((double)stop.tv_usec - start.tv_usec) / 1000000.0;
+
+    startCpuCounter();
+    sc->verifyUpdate();
+    endCpuCounter();
+    *decodeTime += getCpuCounter();
+
+    *bytes += sc->getVerifiedBytes() - before;
+
+    next.tv_usec += 1000000 / rfb::Server::frameRate;
+    next.tv_sec += next.tv_usec / 1000000;
+    next.tv_usec %= 1000000;
+    gettimeofday(&stop, nullptr);
+    wait = (next.tv_sec - stop.tv_sec) * 1000000 + (next.tv_usec - stop.tv_usec);
+    if (wait > 0)
+      usleep(wait);
+  }
+
+  *bytes /= frames;
+  *encodeTime /= frames;
+  *decodeTime /= frames;
+  *latency /= frames;
+
+  delete sc;
+  delete verifier;
+}
+
 static void sort(double* array, int len) {
   bool sorted;
   int i;
@@ -393,7 +1176,8 @@ int main(int argc, char** argv) {
 
     ret = core::Configuration::handleParamArg(argc, argv, i);
     if (ret > 0) {
-      i += ret;
+      // The loop itself also steps past the argument
+      i += ret - 1;
       continue;
     }
 
@@ -406,6 +1190,133 @@ int main(int argc, char** argv) {
     fn = argv[i];
   }
 
+  if (jpeg) {
+    // Classification depends on timing, and so would the results
+    rfb::Server::enableVolatilityMap.setParam(false);
+
+    printf("Threads,Latency per frame (quality 6),Latency per frame (quality 8)\n");
+
+    for (int t = 1; t <= threads; t++) {
+      double q6, q8;
+
+      rfb::Server::encodeThreads.setParam(t);
+
+      // Warmup
+      runJpegTest(6);
+
+      q6 = runJpegTest(6);
+      q8 = runJpegTest(8);
+
+      printf("%d,%g ms,%g ms\n", t, q6 * 1000.0, q8 * 1000.0);
+    }
+
+    return 0;
+  }
+
+  if (terminal) {
+    double cpuTime, bytes;
+
+    rfb::Server::enableVolatilityMap.setParam(false);
+
+    if (width == 0 || height == 0) {
+      width.setParam(1280);
+      height.setParam(800);
+    }
+
+    printf("# Terminal scroll: %dx%d, %d lines per frame\n", (int)width, (int)height, (int)scroll);
+    printf("Mode,Encoded bytes per frame,CPU time per frame (encoding)\n");
+
+    runTerminalTest(false, &cpuTime, &bytes);
+    printf("Tight,%g,%g ms\n", bytes, cpuTime * 1000.0);
+    runTerminalTest(true, &cpuTime, &bytes);
+    printf("Tight + GlyphRect,%g,%g ms\n", bytes, cpuTime * 1000.0);
+
+    return 0;
+  }
+
+  if (refresh) {
+    rfb::Server::enableVolatilityMap.setParam(false);
+
+    if (width == 0 || height == 0) {
+      width.setParam(1920);
+      height.setParam(1080);
+    }
+
+    printf("# Lossless refresh: %dx%d photo-like frames\n", (int)width, (int)height);
+    printf("Quality,JPEG bytes per frame,Refresh bytes (full),Refresh bytes (refinement),"
+           "CPU time per refresh (full),CPU time per refresh (refinement)\n");
+
+    for (int quality = 2; quality <= 8; quality += 2) {
+      double lossyBytes, fullBytes, refinedBytes, fullTime, refinedTime;
+
+      runRefreshTest(quality, false, &lossyBytes, &fullBytes, &fullTime);
+      runRefreshTest(quality, true, &lossyBytes, &refinedBytes, &refinedTime);
+
+      printf("%d,%g,%g,%g,%g ms,%g ms\n", quality, lossyBytes, fullBytes, refinedBytes, fullTime * 1000.0,
+             refinedTime * 1000.0);
+    }
+
+    return 0;
+  }
+
+  if (gradient) {
+    double rawBytes;
+
+    rfb::Server::enableVolatilityMap.setParam(false);
+
+    if (width == 0 || height == 0) {
+      width.setParam(1920);
+      height.setParam(1080);
+    }
+
+    rawBytes = (double)width * height * 3;
+
+    printf("# Lossless Tight: %dx%d photo-like frames\n", (int)width, (int)height);
+    printf("Filter,Encoded bytes per frame,Ratio,CPU time per frame (encoding),CPU time per frame (decoding)\n");
+
+    for (bool enable : {false, true}) {
+      double bytes, encodeTime, decodeTime;
+
+      runGradientTest(enable, &bytes, &encodeTime, &decodeTime);
+      printf("%s,%g,%g,%g ms,%g ms\n", enable ? "Gradient" : "Copy", bytes, rawBytes / bytes, encodeTime * 1000.0,
+             decodeTime * 1000.0);
+    }
+
+    return 0;
+  }
+
+  if (video) {
+    if (width == 0 || height == 0) {
+      width.setParam(1920);
+      height.setParam(1080);
+    }
+
+    printf("# Video: %dx%d area of a %dx%d desktop at %d fps\n", (int)width / 2, (int)height / 2, (int)width,
+           (int)height, (int)rfb::Server::frameRate);
+    printf("Mode,Encoded bytes per frame,CPU time per frame (encoding),CPU time per frame (decoding),"
+           "Latency per frame (encoding)\n");
+
+    for (bool enable : {false, true}) {
+      double bytes, encodeTime, decodeTime, latency;
+
+      runVideoTest(enable, false, &bytes, &encodeTime, &decodeTime, &latency);
+      printf("%s,%g,%g ms,%g ms,%g ms\n", enable ? "VolatilityMap" : "Plain", bytes, encodeTime * 1000.0,
+             decodeTime * 1000.0, latency * 1000.0);
+    }
+
+#ifdef HAVE_H264
+    // H.264 is only used for areas the VolatilityMap has found
+    if (h264) {
+      double bytes, encodeTime, decodeTime, latency;
+
+      runVideoTest(true, true, &bytes, &encodeTime, &decodeTime, &latency);
+      printf("H.264,%g,%g ms,%g ms,%g ms\n", bytes, encodeTime * 1000.0, decodeTime * 1000.0, latency * 1000.0);
+    }
+#endif
+
+    return 0;
+  }
+
   int runCount = count;
   struct stats* runs = new struct stats[runCount];
   double* values = new double[runCount];
@@ -483,5 +1394,97 @@ int main(int argc, char** argv) {
   printf("Raw equivalent bytes: %llu\n", runs[0].rawEquivalent);
   printf("Ratio: %g\n", runs[0].ratio);
 
+  // Per frame numbers make it easy to compare e.g. H.264 and JPEG on
+  // video content
+  if (runs[0].frames != 0) {
+    for (i = 0; i < runCount; i++)
+      values[i] = runs[i].encodeTime / runs[i].frames;
+
+    sort(values, runCount);
+
+    printf("Frames: %u\n", runs[0].frames);
+    printf("CPU time per frame (encoding): %g ms\n", values[runCount / 2] * 1000.0);
+    printf("Encoded bytes per frame: %llu\n", runs[0].bytes / runs[0].frames);
+  }
+
+  if (threads > 1) {
+    double baseline;
+    uint64_t expected;
+    bool mismatch;
+
+    printf("\n");
+    printf("Threads,Encode time (wall),Speedup,Encoded bytes,Decoded checksum\n");
+
+    baseline = 0;
+    expected = 0;
+    mismatch = false;
+
+    // Classification depends on timing, which would make the output
+    // differ between runs regardless of the thread count
+    rfb::Server::enableVolatilityMap.setParam(false);
+
+    for (int t = 1; t <= threads; t++) {
+      rfb::Server::encodeThreads.setParam(t);
+
+      for (i = 0; i < runCount; i++)
+        runs[i] = runTest(fn, true);
+
+      for (i = 0; i < runCount; i++)
+        values[i] = runs[i].encodeWallTime;
+
+      sort(values, runCount);
+      median = values[runCount / 2];
+
+      if (t == 1) {
+        baseline = median;
+        expected = runs[0].checksum;
+      }
+
+      for (i = 0; i < runCount; i++) {
+        if (runs[i].checksum != expected)
+          mismatch = true;
+      }
+
+      printf("%d,%g,%g,%llu,%016llx\n", t, median, baseline / median, runs[0].bytes,
+             (unsigned long long)runs[0].checksum);
+    }
+
+    if (mismatch) {
+      fprintf(stderr, "Decoded results differ between thread counts!\n");
+      return 1;
+    }
+
+    rfb::Server::encodeThreads.setParam(1);
+  }
+
+  if (clients > 1) {
+    printf("\n");
+    printf("Clients,CPU time per frame (private),CPU time per frame (shared),Shared per client\n");
+
+    for (int c = 1; c <= clients; c++) {
+      double privateTime, sharedTime;
+
+      for (int shared = 0; shared < 2; shared++) {
+        rfb::Server::shareEncodedUpdates.setParam(shared);
+
+        for (i = 0; i < runCount; i++)
+          runs[i] = runTest(fn, false, c);
+
+        for (i = 0; i < runCount; i++)
+          values[i] = runs[i].encodeTime / runs[i].frames;
+
+        sort(values, runCount);
+        median = values[runCount / 2];
+
+        if (shared)
+          sharedTime = median;
+        else
+          privateTime = median;
+      }
+
+      printf("%d,%g ms,%g ms,%g ms\n", c, privateTime * 1000.0, sharedTime * 1000.0, sharedTime * 1000.0 / c);
+    }
+  }
+
   return 0;
 }
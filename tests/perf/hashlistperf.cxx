@@ -0,0 +1,261 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+/*
+ * Measures what it costs a viewer to tell the server which cache IDs
+ * it has when connecting: the bytes on the wire and the time the
+ * server spends decoding and recording them. Compares the legacy
+ * HashList of full 16 byte keys with the compressed ID list, both as
+ * a full list and as a delta against the previous session's epoch.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include <core/Configuration.h>
+
+#include <rdr/MemInStream.h>
+#include <rdr/MemOutStream.h>
+
+#include <rfb/CMsgWriter.h>
+#include <rfb/CacheKey.h>
+#include <rfb/SMsgHandler.h>
+#include <rfb/SMsgReader.h>
+#include <rfb/ServerParams.h>
+#include <rfb/msgTypes.h>
+#include <rfb/cache/CacheKeyDictionary.h>
+#include <rfb/cache/IdListCodec.h>
+
+#include "util.h"
+
+static core::IntParameter keyCount("keys", "Number of cache IDs the viewer has", 1000000);
+static core::IntParameter churn("churn", "Percentage of IDs replaced since the last session", 2, 0, 100);
+static core::IntParameter linkRate("link", "Link rate in kbit/s", 10000, 1);
+static core::IntParameter count("count", "Number of runs to average the processing time over", 10, 1);
+
+// Records the IDs the same way VNCSConnectionST does
+
+class Handler : public rfb::SMsgHandler {
+public:
+  Handler(rfb::cache::CacheKeyDictionary* dict) : known(dict) {}
+
+  void handlePersistentHashList(uint32_t, uint16_t, uint16_t, const std::vector<uint64_t>& ids) override {
+    known.addMultiple(ids);
+  }
+  void handlePersistentIdList(uint8_t flags, uint64_t, uint16_t, uint16_t,
+                              const std::vector<uint64_t>& ids) override {
+    if (flags & rfb::idListFlagRemoved)
+      known.removeMultiple(ids);
+    else
+      known.addMultiple(ids);
+  }
+
+  void clientInit(bool) override {}
+  void setPixelFormat(const rfb::PixelFormat&) override {}
+  void setEncodings(int, const int32_t*) override {}
+  void framebufferUpdateRequest(const core::Rect&, bool) override {}
+  void setDesktopSize(int, int, const rfb::ScreenSet&) override {}
+  void fence(uint32_t, unsigned, const uint8_t*) override {}
+  void enableContinuousUpdates(bool, int, int, int, int) override {}
+  void keyEvent(uint32_t, uint32_t, bool) override {}
+  void pointerEvent(const core::Point&, uint16_t) override {}
+  void clientCutText(const char*) override {}
+  void handleClipboardCaps(uint32_t, const uint32_t*) override {}
+  void handleClipboardRequest(uint32_t) override {}
+  void handleClipboardPeek() override {}
+  void handleClipboardNotify(uint32_t) override {}
+  void handleClipboardProvide(uint32_t, const size_t*, const uint8_t* const*) override {}
+  void handlePersistentCacheQuery(const std::vector<uint64_t>&) override {}
+  void handlePersistentCacheEviction(const std::vector<uint64_t>&) override {}
+  void handlePersistentCacheHashReport(const rfb::CacheKey&, const rfb::CacheKey&) override {}
+  void handleDebugDumpRequest(uint32_t) override {}
+
+  rfb::cache::KnownKeySet known;
+};
+
+struct Result {
+  size_t bytes;
+  double process;
+};
+
+static std::vector<uint64_t> ids, base;
+
+static void writeLegacy(rfb::CMsgWriter* writer) {
+  const size_t batchSize = 1000;
+  size_t totalChunks;
+
+  totalChunks = (ids.size() + batchSize - 1) / batchSize;
+  for (size_t i = 0; i < totalChunks; i++) {
+    std::vector<rfb::CacheKey> keys;
+
+    for (size_t j = i * batchSize; j < std::min(ids.size(), (i + 1) * batchSize); j++) {
+      rfb::CacheKey key;
+      key.bytes.fill(0);
+      memcpy(key.bytes.data(), &ids[j], sizeof(ids[j]));
+      keys.push_back(key);
+    }
+
+    writer->writePersistentHashList(1, totalChunks, i, keys);
+  }
+}
+
+static void writeIdList(rfb::CMsgWriter* writer, uint8_t flags, const std::vector<uint64_t>& list, size_t first,
+                        size_t total) {
+  const size_t batchSize = 16384;
+
+  for (size_t i = 0; i * batchSize < list.size(); i++) {
+    std::vector<uint64_t> chunk(list.begin() + i * batchSize,
+                                list.begin() + std::min(list.size(), (i + 1) * batchSize));
+    writer->writePersistentIdList(flags, 1, total, first + i, chunk);
+  }
+}
+
+static void writeFull(rfb::CMsgWriter* writer) {
+  writeIdList(writer, 0, ids, 0, (ids.size() + 16383) / 16384);
+}
+
+static void writeDelta(rfb::CMsgWriter* writer) {
+  std::vector<uint64_t> added, removed;
+  size_t addChunks, removeChunks;
+
+  std::set_difference(ids.begin(), ids.end(), base.begin(), base.end(), std::back_inserter(added));
+  std::set_difference(base.begin(), base.end(), ids.begin(), ids.end(), std::back_inserter(removed));
+
+  addChunks = (added.size() + 16383) / 16384;
+  removeChunks = (removed.size() + 16383) / 16384;
+
+  writeIdList(writer, rfb::idListFlagDelta, added, 0, addChunks + removeChunks);
+  writeIdList(writer, rfb::idListFlagDelta | rfb::idListFlagRemoved, removed, addChunks,
+              addChunks + removeChunks);
+}
+
+static Result runTest(void (*write)(rfb::CMsgWriter*), bool delta) {
+  rdr::MemOutStream out;
+  rfb::ServerParams params;
+  rfb::CMsgWriter writer(&params, &out);
+  Result result;
+
+  write(&writer);
+
+  result.bytes = out.length();
+  result.process = 0.0;
+
+  for (int i = 0; i < count; i++) {
+    rfb::cache::CacheKeyDictionary dict;
+    Handler handler(&dict);
+    rdr::MemInStream in(out.data(), out.length());
+    rfb::SMsgReader reader(&handler, &in);
+
+    // A delta is applied on top of the snapshot the server kept from
+    // last time, which is already there when the viewer connects
+    if (delta)
+      handler.known.addMultiple(base);
+
+    startTimeCounter();
+    while (in.avail() > 0)
+      reader.readMsg();
+    endTimeCounter();
+
+    result.process += getTimeCounter();
+
+    if (handler.known.size() != ids.size())
+      fprintf(stderr, "Server ended up with %zu IDs rather than %zu\n", handler.known.size(), ids.size());
+  }
+
+  result.process /= count;
+
+  return result;
+}
+
+static void printResult(const char* name, const Result& result) {
+  double transfer;
+
+  transfer = result.bytes * 8.0 / (linkRate * 1000.0);
+
+  printf("%s,%zu,%g,%g,%g,%g\n", name, result.bytes, (double)result.bytes / ids.size(), result.process * 1000.0,
+         transfer * 1000.0, (transfer + result.process) * 1000.0);
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Syntax: %s [options]\n", argv0);
+  fprintf(stderr, "Options:\n");
+  core::Configuration::listParams(79, 14);
+  exit(1);
+}
+
+int main(int argc, char** argv) {
+  time_t t;
+  char datebuffer[256];
+  std::mt19937_64 random(1);
+  size_t replaced;
+
+  for (int i = 1; i < argc;) {
+    int ret;
+
+    ret = core::Configuration::handleParamArg(argc, argv, i);
+    if (ret > 0) {
+      i += ret;
+      continue;
+    }
+
+    usage(argv[0]);
+  }
+
+  for (int i = 0; i < keyCount; i++)
+    base.push_back(random());
+  rfb::cache::sortIds(&base);
+
+  // Evictions and new content since the previous session
+  ids = base;
+  replaced = ids.size() * churn / 100;
+  std::shuffle(ids.begin(), ids.end(), random);
+  for (size_t i = 0; i < replaced; i++)
+    ids[i] = random();
+  rfb::cache::sortIds(&ids);
+
+  time(&t);
+  strftime(datebuffer, sizeof(datebuffer), "%Y-%m-%d %H:%M UTC", gmtime(&t));
+
+  printf("# Cache ID Advertisement Performance Test %s\n", datebuffer);
+  printf("#\n");
+  printf("# IDs: %d\n", (int)keyCount);
+  printf("# Churn since last session: %d%%\n", (int)churn);
+  printf("# Link rate: %d kbit/s\n", (int)linkRate);
+  printf("#\n");
+  printf("# Note: Times are ms, FirstHit is transfer plus server processing\n");
+  printf("#\n");
+
+  printf("Format,Bytes,BytesPerID,Process,Transfer,FirstHit\n");
+
+  printResult("HashList", runTest(writeLegacy, false));
+  printResult("IdList", runTest(writeFull, false));
+  printResult("IdListDelta", runTest(writeDelta, true));
+
+  return 0;
+}
@@ -0,0 +1,291 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+/*
+ * Measures memory use and speed of the set that tracks which cache IDs
+ * a client knows about, compared to a plain std::unordered_set, when
+ * filled from HashList sized chunks of random 64-bit IDs.
+ *
+ * Also measures the total memory used by a server as more clients with
+ * largely the same cache connect, with every client keeping its own
+ * set compared to sharing a CacheKeyDictionary.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <new>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+#include <core/Configuration.h>
+
+#include <rfb/cache/CacheKeyDictionary.h>
+#include <rfb/cache/ServerHashSet.h>
+
+#include "util.h"
+
+static core::IntParameter keyCount("keys", "Number of cache IDs", 1000000);
+static core::IntParameter chunkSize("chunk", "IDs per HashList chunk", 1000);
+static core::IntParameter maxClients("clients", "Highest number of clients to test", 20, 1, 1000);
+static core::IntParameter common("common", "Percentage of IDs that all clients have in common", 90, 0, 100);
+
+// Track live heap usage so both containers are measured the same way
+
+static size_t liveBytes = 0;
+
+void* operator new(size_t size) {
+  size_t* p;
+
+  p = (size_t*)malloc(size + sizeof(max_align_t));
+  if (p == nullptr)
+    throw std::bad_alloc();
+
+  *p = size;
+  liveBytes += size;
+
+  return (char*)p + sizeof(max_align_t);
+}
+
+void operator delete(void* ptr) noexcept {
+  size_t* p;
+
+  if (ptr == nullptr)
+    return;
+
+  p = (size_t*)((char*)ptr - sizeof(max_align_t));
+  liveBytes -= *p;
+  free(p);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  operator delete(ptr);
+}
+
+struct Result {
+  double memory;
+  double insert;
+  double hit;
+  double miss;
+};
+
+static std::vector<uint64_t> ids, others;
+
+template <class Set> static void insertChunks(Set* set) {
+  for (size_t i = 0; i < ids.size(); i += chunkSize) {
+    for (size_t j = i; (j < ids.size()) && (j < i + chunkSize); j++)
+      set->insert(ids[j]);
+  }
+}
+
+static void insertChunks(rfb::ServerHashSet<uint64_t>* set) {
+  for (size_t i = 0; i < ids.size(); i += chunkSize) {
+    std::vector<uint64_t> chunk(ids.begin() + i, ids.begin() + std::min(ids.size(), i + chunkSize));
+    set->addMultiple(chunk);
+  }
+}
+
+static bool contains(const std::unordered_set<uint64_t>& set, uint64_t key) {
+  return set.find(key) != set.end();
+}
+
+static bool contains(const rfb::ServerHashSet<uint64_t>& set, uint64_t key) {
+  return set.has(key);
+}
+
+static void insertChunks(rfb::cache::KnownKeySet* set) {
+  for (size_t i = 0; i < ids.size(); i += chunkSize) {
+    std::vector<uint64_t> chunk(ids.begin() + i, ids.begin() + std::min(ids.size(), i + chunkSize));
+    set->addMultiple(chunk);
+  }
+}
+
+static bool contains(const rfb::cache::KnownKeySet& set, uint64_t key) {
+  return set.has(key);
+}
+
+template <class Set> static Result runTest() {
+  Result result;
+  size_t before, found;
+  Set* set;
+
+  before = liveBytes;
+
+  set = new Set;
+
+  startTimeCounter();
+  insertChunks(set);
+  endTimeCounter();
+  result.insert = getTimeCounter();
+
+  result.memory = liveBytes - before;
+
+  found = 0;
+  startTimeCounter();
+  for (uint64_t id : ids)
+    found += contains(*set, id);
+  endTimeCounter();
+  result.hit = getTimeCounter();
+
+  if (found != ids.size()) {
+    fprintf(stderr, "Lost %zu keys\n", ids.size() - found);
+    exit(1);
+  }
+
+  found = 0;
+  startTimeCounter();
+  for (uint64_t id : others)
+    found += contains(*set, id);
+  endTimeCounter();
+  result.miss = getTimeCounter();
+
+  // Random IDs should essentially never collide, but the result must be
+  // used or the lookups get optimised away
+  if (found != 0)
+    printf("# %zu false hits\n", found);
+
+  delete set;
+
+  return result;
+}
+
+// IDs for a client, where the common part is the same for everyone
+static std::vector<uint64_t> clientIds(int client) {
+  std::vector<uint64_t> result;
+  std::mt19937_64 rng(client + 2);
+  size_t shared;
+
+  shared = ids.size() * common / 100;
+  result.assign(ids.begin(), ids.begin() + shared);
+  while (result.size() < ids.size())
+    result.push_back(rng());
+
+  return result;
+}
+
+static double runPerClient(int clients) {
+  std::vector<rfb::ServerHashSet<uint64_t>*> sets;
+  size_t before, used;
+
+  before = liveBytes;
+
+  for (int i = 0; i < clients; i++) {
+    sets.push_back(new rfb::ServerHashSet<uint64_t>);
+    sets.back()->addMultiple(clientIds(i));
+  }
+
+  used = liveBytes - before;
+
+  for (rfb::ServerHashSet<uint64_t>* set : sets)
+    delete set;
+
+  return used;
+}
+
+static double runShared(int clients) {
+  rfb::cache::CacheKeyDictionary* dict;
+  std::vector<rfb::cache::KnownKeySet*> sets;
+  size_t before, used;
+
+  before = liveBytes;
+
+  dict = new rfb::cache::CacheKeyDictionary;
+  for (int i = 0; i < clients; i++) {
+    sets.push_back(new rfb::cache::KnownKeySet(dict));
+    sets.back()->addMultiple(clientIds(i));
+  }
+
+  used = liveBytes - before;
+
+  for (rfb::cache::KnownKeySet* set : sets)
+    delete set;
+  delete dict;
+
+  return used;
+}
+
+static void printResult(const char* name, const Result& result) {
+  double n = ids.size();
+
+  printf("%s,%g,%g,%g,%g\n", name, result.memory / n * 1e6 / 1024 / 1024, result.insert / n * 1e9,
+         result.hit / n * 1e9, result.miss / n * 1e9);
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Syntax: %s [options]\n", argv0);
+  fprintf(stderr, "Options:\n");
+  core::Configuration::listParams(79, 14);
+  exit(1);
+}
+
+int main(int argc, char** argv) {
+  time_t t;
+  char datebuffer[256];
+  std::mt19937_64 rng(1);
+
+  for (int i = 1; i < argc;) {
+    int ret;
+
+    ret = core::Configuration::handleParamArg(argc, argv, i);
+    if (ret > 0) {
+      i += ret;
+      continue;
+    }
+
+    usage(argv[0]);
+  }
+
+  for (int i = 0; i < keyCount; i++) {
+    ids.push_back(rng());
+    others.push_back(rng());
+  }
+
+  time(&t);
+  strftime(datebuffer, sizeof(datebuffer), "%Y-%m-%d %H:%M UTC", gmtime(&t));
+
+  printf("# Known Cache ID Set Performance Test %s\n", datebuffer);
+  printf("#\n");
+  printf("# Keys: %d, in chunks of %d\n", (int)keyCount, (int)chunkSize);
+  printf("#\n");
+  printf("# Note: Memory is MiB per million keys, times are ns per key\n");
+  printf("#\n");
+
+  printf("Set,Memory,Insert,Hit,Miss\n");
+  printResult("unordered_set", runTest<std::unordered_set<uint64_t>>());
+  printResult("ServerHashSet", runTest<rfb::ServerHashSet<uint64_t>>());
+  printResult("KnownKeySet", runTest<rfb::cache::KnownKeySet>());
+
+  printf("\n");
+  printf("# Server memory in MiB with %d%% of IDs common to all clients\n", (int)common);
+  printf("#\n");
+
+  printf("Clients,PerClient,Shared\n");
+  for (int clients = 1; clients <= maxClients; clients = clients < 5 ? clients + 1 : clients + 5) {
+    printf("%d,%g,%g\n", clients, runPerClient(clients) / 1024 / 1024, runShared(clients) / 1024 / 1024);
+    fflush(stdout);
+  }
+
+  return 0;
+}
@@ -0,0 +1,206 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+/*
+ * Measures the cost of a single event loop wakeup when a server has
+ * many idle connections and only one of them is active. Compares a
+ * select() loop that rebuilds and scans its descriptor sets on every
+ * iteration with network::Poller.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+#include <vector>
+
+#include <core/Configuration.h>
+
+#include <network/Poller.h>
+
+#include "util.h"
+
+static core::IntParameter idle("idle", "Number of idle connections", 400, 0, 480);
+static core::IntParameter count("count", "Number of wakeups to measure", 100000);
+
+struct Pair {
+  int local, remote;
+};
+
+static std::vector<Pair> pairs;
+
+static void openPairs() {
+  for (int i = 0; i < idle + 1; i++) {
+    int fds[2];
+    Pair pair;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+      perror("socketpair");
+      exit(1);
+    }
+
+    pair.local = fds[0];
+    pair.remote = fds[1];
+    pairs.push_back(pair);
+  }
+}
+
+static void closePairs() {
+  for (Pair pair : pairs) {
+    close(pair.local);
+    close(pair.remote);
+  }
+  pairs.clear();
+}
+
+static void poke(const Pair& pair) {
+  char c;
+
+  c = 0;
+  if (write(pair.remote, &c, 1) != 1) {
+    perror("write");
+    exit(1);
+  }
+}
+
+static void drain(const Pair& pair) {
+  char c;
+
+  if (read(pair.local, &c, 1) != 1) {
+    perror("read");
+    exit(1);
+  }
+}
+
+static double runSelect() {
+  const Pair& active = pairs.back();
+
+  startTimeCounter();
+
+  for (int i = 0; i < count; i++) {
+    fd_set rfds, wfds;
+    int nfds;
+
+    poke(active);
+
+    // Mirrors what the old loop did: rebuild the sets from scratch and
+    // then look at every connection afterwards
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    nfds = 0;
+    for (const Pair& pair : pairs) {
+      FD_SET(pair.local, &rfds);
+      if (pair.local >= nfds)
+        nfds = pair.local + 1;
+    }
+
+    if (select(nfds, &rfds, &wfds, nullptr, nullptr) < 0) {
+      perror("select");
+      exit(1);
+    }
+
+    for (const Pair& pair : pairs) {
+      if (FD_ISSET(pair.local, &rfds))
+        drain(pair);
+    }
+  }
+
+  endTimeCounter();
+
+  return getTimeCounter();
+}
+
+static double runPoller() {
+  network::Poller poller;
+  const Pair& active = pairs.back();
+
+  for (const Pair& pair : pairs)
+    poller.add(pair.local, network::Poller::Read);
+
+  startTimeCounter();
+
+  for (int i = 0; i < count; i++) {
+    poke(active);
+
+    if (poller.wait(-1) < 0) {
+      perror("wait");
+      exit(1);
+    }
+
+    for (const network::Poller::Event& event : poller.getReady()) {
+      if (event.fd == active.local)
+        drain(active);
+    }
+  }
+
+  endTimeCounter();
+
+  return getTimeCounter();
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Syntax: %s [options]\n", argv0);
+  fprintf(stderr, "Options:\n");
+  core::Configuration::listParams(79, 14);
+  exit(1);
+}
+
+int main(int argc, char** argv) {
+  time_t t;
+  char datebuffer[256];
+
+  for (int i = 1; i < argc;) {
+    int ret;
+
+    ret = core::Configuration::handleParamArg(argc, argv, i);
+    if (ret > 0) {
+      i += ret;
+      continue;
+    }
+
+    usage(argv[0]);
+  }
+
+  time(&t);
+  strftime(datebuffer, sizeof(datebuffer), "%Y-%m-%d %H:%M UTC", gmtime(&t));
+
+  printf("# Event Loop Performance Test %s\n", datebuffer);
+  printf("#\n");
+  printf("# Idle connections: %d\n", (int)idle);
+  printf("# Edge triggered: %s\n", network::Poller::edgeTriggered() ? "yes" : "no");
+  printf("#\n");
+  printf("# Note: Results are microseconds per wakeup\n");
+  printf("#\n");
+
+  openPairs();
+
+  printf("Loop,Time\n");
+  printf("select,%g\n", runSelect() * 1e6 / count);
+  printf("Poller,%g\n", runPoller() * 1e6 / count);
+
+  closePairs();
+
+  return 0;
+}
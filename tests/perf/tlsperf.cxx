@@ -0,0 +1,307 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+/*
+ * Measures how fast data can be sent over a TLS session on the
+ * loopback interface, with GnuTLS doing the encryption and with the
+ * kernel doing it (KernelTLS).
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <gnutls/gnutls.h>
+
+#include <core/Configuration.h>
+#include <core/Logger_stdio.h>
+
+#include <rdr/FdInStream.h>
+#include <rdr/FdOutStream.h>
+#include <rdr/TLSSocket.h>
+
+static core::IntParameter size("size", "MiB of data to send per mode", 2048, 1, 1000000);
+static core::IntParameter chunk("chunk", "Bytes written at a time", 65536, 1, 16 * 1024 * 1024);
+static core::StringParameter priority("priority", "GnuTLS priority string", "NORMAL:+ANON-ECDH");
+
+typedef std::chrono::steady_clock Clock;
+
+struct Stats {
+  bool kernelTx;
+  bool kernelRx;
+  double throughput;
+  double cpuUsage;
+};
+
+static void waitFd(int fd, short events) {
+  struct pollfd pfd;
+
+  pfd.fd = fd;
+  pfd.events = events;
+  poll(&pfd, 1, 100);
+}
+
+// Half of a connection, either sending or receiving
+class Peer {
+public:
+  Peer(int fd_, bool server_)
+      : fd(fd_), server(server_), in(fd_), out(fd_), anonServer(nullptr), anonClient(nullptr), tls(nullptr),
+        kernelTLS(false) {
+    const char* err;
+
+    if (gnutls_init(&session, server ? GNUTLS_SERVER : GNUTLS_CLIENT) != GNUTLS_E_SUCCESS) {
+      fprintf(stderr, "gnutls_init() failed\n");
+      exit(1);
+    }
+
+    if (gnutls_priority_set_direct(session, priority, &err) != GNUTLS_E_SUCCESS) {
+      fprintf(stderr, "Invalid priority string at: %s\n", err);
+      exit(1);
+    }
+
+    if (server) {
+      gnutls_anon_allocate_server_credentials(&anonServer);
+      gnutls_credentials_set(session, GNUTLS_CRD_ANON, anonServer);
+    } else {
+      gnutls_anon_allocate_client_credentials(&anonClient);
+      gnutls_credentials_set(session, GNUTLS_CRD_ANON, anonClient);
+    }
+
+    tls = new rdr::TLSSocket(&in, &out, session);
+  }
+
+  ~Peer() {
+    delete tls;
+    gnutls_deinit(session);
+    if (anonServer)
+      gnutls_anon_free_server_credentials(anonServer);
+    if (anonClient)
+      gnutls_anon_free_client_credentials(anonClient);
+    close(fd);
+  }
+
+  void handshake(bool enableKernel) {
+    while (!tls->handshake())
+      waitFd(fd, POLLIN);
+
+    if (enableKernel)
+      kernelTLS = tls->enableKernelTLS();
+  }
+
+  void send(size_t total) {
+    std::vector<uint8_t> data(chunk);
+    rdr::TLSOutStream& os = tls->outStream();
+
+    for (size_t i = 0; i < data.size(); i++)
+      data[i] = rand();
+
+    while (total > 0) {
+      size_t len;
+
+      len = std::min(total, data.size());
+      os.writeBytes(data.data(), len);
+      os.flush();
+      total -= len;
+
+      while (out.hasBufferedData()) {
+        waitFd(fd, POLLOUT);
+        out.flush();
+      }
+    }
+
+    tls->shutdown();
+  }
+
+  void receive(size_t total) {
+    rdr::TLSInStream& is = tls->inStream();
+
+    while (total > 0) {
+      size_t len;
+
+      if (!is.hasData(1)) {
+        waitFd(fd, POLLIN);
+        continue;
+      }
+
+      len = std::min(total, is.avail());
+      is.skip(len);
+      total -= len;
+    }
+  }
+
+  int fd;
+  bool server;
+  rdr::FdInStream in;
+  rdr::FdOutStream out;
+  gnutls_session_t session;
+  gnutls_anon_server_credentials_t anonServer;
+  gnutls_anon_client_credentials_t anonClient;
+  rdr::TLSSocket* tls;
+  bool kernelTLS;
+};
+
+static void connectPair(int* serverFd, int* clientFd) {
+  struct sockaddr_in addr;
+  socklen_t addrlen;
+  int listener;
+
+  listener = socket(AF_INET, SOCK_STREAM, 0);
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addrlen = sizeof(addr);
+
+  if ((bind(listener, (struct sockaddr*)&addr, sizeof(addr)) < 0) || (listen(listener, 1) < 0) ||
+      (getsockname(listener, (struct sockaddr*)&addr, &addrlen) < 0)) {
+    perror("Failed to listen on loopback");
+    exit(1);
+  }
+
+  *clientFd = socket(AF_INET, SOCK_STREAM, 0);
+  if (connect(*clientFd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+    perror("connect");
+    exit(1);
+  }
+
+  *serverFd = accept(listener, nullptr, nullptr);
+  if (*serverFd < 0) {
+    perror("accept");
+    exit(1);
+  }
+
+  close(listener);
+}
+
+static double cpuTime() {
+  struct rusage usage;
+
+  getrusage(RUSAGE_SELF, &usage);
+
+  return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static Stats runTest(bool enableKernel) {
+  int serverFd, clientFd;
+  Peer *server, *client;
+  std::thread* receiver;
+  size_t total;
+  Clock::time_point start;
+  double cpuStart, elapsed;
+  Stats stats;
+
+  connectPair(&serverFd, &clientFd);
+
+  server = new Peer(serverFd, true);
+  client = new Peer(clientFd, false);
+
+  receiver = new std::thread(&Peer::handshake, client, enableKernel);
+  server->handshake(enableKernel);
+  receiver->join();
+  delete receiver;
+
+  total = (size_t)size * 1024 * 1024;
+
+  cpuStart = cpuTime();
+  start = Clock::now();
+
+  receiver = new std::thread(&Peer::receive, client, total);
+  server->send(total);
+  receiver->join();
+  delete receiver;
+
+  elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+  stats.kernelTx = server->kernelTLS;
+  stats.kernelRx = client->kernelTLS;
+  stats.throughput = total / elapsed;
+  stats.cpuUsage = (cpuTime() - cpuStart) * 100 / elapsed;
+
+  delete client;
+  delete server;
+
+  return stats;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Syntax: %s [options]\n", argv0);
+  fprintf(stderr, "Options:\n");
+  core::Configuration::listParams(79, 14);
+  exit(1);
+}
+
+int main(int argc, char** argv) {
+  time_t t;
+  char datebuffer[256];
+
+  core::initStdIOLoggers();
+
+  for (int i = 1; i < argc;) {
+    int ret;
+
+    ret = core::Configuration::handleParamArg(argc, argv, i);
+    if (ret > 0) {
+      i += ret;
+      continue;
+    }
+
+    usage(argv[0]);
+  }
+
+  gnutls_global_init();
+
+  time(&t);
+  strftime(datebuffer, sizeof(datebuffer), "%Y-%m-%d %H:%M UTC", gmtime(&t));
+
+  printf("# TLS Throughput Test %s\n", datebuffer);
+  printf("#\n");
+  printf("# Data: %d MiB in writes of %d bytes over loopback\n", (int)size, (int)chunk);
+  printf("#\n");
+  printf("# Note: Throughput is in MiB/s, CPU is for both ends in %% of one core.\n");
+  printf("#       Kernel sending/receiving shows if KernelTLS was actually used.\n");
+  printf("#\n");
+
+  printf("KernelTLS,Kernel sending,Kernel receiving,Throughput,CPU\n");
+
+  for (int on = 0; on <= 1; on++) {
+    Stats stats;
+
+    stats = runTest(on);
+    printf("%s,%s,%s,%g,%g\n", on ? "on" : "off", stats.kernelTx ? "yes" : "no", stats.kernelRx ? "yes" : "no",
+           stats.throughput / (1024 * 1024), stats.cpuUsage);
+  }
+
+  gnutls_global_deinit();
+
+  return 0;
+}
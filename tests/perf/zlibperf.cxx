@@ -0,0 +1,164 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+/*
+ * Measures the throughput and compression ratio of ZlibOutStream when
+ * compressing screen-like data in Tight sized rectangles, serially
+ * and with parallel deflate across a range of thread counts.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <vector>
+
+#include <core/Configuration.h>
+
+#include <rdr/MemOutStream.h>
+#include <rdr/ZlibOutStream.h>
+
+#include "util.h"
+
+static core::IntParameter size("size", "Megabytes of data compressed per level and thread count", 64);
+static core::IntParameter rectSize("rectsize", "Kilobytes of data in each flushed rectangle", 192);
+static core::IntParameter maxThreads("threads", "Highest thread count to test", 8, 1, 64);
+
+// Text-like runs on a flat background, with the odd gradient, packed as
+// 24 bit pixels like Tight does
+static std::vector<uint8_t> makeData(size_t length) {
+  std::vector<uint8_t> data(length);
+  uint32_t seed;
+
+  seed = 1;
+  for (size_t i = 0; i < length; i += 3) {
+    size_t pixel;
+    uint32_t colour;
+
+    pixel = i / 3;
+
+    seed = seed * 1103515245 + 12345;
+
+    if ((pixel / 1920) % 97 < 20)
+      colour = ((pixel % 1920) * 255 / 1920) * 0x010101;
+    else if (((seed >> 16) % 8) == 0)
+      colour = 0x202020 + ((seed >> 8) & 0x0f0f0f);
+    else
+      colour = 0xf0f0f0;
+
+    for (size_t j = 0; (j < 3) && (i + j < length); j++)
+      data[i + j] = colour >> (j * 8);
+  }
+
+  return data;
+}
+
+static void runTest(const std::vector<uint8_t>& data, int level, int threads, double* throughput,
+                    double* ratio) {
+  rdr::MemOutStream out;
+  rdr::ZlibOutStream zos(nullptr, level);
+  size_t total, compressed;
+  double elapsed;
+
+  zos.setThreads(threads);
+  zos.setUnderlying(&out);
+
+  total = compressed = 0;
+  elapsed = 0.0;
+
+  while (total < (size_t)size * 1024 * 1024) {
+    for (size_t offset = 0; offset + rectSize * 1024 <= data.size(); offset += rectSize * 1024) {
+      startTimeCounter();
+      zos.cork(true);
+      zos.writeBytes(data.data() + offset, rectSize * 1024);
+      zos.cork(false);
+      zos.flush();
+      endTimeCounter();
+
+      elapsed += getTimeCounter();
+      total += rectSize * 1024;
+      compressed += out.length();
+      out.clear();
+    }
+  }
+
+  zos.setUnderlying(nullptr);
+
+  *throughput = total / elapsed;
+  *ratio = (double)total / compressed;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Syntax: %s [options]\n", argv0);
+  fprintf(stderr, "Options:\n");
+  core::Configuration::listParams(79, 14);
+  exit(1);
+}
+
+int main(int argc, char** argv) {
+  time_t t;
+  char datebuffer[256];
+  std::vector<uint8_t> data;
+
+  for (int i = 1; i < argc;) {
+    int ret;
+
+    ret = core::Configuration::handleParamArg(argc, argv, i);
+    if (ret > 0) {
+      i += ret;
+      continue;
+    }
+
+    usage(argv[0]);
+  }
+
+  if (rectSize <= 0) {
+    fprintf(stderr, "Rectangle size must be positive!\n\n");
+    usage(argv[0]);
+  }
+
+  time(&t);
+  strftime(datebuffer, sizeof(datebuffer), "%Y-%m-%d %H:%M UTC", gmtime(&t));
+
+  printf("# Zlib Compression Performance Test %s\n", datebuffer);
+  printf("#\n");
+  printf("# Data: %d MB in %d KB rectangles\n", (int)size, (int)rectSize);
+  printf("#\n");
+  printf("# Note: Throughput is MB/s of uncompressed data\n");
+  printf("#\n");
+
+  data = makeData(16 * 1024 * 1024);
+
+  printf("Level,Threads,Throughput,Ratio\n");
+
+  for (int level : {1, 6, 9}) {
+    for (int threads = 1; threads <= maxThreads; threads++) {
+      double throughput, ratio;
+
+      runTest(data, level, threads, &throughput, &ratio);
+
+      printf("%d,%d,%g,%g\n", level, threads, throughput / 1e6, ratio);
+    }
+  }
+
+  return 0;
+}
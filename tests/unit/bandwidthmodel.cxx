@@ -0,0 +1,221 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <deque>
+
+#include <gtest/gtest.h>
+
+#include <rfb/BandwidthModel.h>
+
+using rfb::BandwidthModel;
+
+// A link with a fixed bandwidth and latency, and an unbounded queue
+// in front of it
+class Link {
+public:
+  Link(BandwidthModel* model_, unsigned rate_, unsigned delay_)
+      : model(model_), rate(rate_), delay(delay_), now(0), linkFree(0), pos(0), acked(0) {}
+
+  void send(unsigned bytes) {
+    linkFree = std::max(linkFree, now) + (uint64_t)bytes * 1000000 / rate;
+    pos += bytes;
+  }
+
+  void marker(bool appLimited) {
+    struct timeval tv;
+
+    tv = toTimeval(now);
+    model->sentMarker(&tv, pos, appLimited);
+    acks.push_back({std::max(linkFree, now) + delay, pos});
+  }
+
+  void advance(unsigned us) {
+    uint64_t target;
+
+    target = now + us;
+    while (!acks.empty() && (acks.front().time <= target)) {
+      struct timeval tv;
+
+      now = acks.front().time;
+      acked = acks.front().pos;
+      acks.pop_front();
+
+      tv = toTimeval(now);
+      model->ackedMarker(&tv);
+    }
+
+    now = target;
+  }
+
+  unsigned inFlight() const {
+    return pos - acked;
+  }
+
+  BandwidthModel* model;
+  unsigned rate;
+  unsigned delay;
+
+private:
+  static struct timeval toTimeval(uint64_t us) {
+    struct timeval tv;
+    tv.tv_sec = us / 1000000;
+    tv.tv_usec = us % 1000000;
+    return tv;
+  }
+
+  struct Ack {
+    uint64_t time;
+    unsigned pos;
+  };
+
+  uint64_t now;
+  uint64_t linkFree;
+  unsigned pos;
+  unsigned acked;
+  std::deque<Ack> acks;
+};
+
+// Sends updates framed by markers, like the server does, whenever
+// less than the given amount of data is in flight
+static void runSaturated(Link* link, unsigned ms, unsigned window) {
+  for (unsigned i = 0; i < ms; i++) {
+    while (link->inFlight() < window) {
+      link->marker(false);
+      link->send(16384);
+      link->marker(false);
+    }
+    link->advance(1000);
+  }
+}
+
+// Sends a small update at a fixed interval, never filling the link
+static void runAppLimited(Link* link, unsigned ms, unsigned bytes, unsigned interval) {
+  for (unsigned i = 0; i < ms; i += interval) {
+    link->marker(true);
+    link->send(bytes);
+    link->marker(true);
+    link->advance(interval * 1000);
+  }
+}
+
+TEST(BandwidthModel, NoEstimateInitially) {
+  BandwidthModel model;
+
+  EXPECT_EQ(model.getBandwidth(), 0U);
+  EXPECT_EQ(model.getMinRTT(), 0U);
+  EXPECT_EQ(model.getPacingRate(), 0U);
+  EXPECT_TRUE(model.inStartup());
+}
+
+TEST(BandwidthModel, SaturatedLink) {
+  BandwidthModel model;
+  Link link(&model, 1000000, 20000);
+
+  runSaturated(&link, 2000, 100000);
+
+  EXPECT_NEAR(model.getBandwidth(), 1000000, 50000);
+  EXPECT_NEAR(model.getMinRTT(), 20000, 1000);
+}
+
+TEST(BandwidthModel, StartupEndsWhenLinkIsFull) {
+  BandwidthModel model;
+  Link link(&model, 1000000, 20000);
+
+  link.marker(false);
+  link.send(16384);
+  link.marker(false);
+  link.advance(100000);
+  EXPECT_TRUE(model.inStartup());
+  EXPECT_EQ(model.getPacingRate(), model.getBandwidth() * 289 / 100);
+
+  runSaturated(&link, 2000, 100000);
+  EXPECT_FALSE(model.inStartup());
+
+  // Probing cycles around the estimate once the link is full
+  for (int i = 0; i < 20; i++) {
+    runSaturated(&link, 10, 100000);
+    EXPECT_GE(model.getPacingRate(), model.getBandwidth() * 75 / 100);
+    EXPECT_LE(model.getPacingRate(), model.getBandwidth() * 125 / 100);
+  }
+}
+
+TEST(BandwidthModel, AppLimitedKeepsEstimate) {
+  BandwidthModel model;
+  Link link(&model, 1000000, 20000);
+
+  runSaturated(&link, 2000, 100000);
+  EXPECT_NEAR(model.getBandwidth(), 1000000, 50000);
+
+  // Far less than the link can carry, for many round trips
+  runAppLimited(&link, 5000, 1000, 20);
+  EXPECT_NEAR(model.getBandwidth(), 1000000, 50000);
+}
+
+TEST(BandwidthModel, AppLimitedRaisesEstimate) {
+  BandwidthModel model;
+  Link link(&model, 1000000, 20000);
+
+  runAppLimited(&link, 1000, 1000, 20);
+  EXPECT_GT(model.getBandwidth(), 0U);
+  EXPECT_LT(model.getBandwidth(), 1000000U);
+
+  runSaturated(&link, 2000, 100000);
+  EXPECT_NEAR(model.getBandwidth(), 1000000, 50000);
+}
+
+TEST(BandwidthModel, IdleTimeIsIgnored) {
+  BandwidthModel model;
+  Link link(&model, 1000000, 20000);
+
+  // Large updates, but with long pauses in between
+  runAppLimited(&link, 10000, 100000, 1000);
+  EXPECT_GT(model.getBandwidth(), 800000U);
+  EXPECT_LE(model.getBandwidth(), 1000000U);
+}
+
+TEST(BandwidthModel, FollowsBandwidthDrop) {
+  BandwidthModel model;
+  Link link(&model, 2000000, 20000);
+
+  runSaturated(&link, 2000, 200000);
+  EXPECT_NEAR(model.getBandwidth(), 2000000, 100000);
+
+  link.rate = 500000;
+  runSaturated(&link, 3000, 50000);
+  EXPECT_NEAR(model.getBandwidth(), 500000, 25000);
+}
+
+TEST(BandwidthModel, MinRTTExpires) {
+  BandwidthModel model;
+  Link link(&model, 1000000, 20000);
+
+  runAppLimited(&link, 2000, 1000, 20);
+  EXPECT_NEAR(model.getMinRTT(), 20000, 2000);
+
+  // A longer path is only believed once the old one is forgotten
+  link.delay = 50000;
+  runAppLimited(&link, 5000, 1000, 20);
+  EXPECT_NEAR(model.getMinRTT(), 20000, 2000);
+
+  runAppLimited(&link, 6000, 1000, 20);
+  EXPECT_NEAR(model.getMinRTT(), 50000, 2000);
+}
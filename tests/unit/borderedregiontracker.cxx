@@ -0,0 +1,105 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include <rfb/ContentHash.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/cache/BorderedRegionTracker.h>
+
+using namespace rfb;
+
+static const PixelFormat fbPF(32, 24, false, true, 255, 255, 255, 0, 8, 16);
+
+static void fill(ManagedPixelBuffer* pb, const core::Rect& r, uint32_t value) {
+  pb->fillRect(r, &value);
+}
+
+static bool sameRegions(const std::vector<ContentHash::BorderedRegion>& a,
+                        const std::vector<ContentHash::BorderedRegion>& b) {
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i].contentRect != b[i].contentRect)
+      return false;
+    if (a[i].outerRect != b[i].outerRect)
+      return false;
+  }
+  return true;
+}
+
+TEST(BorderedRegionTracker, MatchesDetector) {
+  ManagedPixelBuffer pb(fbPF, 1280, 1024);
+  cache::BorderedRegionTracker tracker(5, 50000);
+
+  fill(&pb, pb.getRect(), 0x808080);
+
+  EXPECT_TRUE(sameRegions(tracker.regions(&pb), ContentHash::detectBorderedRegions(&pb, 5, 50000)));
+  ASSERT_FALSE(tracker.regions(&pb).empty());
+
+  // Too small for any region
+  ManagedPixelBuffer small(fbPF, 320, 200);
+  EXPECT_TRUE(tracker.regions(&small).empty());
+  EXPECT_TRUE(ContentHash::detectBorderedRegions(&small, 5, 50000).empty());
+}
+
+TEST(BorderedRegionTracker, FollowsResize) {
+  ManagedPixelBuffer pb(fbPF, 1280, 1024);
+  cache::BorderedRegionTracker tracker(5, 50000);
+
+  tracker.regions(&pb);
+
+  pb.setSize(1920, 1080);
+  EXPECT_TRUE(sameRegions(tracker.regions(&pb), ContentHash::detectBorderedRegions(&pb, 5, 50000)));
+}
+
+TEST(BorderedRegionTracker, HashReusedUntilDamaged) {
+  ManagedPixelBuffer pb(fbPF, 1280, 1024);
+  cache::BorderedRegionTracker tracker(5, 50000);
+  cache::ScanStats stats;
+
+  fill(&pb, pb.getRect(), 0x808080);
+
+  ASSERT_FALSE(tracker.regions(&pb).empty());
+  const core::Rect content = tracker.regions(&pb)[0].contentRect;
+
+  std::vector<uint8_t> first = tracker.contentHash(&pb, 0);
+  EXPECT_EQ(first, ContentHash::computeRect(&pb, content));
+  EXPECT_EQ(tracker.contentHash(&pb, 0), first);
+
+  stats = tracker.takeStats();
+  EXPECT_EQ(stats.rectsHashed, 1U);
+  EXPECT_EQ(stats.blocksHit, 1U);
+
+  // Damage outside the content area keeps the hash
+  tracker.noteDamage(core::Region({0, 0, 10, 10}));
+  EXPECT_EQ(tracker.contentHash(&pb, 0), first);
+  EXPECT_EQ(tracker.takeStats().rectsHashed, 0U);
+
+  // Damage inside does not
+  core::Rect dirty(content.tl.x, content.tl.y, content.tl.x + 16, content.tl.y + 16);
+  fill(&pb, dirty, 0xff0000);
+  tracker.noteDamage(dirty);
+  EXPECT_EQ(tracker.contentHash(&pb, 0), ContentHash::computeRect(&pb, content));
+  EXPECT_NE(tracker.contentHash(&pb, 0), first);
+  EXPECT_EQ(tracker.takeStats().rectsHashed, 1U);
+}
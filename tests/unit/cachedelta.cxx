@@ -0,0 +1,206 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <rfb/PixelBuffer.h>
+#include <rfb/cache/CacheDelta.h>
+
+using namespace rfb;
+using namespace rfb::cache;
+
+static const PixelFormat fbPF(32, 24, false, true, 255, 255, 255, 16, 8, 0);
+
+static CacheKey makeKey(uint64_t id) {
+  uint8_t bytes[16];
+
+  memset(bytes, 0, sizeof(bytes));
+  memcpy(bytes, &id, sizeof(id));
+
+  return CacheKey(bytes);
+}
+
+static void fillNoise(ManagedPixelBuffer* pb, const core::Rect& r, unsigned seed) {
+  uint32_t* data;
+  int stride;
+
+  srand(seed);
+
+  data = (uint32_t*)pb->getBufferRW(r, &stride);
+  for (int y = 0; y < r.height(); y++) {
+    for (int x = 0; x < r.width(); x++)
+      data[x + y * stride] = rand() & 0xffffff;
+  }
+  pb->commitBufferRW(r);
+}
+
+static bool acceptAll(const CacheKey&) {
+  return true;
+}
+
+TEST(DeltaReferenceStore, FindsSimilarContent) {
+  ManagedPixelBuffer pb(fbPF, 512, 256);
+  core::Rect page(0, 0, 256, 128);
+  uint32_t pixel = 0x123456;
+
+  fillNoise(&pb, pb.getRect(), 1);
+
+  DeltaReferenceStore store(16 * 1024 * 1024);
+  store.insert(makeKey(1), page, &pb);
+  EXPECT_EQ(store.size(), 1U);
+
+  // A single edited pixel only changes one tile
+  pb.fillRect({10, 10, 11, 11}, &pixel);
+
+  const DeltaReferenceStore::Entry* base = store.findBase(page, &pb, 500, acceptAll);
+  ASSERT_NE(base, nullptr);
+  EXPECT_EQ(base->key, makeKey(1));
+}
+
+TEST(DeltaReferenceStore, FindsMovedContent) {
+  ManagedPixelBuffer pb(fbPF, 512, 256);
+  core::Rect page(0, 0, 256, 128);
+  uint32_t pixel = 0x123456;
+
+  fillNoise(&pb, pb.getRect(), 1);
+
+  DeltaReferenceStore store(16 * 1024 * 1024);
+  store.insert(makeKey(1), page, &pb);
+
+  pb.copyRect({256, 128, 512, 256}, {256, 128});
+  pb.fillRect({300, 140, 301, 141}, &pixel);
+
+  const DeltaReferenceStore::Entry* base = store.findBase({256, 128, 512, 256}, &pb, 500, acceptAll);
+  ASSERT_NE(base, nullptr);
+  EXPECT_EQ(base->key, makeKey(1));
+}
+
+TEST(DeltaReferenceStore, RequiresEnoughMatchingTiles) {
+  ManagedPixelBuffer pb(fbPF, 512, 256);
+  core::Rect page(0, 0, 256, 128);
+
+  fillNoise(&pb, pb.getRect(), 1);
+
+  DeltaReferenceStore store(16 * 1024 * 1024);
+  store.insert(makeKey(1), page, &pb);
+
+  fillNoise(&pb, {0, 0, 256, 96}, 2);
+
+  EXPECT_EQ(store.findBase(page, &pb, 500, acceptAll), nullptr);
+  EXPECT_NE(store.findBase(page, &pb, 200, acceptAll), nullptr);
+}
+
+TEST(DeltaReferenceStore, SkipsUnsuitableEntries) {
+  ManagedPixelBuffer pb(fbPF, 512, 256);
+  core::Rect page(0, 0, 256, 128);
+  uint32_t pixel = 0x123456;
+
+  fillNoise(&pb, pb.getRect(), 1);
+
+  DeltaReferenceStore store(16 * 1024 * 1024);
+  store.insert(makeKey(1), page, &pb);
+
+  // Identical content is not a delta
+  EXPECT_EQ(store.findBase(page, &pb, 500, acceptAll), nullptr);
+
+  pb.fillRect({10, 10, 11, 11}, &pixel);
+
+  // Different size
+  EXPECT_EQ(store.findBase({0, 0, 256, 112}, &pb, 500, acceptAll), nullptr);
+
+  // Vetoed
+  EXPECT_EQ(store.findBase(page, &pb, 500, [](const CacheKey&) { return false; }), nullptr);
+
+  store.remove(1);
+  EXPECT_EQ(store.size(), 0U);
+  EXPECT_EQ(store.memoryUsage(), 0U);
+  EXPECT_EQ(store.findBase(page, &pb, 500, acceptAll), nullptr);
+}
+
+TEST(DeltaReferenceStore, EvictsLeastRecentlyUsed) {
+  ManagedPixelBuffer pb(fbPF, 512, 256);
+  core::Rect page(0, 0, 64, 64);
+  size_t entryBytes;
+
+  fillNoise(&pb, pb.getRect(), 1);
+
+  DeltaReferenceStore store(16 * 1024 * 1024);
+  store.insert(makeKey(1), page, &pb);
+  entryBytes = store.memoryUsage();
+
+  // Room for two entries
+  store.setMaxBytes(entryBytes * 2 + entryBytes / 2);
+
+  store.insert(makeKey(2), page.translate({64, 0}), &pb);
+  store.touch(1);
+  store.insert(makeKey(3), page.translate({128, 0}), &pb);
+
+  EXPECT_EQ(store.size(), 2U);
+  EXPECT_LE(store.memoryUsage(), entryBytes * 2 + entryBytes / 2);
+
+  // Entry 2 was the least recently used and should be gone
+  store.remove(2);
+  EXPECT_EQ(store.size(), 2U);
+  store.remove(1);
+  store.remove(3);
+  EXPECT_EQ(store.size(), 0U);
+
+  // Disabled
+  store.setMaxBytes(0);
+  store.insert(makeKey(4), page, &pb);
+  EXPECT_EQ(store.size(), 0U);
+}
+
+TEST(CacheDelta, ResidualRoundTrip) {
+  std::vector<uint8_t> base(256 * 128 * 4), pixels, residual;
+
+  srand(3);
+  for (uint8_t& b : base)
+    b = rand();
+
+  pixels = base;
+  memset(pixels.data() + 4000, 0xff, 300);
+
+  encodeResidual(base.data(), pixels.data(), pixels.size(), 6, &residual);
+
+  // Mostly zeroes, so much smaller than the content itself
+  EXPECT_LT(residual.size() * 10, compressedSize(pixels.data(), pixels.size(), 6));
+
+  ASSERT_TRUE(applyResidual(residual.data(), residual.size(), base.data(), base.size()));
+  EXPECT_EQ(base, pixels);
+}
+
+TEST(CacheDelta, ResidualLengthMismatch) {
+  std::vector<uint8_t> base(4096, 0x55), pixels(4096, 0xaa), residual;
+
+  encodeResidual(base.data(), pixels.data(), pixels.size(), 6, &residual);
+
+  EXPECT_FALSE(applyResidual(residual.data(), residual.size(), base.data(), 2048));
+  base.resize(8192);
+  EXPECT_FALSE(applyResidual(residual.data(), residual.size(), base.data(), base.size()));
+}
@@ -0,0 +1,257 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <unordered_set>
+
+#include <gtest/gtest.h>
+
+#include <rfb/cache/CacheEpochStore.h>
+#include <rfb/cache/CacheKeyDictionary.h>
+
+using namespace rfb::cache;
+
+TEST(CacheKeyDictionary, RefCounting) {
+  CacheKeyDictionary dict;
+  uint32_t a, b;
+
+  EXPECT_EQ(dict.find(42), CacheKeyDictionary::NoIndex);
+
+  a = dict.acquire(42);
+  b = dict.acquire(42);
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(dict.find(42), a);
+  EXPECT_EQ(dict.size(), 1);
+
+  dict.release(a);
+  EXPECT_EQ(dict.find(42), a);
+
+  dict.release(a);
+  EXPECT_EQ(dict.find(42), CacheKeyDictionary::NoIndex);
+  EXPECT_EQ(dict.size(), 0);
+}
+
+TEST(CacheKeyDictionary, IndicesAreReused) {
+  CacheKeyDictionary dict;
+  std::vector<uint32_t> indices;
+
+  for (uint64_t key = 1; key <= 100; key++)
+    indices.push_back(dict.acquire(key));
+
+  EXPECT_EQ(*std::max_element(indices.begin(), indices.end()), 99);
+
+  dict.releaseMultiple(indices);
+  EXPECT_EQ(dict.size(), 0);
+
+  for (uint64_t key = 1000; key < 1100; key++)
+    EXPECT_LT(dict.acquire(key), 100);
+}
+
+TEST(KnownKeySet, Basic) {
+  KnownKeySet set;
+
+  EXPECT_TRUE(set.empty());
+  EXPECT_FALSE(set.has(0));
+
+  set.add(0);
+  set.add(123);
+  set.add(123);
+
+  EXPECT_TRUE(set.has(0));
+  EXPECT_TRUE(set.has(123));
+  EXPECT_FALSE(set.has(124));
+  EXPECT_EQ(set.size(), 2);
+
+  EXPECT_TRUE(set.remove(123));
+  EXPECT_FALSE(set.remove(123));
+  EXPECT_FALSE(set.has(123));
+  EXPECT_EQ(set.size(), 1);
+
+  auto stats = set.getStats();
+  EXPECT_EQ(stats.currentSize, 1);
+  EXPECT_EQ(stats.totalAdded, 2);
+  EXPECT_EQ(stats.totalEvicted, 1);
+}
+
+TEST(KnownKeySet, SharedDictionary) {
+  CacheKeyDictionary dict;
+  KnownKeySet* first;
+  KnownKeySet* second;
+  std::vector<uint64_t> keys;
+
+  for (uint64_t i = 1; i <= 1000; i++)
+    keys.push_back(i * 0x9e3779b97f4a7c15ULL);
+
+  first = new KnownKeySet(&dict);
+  second = new KnownKeySet(&dict);
+
+  first->addMultiple(keys);
+  second->addMultiple(keys);
+  second->add(7);
+
+  EXPECT_EQ(dict.size(), 1001);
+  EXPECT_FALSE(first->has(7));
+  EXPECT_TRUE(second->has(7));
+
+  // Still referenced by the other set
+  EXPECT_TRUE(first->remove(keys[0]));
+  EXPECT_FALSE(first->has(keys[0]));
+  EXPECT_TRUE(second->has(keys[0]));
+  EXPECT_EQ(dict.size(), 1001);
+
+  delete second;
+  EXPECT_EQ(dict.size(), 999);
+  EXPECT_TRUE(first->has(keys[1]));
+
+  delete first;
+  EXPECT_EQ(dict.size(), 0);
+}
+
+TEST(KnownKeySet, SetDictionary) {
+  CacheKeyDictionary dict;
+  KnownKeySet set;
+
+  set.add(1);
+  set.setDictionary(&dict);
+
+  EXPECT_TRUE(set.empty());
+  EXPECT_FALSE(set.has(1));
+
+  set.add(2);
+  EXPECT_EQ(dict.find(2), 0);
+
+  set.setDictionary(nullptr);
+  EXPECT_EQ(dict.size(), 0);
+}
+
+TEST(KnownKeySet, DenseBlocks) {
+  KnownKeySet set;
+  std::vector<uint64_t> keys;
+  size_t sparseMemory;
+
+  // Enough for the first block to turn in to a bitmap
+  for (uint64_t i = 1; i <= 70000; i++)
+    keys.push_back(i);
+  set.addMultiple(keys);
+
+  EXPECT_EQ(set.size(), 70000);
+  EXPECT_LT(set.memoryUsage(), 70000 * sizeof(uint16_t));
+
+  keys = set.getKeys();
+  std::sort(keys.begin(), keys.end());
+  EXPECT_EQ(keys.size(), 70000);
+  EXPECT_EQ(keys.front(), 1);
+  EXPECT_EQ(keys.back(), 70000);
+
+  // And back to arrays again
+  for (uint64_t i = 1; i <= 69000; i++)
+    EXPECT_TRUE(set.remove(i));
+
+  EXPECT_EQ(set.size(), 1000);
+  for (uint64_t i = 69001; i <= 70000; i++)
+    EXPECT_TRUE(set.has(i));
+  EXPECT_FALSE(set.has(1));
+
+  sparseMemory = set.memoryUsage();
+  EXPECT_LT(sparseMemory, 65536 / 8);
+}
+
+TEST(KnownKeySet, ChurnMatchesReference) {
+  CacheKeyDictionary dict;
+  KnownKeySet set(&dict), other(&dict);
+  std::unordered_set<uint64_t> reference;
+
+  srand(1);
+  for (int i = 0; i < 200000; i++) {
+    uint64_t key = rand() % 20000;
+
+    if (rand() % 2 == 0)
+      other.add(key);
+
+    if (rand() % 3 == 0) {
+      EXPECT_EQ(set.remove(key), reference.erase(key) > 0);
+    } else {
+      set.add(key);
+      reference.insert(key);
+    }
+  }
+
+  EXPECT_EQ(set.size(), reference.size());
+  for (uint64_t key = 0; key < 20000; key++)
+    EXPECT_EQ(set.has(key), reference.count(key) > 0) << key;
+
+  other.clear();
+  EXPECT_EQ(dict.size(), reference.size());
+}
+
+TEST(CacheEpochStore, StoreAndTake) {
+  CacheKeyDictionary dict;
+  CacheEpochStore epochs(&dict);
+  KnownKeySet* keys;
+  uint64_t token;
+
+  keys = new KnownKeySet(&dict);
+  keys->addMultiple({1, 2, 3});
+
+  token = epochs.store(keys);
+  EXPECT_NE(token, 0);
+  EXPECT_EQ(epochs.size(), 1);
+
+  // Snapshots keep their keys alive in the dictionary
+  EXPECT_NE(dict.find(2), CacheKeyDictionary::NoIndex);
+
+  EXPECT_EQ(epochs.take(token + 1), nullptr);
+  EXPECT_EQ(epochs.take(0), nullptr);
+
+  keys = epochs.take(token);
+  ASSERT_NE(keys, nullptr);
+  EXPECT_EQ(keys->size(), 3);
+  EXPECT_TRUE(keys->has(2));
+  delete keys;
+
+  // Tokens can only be used once
+  EXPECT_EQ(epochs.take(token), nullptr);
+  EXPECT_EQ(dict.find(2), CacheKeyDictionary::NoIndex);
+}
+
+TEST(CacheEpochStore, DropsOldest) {
+  CacheKeyDictionary dict;
+  CacheEpochStore epochs(&dict);
+  std::vector<uint64_t> tokens;
+  KnownKeySet* keys;
+
+  for (size_t i = 0; i < CacheEpochStore::MaxSnapshots + 1; i++) {
+    keys = new KnownKeySet(&dict);
+    keys->add(i);
+    tokens.push_back(epochs.store(keys));
+  }
+
+  EXPECT_EQ(epochs.size(), CacheEpochStore::MaxSnapshots);
+  EXPECT_EQ(epochs.take(tokens.front()), nullptr);
+
+  keys = epochs.take(tokens.back());
+  ASSERT_NE(keys, nullptr);
+  EXPECT_TRUE(keys->has(CacheEpochStore::MaxSnapshots));
+  delete keys;
+}
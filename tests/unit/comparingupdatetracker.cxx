@@ -0,0 +1,125 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include <rfb/ComparingUpdateTracker.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/ServerCore.h>
+
+using namespace rfb;
+
+static const PixelFormat fbPF(32, 24, false, true, 255, 255, 255, 0, 8, 16);
+
+static void setPixel(ManagedPixelBuffer* pb, int x, int y, uint32_t value) {
+  core::Rect r(x, y, x + 1, y + 1);
+  pb->fillRect(r, &value);
+}
+
+static core::Region runCompare(ManagedPixelBuffer* pb, ComparingUpdateTracker* comparer) {
+  UpdateInfo ui;
+
+  comparer->add_changed(pb->getRect());
+  comparer->compare();
+  comparer->getUpdateInfo(&ui, pb->getRect());
+  comparer->clear();
+
+  return ui.changed;
+}
+
+TEST(ComparingUpdateTracker, UnchangedFramebuffer) {
+  ManagedPixelBuffer pb(fbPF, 256, 256);
+  ComparingUpdateTracker comparer(&pb);
+
+  comparer.compare();
+  comparer.clear();
+
+  EXPECT_TRUE(runCompare(&pb, &comparer).is_empty());
+}
+
+TEST(ComparingUpdateTracker, SinglePixelIsCropped) {
+  ManagedPixelBuffer pb(fbPF, 256, 256);
+  ComparingUpdateTracker comparer(&pb);
+
+  comparer.compare();
+  comparer.clear();
+
+  setPixel(&pb, 100, 70, 0xffffff);
+
+  // Cropping happens in steps of 8 pixels from each block edge
+  core::Region changed = runCompare(&pb, &comparer);
+  EXPECT_EQ(changed, core::Region({96, 70, 104, 71}));
+
+  // The old copy must have been brought up to date
+  EXPECT_TRUE(runCompare(&pb, &comparer).is_empty());
+}
+
+TEST(ComparingUpdateTracker, RowsWithinBlock) {
+  ManagedPixelBuffer pb(fbPF, 256, 256);
+  ComparingUpdateTracker comparer(&pb);
+
+  comparer.compare();
+  comparer.clear();
+
+  setPixel(&pb, 130, 5, 0x123456);
+  setPixel(&pb, 190, 40, 0x654321);
+
+  core::Region changed = runCompare(&pb, &comparer);
+  EXPECT_EQ(changed, core::Region({128, 5, 192, 41}));
+}
+
+TEST(ComparingUpdateTracker, ThreadedMatchesSerial) {
+  ManagedPixelBuffer serialPb(fbPF, 1920, 1080);
+  ManagedPixelBuffer threadedPb(fbPF, 1920, 1080);
+
+  Server::compareFBThreads.setParam(1);
+  ComparingUpdateTracker serial(&serialPb);
+  Server::compareFBThreads.setParam(4);
+  ComparingUpdateTracker threaded(&threadedPb);
+
+  serial.compare();
+  serial.clear();
+  threaded.compare();
+  threaded.clear();
+
+  srand(1);
+  for (int frame = 0; frame < 10; frame++) {
+    for (int i = 0; i < 40; i++) {
+      int x = rand() % serialPb.width();
+      int y = rand() % serialPb.height();
+      uint32_t value = rand();
+      setPixel(&serialPb, x, y, value);
+      setPixel(&threadedPb, x, y, value);
+    }
+
+    core::Region expected = runCompare(&serialPb, &serial);
+    core::Region actual = runCompare(&threadedPb, &threaded);
+
+    EXPECT_FALSE(expected.is_empty());
+    EXPECT_EQ(expected, actual);
+  }
+
+  Server::compareFBThreads.setParam(0);
+}
@@ -20,13 +20,17 @@
 #include <config.h>
 #endif
 
+#include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
 #include <list>
+#include <vector>
 
 #include <gtest/gtest.h>
 
 #include <rfb/PixelFormat.h>
+#include <rfb/PixelFormatSIMD.h>
 
 static const uint8_t pixelRed = 0xf1;
 static const uint8_t pixelGreen = 0xc3;
@@ -256,6 +260,66 @@ TEST_P(Conv, pixelToFromRGB) {
   verifyPixel(dstpf, srcpf, buffer);
 }
 
+TEST_P(Conv, kernelsMatchScalar) {
+  // Odd sizes, so that the kernels always leave something for the
+  // scalar code, and enough pixels to cover most channel values
+  const int w = 250, h = 4, stride = 253;
+  const int size = stride * h * 4 + 1;
+
+  std::vector<uint8_t> src(size), rgb(size);
+  std::vector<uint8_t> expected(size), actual(size);
+
+  const rfb::PixelFormat& srcpf = GetParam().first;
+  const rfb::PixelFormat& dstpf = GetParam().second;
+
+  srand(1);
+  for (int i = 0; i < size; i++) {
+    src[i] = rand();
+    rgb[i] = rand();
+  }
+
+  for (rfb::ConvKernels kernels : {rfb::convSSE2, rfb::convAVX2, rfb::convNEON}) {
+    if (!rfb::convKernelsSupported(kernels))
+      continue;
+
+    SCOPED_TRACE(rfb::convKernelsName(kernels));
+
+    for (int unaligned = 0; unaligned < 2; unaligned++) {
+      rfb::setConvKernels(rfb::convScalar);
+      std::fill(expected.begin(), expected.end(), 0);
+      dstpf.bufferFromBuffer(&expected[unaligned], srcpf, &src[unaligned], w, h, stride, stride);
+
+      rfb::setConvKernels(kernels);
+      std::fill(actual.begin(), actual.end(), 0);
+      dstpf.bufferFromBuffer(&actual[unaligned], srcpf, &src[unaligned], w, h, stride, stride);
+
+      EXPECT_EQ(expected, actual) << "bufferFromBuffer";
+
+      rfb::setConvKernels(rfb::convScalar);
+      std::fill(expected.begin(), expected.end(), 0);
+      srcpf.rgbFromBuffer(&expected[unaligned], &src[unaligned], w, stride, h);
+
+      rfb::setConvKernels(kernels);
+      std::fill(actual.begin(), actual.end(), 0);
+      srcpf.rgbFromBuffer(&actual[unaligned], &src[unaligned], w, stride, h);
+
+      EXPECT_EQ(expected, actual) << "rgbFromBuffer";
+
+      rfb::setConvKernels(rfb::convScalar);
+      std::fill(expected.begin(), expected.end(), 0);
+      dstpf.bufferFromRGB(&expected[unaligned], &rgb[unaligned], w, stride, h);
+
+      rfb::setConvKernels(kernels);
+      std::fill(actual.begin(), actual.end(), 0);
+      dstpf.bufferFromRGB(&actual[unaligned], &rgb[unaligned], w, stride, h);
+
+      EXPECT_EQ(expected, actual) << "bufferFromRGB";
+    }
+  }
+
+  rfb::setConvKernels(rfb::convBestKernels());
+}
+
 static std::list<TestPair> paramGenerator() {
   std::list<TestPair> params;
   rfb::PixelFormat dstpf, srcpf;
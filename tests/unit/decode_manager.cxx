@@ -7,13 +7,27 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
+#include <stdlib.h>
+#include <string.h>
+
 #include <core/Configuration.h>
+#include <rdr/MemInStream.h>
+#include <rdr/MemOutStream.h>
+#include <rfb/CConnection.h>
+#include <rfb/CMsgWriter.h>
 #include <rfb/DecodeManager.h>
+#include <rfb/GlobalClientPersistentCache.h>
+#include <rfb/SMsgHandler.h>
+#include <rfb/SMsgReader.h>
+#include <rfb/msgTypes.h>
 
 using namespace rfb;
 
 // Test-scoped parameters that Configuration::getParam() will see.
 static core::BoolParameter gPersistentCacheParam("PersistentCache", "Enable PersistentCache in client", true);
+static core::StringParameter gPersistentCachePathParam("PersistentCachePath", "PersistentCache directory", "");
 
 namespace {
 
@@ -36,6 +50,170 @@ TEST(DecodeManagerGating, PersistentCacheEnabledConstructsEngine) {
   EXPECT_NE(dm.getPersistentCacheForTest(), nullptr);
 }
 
+// Only what is needed to give DecodeManager a writer and a server name
+class TestConnection : public CConnection {
+public:
+  TestConnection(rdr::OutStream* out) {
+    setServerName("legacy.example.com::5901");
+    setWriter(new CMsgWriter(&server, out));
+  }
+
+  void initDone() override {}
+  void framebufferUpdateStart() override {}
+  void framebufferUpdateEnd() override {}
+  void setColourMapEntries(int, int, uint16_t*) override {}
+  void bell() override {}
+  void serverCutText(const char*) override {}
+  void getUserPasswd(bool, std::string*, std::string*) override {}
+  bool showMsgBox(MsgBoxFlags, const char*, const char*) override { return true; }
+};
+
+// Records which kind of advertisement the viewer sent
+class AdvertisementHandler : public SMsgHandler {
+public:
+  std::vector<uint64_t> hashListIds;
+  std::vector<uint64_t> idListIds;
+  int idLists = 0;
+  uint8_t idListFlags = 0;
+  uint64_t idListToken = 0;
+
+  void handlePersistentHashList(uint32_t, uint16_t, uint16_t, const std::vector<uint64_t>& ids) override {
+    hashListIds.insert(hashListIds.end(), ids.begin(), ids.end());
+  }
+  void handlePersistentIdList(uint8_t flags, uint64_t baseToken, uint16_t, uint16_t,
+                              const std::vector<uint64_t>& ids) override {
+    idLists++;
+    idListFlags = flags;
+    idListToken = baseToken;
+    idListIds.insert(idListIds.end(), ids.begin(), ids.end());
+  }
+
+  void clientInit(bool) override {}
+  void setPixelFormat(const PixelFormat&) override {}
+  void setEncodings(int, const int32_t*) override {}
+  void framebufferUpdateRequest(const core::Rect&, bool) override {}
+  void setDesktopSize(int, int, const ScreenSet&) override {}
+  void fence(uint32_t, unsigned, const uint8_t*) override {}
+  void enableContinuousUpdates(bool, int, int, int, int) override {}
+  void keyEvent(uint32_t, uint32_t, bool) override {}
+  void pointerEvent(const core::Point&, uint16_t) override {}
+  void clientCutText(const char*) override {}
+  void handleClipboardCaps(uint32_t, const uint32_t*) override {}
+  void handleClipboardRequest(uint32_t) override {}
+  void handleClipboardPeek() override {}
+  void handleClipboardNotify(uint32_t) override {}
+  void handleClipboardProvide(uint32_t, const size_t*, const uint8_t* const*) override {}
+  void handlePersistentCacheQuery(const std::vector<uint64_t>&) override {}
+  void handlePersistentCacheEviction(const std::vector<uint64_t>&) override {}
+  void handlePersistentCacheHashReport(const CacheKey&, const CacheKey&) override {}
+  void handleDebugDumpRequest(uint32_t) override {}
+};
+
+static void readAdvertisement(rdr::MemOutStream* out, AdvertisementHandler* handler) {
+  rdr::MemInStream in(out->data(), out->length());
+  SMsgReader reader(handler, &in);
+
+  while (in.avail() > 0)
+    ASSERT_TRUE(reader.readMsg());
+}
+
+// A cache directory holding a few entries, as left by an earlier session
+static std::string makeCacheDir(std::vector<uint64_t>* ids) {
+  char tmpl[] = "/tmp/tigervnc_dm_advertise_XXXXXX";
+  char* dir = mkdtemp(tmpl);
+  if (dir == nullptr)
+    return "";
+
+  PixelFormat pf(32, 24, false, true, 255, 255, 255, 16, 8, 0);
+  std::vector<uint8_t> pixels(16 * 16 * 4, 0x55);
+  GlobalClientPersistentCache cache(1, 1, 1, dir);
+
+  for (uint64_t id = 1; id <= 3; id++) {
+    std::vector<uint8_t> hash(16, 0);
+    memcpy(hash.data(), &id, sizeof(id));
+    cache.insert(id, id, hash, pixels.data(), pf, 16, 16, 16, true);
+    ids->push_back(id);
+  }
+  cache.flushDirtyEntries();
+  cache.saveToDisk();
+
+  return dir;
+}
+
+static void removeCacheDir(const std::string& dir) {
+  std::string cmd = "rm -rf \"" + dir + "\"";
+  int ret = system(cmd.c_str());
+  (void)ret;
+}
+
+TEST(DecodeManagerAdvertise, UnknownServerGetsHashList) {
+  std::vector<uint64_t> ids;
+  std::string dir = makeCacheDir(&ids);
+  ASSERT_FALSE(dir.empty());
+
+  gPersistentCacheParam.setParam(true);
+  gPersistentCachePathParam.setParam(dir.c_str());
+
+  rdr::MemOutStream out;
+  TestConnection conn(&out);
+  DecodeManager dm(&conn);
+
+  dm.triggerPersistentCacheLoad();
+  dm.advertisePersistentCacheHashes();
+
+  // Older servers drop the connection on an ID list, so nothing but a
+  // HashList may be sent until the server has proven it knows better
+  AdvertisementHandler handler;
+  readAdvertisement(&out, &handler);
+
+  EXPECT_EQ(handler.idLists, 0);
+  std::sort(handler.hashListIds.begin(), handler.hashListIds.end());
+  EXPECT_EQ(handler.hashListIds, ids);
+
+  removeCacheDir(dir);
+}
+
+TEST(DecodeManagerAdvertise, KnownServerGetsIdListDelta) {
+  std::vector<uint64_t> ids;
+  std::string dir = makeCacheDir(&ids);
+  ASSERT_FALSE(dir.empty());
+
+  gPersistentCacheParam.setParam(true);
+  gPersistentCachePathParam.setParam(dir.c_str());
+
+  // First session: the server answers the HashList with an epoch
+  {
+    rdr::MemOutStream out;
+    TestConnection conn(&out);
+    DecodeManager dm(&conn);
+
+    dm.triggerPersistentCacheLoad();
+    dm.advertisePersistentCacheHashes();
+    dm.setPersistentCacheEpoch(0x1234);
+  }
+
+  // Second session: only the (empty) difference is sent, as an ID list
+  {
+    rdr::MemOutStream out;
+    TestConnection conn(&out);
+    DecodeManager dm(&conn);
+
+    dm.triggerPersistentCacheLoad();
+    dm.advertisePersistentCacheHashes();
+
+    AdvertisementHandler handler;
+    readAdvertisement(&out, &handler);
+
+    EXPECT_TRUE(handler.hashListIds.empty());
+    EXPECT_EQ(handler.idLists, 1);
+    EXPECT_EQ(handler.idListFlags, idListFlagDelta);
+    EXPECT_EQ(handler.idListToken, 0x1234u);
+    EXPECT_TRUE(handler.idListIds.empty());
+  }
+
+  removeCacheDir(dir);
+}
+
 } // namespace
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,171 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include <rfb/ClientParams.h>
+#include <rfb/EncodeController.h>
+
+using rfb::EncodeController;
+
+// Reports updates that take the given time to encode and to send
+static void run(EncodeController* controller, int updates, unsigned encodeMs, unsigned sendMs) {
+  for (int i = 0; i < updates; i++)
+    controller->noteUpdate(encodeMs * 1000, sendMs * 1000, 1000000, 16);
+}
+
+TEST(EncodeController, ClientSettingsByDefault) {
+  EncodeController controller;
+
+  controller.setClientSettings(-1, 8, -1, rfb::subsampleUndefined);
+
+  EXPECT_EQ(controller.compressLevel(), -1);
+  EXPECT_EQ(controller.qualityLevel(), 8);
+  EXPECT_EQ(controller.fineQualityLevel(), -1);
+  EXPECT_EQ(controller.subsampling(), rfb::subsampleUndefined);
+  EXPECT_FALSE(controller.preferLossless());
+
+  // Within budget, but not by enough to change anything
+  run(&controller, 100, 6, 6);
+
+  EXPECT_EQ(controller.compressLevel(), -1);
+  EXPECT_EQ(controller.qualityLevel(), 8);
+  EXPECT_FALSE(controller.preferLossless());
+}
+
+TEST(EncodeController, EncodingLowersCompressionFirst) {
+  EncodeController controller;
+
+  controller.setClientSettings(6, 8, -1, rfb::subsampleUndefined);
+
+  run(&controller, 4, 30, 1);
+  EXPECT_EQ(controller.compressLevel(), 5);
+  EXPECT_EQ(controller.qualityLevel(), 8);
+
+  run(&controller, 100, 30, 1);
+  EXPECT_EQ(controller.compressLevel(), 3);
+  EXPECT_EQ(controller.qualityLevel(), 5);
+}
+
+TEST(EncodeController, SendingLowersQualityFirst) {
+  EncodeController controller;
+
+  controller.setClientSettings(6, 8, -1, rfb::subsampleUndefined);
+
+  run(&controller, 4, 1, 40);
+  EXPECT_EQ(controller.compressLevel(), 6);
+  EXPECT_EQ(controller.qualityLevel(), 7);
+
+  run(&controller, 100, 1, 40);
+  EXPECT_EQ(controller.qualityLevel(), 5);
+  EXPECT_EQ(controller.compressLevel(), 9);
+}
+
+TEST(EncodeController, HeadroomRestoresClientSettings) {
+  EncodeController controller;
+
+  controller.setClientSettings(2, 8, -1, rfb::subsampleUndefined);
+
+  run(&controller, 100, 30, 1);
+  EXPECT_LT(controller.compressLevel(), 2);
+  EXPECT_LT(controller.qualityLevel(), 8);
+
+  run(&controller, 100, 1, 1);
+  EXPECT_EQ(controller.compressLevel(), 2);
+  EXPECT_EQ(controller.qualityLevel(), 8);
+  EXPECT_TRUE(controller.preferLossless());
+
+  // Lossless is the first thing to go once it gets tight again
+  run(&controller, 4, 1, 40);
+  EXPECT_FALSE(controller.preferLossless());
+  EXPECT_EQ(controller.qualityLevel(), 8);
+
+  controller.reset();
+  EXPECT_EQ(controller.compressLevel(), 2);
+  EXPECT_EQ(controller.qualityLevel(), 8);
+  EXPECT_FALSE(controller.preferLossless());
+}
+
+TEST(EncodeController, LosslessBacksOff) {
+  EncodeController controller;
+
+  controller.setClientSettings(2, 8, -1, rfb::subsampleUndefined);
+
+  run(&controller, 4, 1, 1);
+  EXPECT_TRUE(controller.preferLossless());
+
+  run(&controller, 4, 1, 400);
+  EXPECT_FALSE(controller.preferLossless());
+
+  // Plenty of headroom again, but not for long enough
+  run(&controller, 8, 1, 1);
+  EXPECT_FALSE(controller.preferLossless());
+
+  run(&controller, 20, 1, 1);
+  EXPECT_TRUE(controller.preferLossless());
+
+  // The second failure makes it wait twice as long
+  run(&controller, 4, 1, 400);
+  EXPECT_FALSE(controller.preferLossless());
+
+  run(&controller, 24, 1, 1);
+  EXPECT_FALSE(controller.preferLossless());
+
+  run(&controller, 12, 1, 1);
+  EXPECT_TRUE(controller.preferLossless());
+}
+
+TEST(EncodeController, NoJpegWithoutClient) {
+  EncodeController controller;
+
+  controller.setClientSettings(2, -1, -1, rfb::subsampleUndefined);
+
+  run(&controller, 100, 1, 40);
+  EXPECT_EQ(controller.qualityLevel(), -1);
+  EXPECT_EQ(controller.compressLevel(), 5);
+
+  run(&controller, 100, 1, 1);
+  EXPECT_EQ(controller.compressLevel(), 2);
+  EXPECT_FALSE(controller.preferLossless());
+}
+
+TEST(EncodeController, FineQualityAndSubsampling) {
+  EncodeController controller;
+
+  controller.setClientSettings(2, -1, 90, rfb::subsampleNone);
+
+  run(&controller, 4, 1, 40);
+  EXPECT_EQ(controller.fineQualityLevel(), 80);
+  EXPECT_EQ(controller.subsampling(), rfb::subsampleNone);
+
+  run(&controller, 4, 1, 40);
+  EXPECT_EQ(controller.fineQualityLevel(), 70);
+  EXPECT_EQ(controller.subsampling(), rfb::subsample2X);
+
+  run(&controller, 4, 1, 40);
+  EXPECT_EQ(controller.fineQualityLevel(), 60);
+  EXPECT_EQ(controller.subsampling(), rfb::subsample4X);
+
+  // Grayscale is never touched
+  controller.setClientSettings(2, -1, 90, rfb::subsampleGray);
+  EXPECT_EQ(controller.subsampling(), rfb::subsampleGray);
+}
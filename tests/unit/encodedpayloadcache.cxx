@@ -0,0 +1,99 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include <rfb/CacheKey.h>
+#include <rfb/PixelFormat.h>
+#include <rfb/RREEncoder.h>
+#include <rfb/RawEncoder.h>
+#include <rfb/cache/EncodedPayloadCache.h>
+
+using namespace rfb;
+
+static const PixelFormat nativePF(32, 24, false, true, 255, 255, 255, 16, 8, 0);
+static const PixelFormat clientPF(16, 16, false, true, 31, 63, 31, 11, 5, 0);
+
+static CacheKey makeContent(uint8_t seed) {
+  CacheKey key;
+  key.bytes.fill(seed);
+  return key;
+}
+
+TEST(EncodedPayloadCache, RoundTrip) {
+  cache::EncodedPayloadCache payloadCache(1024 * 1024);
+  RawEncoder encoder(nullptr);
+  std::string key;
+  std::vector<uint8_t> data;
+  unsigned encodeUs;
+  const uint8_t payload[] = {1, 2, 3, 4, 5};
+
+  key = cache::EncodedPayloadCache::makeKey(makeContent(1), nativePF, clientPF, &encoder);
+
+  EXPECT_FALSE(payloadCache.lookup(key, &data, &encodeUs));
+
+  payloadCache.insert(key, payload, sizeof(payload), 1234);
+
+  ASSERT_TRUE(payloadCache.lookup(key, &data, &encodeUs));
+  EXPECT_EQ(data, std::vector<uint8_t>(payload, payload + sizeof(payload)));
+  EXPECT_EQ(encodeUs, 1234U);
+}
+
+TEST(EncodedPayloadCache, KeyCoversParameters) {
+  RawEncoder raw(nullptr);
+  RREEncoder rre(nullptr);
+  std::string key;
+
+  key = cache::EncodedPayloadCache::makeKey(makeContent(1), nativePF, clientPF, &raw);
+
+  EXPECT_EQ(key, cache::EncodedPayloadCache::makeKey(makeContent(1), nativePF, clientPF, &raw));
+  EXPECT_NE(key, cache::EncodedPayloadCache::makeKey(makeContent(2), nativePF, clientPF, &raw));
+  EXPECT_NE(key, cache::EncodedPayloadCache::makeKey(makeContent(1), nativePF, nativePF, &raw));
+  EXPECT_NE(key, cache::EncodedPayloadCache::makeKey(makeContent(1), clientPF, clientPF, &raw));
+  EXPECT_NE(key, cache::EncodedPayloadCache::makeKey(makeContent(1), nativePF, clientPF, &rre));
+}
+
+TEST(EncodedPayloadCache, BoundedBySize) {
+  cache::EncodedPayloadCache payloadCache(64 * 1024);
+  RawEncoder encoder(nullptr);
+  std::vector<uint8_t> payload(16 * 1024);
+  std::vector<uint8_t> data;
+  unsigned encodeUs;
+  int found;
+
+  for (int i = 0; i < 16; i++) {
+    std::string key;
+    key = cache::EncodedPayloadCache::makeKey(makeContent(i), nativePF, clientPF, &encoder);
+    payloadCache.insert(key, payload.data(), payload.size(), 0);
+  }
+
+  found = 0;
+  for (int i = 0; i < 16; i++) {
+    std::string key;
+    key = cache::EncodedPayloadCache::makeKey(makeContent(i), nativePF, clientPF, &encoder);
+    if (payloadCache.lookup(key, &data, &encodeUs))
+      found++;
+  }
+
+  EXPECT_GT(found, 0);
+  EXPECT_LE(found, 4);
+}
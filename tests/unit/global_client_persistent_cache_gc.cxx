@@ -252,3 +252,36 @@ TEST(GlobalClientPersistentCache, GcReclaimsPartiallyColdShards) {
 
   removeDirRecursive(cacheDir);
 }
+
+// The epoch a server hands out must survive a restart of the viewer, and
+// be kept apart from other servers' epochs.
+TEST(GlobalClientPersistentCache, EpochRoundTrip) {
+  char tmpl[] = "/tmp/tigervnc_pcache_test_XXXXXX";
+  char* dir = mkdtemp(tmpl);
+  ASSERT_NE(dir, nullptr);
+
+  std::string cacheDir(dir);
+  std::vector<uint64_t> ids = {3, 17, 0x8000000000000000ULL, UINT64_MAX};
+
+  {
+    rfb::GlobalClientPersistentCache cache(1, 1, 1, cacheDir);
+    ASSERT_TRUE(cache.saveEpoch("host:1", 0x1234, ids));
+  }
+
+  {
+    rfb::GlobalClientPersistentCache cache(1, 1, 1, cacheDir);
+    std::vector<uint64_t> loaded;
+    uint64_t token;
+
+    EXPECT_FALSE(cache.loadEpoch("host:2", &token, &loaded));
+
+    ASSERT_TRUE(cache.loadEpoch("host:1", &token, &loaded));
+    EXPECT_EQ(token, 0x1234u);
+    EXPECT_EQ(loaded, ids);
+
+    cache.clearEpoch("host:1");
+    EXPECT_FALSE(cache.loadEpoch("host:1", &token, &loaded));
+  }
+
+  removeDirRecursive(cacheDir);
+}
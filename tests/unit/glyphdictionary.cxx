@@ -0,0 +1,211 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <rfb/cache/GlyphDictionary.h>
+
+using namespace rfb::cache;
+
+static std::vector<uint8_t> makeGlyph(uint8_t value, size_t length) {
+  return std::vector<uint8_t>(length, value);
+}
+
+static GlyphLayout makeLayout(int width, int height, int ox, int oy) {
+  GlyphLayout layout;
+
+  layout.width = width;
+  layout.height = height;
+  layout.cellW = 8;
+  layout.cellH = 16;
+  layout.ox = ox;
+  layout.oy = oy;
+  layout.bytesPerPixel = 4;
+
+  return layout;
+}
+
+// Fills the cells of a rect with a few distinct glyphs and the rest
+// with noise
+static std::vector<uint8_t> makeText(const GlyphLayout& layout, std::vector<uint16_t>* cells,
+                                     std::vector<std::pair<uint16_t, int>>* newGlyphs) {
+  std::vector<uint8_t> pixels((size_t)layout.width * layout.height * layout.bytesPerPixel);
+  size_t stride;
+
+  srand(1);
+  for (uint8_t& byte : pixels)
+    byte = rand();
+
+  stride = (size_t)layout.width * layout.bytesPerPixel;
+
+  cells->clear();
+  newGlyphs->clear();
+  for (int cell = 0; cell < layout.columns() * layout.rows(); cell++) {
+    int glyph;
+    uint8_t* dst;
+
+    glyph = cell % 3;
+    if (cell < 3)
+      newGlyphs->push_back(std::make_pair((uint16_t)(10 + glyph), cell));
+    cells->push_back(10 + glyph);
+
+    dst = pixels.data() + (size_t)(layout.oy + cell / layout.columns() * layout.cellH) * stride +
+          (size_t)(layout.ox + cell % layout.columns() * layout.cellW) * layout.bytesPerPixel;
+    for (int y = 0; y < layout.cellH; y++)
+      memset(dst + y * stride, 0x40 * (glyph + 1), layout.cellW * layout.bytesPerPixel);
+  }
+
+  return pixels;
+}
+
+TEST(GlyphDictionary, FindsExactContent) {
+  GlyphDictionary dict(16);
+  std::vector<uint8_t> a = makeGlyph(1, 512);
+  std::vector<uint8_t> b = makeGlyph(2, 512);
+  int index;
+
+  EXPECT_EQ(dict.find(100, a.data(), a.size()), -1);
+
+  index = dict.add(100, a.data(), a.size());
+  EXPECT_EQ(dict.find(100, a.data(), a.size()), index);
+  EXPECT_EQ(dict.size(), 1U);
+
+  // Same hash but other content must not match
+  EXPECT_EQ(dict.find(100, b.data(), b.size()), -1);
+
+  dict.clear();
+  EXPECT_EQ(dict.size(), 0U);
+  EXPECT_EQ(dict.find(100, a.data(), a.size()), -1);
+}
+
+TEST(GlyphDictionary, ReusesLeastRecentlyUsedIndex) {
+  GlyphDictionary dict(2);
+  std::vector<uint8_t> a = makeGlyph(1, 64);
+  std::vector<uint8_t> b = makeGlyph(2, 64);
+  std::vector<uint8_t> c = makeGlyph(3, 64);
+  int ia, ib, ic;
+
+  ia = dict.add(1, a.data(), a.size());
+  ib = dict.add(2, b.data(), b.size());
+  EXPECT_NE(ia, ib);
+
+  dict.touch(ia);
+
+  ic = dict.add(3, c.data(), c.size());
+  EXPECT_EQ(ic, ib);
+  EXPECT_EQ(dict.size(), 2U);
+  EXPECT_EQ(dict.find(1, a.data(), a.size()), ia);
+  EXPECT_EQ(dict.find(2, b.data(), b.size()), -1);
+  EXPECT_EQ(dict.find(3, c.data(), c.size()), ic);
+}
+
+TEST(GlyphDictionary, SizeIsClamped) {
+  GlyphDictionary dict(1000000);
+
+  EXPECT_EQ(dict.maxGlyphs(), (size_t)GlyphDictionary::MaxGlyphs);
+}
+
+TEST(GlyphTable, RejectsBadIndices) {
+  GlyphTable table;
+  std::vector<uint8_t> a = makeGlyph(1, 64);
+
+  EXPECT_FALSE(table.set(-1, a.data(), a.size()));
+  EXPECT_FALSE(table.set(GlyphDictionary::MaxGlyphs, a.data(), a.size()));
+  EXPECT_TRUE(table.set(5, a.data(), a.size()));
+
+  EXPECT_EQ(table.size(), 1U);
+  EXPECT_NE(table.get(5, a.size()), nullptr);
+  EXPECT_EQ(table.get(4, a.size()), nullptr);
+  EXPECT_EQ(table.get(5, a.size() * 2), nullptr);
+
+  table.clear();
+  EXPECT_EQ(table.get(5, a.size()), nullptr);
+}
+
+TEST(GlyphRect, RoundTrip) {
+  GlyphLayout layout = makeLayout(8 * 10 + 5, 16 * 3 + 7, 3, 2);
+  std::vector<uint16_t> cells;
+  std::vector<std::pair<uint16_t, int>> newGlyphs;
+  std::vector<uint8_t> pixels, data, decoded;
+  GlyphTable table;
+
+  pixels = makeText(layout, &cells, &newGlyphs);
+  ASSERT_EQ(cells.size(), 30U);
+
+  encodeGlyphRect(layout, pixels.data(), cells, newGlyphs, 6, &data);
+
+  // Mostly repeated glyphs, so well below the raw size
+  EXPECT_LT(data.size(), pixels.size() / 2);
+
+  decoded.resize(pixels.size());
+  ASSERT_TRUE(decodeGlyphRect(layout, data.data(), data.size(), &table, decoded.data()));
+  EXPECT_EQ(decoded, pixels);
+  EXPECT_EQ(table.size(), 3U);
+
+  // The glyphs are now known, so a second rect can just refer to them
+  newGlyphs.clear();
+  encodeGlyphRect(layout, pixels.data(), cells, newGlyphs, 6, &data);
+  std::fill(decoded.begin(), decoded.end(), 0);
+  ASSERT_TRUE(decodeGlyphRect(layout, data.data(), data.size(), &table, decoded.data()));
+  EXPECT_EQ(decoded, pixels);
+}
+
+TEST(GlyphRect, RejectsUnknownGlyph) {
+  GlyphLayout layout = makeLayout(8 * 4, 16, 0, 0);
+  std::vector<uint16_t> cells;
+  std::vector<std::pair<uint16_t, int>> newGlyphs;
+  std::vector<uint8_t> pixels, data, decoded;
+  GlyphTable table;
+
+  pixels = makeText(layout, &cells, &newGlyphs);
+  newGlyphs.clear();
+
+  encodeGlyphRect(layout, pixels.data(), cells, newGlyphs, 6, &data);
+
+  decoded.resize(pixels.size());
+  EXPECT_FALSE(decodeGlyphRect(layout, data.data(), data.size(), &table, decoded.data()));
+}
+
+TEST(GlyphRect, RejectsTruncatedPayload) {
+  GlyphLayout layout = makeLayout(8 * 4, 16, 0, 0);
+  std::vector<uint16_t> cells;
+  std::vector<std::pair<uint16_t, int>> newGlyphs;
+  std::vector<uint8_t> pixels, data, decoded;
+  GlyphTable table;
+
+  pixels = makeText(layout, &cells, &newGlyphs);
+
+  encodeGlyphRect(layout, pixels.data(), cells, newGlyphs, 6, &data);
+
+  decoded.resize(pixels.size());
+  EXPECT_FALSE(decodeGlyphRect(layout, data.data(), data.size() / 2, &table, decoded.data()));
+
+  // A rect with a different shape doesn't match the payload either
+  layout.width += 8;
+  decoded.resize((size_t)layout.width * layout.height * layout.bytesPerPixel);
+  EXPECT_FALSE(decodeGlyphRect(layout, data.data(), data.size(), &table, decoded.data()));
+}
@@ -0,0 +1,132 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include <rfb/cache/IdListCodec.h>
+
+using namespace rfb::cache;
+
+static std::vector<uint64_t> randomIds(size_t count, unsigned seed) {
+  std::mt19937_64 random(seed);
+  std::vector<uint64_t> ids;
+
+  for (size_t i = 0; i < count; i++)
+    ids.push_back(random());
+  sortIds(&ids);
+
+  return ids;
+}
+
+static std::vector<uint8_t> encode(const std::vector<uint64_t>& ids, uint8_t* riceBits) {
+  std::vector<uint8_t> data;
+
+  *riceBits = chooseRiceBits(ids.data(), ids.size());
+  encodeIdList(ids.data(), ids.size(), *riceBits, &data);
+
+  return data;
+}
+
+TEST(IdListCodec, SortIds) {
+  std::vector<uint64_t> ids = {5, 3, 5, 1, 3};
+
+  sortIds(&ids);
+  EXPECT_EQ(ids, std::vector<uint64_t>({1, 3, 5}));
+}
+
+TEST(IdListCodec, RandomRoundTrip) {
+  for (size_t count : {1, 2, 100, 65536}) {
+    std::vector<uint64_t> ids, decoded;
+    std::vector<uint8_t> data;
+    uint8_t riceBits;
+
+    ids = randomIds(count, count);
+    data = encode(ids, &riceBits);
+
+    EXPECT_LE(data.size(), maxIdListLength(ids.size()));
+    ASSERT_TRUE(decodeIdList(data.data(), data.size(), ids.size(), riceBits, &decoded));
+    EXPECT_EQ(decoded, ids);
+  }
+}
+
+TEST(IdListCodec, Compression) {
+  std::vector<uint64_t> ids;
+  std::vector<uint8_t> data;
+  uint8_t riceBits;
+
+  ids = randomIds(65536, 1);
+  data = encode(ids, &riceBits);
+
+  // About 66 - log2(count) = 50 bits per ID
+  EXPECT_LT(data.size(), ids.size() * 52 / 8);
+}
+
+TEST(IdListCodec, Extremes) {
+  std::vector<uint64_t> ids = {0, 1, 2, 1000, UINT64_MAX - 1, UINT64_MAX};
+  std::vector<uint64_t> decoded;
+  std::vector<uint8_t> data;
+
+  // A small parameter forces the huge gaps through the escape path
+  for (uint8_t riceBits : {0, 4, 63}) {
+    data.clear();
+    encodeIdList(ids.data(), ids.size(), riceBits, &data);
+    EXPECT_LE(data.size(), maxIdListLength(ids.size()));
+    ASSERT_TRUE(decodeIdList(data.data(), data.size(), ids.size(), riceBits, &decoded));
+    EXPECT_EQ(decoded, ids);
+  }
+}
+
+TEST(IdListCodec, Empty) {
+  std::vector<uint64_t> decoded = {1};
+  std::vector<uint8_t> data;
+
+  encodeIdList(nullptr, 0, 0, &data);
+  EXPECT_TRUE(data.empty());
+  EXPECT_TRUE(decodeIdList(data.data(), 0, 0, 0, &decoded));
+  EXPECT_TRUE(decoded.empty());
+}
+
+TEST(IdListCodec, Truncated) {
+  std::vector<uint64_t> ids, decoded;
+  std::vector<uint8_t> data;
+  uint8_t riceBits;
+
+  ids = randomIds(1000, 2);
+  data = encode(ids, &riceBits);
+
+  EXPECT_FALSE(decodeIdList(data.data(), data.size() - 8, ids.size(), riceBits, &decoded));
+  EXPECT_FALSE(decodeIdList(data.data(), data.size(), ids.size() * 100, riceBits, &decoded));
+}
+
+TEST(IdListCodec, Overflow) {
+  std::vector<uint8_t> data;
+  std::vector<uint64_t> decoded;
+
+  // UINT64_MAX followed by a gap of one
+  data.assign(8, 0xff);
+  data.push_back(0x00);
+
+  EXPECT_FALSE(decodeIdList(data.data(), data.size(), 2, 0, &decoded));
+  EXPECT_FALSE(decodeIdList(data.data(), data.size(), 2, 64, &decoded));
+}
@@ -0,0 +1,263 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+#include <gnutls/gnutls.h>
+
+#include <gtest/gtest.h>
+
+#include <rdr/FdInStream.h>
+#include <rdr/FdOutStream.h>
+#include <rdr/InStream.h>
+#include <rdr/TLSSocket.h>
+
+// TLS 1.2, so the kernel gets to do the receiving as well
+static const char* priority = "NORMAL:-VERS-ALL:+VERS-TLS1.2:+ANON-ECDH";
+
+static void connectPair(int* serverFd, int* clientFd) {
+  struct sockaddr_in addr;
+  socklen_t addrlen;
+  int listener;
+
+  *serverFd = *clientFd = -1;
+
+  listener = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(listener, 0);
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addrlen = sizeof(addr);
+
+  ASSERT_EQ(bind(listener, (struct sockaddr*)&addr, sizeof(addr)), 0);
+  ASSERT_EQ(listen(listener, 1), 0);
+  ASSERT_EQ(getsockname(listener, (struct sockaddr*)&addr, &addrlen), 0);
+
+  *clientFd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(*clientFd, 0);
+  ASSERT_EQ(connect(*clientFd, (struct sockaddr*)&addr, sizeof(addr)), 0);
+
+  *serverFd = accept(listener, nullptr, nullptr);
+  ASSERT_GE(*serverFd, 0);
+
+  close(listener);
+}
+
+static bool haveKernelTLS() {
+  int serverFd, clientFd;
+  bool ok;
+
+  connectPair(&serverFd, &clientFd);
+  if ((serverFd < 0) || (clientFd < 0))
+    return false;
+
+  ok = setsockopt(clientFd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == 0;
+
+  close(serverFd);
+  close(clientFd);
+
+  return ok;
+}
+
+static void waitFd(int fd) {
+  struct pollfd pfd;
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  poll(&pfd, 1, 100);
+}
+
+class Peer {
+public:
+  Peer(int fd_, bool server) : fd(fd_), in(fd_), out(fd_), anonServer(nullptr), anonClient(nullptr) {
+    gnutls_init(&session, server ? GNUTLS_SERVER : GNUTLS_CLIENT);
+    gnutls_priority_set_direct(session, priority, nullptr);
+
+    if (server) {
+      gnutls_anon_allocate_server_credentials(&anonServer);
+      gnutls_credentials_set(session, GNUTLS_CRD_ANON, anonServer);
+    } else {
+      gnutls_anon_allocate_client_credentials(&anonClient);
+      gnutls_credentials_set(session, GNUTLS_CRD_ANON, anonClient);
+    }
+
+    tls = new rdr::TLSSocket(&in, &out, session);
+  }
+
+  ~Peer() {
+    delete tls;
+    gnutls_deinit(session);
+    if (anonServer)
+      gnutls_anon_free_server_credentials(anonServer);
+    if (anonClient)
+      gnutls_anon_free_client_credentials(anonClient);
+    close(fd);
+  }
+
+  void handshake() {
+    while (!tls->handshake())
+      waitFd(fd);
+  }
+
+  void send(const std::string& data) {
+    tls->outStream().writeBytes((const uint8_t*)data.data(), data.size());
+    tls->outStream().flush();
+  }
+
+  std::string receive(size_t len) {
+    rdr::TLSInStream& is = tls->inStream();
+    std::string data;
+
+    while (data.size() < len) {
+      size_t count;
+
+      if (!is.hasData(1)) {
+        waitFd(fd);
+        continue;
+      }
+
+      count = std::min(len - data.size(), is.avail());
+      data.append((const char*)is.getptr(count), count);
+      is.setptr(count);
+    }
+
+    return data;
+  }
+
+  // Returns true if the stream ended cleanly
+  bool receiveEnd() {
+    try {
+      while (true) {
+        if (!tls->inStream().hasData(1))
+          waitFd(fd);
+        else
+          tls->inStream().skip(tls->inStream().avail());
+      }
+    } catch (rdr::end_of_stream&) {
+      return true;
+    } catch (std::exception& e) {
+      ADD_FAILURE() << e.what();
+      return false;
+    }
+  }
+
+  int fd;
+  rdr::FdInStream in;
+  rdr::FdOutStream out;
+  gnutls_session_t session;
+  gnutls_anon_server_credentials_t anonServer;
+  gnutls_anon_client_credentials_t anonClient;
+  rdr::TLSSocket* tls;
+};
+
+class KernelTLS : public ::testing::Test {
+protected:
+  void SetUp() override {
+    int serverFd, clientFd;
+
+    if (!haveKernelTLS())
+      GTEST_SKIP() << "Kernel has no TLS support";
+
+    connectPair(&serverFd, &clientFd);
+    ASSERT_GE(serverFd, 0);
+    ASSERT_GE(clientFd, 0);
+
+    // Only the server uses kernel TLS, the client is plain GnuTLS
+    server = new Peer(serverFd, true);
+    client = new Peer(clientFd, false);
+
+    std::thread thread(&Peer::handshake, client);
+    server->handshake();
+    thread.join();
+
+    ASSERT_TRUE(server->tls->enableKernelTLS());
+  }
+
+  void TearDown() override {
+    delete client;
+    delete server;
+  }
+
+  Peer* server = nullptr;
+  Peer* client = nullptr;
+};
+
+TEST_F(KernelTLS, exchangeBothWays) {
+  std::string ping(100000, 'x'), pong("pong");
+
+  for (size_t i = 0; i < ping.size(); i++)
+    ping[i] = (char)(i * 7);
+
+  std::thread thread(&Peer::send, client, ping);
+  EXPECT_EQ(server->receive(ping.size()), ping);
+  thread.join();
+
+  server->send(pong);
+  EXPECT_EQ(client->receive(pong.size()), pong);
+
+  // And again, to make sure the sequence numbers still agree
+  server->send(pong);
+  EXPECT_EQ(client->receive(pong.size()), pong);
+  client->send(pong);
+  EXPECT_EQ(server->receive(pong.size()), pong);
+}
+
+TEST_F(KernelTLS, kernelSeesCloseNotify) {
+  client->send("bye");
+  EXPECT_EQ(server->receive(3), "bye");
+
+  client->tls->shutdown();
+  EXPECT_TRUE(server->receiveEnd());
+}
+
+TEST_F(KernelTLS, gnutlsSeesCloseNotify) {
+  server->send("bye");
+  EXPECT_EQ(client->receive(3), "bye");
+
+  server->tls->shutdown();
+  EXPECT_TRUE(client->receiveEnd());
+}
+
+int main(int argc, char** argv) {
+  int ret;
+
+  gnutls_global_init();
+
+  ::testing::InitGoogleTest(&argc, argv);
+  ret = RUN_ALL_TESTS();
+
+  gnutls_global_deinit();
+
+  return ret;
+}
@@ -0,0 +1,188 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <rfb/JpegCompressor.h>
+#include <rfb/JpegDecompressor.h>
+#include <rfb/LossyRefinement.h>
+#include <rfb/PixelBuffer.h>
+
+using namespace rfb;
+
+static const PixelFormat serverPF(32, 24, false, true, 255, 255, 255, 16, 8, 0);
+static const PixelFormat clientPF(32, 24, true, true, 255, 255, 255, 0, 8, 16);
+
+// Smooth shading with a little noise, like a photo
+static void fillPhoto(ManagedPixelBuffer* pb) {
+  uint32_t* data;
+  int stride;
+
+  data = (uint32_t*)pb->getBufferRW(pb->getRect(), &stride);
+
+  srand(1);
+  for (int y = 0; y < pb->height(); y++) {
+    for (int x = 0; x < pb->width(); x++) {
+      int r, g, b;
+
+      r = 128 + 100 * sin(x / 17.0) + rand() % 8;
+      g = 128 + 100 * cos(y / 23.0) + rand() % 8;
+      b = (x + y) % 256;
+      data[x + y * stride] = r << 16 | g << 8 | b;
+    }
+  }
+
+  pb->commitBufferRW(pb->getRect());
+}
+
+// What TightDecoder leaves in the client's framebuffer
+static void clientDecode(const PixelBuffer* pb, const core::Rect& rect, int quality, int subsampling,
+                         ModifiablePixelBuffer* fb) {
+  JpegCompressor jc;
+  JpegDecompressor jd;
+  const uint8_t* buffer;
+  uint8_t* out;
+  int stride;
+
+  buffer = pb->getBuffer(rect, &stride);
+  jc.compress(buffer, stride, rect, pb->getPF(), quality, subsampling);
+
+  out = fb->getBufferRW(rect, &stride);
+  jd.decompress(jc.data(), jc.length(), out, stride, rect, fb->getPF());
+  fb->commitBufferRW(rect);
+}
+
+TEST(LossyRefinementStore, ReplacesOverlaps) {
+  LossyRefinementStore store;
+  std::vector<LossyRefinementStore::Entry> entries;
+
+  store.add({0, 0, 64, 64}, 80, 0);
+  store.add({64, 0, 128, 64}, 80, 0);
+  store.add({32, 32, 96, 96}, 50, 0);
+
+  store.find(core::Region({0, 0, 256, 256}), &entries);
+  ASSERT_EQ(entries.size(), 1U);
+  EXPECT_EQ(entries[0].rect, core::Rect(32, 32, 96, 96));
+  EXPECT_EQ(entries[0].quality, 50);
+}
+
+TEST(LossyRefinementStore, FindsEnclosedOnly) {
+  LossyRefinementStore store;
+  std::vector<LossyRefinementStore::Entry> entries;
+
+  store.add({0, 0, 64, 64}, 80, 0);
+  store.add({64, 0, 128, 64}, 80, 0);
+
+  store.find(core::Region({0, 0, 100, 64}), &entries);
+  ASSERT_EQ(entries.size(), 1U);
+  EXPECT_EQ(entries[0].rect, core::Rect(0, 0, 64, 64));
+
+  store.discard(core::Region({10, 10, 11, 11}));
+  store.find(core::Region({0, 0, 256, 256}), &entries);
+  ASSERT_EQ(entries.size(), 1U);
+  EXPECT_EQ(entries[0].rect, core::Rect(64, 0, 128, 64));
+
+  store.clear();
+  EXPECT_EQ(store.size(), 0U);
+}
+
+TEST(LossyRefinementStore, KeepsNewest) {
+  LossyRefinementStore store;
+
+  for (size_t i = 0; i < LossyRefinementStore::MaxEntries + 10; i++)
+    store.add({(int)i, 0, (int)i + 1, 1}, 80, 0);
+
+  EXPECT_EQ(store.size(), LossyRefinementStore::MaxEntries);
+}
+
+TEST(LossyRefinement, RestoresExactPixels) {
+  ManagedPixelBuffer pb(serverPF, 256, 128);
+  ManagedPixelBuffer fb(clientPF, 256, 128);
+  LossyRefinementStore store;
+  std::vector<LossyRefinementStore::Entry> entries;
+  std::vector<uint8_t> lossy, exact, client, data;
+  core::Rect rect(16, 8, 208, 120);
+
+  fillPhoto(&pb);
+
+  store.add(rect, 62, 2);
+  store.find(core::Region(pb.getRect()), &entries);
+  ASSERT_EQ(entries.size(), 1U);
+
+  clientDecode(&pb, rect, 62, 2, &fb);
+
+  // Server side
+  lossy.resize(rect.area() * 4);
+  exact.resize(rect.area() * 4);
+  store.reproduce(&pb, entries[0], lossy.data());
+  pb.getImage(lossyRefinementPF, exact.data(), rect);
+  EXPECT_NE(lossy, exact);
+
+  encodeRefinement(lossy.data(), exact.data(), rect.area(), 6, &data);
+  EXPECT_LT(data.size(), refinementReferenceSize(exact.data(), rect.area(), 6));
+
+  // Client side
+  client.resize(rect.area() * 4);
+  fb.getImage(lossyRefinementPF, client.data(), rect);
+  ASSERT_EQ(hashRefinementBase(client.data(), rect.area()), hashRefinementBase(lossy.data(), rect.area()));
+  ASSERT_TRUE(applyRefinement(data.data(), data.size(), client.data(), rect.area()));
+  fb.imageRect(lossyRefinementPF, rect, client.data());
+
+  for (int y = rect.tl.y; y < rect.br.y; y++) {
+    for (int x = rect.tl.x; x < rect.br.x; x++) {
+      uint8_t expected[4], actual[4];
+      pb.getImage(lossyRefinementPF, expected, {x, y, x + 1, y + 1});
+      fb.getImage(lossyRefinementPF, actual, {x, y, x + 1, y + 1});
+      ASSERT_EQ(expected[0], actual[0]);
+      ASSERT_EQ(expected[1], actual[1]);
+      ASSERT_EQ(expected[2], actual[2]);
+    }
+  }
+}
+
+TEST(LossyRefinement, HashIgnoresPadding) {
+  std::vector<uint8_t> a(64 * 4, 0x55), b(64 * 4, 0x55);
+
+  for (size_t i = 3; i < b.size(); i += 4)
+    b[i] = 0xaa;
+  EXPECT_EQ(hashRefinementBase(a.data(), 64), hashRefinementBase(b.data(), 64));
+
+  b[4] = 0x56;
+  EXPECT_NE(hashRefinementBase(a.data(), 64), hashRefinementBase(b.data(), 64));
+}
+
+TEST(LossyRefinement, RejectsWrongSize) {
+  std::vector<uint8_t> lossy(100 * 4, 0x10), exact(100 * 4, 0x12), scratch(101 * 4), data;
+
+  encodeRefinement(lossy.data(), exact.data(), 100, 6, &data);
+
+  EXPECT_FALSE(applyRefinement(data.data(), data.size(), scratch.data(), 101));
+  EXPECT_FALSE(applyRefinement(data.data(), data.size(), scratch.data(), 99));
+  EXPECT_FALSE(applyRefinement(data.data(), data.size() / 2, scratch.data(), 100));
+  EXPECT_TRUE(applyRefinement(data.data(), data.size(), lossy.data(), 100));
+  EXPECT_EQ(lossy[0], 0x12);
+}
@@ -22,6 +22,7 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <cstring>
 #include <rdr/MemInStream.h>
 #include <rdr/MemOutStream.h>
@@ -46,6 +47,12 @@ class MockSMsgHandler : public SMsgHandler {
 public:
   std::vector<uint64_t> receivedEvictions;
 
+  uint8_t idListFlags = 0;
+  uint64_t idListToken = 0;
+  uint16_t idListChunks = 0;
+  uint16_t idListIndex = 0;
+  std::vector<uint64_t> receivedIdList;
+
   // Override PersistentCache eviction to capture data
   void handlePersistentCacheEviction(const std::vector<uint64_t>& ids) override {
     receivedEvictions = ids;
@@ -69,6 +76,14 @@ public:
   void handleClipboardProvide(uint32_t, const size_t*, const uint8_t* const*) override {}
   void handlePersistentCacheQuery(const std::vector<uint64_t>&) override {}
   void handlePersistentHashList(uint32_t, uint16_t, uint16_t, const std::vector<uint64_t>&) override {}
+  void handlePersistentIdList(uint8_t flags, uint64_t baseToken, uint16_t totalChunks, uint16_t chunkIndex,
+                              const std::vector<uint64_t>& ids) override {
+    idListFlags = flags;
+    idListToken = baseToken;
+    idListChunks = totalChunks;
+    idListIndex = chunkIndex;
+    receivedIdList = ids;
+  }
   void handlePersistentCacheHashReport(const CacheKey&, const CacheKey&) override {}
   void handleDebugDumpRequest(uint32_t) override {}
 };
@@ -400,3 +415,64 @@ TEST(PersistentCacheProtocol, EvictionExactBatchBoundaryPlusOne) {
 
   EXPECT_EQ(inStream.avail(), 0);
 }
+
+// ============================================================================
+// PersistentCacheIdList Message Tests
+// ============================================================================
+
+TEST(PersistentCacheProtocol, IdListRoundTrip) {
+  std::vector<uint64_t> ids;
+  for (uint64_t i = 0; i < 5000; i++)
+    ids.push_back(i * 0x9E3779B97F4A7C15ULL);
+  std::sort(ids.begin(), ids.end());
+
+  rdr::MemOutStream outStream;
+  ServerParams serverParams;
+  CMsgWriter writer(&serverParams, &outStream);
+  writer.writePersistentIdList(idListFlagDelta | idListFlagRemoved, 0x0123456789ABCDEFULL, 3, 2, ids);
+
+  // Well below the 8 bytes per ID of a plain list
+  EXPECT_LT(outStream.length(), ids.size() * 7);
+
+  rdr::MemInStream inStream(outStream.data(), outStream.length());
+  MockSMsgHandler handler;
+  SMsgReader reader(&handler, &inStream);
+
+  ASSERT_TRUE(reader.readMsg());
+
+  EXPECT_EQ(handler.idListFlags, idListFlagDelta | idListFlagRemoved);
+  EXPECT_EQ(handler.idListToken, 0x0123456789ABCDEFULL);
+  EXPECT_EQ(handler.idListChunks, 3);
+  EXPECT_EQ(handler.idListIndex, 2);
+  EXPECT_EQ(handler.receivedIdList, ids);
+  EXPECT_EQ(inStream.avail(), 0);
+}
+
+TEST(PersistentCacheProtocol, IdListEmpty) {
+  rdr::MemOutStream outStream;
+  ServerParams serverParams;
+  CMsgWriter writer(&serverParams, &outStream);
+  writer.writePersistentIdList(0, 0, 1, 0, {});
+
+  rdr::MemInStream inStream(outStream.data(), outStream.length());
+  MockSMsgHandler handler;
+  SMsgReader reader(&handler, &inStream);
+
+  ASSERT_TRUE(reader.readMsg());
+
+  EXPECT_EQ(handler.idListChunks, 1);
+  EXPECT_TRUE(handler.receivedIdList.empty());
+}
+
+TEST(PersistentCacheProtocol, IdListRejectsBadChunkIndex) {
+  rdr::MemOutStream outStream;
+  ServerParams serverParams;
+  CMsgWriter writer(&serverParams, &outStream);
+  writer.writePersistentIdList(0, 0, 2, 2, {1, 2, 3});
+
+  rdr::MemInStream inStream(outStream.data(), outStream.length());
+  MockSMsgHandler handler;
+  SMsgReader reader(&handler, &inStream);
+
+  EXPECT_THROW(reader.readMsg(), std::exception);
+}
@@ -0,0 +1,135 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <network/Poller.h>
+
+using network::Poller;
+
+class PollerTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  }
+
+  void TearDown() override {
+    close(fds[0]);
+    close(fds[1]);
+  }
+
+  int fds[2];
+};
+
+TEST_F(PollerTest, Timeout) {
+  Poller poller;
+  struct timeval start, end;
+  int elapsed;
+
+  poller.add(fds[0], Poller::Read);
+
+  gettimeofday(&start, nullptr);
+  EXPECT_EQ(poller.wait(50), 0);
+  gettimeofday(&end, nullptr);
+
+  elapsed = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000;
+  EXPECT_GE(elapsed, 45);
+  EXPECT_LT(elapsed, 1000);
+
+  EXPECT_EQ(poller.wait(0), 0);
+}
+
+TEST_F(PollerTest, Readable) {
+  Poller poller;
+
+  poller.add(fds[0], Poller::Read);
+  poller.add(fds[1], Poller::Read);
+
+  ASSERT_EQ(write(fds[1], "x", 1), 1);
+
+  ASSERT_EQ(poller.wait(1000), 1);
+  EXPECT_EQ(poller.getReady()[0].fd, fds[0]);
+  EXPECT_EQ(poller.getEvents(fds[0]), Poller::Read);
+  EXPECT_EQ(poller.getEvents(fds[1]), 0);
+
+  // Still readable, as nothing was read
+  EXPECT_EQ(poller.wait(0), 1);
+}
+
+TEST_F(PollerTest, Writable) {
+  Poller poller;
+
+  poller.add(fds[0], Poller::Read | Poller::Write);
+
+  ASSERT_EQ(poller.wait(1000), 1);
+  EXPECT_EQ(poller.getEvents(fds[0]), Poller::Write);
+
+  poller.modify(fds[0], Poller::Read);
+  EXPECT_EQ(poller.wait(0), 0);
+}
+
+TEST_F(PollerTest, EdgeTriggered) {
+  Poller poller;
+  char buf[16];
+
+  if (!Poller::edgeTriggered())
+    GTEST_SKIP() << "Edge triggering not supported";
+
+  poller.add(fds[0], Poller::Read | Poller::EdgeTriggered);
+
+  ASSERT_EQ(write(fds[1], "x", 1), 1);
+  EXPECT_EQ(poller.wait(1000), 1);
+
+  // Nothing new has arrived
+  EXPECT_EQ(poller.wait(0), 0);
+
+  ASSERT_EQ(write(fds[1], "y", 1), 1);
+  EXPECT_EQ(poller.wait(1000), 1);
+
+  EXPECT_EQ(read(fds[0], buf, sizeof(buf)), 2);
+}
+
+TEST_F(PollerTest, Hangup) {
+  Poller poller;
+
+  poller.add(fds[0], Poller::Read | Poller::EdgeTriggered);
+
+  shutdown(fds[1], SHUT_WR);
+
+  ASSERT_EQ(poller.wait(1000), 1);
+  EXPECT_EQ(poller.getEvents(fds[0]), Poller::Read);
+}
+
+TEST_F(PollerTest, Remove) {
+  Poller poller;
+
+  poller.add(fds[0], Poller::Read);
+  ASSERT_EQ(write(fds[1], "x", 1), 1);
+
+  poller.remove(fds[0]);
+  EXPECT_EQ(poller.wait(0), 0);
+  EXPECT_EQ(poller.getEvents(fds[0]), 0);
+}
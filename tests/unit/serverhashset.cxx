@@ -20,6 +20,11 @@
 #include <config.h>
 #endif
 
+#include <stdlib.h>
+
+#include <algorithm>
+#include <unordered_set>
+
 #include <gtest/gtest.h>
 
 #include <rfb/cache/ServerHashSet.h>
@@ -395,3 +400,100 @@ TEST(ServerHashSet, AddRemoveAddPattern) {
   EXPECT_EQ(stats.totalAdded, 2);   // Added twice
   EXPECT_EQ(stats.totalEvicted, 1); // Removed once
 }
+
+// ============================================================================
+// Flat uint64_t table specifics
+// ============================================================================
+
+TEST(ServerHashSet, ZeroKey) {
+  ServerHashSet<uint64_t> hashSet;
+
+  hashSet.add(0);
+  hashSet.add(7);
+
+  EXPECT_TRUE(hashSet.has(0));
+  EXPECT_EQ(hashSet.size(), 2);
+
+  std::vector<uint64_t> keys(hashSet.begin(), hashSet.end());
+  std::sort(keys.begin(), keys.end());
+  EXPECT_EQ(keys, std::vector<uint64_t>({0, 7}));
+
+  EXPECT_TRUE(hashSet.remove(0));
+  EXPECT_FALSE(hashSet.has(0));
+  EXPECT_TRUE(hashSet.has(7));
+  EXPECT_EQ(hashSet.size(), 1);
+}
+
+TEST(ServerHashSet, Iteration) {
+  ServerHashSet<uint64_t> hashSet;
+  std::vector<uint64_t> expected, actual;
+
+  EXPECT_TRUE(hashSet.begin() == hashSet.end());
+
+  for (uint64_t i = 1; i <= 1000; i++) {
+    hashSet.add(i << 32);
+    expected.push_back(i << 32);
+  }
+
+  actual.assign(hashSet.begin(), hashSet.end());
+  std::sort(actual.begin(), actual.end());
+  EXPECT_EQ(actual, expected);
+}
+
+TEST(ServerHashSet, AddMultiple) {
+  ServerHashSet<uint64_t> hashSet;
+  std::vector<uint64_t> chunk;
+
+  for (uint64_t i = 1; i <= 5000; i++)
+    chunk.push_back(i * 0x9e3779b97f4a7c15ULL);
+
+  hashSet.add(chunk[0]);
+  hashSet.addMultiple(chunk);
+
+  EXPECT_EQ(hashSet.size(), 5000);
+  for (uint64_t key : chunk)
+    EXPECT_TRUE(hashSet.has(key));
+
+  auto stats = hashSet.getStats();
+  EXPECT_EQ(stats.totalAdded, 5000);
+}
+
+TEST(ServerHashSet, ChurnMatchesReference) {
+  // Random adds and removes in a small key space, so that removal has
+  // to shift back lots of colliding entries
+  ServerHashSet<uint64_t> hashSet;
+  std::unordered_set<uint64_t> reference;
+
+  srand(1);
+  for (int i = 0; i < 200000; i++) {
+    uint64_t key = rand() % 4096;
+
+    if (rand() % 3 == 0) {
+      EXPECT_EQ(hashSet.remove(key), reference.erase(key) > 0);
+    } else {
+      hashSet.add(key);
+      reference.insert(key);
+    }
+  }
+
+  EXPECT_EQ(hashSet.size(), reference.size());
+  for (uint64_t key = 0; key < 4096; key++)
+    EXPECT_EQ(hashSet.has(key), reference.count(key) > 0) << key;
+}
+
+TEST(ServerHashSet, ClearReleasesMemory) {
+  ServerHashSet<uint64_t> hashSet;
+
+  hashSet.reserve(100000);
+  EXPECT_GE(hashSet.memoryUsage(), 100000 * sizeof(uint64_t));
+
+  // Reserving must not allocate again when filled up to that size
+  size_t reserved = hashSet.memoryUsage();
+  for (uint64_t i = 1; i <= 100000; i++)
+    hashSet.add(i);
+  EXPECT_EQ(hashSet.memoryUsage(), reserved);
+
+  hashSet.clear();
+  EXPECT_EQ(hashSet.memoryUsage(), 0);
+  EXPECT_FALSE(hashSet.has(1));
+}
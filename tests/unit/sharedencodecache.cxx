@@ -0,0 +1,98 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include <core/Region.h>
+
+#include <rfb/PixelBuffer.h>
+#include <rfb/SharedEncodeCache.h>
+
+using namespace rfb;
+
+static const PixelFormat fbPF(32, 24, false, true, 255, 255, 255, 16, 8, 0);
+static const uint8_t payload[] = {1, 2, 3, 4, 5};
+
+TEST(SharedEncodeCache, RoundTrip) {
+  ManagedPixelBuffer pb(fbPF, 256, 256);
+  SharedEncodeCache sharedEncodes;
+  std::vector<uint8_t> data;
+  int type;
+
+  sharedEncodes.setFramebuffer(&pb);
+
+  EXPECT_FALSE(sharedEncodes.lookup("a", {0, 0, 64, 64}, &type, &data));
+
+  sharedEncodes.insert("a", {0, 0, 64, 64}, 3, payload, sizeof(payload));
+
+  ASSERT_TRUE(sharedEncodes.lookup("a", {0, 0, 64, 64}, &type, &data));
+  EXPECT_EQ(type, 3);
+  EXPECT_EQ(data, std::vector<uint8_t>(payload, payload + sizeof(payload)));
+
+  // Other settings or another rect must not match
+  EXPECT_FALSE(sharedEncodes.lookup("b", {0, 0, 64, 64}, &type, &data));
+  EXPECT_FALSE(sharedEncodes.lookup("a", {0, 0, 64, 32}, &type, &data));
+
+  SharedEncodeCache::Stats stats = sharedEncodes.takeStats();
+  EXPECT_EQ(stats.lookups, 4U);
+  EXPECT_EQ(stats.hits, 1U);
+}
+
+TEST(SharedEncodeCache, DamageInvalidates) {
+  ManagedPixelBuffer pb(fbPF, 256, 256);
+  SharedEncodeCache sharedEncodes;
+  std::vector<uint8_t> data;
+  int type;
+
+  sharedEncodes.setFramebuffer(&pb);
+
+  sharedEncodes.insert("a", {0, 0, 64, 64}, 0, payload, sizeof(payload));
+  sharedEncodes.insert("a", {64, 0, 128, 64}, 0, payload, sizeof(payload));
+
+  sharedEncodes.invalidate(core::Region({100, 10, 101, 11}));
+
+  EXPECT_TRUE(sharedEncodes.lookup("a", {0, 0, 64, 64}, &type, &data));
+  EXPECT_FALSE(sharedEncodes.lookup("a", {64, 0, 128, 64}, &type, &data));
+
+  // A new framebuffer means nothing can be trusted
+  sharedEncodes.setFramebuffer(&pb);
+  EXPECT_FALSE(sharedEncodes.lookup("a", {0, 0, 64, 64}, &type, &data));
+}
+
+TEST(SharedEncodeCache, Groups) {
+  SharedEncodeCache sharedEncodes;
+
+  sharedEncodes.join("a");
+  sharedEncodes.join("a");
+  sharedEncodes.join("b");
+
+  EXPECT_EQ(sharedEncodes.groupSize("a"), 2U);
+  EXPECT_EQ(sharedEncodes.groupSize("b"), 1U);
+  EXPECT_EQ(sharedEncodes.groupSize("c"), 0U);
+  EXPECT_EQ(sharedEncodes.groupCount(), 2U);
+
+  sharedEncodes.leave("a");
+  sharedEncodes.leave("b");
+
+  EXPECT_EQ(sharedEncodes.groupSize("a"), 1U);
+  EXPECT_EQ(sharedEncodes.groupCount(), 1U);
+}
@@ -0,0 +1,154 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include <gtest/gtest.h>
+
+#include <rdr/FdInStream.h>
+#include <rdr/FdOutStream.h>
+#include <rfb/SharedPixelBuffer.h>
+
+using namespace rfb;
+
+static const PixelFormat fbPF(32, 24, false, true, 255, 255, 255, 16, 8, 0);
+
+static uint32_t firstPixel(const PixelBuffer* pb) {
+  int stride;
+  return *(const uint32_t*)pb->getBuffer({0, 0, 1, 1}, &stride);
+}
+
+TEST(SharedPixelBuffer, ClientSeesServerContent) {
+  SharedPixelBuffer server(fbPF, 100, 50);
+  uint32_t pixel;
+
+  pixel = 0x123456;
+  server.fillRect({10, 10, 20, 20}, &pixel);
+
+  SharedPixelBuffer client(server.dupFd(), fbPF, 100, 50, server.getStride());
+
+  EXPECT_EQ(client.getStride(), server.getStride());
+  for (int y = 0; y < 50; y++) {
+    const uint8_t *a, *b;
+    int stride;
+
+    a = server.getBuffer({0, y, 100, y + 1}, &stride);
+    b = client.getBuffer({0, y, 100, y + 1}, &stride);
+    EXPECT_EQ(memcmp(a, b, 100 * 4), 0);
+  }
+
+  // Later changes show up without anything else being done
+  pixel = 0xabcdef;
+  server.fillRect({0, 0, 1, 1}, &pixel);
+  EXPECT_EQ(firstPixel(&client), 0xabcdefu);
+}
+
+TEST(SharedPixelBuffer, ClientIsReadOnly) {
+  SharedPixelBuffer server(fbPF, 16, 16);
+  SharedPixelBuffer client(server.dupFd(), fbPF, 16, 16, server.getStride());
+  int stride;
+
+  EXPECT_THROW(client.getBufferRW(client.getRect(), &stride), std::exception);
+}
+
+TEST(SharedPixelBuffer, CannotBeResized) {
+  SharedPixelBuffer server(fbPF, 16, 16);
+  int fd;
+
+  fd = server.dupFd();
+  EXPECT_NE(ftruncate(fd, 0), 0);
+  close(fd);
+}
+
+TEST(SharedPixelBuffer, RejectsUnsealedFd) {
+  int fd;
+
+  fd = memfd_create("test", MFD_CLOEXEC);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(ftruncate(fd, 16 * 16 * 4), 0);
+
+  EXPECT_THROW(SharedPixelBuffer(fd, fbPF, 16, 16, 16), std::exception);
+}
+
+TEST(SharedPixelBuffer, RejectsSmallBuffer) {
+  SharedPixelBuffer server(fbPF, 16, 16);
+
+  EXPECT_THROW(SharedPixelBuffer(server.dupFd(), fbPF, 16, 32, 16), std::exception);
+  EXPECT_THROW(SharedPixelBuffer(server.dupFd(), fbPF, 16, 16, 32), std::exception);
+}
+
+TEST(SharedPixelBuffer, PassOverSocket) {
+  int fds[2];
+
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  rdr::FdOutStream out(fds[0]);
+  rdr::FdInStream in(fds[1]);
+  SharedPixelBuffer server(fbPF, 16, 16);
+  int fd;
+
+  in.acceptFds(true);
+
+  out.passFd(server.dupFd());
+  out.writeU32(0x12345678);
+  out.flush();
+
+  ASSERT_TRUE(in.hasData(4));
+  EXPECT_EQ(in.readU32(), 0x12345678u);
+
+  fd = in.takeFd();
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(in.takeFd(), -1);
+
+  SharedPixelBuffer client(fd, fbPF, 16, 16, server.getStride());
+  uint32_t pixel = 0xff;
+  server.fillRect({0, 0, 1, 1}, &pixel);
+  EXPECT_EQ(firstPixel(&client), 0xffu);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(SharedPixelBuffer, IgnoredUnlessAccepted) {
+  int fds[2];
+
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  rdr::FdOutStream out(fds[0]);
+  rdr::FdInStream in(fds[1]);
+  SharedPixelBuffer server(fbPF, 16, 16);
+
+  out.passFd(server.dupFd());
+  out.writeU32(0x12345678);
+  out.flush();
+
+  ASSERT_TRUE(in.hasData(4));
+  EXPECT_EQ(in.readU32(), 0x12345678u);
+  EXPECT_EQ(in.takeFd(), -1);
+
+  close(fds[0]);
+  close(fds[1]);
+}
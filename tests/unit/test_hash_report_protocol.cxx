@@ -65,6 +65,7 @@ public:
   void handleClipboardProvide(uint32_t, const size_t*, const uint8_t* const*) override {}
   void handlePersistentCacheQuery(const std::vector<uint64_t>&) override {}
   void handlePersistentHashList(uint32_t, uint16_t, uint16_t, const std::vector<uint64_t>&) override {}
+  void handlePersistentIdList(uint8_t, uint64_t, uint16_t, uint16_t, const std::vector<uint64_t>&) override {}
   void handlePersistentCacheEviction(const std::vector<uint64_t>&) override {}
   void handleDebugDumpRequest(uint32_t) override {}
 };
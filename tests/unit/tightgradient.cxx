@@ -0,0 +1,165 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <rdr/MemInStream.h>
+#include <rdr/MemOutStream.h>
+#include <rdr/ZlibOutStream.h>
+
+#include <rfb/PixelBuffer.h>
+#include <rfb/ServerParams.h>
+#include <rfb/TightConstants.h>
+#include <rfb/TightDecoder.h>
+#include <rfb/TightGradient.h>
+
+using namespace rfb;
+
+static const PixelFormat fbPF(32, 24, false, true, 255, 255, 255, 16, 8, 0);
+
+// Straight from the Tight specification, one channel at a time
+static void referencePredict(const uint8_t* prevRow, const uint8_t* thisRow, uint8_t* out, int width) {
+  for (int i = 0; i < width * 3; i++) {
+    int left, aboveLeft, est;
+
+    left = i < 3 ? 0 : thisRow[i - 3];
+    aboveLeft = i < 3 ? 0 : prevRow[i - 3];
+
+    est = left + prevRow[i] - aboveLeft;
+    if (est < 0)
+      est = 0;
+    if (est > 255)
+      est = 255;
+
+    out[i] = thisRow[i] - est;
+  }
+}
+
+static std::vector<uint8_t> randomRow(int width) {
+  std::vector<uint8_t> row(width * 3);
+
+  for (uint8_t& b : row)
+    b = rand();
+
+  return row;
+}
+
+TEST(TightGradient, PredictMatchesReference) {
+  srand(1);
+
+  for (int width : {1, 2, 5, 6, 7, 16, 33, 100, 2048}) {
+    std::vector<uint8_t> prevRow, thisRow;
+    std::vector<uint8_t> expected(width * 3), actual(width * 3);
+
+    prevRow = randomRow(width);
+    thisRow = randomRow(width);
+
+    referencePredict(prevRow.data(), thisRow.data(), expected.data(), width);
+    tightGradientPredictRow(prevRow.data(), thisRow.data(), actual.data(), width);
+
+    EXPECT_EQ(expected, actual) << "width " << width;
+  }
+}
+
+TEST(TightGradient, RestoreReversesPredict) {
+  srand(2);
+
+  for (int width : {1, 2, 5, 6, 7, 16, 33, 100, 2048}) {
+    std::vector<uint8_t> prevRow, thisRow;
+    std::vector<uint8_t> residuals(width * 3), restored(width * 3);
+
+    prevRow = randomRow(width);
+    thisRow = randomRow(width);
+
+    tightGradientPredictRow(prevRow.data(), thisRow.data(), residuals.data(), width);
+    tightGradientRestoreRow(prevRow.data(), residuals.data(), restored.data(), width);
+
+    EXPECT_EQ(thisRow, restored) << "width " << width;
+  }
+}
+
+TEST(TightGradient, DecodesGradientRect) {
+  const core::Rect rect(0, 0, 61, 37);
+
+  ManagedPixelBuffer source(fbPF, rect.width(), rect.height());
+  ManagedPixelBuffer decoded(fbPF, rect.width(), rect.height());
+  std::vector<uint8_t> prevRow(rect.width() * 3), thisRow(rect.width() * 3);
+  std::vector<uint8_t> residuals(rect.width() * 3);
+  const uint8_t* buffer;
+  int stride;
+
+  ServerParams server;
+  TightDecoder decoder;
+  rdr::MemOutStream compressed, packet, decoderBuffer;
+
+  // Shading plus noise, like a photo
+  srand(3);
+  for (int y = 0; y < rect.height(); y++) {
+    for (int x = 0; x < rect.width(); x++) {
+      uint32_t pixel;
+
+      pixel = ((x * 4 + rand() % 8) & 0xff) << 16 | ((y * 6 + rand() % 8) & 0xff) << 8 | ((x + y) & 0xff);
+      source.fillRect({x, y, x + 1, y + 1}, &pixel);
+    }
+  }
+
+  // What TightEncoder would send
+  rdr::ZlibOutStream zos(&compressed, 6);
+
+  buffer = source.getBuffer(rect, &stride);
+  for (int y = 0; y < rect.height(); y++) {
+    fbPF.rgbFromBuffer(thisRow.data(), buffer + y * stride * 4, rect.width());
+    tightGradientPredictRow(prevRow.data(), thisRow.data(), residuals.data(), rect.width());
+    zos.writeBytes(residuals.data(), residuals.size());
+    std::swap(prevRow, thisRow);
+  }
+  zos.flush();
+
+  packet.writeU8((3 | tightExplicitFilter) << 4);
+  packet.writeU8(tightFilterGradient);
+  packet.writeU8((compressed.length() & 0x7f) | 0x80);
+  packet.writeU8(((compressed.length() >> 7) & 0x7f) | 0x80);
+  packet.writeU8(compressed.length() >> 14);
+  packet.writeBytes(compressed.data(), compressed.length());
+
+  server.setPF(fbPF);
+
+  rdr::MemInStream is(packet.data(), packet.length());
+  ASSERT_TRUE(decoder.readRect(rect, &is, server, &decoderBuffer));
+  decoder.decodeRect(rect, decoderBuffer.data(), decoderBuffer.length(), server, &decoded);
+
+  for (int y = 0; y < rect.height(); y++) {
+    const uint32_t *expected, *actual;
+    int expectedStride, actualStride;
+
+    expected = (const uint32_t*)source.getBuffer(rect, &expectedStride);
+    actual = (const uint32_t*)decoded.getBuffer(rect, &actualStride);
+
+    for (int x = 0; x < rect.width(); x++)
+      ASSERT_EQ(expected[x + y * expectedStride] & 0xffffff, actual[x + y * actualStride] & 0xffffff)
+          << "pixel " << x << "," << y;
+  }
+}
@@ -0,0 +1,129 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include <rfb/UpdatePacer.h>
+
+using rfb::UpdatePacer;
+
+static struct timeval ms(unsigned t) {
+  struct timeval tv;
+  tv.tv_sec = t / 1000;
+  tv.tv_usec = (t % 1000) * 1000;
+  return tv;
+}
+
+// Sends an update at the given time that takes encodeMs to produce
+static void sendUpdate(UpdatePacer* pacer, unsigned start, unsigned encodeMs, size_t bytes, size_t bandwidth) {
+  struct timeval tv;
+
+  tv = ms(start);
+  pacer->startUpdate(&tv);
+  tv = ms(start + encodeMs);
+  pacer->updateSent(&tv, bytes, bandwidth, 20000);
+}
+
+TEST(UpdatePacer, DueInitially) {
+  UpdatePacer pacer;
+  struct timeval now;
+
+  now = ms(1000);
+  EXPECT_EQ(pacer.msToNextUpdate(&now, 1000, 60), 0);
+}
+
+TEST(UpdatePacer, FastClientAlwaysDue) {
+  UpdatePacer pacer;
+  struct timeval now;
+
+  sendUpdate(&pacer, 1000, 1, 10000, 10000000);
+
+  EXPECT_EQ(pacer.getInterval(10000000, 60), 1000000U / 60);
+
+  // Not held back to the frame rate, that's the frame clock's job
+  now = ms(1002);
+  EXPECT_EQ(pacer.msToNextUpdate(&now, 10000000, 60), 0);
+}
+
+TEST(UpdatePacer, SlowLinkIsPaced) {
+  UpdatePacer pacer;
+  struct timeval now;
+
+  // 100 KB over 250 KB/s
+  sendUpdate(&pacer, 1000, 5, 100000, 250000);
+  EXPECT_EQ(pacer.getInterval(250000, 60), 400000U);
+
+  now = ms(1010);
+  EXPECT_EQ(pacer.msToNextUpdate(&now, 250000, 60), 390);
+
+  now = ms(1390);
+  EXPECT_EQ(pacer.msToNextUpdate(&now, 250000, 60), 10);
+
+  // Close enough to be sent along with other clients
+  now = ms(1397);
+  EXPECT_EQ(pacer.msToNextUpdate(&now, 250000, 60), 0);
+
+  now = ms(1400);
+  EXPECT_EQ(pacer.msToNextUpdate(&now, 250000, 60), 0);
+}
+
+TEST(UpdatePacer, SlowEncodingIsPaced) {
+  UpdatePacer pacer;
+
+  sendUpdate(&pacer, 1000, 50, 100000, 10000000);
+  EXPECT_EQ(pacer.getInterval(10000000, 60), 50000U);
+}
+
+TEST(UpdatePacer, IntervalIsCapped) {
+  UpdatePacer pacer;
+
+  sendUpdate(&pacer, 1000, 5, 1000000, 1000);
+  EXPECT_EQ(pacer.getInterval(1000, 60), 1000000U);
+}
+
+TEST(UpdatePacer, Stats) {
+  UpdatePacer pacer;
+  UpdatePacer::Stats stats;
+  struct timeval now;
+
+  for (unsigned t = 1000; t < 11000; t += 100) {
+    now = ms(t - 50);
+    pacer.noteDamage(&now);
+    sendUpdate(&pacer, t, 5, 10000, 500000);
+  }
+
+  now = ms(10500);
+  EXPECT_FALSE(pacer.takeStats(&now, 500000, 60, &stats));
+
+  now = ms(11000);
+  ASSERT_TRUE(pacer.takeStats(&now, 500000, 60, &stats));
+  EXPECT_DOUBLE_EQ(stats.updateRate, 10.0);
+  EXPECT_DOUBLE_EQ(stats.targetRate, 50.0);
+  // Damaged 50 ms before the update, 5 ms to encode, 20 ms to send
+  // and 10 ms on the wire
+  EXPECT_EQ(stats.avgStaleness, 85U);
+  EXPECT_EQ(stats.maxStaleness, 85U);
+
+  // And then it starts over
+  now = ms(12000);
+  EXPECT_FALSE(pacer.takeStats(&now, 500000, 60, &stats));
+}
@@ -0,0 +1,95 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include <rfb/cache/VolatilityMap.h>
+
+using rfb::cache::VolatilityMap;
+
+static void playVideo(VolatilityMap* map, const core::Rect& r, uint64_t start, int frames, int intervalMs) {
+  for (int i = 0; i < frames; i++)
+    map->noteDamage(r, start + i * intervalMs);
+}
+
+TEST(VolatilityMap, SingleUpdateIsNotVolatile) {
+  VolatilityMap map(1024, 768, 64, 100);
+
+  map.noteDamage({100, 100, 200, 200}, 1000);
+
+  EXPECT_FALSE(map.rectTouchesVolatile({0, 0, 1024, 768}));
+  EXPECT_TRUE(map.volatileRegion().is_empty());
+}
+
+TEST(VolatilityMap, VideoBecomesVolatile) {
+  VolatilityMap map(1024, 768, 64, 100);
+
+  playVideo(&map, {128, 128, 448, 368}, 1000, 10, 40);
+
+  EXPECT_TRUE(map.isVolatileXY(200, 200));
+  EXPECT_FALSE(map.isVolatileXY(600, 600));
+  EXPECT_TRUE(map.rectTouchesVolatile({0, 0, 130, 130}));
+  EXPECT_FALSE(map.rectTouchesVolatile({0, 0, 128, 128}));
+
+  // Tiles that are only partially covered still count
+  EXPECT_EQ(map.volatileRegion(), core::Region({128, 128, 448, 384}));
+  EXPECT_EQ(map.updateIntervalMs({128, 128, 448, 368}), 40);
+}
+
+TEST(VolatilityMap, SlowUpdatesAreNotVolatile) {
+  VolatilityMap map(1024, 768, 64, 100);
+
+  // A clock ticking once a second
+  playVideo(&map, {0, 0, 64, 64}, 1000, 10, 1000);
+
+  EXPECT_FALSE(map.isVolatileXY(10, 10));
+}
+
+TEST(VolatilityMap, SettlesWhenIdle) {
+  VolatilityMap map(1024, 768, 64, 100);
+
+  playVideo(&map, {0, 0, 256, 256}, 1000, 10, 40);
+  EXPECT_TRUE(map.isVolatileXY(10, 10));
+
+  map.advance(1360 + 50);
+  EXPECT_TRUE(map.isVolatileXY(10, 10));
+
+  map.advance(1360 + 150);
+  EXPECT_FALSE(map.isVolatileXY(10, 10));
+  EXPECT_TRUE(map.volatileRegion().is_empty());
+
+  // A single new update must not make it volatile again right away
+  map.noteDamage({0, 0, 256, 256}, 2000);
+  EXPECT_FALSE(map.isVolatileXY(10, 10));
+}
+
+TEST(VolatilityMap, ClippedToFramebuffer) {
+  VolatilityMap map(100, 100, 64, 100);
+
+  playVideo(&map, {-50, -50, 500, 500}, 1000, 10, 20);
+
+  EXPECT_EQ(map.volatileRegion(), core::Region({0, 0, 100, 100}));
+  EXPECT_FALSE(map.isVolatileXY(100, 10));
+
+  map.resize(200, 200);
+  EXPECT_TRUE(map.volatileRegion().is_empty());
+}
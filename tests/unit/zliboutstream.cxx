@@ -0,0 +1,153 @@
+/* Copyright (C) 2026 TigerVNC Team.  All Rights Reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <rdr/MemInStream.h>
+#include <rdr/MemOutStream.h>
+#include <rdr/ZlibInStream.h>
+#include <rdr/ZlibOutStream.h>
+
+static std::vector<uint8_t> makeData(uint8_t seed) {
+  std::vector<uint8_t> data(4096);
+
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = (uint8_t)((i / 7) * seed + (i % 13));
+
+  return data;
+}
+
+static std::vector<uint8_t> compress(rdr::ZlibOutStream* zos, const std::vector<uint8_t>& data, int level) {
+  rdr::MemOutStream out;
+
+  zos->setUnderlying(&out);
+  zos->setCompressionLevel(level);
+  zos->writeBytes(data.data(), data.size());
+  zos->flush();
+  zos->setUnderlying(nullptr);
+
+  return std::vector<uint8_t>(out.data(), out.data() + out.length());
+}
+
+static std::vector<uint8_t> decompress(rdr::ZlibInStream* zis, const std::vector<uint8_t>& compressed,
+                                       size_t length) {
+  rdr::MemInStream in(compressed.data(), compressed.size());
+  std::vector<uint8_t> data(length);
+
+  zis->setUnderlying(&in, compressed.size());
+  if (zis->hasData(length))
+    zis->readBytes(data.data(), length);
+  zis->flushUnderlying();
+
+  return data;
+}
+
+TEST(ZlibOutStream, ResetIsIndependent) {
+  rdr::ZlibOutStream zos;
+  rdr::ZlibInStream zis;
+  std::vector<uint8_t> first, second, compressed;
+
+  first = makeData(3);
+  second = makeData(5);
+
+  compress(&zos, first, 6);
+  zos.reset();
+  compressed = compress(&zos, second, 6);
+
+  // Must decode without having seen what came before the reset
+  EXPECT_EQ(decompress(&zis, compressed, second.size()), second);
+}
+
+TEST(ZlibOutStream, ResetMatchesUsedStream) {
+  rdr::ZlibOutStream fresh, used;
+  std::vector<uint8_t> data;
+
+  data = makeData(7);
+
+  fresh.setCompressionLevel(9);
+  fresh.reset();
+
+  compress(&used, makeData(11), 9);
+  used.setCompressionLevel(9);
+  used.reset();
+
+  // A pending level change must not leave anything in the output
+  EXPECT_EQ(compress(&fresh, data, 9), compress(&used, data, 9));
+}
+
+TEST(ZlibOutStream, ParallelIsSingleStream) {
+  rdr::ZlibOutStream zos;
+  rdr::ZlibInStream zis;
+  std::vector<uint8_t> data, small, compressed;
+
+  // Long range repeats, so that chunks refer back into the previous one
+  for (int i = 0; i < 48; i++) {
+    std::vector<uint8_t> block;
+    block = makeData(i % 5 + 1);
+    data.insert(data.end(), block.begin(), block.end());
+  }
+  small = makeData(13);
+
+  zos.setThreads(4);
+
+  // Parallel, serial, then parallel again on the same stream
+  compressed = compress(&zos, data, 6);
+  EXPECT_EQ(decompress(&zis, compressed, data.size()), data);
+
+  compressed = compress(&zos, small, 6);
+  EXPECT_EQ(decompress(&zis, compressed, small.size()), small);
+
+  compressed = compress(&zos, data, 9);
+  EXPECT_EQ(decompress(&zis, compressed, data.size()), data);
+}
+
+TEST(ZlibOutStream, ParallelHoldsBackWhileCorked) {
+  rdr::ZlibOutStream zos;
+  rdr::ZlibInStream zis;
+  rdr::MemOutStream out;
+  std::vector<uint8_t> data, compressed;
+
+  data = makeData(3);
+
+  zos.setThreads(4);
+  zos.setUnderlying(&out);
+  zos.cork(true);
+  for (int i = 0; i < 64; i++)
+    zos.writeBytes(data.data(), data.size());
+  zos.flush();
+
+  EXPECT_EQ(out.length(), 0U);
+
+  zos.cork(false);
+  zos.flush();
+  zos.setUnderlying(nullptr);
+
+  compressed.assign(out.data(), out.data() + out.length());
+  std::vector<uint8_t> result = decompress(&zis, compressed, data.size() * 64);
+  for (int i = 0; i < 64; i++)
+    EXPECT_TRUE(std::equal(data.begin(), data.end(), result.begin() + i * data.size()));
+}
@@ -31,6 +31,8 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <unordered_map>
+
 #include <core/Configuration.h>
 #include <core/LogWriter.h>
 #include <core/Logger_stdio.h>
@@ -42,6 +44,7 @@
 #include <rfb/UnixPasswordValidator.h>
 #include <rfb/VNCServerST.h>
 
+#include <network/Poller.h>
 #include <network/TcpSocket.h>
 #include <network/UnixSocket.h>
 
@@ -356,33 +359,36 @@ int main(int argc, char** argv) {
 
     PollingScheduler sched((int)pollingCycle, (int)maxProcessorUsage);
 
+    // Only the descriptors that are actually ready are looked at on
+    // each wakeup, so idle connections cost (next to) nothing
+    network::Poller poller;
+    std::unordered_map<int, network::Socket*> sockets;
+
+    poller.add(ConnectionNumber(dpy), network::Poller::Read);
+    for (network::SocketListener* listener : listeners)
+      poller.add(listener->getFd(), network::Poller::Read);
+
     while (!caughtSignal) {
       int wait_ms, nextTimeout;
-      struct timeval tv;
-      fd_set rfds, wfds;
-      std::list<network::Socket*> sockets;
-      std::list<network::Socket*>::iterator i;
+      std::list<network::Socket*> closed;
 
       // Process any incoming X events
       TXWindow::handleXEvents(dpy);
 
-      FD_ZERO(&rfds);
-      FD_ZERO(&wfds);
+      // Without edge triggering we must only ask for write readiness
+      // when there is something to write
+      if (!network::Poller::edgeTriggered()) {
+        for (const std::pair<const int, network::Socket*>& sock : sockets) {
+          int events;
 
-      FD_SET(ConnectionNumber(dpy), &rfds);
-      for (network::SocketListener* listener : listeners)
-        FD_SET(listener->getFd(), &rfds);
-
-      server.getSockets(&sockets);
-      int clients_connected = 0;
-      for (i = sockets.begin(); i != sockets.end(); i++) {
-        FD_SET((*i)->getFd(), &rfds);
-        if ((*i)->outStream().hasBufferedData())
-          FD_SET((*i)->getFd(), &wfds);
-        clients_connected++;
+          events = network::Poller::Read;
+          if (sock.second->outStream().hasBufferedData())
+            events |= network::Poller::Write;
+          poller.modify(sock.first, events);
+        }
       }
 
-      if (!clients_connected)
+      if (sockets.empty())
         sched.reset();
 
       wait_ms = -1;
@@ -399,29 +405,19 @@ int main(int argc, char** argv) {
       if (nextTimeout >= 0 && (wait_ms == -1 || nextTimeout < wait_ms))
         wait_ms = nextTimeout;
 
-      tv.tv_sec = wait_ms / 1000;
-      tv.tv_usec = (wait_ms % 1000) * 1000;
-
       // Do the wait...
       sched.sleepStarted();
-      int n = select(FD_SETSIZE, &rfds, &wfds, nullptr, wait_ms >= 0 ? &tv : nullptr);
+      poller.wait(wait_ms);
       sched.sleepFinished();
 
-      if (n < 0) {
-        if (errno == EINTR) {
-          vlog.debug("Interrupted select() system call");
-          continue;
-        } else {
-          throw core::socket_error("select", errno);
-        }
-      }
-
       // Accept new VNC connections
       for (network::SocketListener* listener : listeners) {
-        if (FD_ISSET(listener->getFd(), &rfds)) {
+        if (poller.getEvents(listener->getFd()) & network::Poller::Read) {
           network::Socket* sock = listener->accept();
           if (sock) {
             server.addSocket(sock);
+            poller.add(sock->getFd(), network::Poller::Read | network::Poller::Write | network::Poller::EdgeTriggered);
+            sockets[sock->getFd()] = sock;
           } else {
             vlog.status("Client connection rejected");
           }
@@ -430,30 +426,32 @@ int main(int argc, char** argv) {
 
       core::Timer::checkTimeouts();
 
-      // Client list could have been changed.
-      server.getSockets(&sockets);
+      // Process events on existing VNC connections
+      for (const network::Poller::Event& event : poller.getReady()) {
+        std::unordered_map<int, network::Socket*>::iterator iter;
+        network::Socket* sock;
 
-      // Nothing more to do if there are no client connections.
-      if (sockets.empty())
-        continue;
+        iter = sockets.find(event.fd);
+        if (iter == sockets.end())
+          continue;
 
-      // Process events on existing VNC connections
-      for (i = sockets.begin(); i != sockets.end(); i++) {
-        if (FD_ISSET((*i)->getFd(), &rfds))
-          server.processSocketReadEvent(*i);
-        if (FD_ISSET((*i)->getFd(), &wfds))
-          server.processSocketWriteEvent(*i);
+        sock = iter->second;
+
+        if (event.events & network::Poller::Read)
+          server.processSocketReadEvent(sock);
+        if ((event.events & network::Poller::Write) && sock->outStream().hasBufferedData())
+          server.processSocketWriteEvent(sock);
 
         // Do a graceful close by waiting for the peer to close their
         // end
-        if ((*i)->isShutdown()) {
+        if (sock->isShutdown()) {
           bool done;
 
           done = false;
           while (true) {
             try {
-              (*i)->inStream().skip((*i)->inStream().avail());
-              if (!(*i)->inStream().hasData(1))
+              sock->inStream().skip(sock->inStream().avail());
+              if (!sock->inStream().hasData(1))
                 break;
             } catch (std::exception&) {
               done = true;
@@ -461,13 +459,18 @@ int main(int argc, char** argv) {
             }
           }
 
-          if (done) {
-            server.removeSocket(*i);
-            delete (*i);
-          }
+          if (done)
+            closed.push_back(sock);
         }
       }
 
+      for (network::Socket* sock : closed) {
+        poller.remove(sock->getFd());
+        sockets.erase(sock->getFd());
+        server.removeSocket(sock);
+        delete sock;
+      }
+
       if (desktop.isRunning() && sched.goodTimeToPoll()) {
         sched.newPass();
         desktop.poll();
@@ -277,6 +277,14 @@ void CConn::connect(const char* vncServerName, network::Socket* socket) {
 
   Fl::add_fd(sock->getFd(), FL_READ | FL_EXCEPT, socketEvent, this);
 
+#ifndef WIN32
+  // The server can only pass us its framebuffer over a Unix socket
+  if (::sharedMemory && (dynamic_cast<network::UnixSocket*>(sock) != nullptr)) {
+    sock->inStream().acceptFds(true);
+    supportsSharedMemory = true;
+  }
+#endif
+
   setServerName(serverHost.c_str());
   setStreams(&sock->inStream(), &sock->outStream());
 
@@ -686,6 +694,10 @@ void CConn::handleClipboardData(const char* data) {
   desktop->handleClipboardData(data);
 }
 
+int CConn::takePassedFd() {
+  return sock->inStream().takeFd();
+}
+
 ////////////////////// Internal methods //////////////////////
 
 void CConn::resizeFramebuffer() {
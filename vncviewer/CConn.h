@@ -93,6 +93,8 @@ protected:
   void handleClipboardAnnounce(bool available) override;
   void handleClipboardData(const char* data) override;
 
+  int takePassedFd() override;
+
 private:
   void resizeFramebuffer() override;
 
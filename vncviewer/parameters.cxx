@@ -183,6 +183,9 @@ core::BoolParameter fullscreenSystemKeys("FullscreenSystemKeys",
 
 #ifndef WIN32
 core::StringParameter via("via", "Gateway to tunnel via", "");
+core::BoolParameter sharedMemory("SharedMemory",
+                                 "Use the server's framebuffer in shared memory when connected via a Unix socket",
+                                 true);
 #endif
 
 // PersistentCache parameters (cross-session, content hashes)
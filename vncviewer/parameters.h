@@ -80,6 +80,7 @@ extern core::BoolParameter reconnectOnError;
 
 #ifndef WIN32
 extern core::StringParameter via;
+extern core::BoolParameter sharedMemory;
 #endif
 
 // PersistentCache parameters